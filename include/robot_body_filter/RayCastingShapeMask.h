@@ -1,14 +1,18 @@
 #ifndef ROBOT_BODY_FILTER_RAYCASTINGSHAPEMASK_H
 #define ROBOT_BODY_FILTER_RAYCASTINGSHAPEMASK_H
 
+#include <functional>
 #include <vector>
 #include <map>
 #include <unordered_set>
 
 #include <moveit/point_containment_filter/shape_mask.h>
 
+#include <robot_body_filter/utils/batch_contains_test.h>
 #include <robot_body_filter/utils/bodies.h>
 #include <robot_body_filter/utils/cloud.h>
+#include <robot_body_filter/utils/depth_image_rasterizer.h>
+#include <robot_body_filter/utils/spherical_depth_map.h>
 #include <geometric_shapes/body_operations.h>
 #include <ros/console.h>
 
@@ -239,6 +243,43 @@ public:
       std::vector<MaskValue>& mask,
       const Eigen::Vector3d& sensorPos = Eigen::Vector3d::Zero());
 
+  /** \brief Variant of maskContainmentAndShadows() for points given directly by their coordinates, e.g.
+   * laser scan beams projected from their polar coordinates without building a pointcloud.
+   *
+   * \param [in] data The input points (in the filtering frame). Points containing NaNs are OUTSIDE.
+   * \param [out] mask The mask value of all the points. Ordered by point index.
+   * \param [in] sensorPos Position of the sensor in the filtering frame.
+   *
+   * \note Internally calls updateBodyPoses() to update link transforms.
+   */
+  void maskContainmentAndShadows(
+      const std::vector<Eigen::Vector3f>& data,
+      std::vector<MaskValue>& mask,
+      const Eigen::Vector3d& sensorPos = Eigen::Vector3d::Zero());
+
+  /** \brief Variant of maskContainmentAndShadows() for pointclouds captured by a depth camera. Instead
+   * of testing each point against each body, the bodies are rasterized into the pixels of the camera
+   * and each point is compared to the depths at which the ray of its pixel enters and exits the
+   * bodies. This costs O(triangles + pixels) instead of O(points * bodies).
+   *
+   * \param [in] data The input pointcloud (in the filtering frame).
+   * \param [out] mask The mask value of all the points. Ordered by point index.
+   * \param [in] sensorPose Pose of the camera optical frame in the filtering frame.
+   * \param [in] camera Intrinsics of the camera.
+   *
+   * \note Points are classified by the rays through pixel centers, so the results can differ from
+   *       maskContainmentAndShadows() for points less than a pixel away from the silhouettes of the
+   *       bodies. Meshes are rasterized using their scaled vertices.
+   * \note Points not seen by any pixel (or sharing a pixel with another point) and bodies which
+   *       cannot be rasterized (meshes crossing the camera plane) are tested by the per-point tests.
+   * \note Internally calls updateBodyPoses() to update link transforms.
+   */
+  void maskContainmentAndShadows(
+      const Cloud& data,
+      std::vector<MaskValue>& mask,
+      const Eigen::Isometry3d& sensorPose,
+      const DepthCamera& camera);
+
   /** \brief Decide whether the point is either INSIDE the robot,
    * OUTSIDE of it, SHADOWed by the robot body, or CLIPped by min/max sensor
    * measurement distance. INSIDE points can also be viewed as being SHADOW
@@ -259,6 +300,32 @@ public:
       const Eigen::Vector3d& sensorPos = Eigen::Vector3d::Zero(),
       bool updateBodyPoses = true);
 
+  /** \brief Variant of maskContainmentAndShadows() for pointclouds captured point by point (e.g. by
+   * rotating lidars), where each point has its own viewpoint and the robot moves during the capture.
+   * The points are split into bins. Body poses are updated once at the start of each bin, and then all
+   * points of the bin are classified together (in parallel if multiple threads are used). This is
+   * equivalent to calling the single-point variant for each point, but the lock is only taken once.
+   *
+   * \param [in] data The input pointcloud (in the filtering frame). Unless viewpoints are given, it
+   *                  has to contain float fields vp_x, vp_y and vp_z with the viewpoint of each point.
+   * \param [out] mask The mask value of all the points. Ordered by point index.
+   * \param [in] binStarts Indices of the first points of the bins (in increasing order). Points before
+   *                       the first bin are classified with the current body poses.
+   * \param [in] beforeBodyPosesUpdate If set, it is called with the index of the first point of a bin
+   *                                   right before the body poses are updated for the bin (e.g. to
+   *                                   tell the transform callback which time to use).
+   * \param [in] viewpoints If non-null, the viewpoint of each point (indexed by point index), used
+   *                        instead of the viewpoint fields of the cloud.
+   *
+   * \note The shadow depth map is not used, as it is only valid for a single viewpoint.
+   */
+  void maskContainmentAndShadows(
+      const Cloud& data,
+      std::vector<MaskValue>& mask,
+      const std::vector<size_t>& binStarts,
+      const std::function<void(size_t)>& beforeBodyPosesUpdate = {},
+      const EigenSTL::vector_Vector3d* viewpoints = nullptr);
+
   /**
    * \brief Set the shapes to be ignored when doing test for INSIDE in maskContainmentAndShadows.
    * \param ignoreInContainsTest The shapes to be ignored.
@@ -282,6 +349,81 @@ public:
       std::unordered_set<MultiShapeHandle> ignoreInShadowTest,
       bool updateInternalStructures = true);
 
+  /**
+   * \brief Set the shapes whose pose never changes (e.g. links attached to the filtering frame by fixed
+   *        joints).
+   * \param staticShapes The static shapes.
+   * \note The pose of a static shape is requested from the transform callback only until it succeeds for
+   *       the first time. After that, the pose and the bounding spheres of its bodies are not recomputed.
+   */
+  void setStaticShapes(std::unordered_set<MultiShapeHandle> staticShapes);
+
+  /**
+   * \brief Set the number of threads used for classifying pointclouds in
+   *        maskContainmentAndShadows().
+   * \param numThreads Total number of threads including the calling one. 1 means no parallelism,
+   *                   0 means number of CPU cores minus one. The value is capped at the number of
+   *                   CPU cores.
+   * \param cpuAffinity If not empty, the worker threads are pinned to these CPUs.
+   * \note The worker threads are persistent, they are only restarted by calling this function.
+   */
+  void setNumThreads(size_t numThreads, const std::vector<int>& cpuAffinity = {});
+
+  /**
+   * \brief Get the number of threads used for classifying pointclouds.
+   * \return The number of threads (including the calling one).
+   */
+  size_t getNumThreads() const;
+
+  /**
+   * \brief Set whether points should be classified in single precision.
+   * \param singlePrecision If true, clipping, bounding sphere tests, contains tests and shadow tests
+   *                        of spheres, boxes and cylinders are computed in float. Meshes are still
+   *                        tested in double (after float prefiltering by their bounding volumes).
+   * \note Single precision is faster, but the results can differ from the double-precision ones
+   *       for points closer to a body surface (or to the clipping distances) than a few float
+   *       epsilons (1.2e-7) times the magnitude of the coordinates. For a robot and points within
+   *       10 m from the origin of the filtering frame, this is less than approx. 1e-5 m.
+   */
+  void setSinglePrecision(bool singlePrecision);
+
+  /**
+   * \brief Set whether the shadow test of pointclouds should be accelerated by a spherical depth map.
+   * \param useShadowDepthMap If true, maskContainmentAndShadows() of a pointcloud first renders the
+   *                          bounding spheres of the bodies for shadow test into a spherical depth
+   *                          map centered at the sensor. Points nearer to the sensor than the depth
+   *                          stored in their direction cannot be shadowed and are not ray-tested.
+   *                          All other points are tested exactly, so the results do not change.
+   * \param angularResolution Angular size of the depth map bins (rad).
+   * \note This pays off for scans captured all at once from a single viewpoint (e.g. from a depth
+   *       camera). The single-point maskContainmentAndShadows() ignores this setting.
+   */
+  void setShadowDepthMap(bool useShadowDepthMap, double angularResolution = 0.01);
+
+  /**
+   * \brief Set the resolution of voxel grids used for contains test of meshes.
+   * \param resolution Edge length of the voxels (m). If positive, each mesh body for contains test
+   *                   is voxelized in its own frame when it is added, and points are tested by
+   *                   a lookup in the grid. Only points in voxels the body surface can pass through
+   *                   are tested by the exact test, so the results do not change. If zero, the
+   *                   meshes are tested only by the exact test.
+   * \note Spheres, boxes and cylinders are not voxelized, their exact test is faster than a lookup.
+   * \note Changing the resolution rebuilds the grids of all already added shapes.
+   */
+  void setContainsTestVoxelResolution(double resolution);
+
+  /**
+   * \brief Set the resolution of signed distance fields used for contains test of meshes.
+   * \param resolution Distance of the grid nodes (m). If positive, the signed distance field of each
+   *                   mesh body for contains test is sampled in its own frame when it is added, and
+   *                   points are tested by interpolating it. Only points whose distance from the
+   *                   surface is within the interpolation tolerance are tested by the exact test, so
+   *                   the results do not change. If zero, no distance fields are built.
+   * \note If voxel grids are enabled, they are used instead of the distance fields.
+   * \note Changing the resolution rebuilds the fields of all already added shapes.
+   */
+  void setContainsTestDistanceFieldResolution(double resolution);
+
   /**
    * \brief Provides the map of shape handle to corresponding body (for all added shapes).
    * \return Map shape_handle->body* .
@@ -341,6 +483,12 @@ protected:
    *                  into which transform_callback_ transforms the body parts.
    * \param [out] mask The mask value of the given point.
    * \param [in] sensorPos Position of the sensor in the pointcloud frame.
+   * \param [in] containsTestResults If non-null, results of the batched contains test of this
+   *                                 point. The result for the b-th body of the batch has to be at
+   *                                 containsTestResults[b * BatchContainsTest::BLOCK_SIZE]. If
+   *                                 null, all bodies are tested by the exact per-point test.
+   * \param [in] shadowDepthMap If non-null, depth map of the bodies for shadow test built for
+   *                            sensorPos. Points nearer than the map depth are not ray-tested.
    *
    * \note Contrasting to maskContainmentAndShadows(), this method doesn't
    *       update link poses and expects them to be correctly updated by a prior
@@ -349,8 +497,130 @@ protected:
   void classifyPointNoLock(
       const Eigen::Vector3d& data,
       MaskValue &mask,
+      const Eigen::Vector3d& sensorPos,
+      const BatchContainsTest::Result* containsTestResults = nullptr,
+      const SphericalDepthMap* shadowDepthMap = nullptr);
+
+  /**
+   * \brief Single-precision variant of classifyPointNoLock().
+   * \sa setSinglePrecision()
+   */
+  void classifyPointSinglePrecisionNoLock(
+      const Eigen::Vector3f& data,
+      MaskValue &mask,
+      const Eigen::Vector3f& sensorPos,
+      const BatchContainsTest::Result* containsTestResults = nullptr,
+      const SphericalDepthMap* shadowDepthMap = nullptr);
+
+  /**
+   * \brief Fill the batched contains test with the current poses of the bodies for contains test.
+   *        Spheres, boxes and cylinders are put into the batch as they are, all other bodies are
+   *        represented by their bounding spheres and boxes (and points inside these bounds are
+   *        tested by the exact per-point test).
+   * \note The caller has to hold a lock to shapes_mutex_.
+   */
+  void updateBatchContainsTestNoLock();
+
+  /**
+   * \brief Rebuild the bounding volume hierarchy of the bodies for shadow test using their current
+   *        poses.
+   * \note The caller has to hold a lock to shapes_mutex_.
+   */
+  void updateShadowTestHierarchyNoLock();
+
+  /**
+   * \brief Compute the bounding sphere of the given body in its current pose. Bounding spheres of
+   *        static shapes are only computed once after they are posed.
+   * \param handle Handle of the body.
+   * \param body The body.
+   * \param bsphere The bounding sphere.
+   * \note The caller has to hold a lock to shapes_mutex_.
+   */
+  void computeBoundingSphereNoLock(point_containment_filter::ShapeHandle handle, const bodies::Body& body,
+                                   bodies::BoundingSphere& bsphere);
+
+  /**
+   * \brief Compute the axis-aligned bounding box of the given body in its current pose. Bounding boxes of
+   *        static shapes are only computed once after they are posed.
+   * \param handle Handle of the body.
+   * \param body The body.
+   * \param box The bounding box.
+   * \note The caller has to hold a lock to shapes_mutex_.
+   */
+  void computeBoundingBoxNoLock(point_containment_filter::ShapeHandle handle, const bodies::Body& body,
+                                bodies::AxisAlignedBoundingBox& box);
+
+  /**
+   * \brief Render the current poses of the bodies for shadow test into the shadow depth map.
+   * \param sensorPos Position of the sensor (the center of the depth map).
+   * \note The caller has to hold a lock to shapes_mutex_ and update the body poses.
+   */
+  void updateShadowDepthMapNoLock(const Eigen::Vector3d& sensorPos);
+
+  /**
+   * \brief Build (or remove) the voxel grid or distance field of the given body for contains test
+   *        according to the current voxel and distance field resolutions.
+   * \param handle Handle of the body.
+   * \param body The body. Only meshes get a grid or a distance field.
+   * \note The caller has to hold a lock to shapes_mutex_.
+   */
+  void updateContainsTestGridNoLock(point_containment_filter::ShapeHandle handle, const bodies::Body* body);
+
+  /**
+   * \brief Exact contains test of the given body of the batched contains test. If the body has a voxel
+   *        grid or a distance field, it is used and only points near the body surface are tested by
+   *        the body itself.
+   * \param body Index of the body in the batched contains test.
+   * \param point The point to test.
+   * \return Whether the point is inside the body.
+   * \note The caller has to hold a lock to shapes_mutex_.
+   */
+  bool batchBodyContainsPointNoLock(size_t body, const Eigen::Vector3d& point) const;
+
+  /**
+   * \brief Classify all points of the given points sharing one sensor position. See maskContainmentAndShadows().
+   * \tparam Points Cloud or std::vector<Eigen::Vector3f>.
+   * \param [in] data The input points.
+   * \param [in] np Number of the points.
+   * \param [out] mask The mask values.
+   * \param [in] sensorPos Position of the sensor in the frame of the points.
+   * \note The caller has to hold a lock to shapes_mutex_.
+   */
+  template<typename Points>
+  void maskAllContainmentAndShadowsNoLock(
+      const Points& data, size_t np,
+      std::vector<MaskValue>& mask,
       const Eigen::Vector3d& sensorPos);
 
+  /**
+   * \brief Classify points [start, end) of the given points. See maskContainmentAndShadows().
+   * \tparam Points Cloud or std::vector<Eigen::Vector3f>.
+   * \param [in] data The input points.
+   * \param [in] start Index of the first point to classify.
+   * \param [in] end Index after the last point to classify.
+   * \param [out] mask The mask values. Has to be already resized to the number of points.
+   * \param [in] sensorPos Position of the sensor in the pointcloud frame.
+   * \param [in,out] containsTestResults Scratch buffer for the batched contains test.
+   * \param [in] shadowDepthMap If non-null, depth map of the bodies for shadow test built for
+   *                            sensorPos.
+   * \param [in] viewpoints If non-null, the sensor position of each point (indexed by point index),
+   *                        used instead of sensorPos.
+   * \note The caller has to hold a lock to shapes_mutex_ and update the body poses. Calls with
+   *       disjoint ranges can run in parallel.
+   */
+  template<typename Points>
+  void maskContainmentAndShadowsNoLock(
+      const Points& data, size_t start, size_t end,
+      std::vector<MaskValue>& mask,
+      const Eigen::Vector3d& sensorPos,
+      std::vector<BatchContainsTest::Result>& containsTestResults,
+      const SphericalDepthMap* shadowDepthMap = nullptr,
+      const EigenSTL::vector_Vector3d* viewpoints = nullptr);
+
+  //! Number of points classified by one task of the parallel pointcloud classification. The points
+  //! of one task (together with the mask values) fit into L1 cache.
+  static constexpr size_t POINTS_PER_TASK = 1024;
+
   /**
    * \brief Get the bounding sphere containing all registered shapes.
    * \return The bounding sphere of the mask.
@@ -364,6 +634,12 @@ protected:
    */
   bodies::BoundingSphere getBoundingSphereForContainsTestNoLock() const;
 
+  /**
+   * \brief Get the number of threads used for classifying pointclouds.
+   * \return The number of threads (including the calling one).
+   */
+  size_t getNumThreadsNoLock() const;
+
   double minSensorDist; //!< Minimum sensing distance of the sensor.
   double maxSensorDist; //!< Maximum sensing distance of the sensor.
   double maxShadowDist; //!< Maximum distance of a point classified as SHADOW (further are OUTSIDE).
@@ -371,6 +647,11 @@ protected:
   bool doClipping = true; //!< Classify for CLIP during masking.
   bool doContainsTest = true; //!< Classify for INSIDE during masking.
   bool doShadowTest = true; //!< Classify for SHADOW during masking.
+  bool singlePrecision = false; //!< Classify points in single precision.
+  bool useShadowDepthMap = false; //!< Prefilter the shadow test of pointclouds by a depth map.
+  double containsTestVoxelResolution = 0.0; //!< Resolution of voxel grids of meshes (0 = no grids).
+  //! Resolution of signed distance fields of meshes (0 = no fields).
+  double containsTestDistanceFieldResolution = 0.0;
 
   class RayCastingShapeMaskPIMPL;
   std::unique_ptr<RayCastingShapeMaskPIMPL> data; //!< Implementation-private data.
@@ -390,6 +671,11 @@ protected:
    * bspheresForContainsTest. Values of this vector correspond to indices in bodies_.
    */
   std::vector<size_t> bspheresForContainsTestBodyIndices;
+  /**
+   * \brief Bounding boxes of the bodies for contains test. Indices in this vector correspond to indices in
+   * bspheresForContainsTest.
+   */
+  std::vector<bodies::AxisAlignedBoundingBox> bboxesForContainsTest;
 
   /** \brief Shapes to be ignored when doing test for INSIDE in maskContainmentAndShadows. */
   std::unordered_set<MultiShapeHandle> ignoreInContainsTest;
@@ -400,6 +686,8 @@ protected:
   std::unordered_set<MultiShapeHandle> ignoreInBsphere;
   /** \brief Shapes to be ignored when computing the robot's bounding box. */
   std::unordered_set<MultiShapeHandle> ignoreInBbox;
+  /** \brief Shapes whose pose never changes. */
+  std::unordered_set<MultiShapeHandle> staticShapes;
 };
 
 }
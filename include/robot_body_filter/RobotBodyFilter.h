@@ -1,6 +1,7 @@
 #ifndef ROBOT_BODY_FILTER_ROBOTSELFFILTER_H_
 #define ROBOT_BODY_FILTER_ROBOTSELFFILTER_H_
 
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <set>
@@ -14,11 +15,16 @@
 
 #include <ros/ros.h>
 #include <robot_body_filter/utils/filter_utils.hpp>
+#include <robot_body_filter/utils/joint_state_buffer.h>
+#include <robot_body_filter/utils/pose_keyframe_table.h>
 #include <robot_body_filter/utils/tf2_sensor_msgs.h>
+#include <sensor_msgs/CameraInfo.h>
 #include <sensor_msgs/LaserScan.h>
 #include <robot_body_filter/RayCastingShapeMask.h>
 #include <moveit/occupancy_map_monitor/occupancy_map_updater.h>
 #include <moveit/robot_model/aabb.h>
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/robot_state/robot_state.h>
 #include <urdf/model.h>
 #include <laser_geometry/laser_geometry.h>
 #include <geometric_shapes/mesh_operations.h>
@@ -46,9 +52,13 @@ struct CollisionBodyWithLink {
   size_t indexInCollisionArray;
   MultiShapeHandle multiHandle;
   std::string cacheKey;
+  //! Dense index of the collision body in the transform caches (assigned when the model is loaded).
+  size_t cacheSlot;
+  //! Dense index of the link frame of the collision body (assigned when the model is loaded).
+  size_t linkSlot;
 
   CollisionBodyWithLink() :
-      indexInCollisionArray(0), cacheKey("__empty__") {
+      indexInCollisionArray(0), cacheKey("__empty__"), cacheSlot(0), linkSlot(0) {
   }
 
   CollisionBodyWithLink(urdf::CollisionSharedPtr collision,
@@ -56,7 +66,7 @@ struct CollisionBodyWithLink {
                         const size_t indexInCollisionArray,
                         const MultiShapeHandle& multiHandle):
       collision(collision), link(link), indexInCollisionArray(indexInCollisionArray),
-      multiHandle(multiHandle)
+      multiHandle(multiHandle), cacheSlot(0), linkSlot(0)
   {
     std::ostringstream stream;
     stream << link->name << "-" << indexInCollisionArray;
@@ -122,6 +132,12 @@ protected:
    */
   bool pointByPointScan;
 
+  /** \brief If true, the viewpoints of points of a pointByPointScan are not read from the vp_x, vp_y and
+   * vp_z fields, but computed as the origin of the sensor frame at the time of each point (interpolated
+   * between poses looked up from TF at the scan keyframes).
+   */
+  bool viewpointsFromTf;
+
   //! Whether to keep pointcloud organized or not (if not, invalid points are
   //! removed).
   bool keepCloudsOrganized;
@@ -135,6 +151,22 @@ protected:
    */
   ros::Duration modelPoseUpdateInterval;
 
+  /** \brief Number of time instants spread uniformly over a pointByPointScan at which the link
+   * transforms are looked up (including the scan start and end). The transforms between them are
+   * interpolated piecewise.
+   */
+  size_t numScanKeyframes;
+
+  /** \brief If true, links connected to the filtering frame only by fixed joints get their poses from the
+   * URDF once when the model is loaded, and they are not looked up in TF for each scan.
+   */
+  bool cacheFixedLinkTransforms;
+
+  /** \brief If true, link poses are computed by forward kinematics of the robot model from joint states
+   * and a single TF lookup of the model root. Links not covered by the joint states are looked up in TF.
+   */
+  bool forwardKinematics;
+
   /** \brief Fixed frame wrt the sensor frame.
    * Usually base_link for stationary robots (or sensor frame if both
    * robot and sensor are stationary). For mobile robots, it can be e.g.
@@ -158,6 +190,9 @@ protected:
   //! The maximum distance of points from the sensor origin to apply this filter on (in meters).
   double maxDistance;
 
+  //! Whether to mark points outside minDistance and maxDistance as CLIP.
+  bool doClipping;
+
   //! The default inflation that is applied to the collision model for the purposes of checking if a point is contained
   //! by the robot model (scale 1.0 = no scaling, padding 0.0 = no padding). Every collision element is scaled
   //! individually with the scaling center in its origin. Padding is added individually to every collision element.
@@ -199,8 +234,16 @@ protected:
   //! Name of the parameter where the robot model can be found.
   std::string robotDescriptionParam;
 
+  //! If positive, collision meshes are simplified with this maximum error (in meters) when the model is loaded.
+  double meshSimplificationMaxError;
+
   //! Subscriber for robot_description updates.
   ros::Subscriber robotDescriptionUpdatesListener;
+
+  //! Subscriber of joint states used for forward kinematics.
+  ros::Subscriber jointStatesSubscriber;
+  //! History of joint states used for forward kinematics.
+  std::unique_ptr<JointStateBuffer> jointStates;
   //! Name of the field in the dynamic reconfigure message that contains robot model.
   std::string robotDescriptionUpdatesFieldName;
 
@@ -301,8 +344,6 @@ protected:
 
   //! Timeout for reachable transforms.
   ros::Duration reachableTransformTimeout;
-  //! Timeout for unreachable transforms.
-  ros::Duration unreachableTransformTimeout;
 
   //! Whether to process data when there are some unreachable frames.
   bool requireAllFramesReachable;
@@ -333,10 +374,62 @@ protected:
   std::set<point_containment_filter::ShapeHandle> shapesIgnoredInBoundingSphere;
   std::set<point_containment_filter::ShapeHandle> shapesIgnoredInBoundingBox;
 
-  //! Caches any link->fixedFrame transforms after a scan message is received. Is queried by robot_shape_mask. Keys are CollisionBodyWithLink#cacheKey.
-  std::map<std::string, std::shared_ptr<Eigen::Isometry3d> > transformCache;
-  //! Caches any link->fixedFrame transforms at the time of scan end. Only used for pointByPoint scans. Is queried by robot_shape_mask. Keys are CollisionBodyWithLink#cacheKey.
-  std::map<std::string, std::shared_ptr<Eigen::Isometry3d> > transformCacheAfterScan;
+  //! All collision bodies of the model. Indexed by CollisionBodyWithLink#cacheSlot.
+  std::vector<CollisionBodyWithLink> collisionBodies;
+  //! Cache slot of each shape handle (indexed by the handle, -1 for unknown handles).
+  std::vector<int> shapeCacheSlots;
+  //! Distinct link frames of collisionBodies. Indexed by CollisionBodyWithLink#linkSlot.
+  std::vector<std::string> collisionLinkFrames;
+
+  //! Link transforms resolved in the last updateTransformCache() call, one per link and keyframe (row-major).
+  EigenSTL::vector_Isometry3d linkTransforms;
+  //! Whether each item of linkTransforms has been resolved.
+  std::vector<std::uint8_t> linkTransformsValid;
+
+  //! Scratch buffers for the batched TF lookups in updateTransformCache(): the looked up frames, their link
+  //! slots, the transforms and whether they were found.
+  std::vector<std::string> lookupFrames;
+  std::vector<size_t> lookupLinkSlots;
+  std::vector<geometry_msgs::TransformStamped> lookupResults;
+  std::vector<std::uint8_t> lookupFound;
+  //! Whether the link never moves relative to the filtering frame. Indexed by CollisionBodyWithLink#linkSlot.
+  std::vector<std::uint8_t> staticLinks;
+  //! Poses of the static links in the filtering frame (computed from the URDF). Indexed by CollisionBodyWithLink#linkSlot.
+  EigenSTL::vector_Isometry3d staticLinkTransforms;
+
+  //! Kinematic model of the first loaded robot model (only used with forwardKinematics).
+  moveit::core::RobotModelConstPtr fkRobotModel;
+  //! Scratch state of fkRobotModel.
+  std::unique_ptr<moveit::core::RobotState> fkRobotState;
+  //! Active joints of fkRobotModel.
+  std::vector<const moveit::core::JointModel*> fkJoints;
+  //! Names of the variables of fkJoints (in the order of the joints).
+  std::vector<std::string> fkVariableNames;
+  //! Scratch buffer for the positions of fkVariableNames.
+  std::vector<double> fkVariablePositions;
+  //! Scratch buffer telling whether the joint states contain each of fkVariableNames.
+  std::vector<std::uint8_t> fkVariablesFound;
+  //! Scratch buffer telling whether the joint states contain all variables of each of fkJoints.
+  std::vector<std::uint8_t> fkJointsFound;
+  //! Link of fkRobotModel corresponding to each link frame (null if it is not a part of it). Indexed by CollisionBodyWithLink#linkSlot.
+  std::vector<const moveit::core::LinkModel*> fkLinks;
+  //! Indices (to fkJoints) of the joints moving each of fkLinks relative to the model root. Indexed by CollisionBodyWithLink#linkSlot.
+  std::vector<std::vector<size_t>> fkLinkJoints;
+  //! Scratch buffer telling which of fkLinks can be computed from the current joint states.
+  std::vector<std::uint8_t> fkLinksFound;
+
+  //! Caches any link->fixedFrame transforms after a scan message is received. Is queried by robot_shape_mask. Indexed by CollisionBodyWithLink#cacheSlot.
+  EigenSTL::vector_Isometry3d transformCache;
+  //! Whether each item of transformCache has been found in the last update.
+  std::vector<std::uint8_t> transformCacheValid;
+  //! Poses of the collision bodies at keyframes across the scan. Only used for pointByPoint scans. Is queried by robot_shape_mask. Rows are CollisionBodyWithLink#cacheSlot.
+  PoseKeyframeTable scanKeyframes;
+  //! Poses of the sensor frame at keyframes across the scan. Only used if viewpointsFromTf is true.
+  PoseKeyframeTable sensorKeyframes;
+  //! Number of the leading keyframes of sensorKeyframes found in the last updateTransformCache() call.
+  size_t numSensorKeyframesFound = 0;
+  //! Viewpoints of the points of the last scan. Only used if viewpointsFromTf is true.
+  EigenSTL::vector_Vector3d viewpoints;
 
   //! If the scan is pointByPoint, set this variable to the ratio between scan start and end time you're looking for with getShapeTransform().
   mutable double cacheLookupBetweenScansRatio;
@@ -357,11 +450,30 @@ protected:
    * \param sensorFrame Sensor frame id. Only needed for scans with all points
    *                    captured at the same time. Point-by-point scans read
    *                    sensor position from the viewpoint channels.
+   * \param depthCamera If not null, the cloud was captured by this depth camera
+   *                    with optical frame sensorFrame, and the mask is computed
+   *                    by rasterizing the robot into the camera pixels.
    * \return Whether the computation succeeded.
    */
   bool computeMask(const sensor_msgs::PointCloud2& projectedPointCloud,
                    std::vector<RayCastingShapeMask::MaskValue>& mask,
-                   const std::string& sensorFrame = "");
+                   const std::string& sensorFrame = "",
+                   const DepthCamera* depthCamera = nullptr);
+
+  /** \brief Compute the viewpoint of each point of a pointByPointScan from its stamp.
+   *
+   * The viewpoint is the origin of sensorFrame (wrt filtering frame) at the time of the point,
+   * interpolated between its poses at the scan keyframes.
+   *
+   * You should call updateTransformCache before calling this function (it fills sensorKeyframes).
+   *
+   * \param projectedPointCloud The scan. It has to contain float32 field stamps.
+   * \param scanDuration Duration of the scan (the largest stamp).
+   * \param[out] viewpoints The viewpoints (indexed by point index).
+   * \return Whether the sensor poses were found at all keyframes.
+   */
+  bool computeViewpoints(const sensor_msgs::PointCloud2& projectedPointCloud, double scanDuration,
+                         EigenSTL::vector_Vector3d& viewpoints);
 
   /** \brief Return the latest cached transform for the link corresponding to the given shape handle.
    *
@@ -390,9 +502,34 @@ protected:
    *
    * \param time The time to get transforms for.
    * \param afterScantime The after scan time to get transforms for (if zero time is passed, after scan transforms are not computed).
+   *                      If nonzero, the scanKeyframes table is filled (and also sensorKeyframes if
+   *                      viewpointsFromTf is true).
    */
   void updateTransformCache(const ros::Time& time, const ros::Time& afterScanTime = ros::Time(0));
 
+  /** \brief Compute the link transforms of one keyframe by forward kinematics from the joint states.
+   *
+   * Only fills the items of linkTransforms of the links of fkRobotModel that are not static and whose
+   * joints (all joints between them and the model root) are all covered by the joint states. The other
+   * links are left to be looked up in TF.
+   *
+   * \param time The time to get transforms for.
+   * \param scanTime Time of the scan start (the TF timeout is computed from it).
+   * \param keyframe Index of the keyframe.
+   * \param numKeyframes Number of keyframes in linkTransforms.
+   * \return Whether at least one link was computed (i.e. some links were covered by the joint states and
+   *         the pose of the model root was available).
+   */
+  bool updateLinkTransformsFromJointStates(const ros::Time& time, const ros::Time& scanTime, size_t keyframe,
+                                           size_t numKeyframes);
+
+  /**
+   * \brief Callback storing the received joint states for forward kinematics.
+   *
+   * \param jointState The joint states.
+   */
+  void jointStatesReceived(const sensor_msgs::JointStateConstPtr& jointState);
+
   /**
    * \brief Callback handling update of the robot_description parameter using dynamic reconfigure.
    *
@@ -465,6 +602,39 @@ protected:
 
   // in RobotBodyFilterLaserScan::update we project the scan to a pointcloud with viewpoints
   const std::unordered_map<std::string, CloudChannelType> channelsToTransform { {"vp_", CloudChannelType::POINT} };
+
+  //! Whether all-at-once scans are classified directly from the angles and ranges of the beams.
+  bool directScanClassification = true;
+
+  //! Cosines of the beam angles of the scan geometry given by beamTablesAngleMin and beamTablesAngleIncrement.
+  std::vector<float> beamCosines;
+  //! Sines of the beam angles of the scan geometry given by beamTablesAngleMin and beamTablesAngleIncrement.
+  std::vector<float> beamSines;
+  float beamTablesAngleMin = 0.0f;
+  float beamTablesAngleIncrement = 0.0f;
+
+  //! Scratch buffer of the beam endpoints in the filtering frame.
+  std::vector<Eigen::Vector3f> beamPoints;
+  //! Scratch buffer of the mask of the beams.
+  std::vector<RayCastingShapeMask::MaskValue> beamMask;
+
+  /**
+   * \brief Classify the beams of an all-at-once scan directly from their angles and ranges and mark the
+   *        filtered beams in filteredScan by NaNs.
+   * \param inputScan The scan to filter.
+   * \param filteredScan The output scan. It has to be a copy of inputScan with adjusted range limits.
+   * \param scanFrame Frame of the scan.
+   * \return Whether the scan was filtered.
+   * \note The caller has to hold a lock to modelMutex.
+   */
+  bool classifyScanDirectly(const sensor_msgs::LaserScan& inputScan, sensor_msgs::LaserScan& filteredScan,
+                            const std::string& scanFrame);
+
+  /**
+   * \brief Precompute the sines and cosines of the beam angles if the geometry of the scan has changed.
+   * \param scan The scan.
+   */
+  void updateBeamTables(const sensor_msgs::LaserScan& scan);
 };
 
 class RobotBodyFilterPointCloud2 : public RobotBodyFilter<sensor_msgs::PointCloud2>
@@ -480,6 +650,27 @@ protected:
   std::string outputFrame;
 
   std::unordered_map<std::string, CloudChannelType> channelsToTransform;
+
+  //! Subscriber of the camera info used for filtering organized clouds by rasterization.
+  ros::Subscriber cameraInfoSubscriber;
+  //! The last received camera info (null until one is received).
+  sensor_msgs::CameraInfoConstPtr cameraInfo;
+  //! Mutex guarding cameraInfo.
+  std::mutex cameraInfoMutex;
+
+  /**
+   * \brief Store the camera info.
+   * \param msg The camera info.
+   */
+  void cameraInfoReceived(const sensor_msgs::CameraInfoConstPtr& msg);
+
+  /**
+   * \brief Get the intrinsics of the depth camera which captured the given cloud.
+   * \param cloud The cloud.
+   * \param [out] camera The intrinsics.
+   * \return Whether the cloud is organized and matches the last received camera info.
+   */
+  bool getDepthCamera(const sensor_msgs::PointCloud2& cloud, DepthCamera& camera);
 };
 
 }
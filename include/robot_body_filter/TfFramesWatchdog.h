@@ -1,16 +1,22 @@
 #ifndef ROBOT_BODY_FILTER_TFFRAMESWATCHDOG_H
 #define ROBOT_BODY_FILTER_TFFRAMESWATCHDOG_H
 
+#include <condition_variable>
+#include <cstdint>
+#include <map>
 #include <mutex>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <thread>
+#include <vector>
 
 #include <ros/ros.h>
 #include <tf2_ros/buffer.h>
 #include <tf2_ros/transform_listener.h>
 
 #include <robot_body_filter/utils/optional.hpp>
+#include <robot_body_filter/utils/transform_memo.h>
 
 namespace robot_body_filter {
 
@@ -19,16 +25,36 @@ namespace robot_body_filter {
  *        frames haven't got unreachable (in which case the node tries to get
  *        the transforms with longer timeouts but doesn't block other queries).
  *
- * Runs a separate thread.
+ * Unreachable frames are watched by transformable requests of the TF buffer, so they are marked
+ * reachable as soon as the connecting transforms arrive. Runs a separate thread which (re)issues
+ * the requests without blocking.
  *
  * \author Martin Pecka
  */
 class TFFramesWatchdog {
 public:
+  /**
+   * \param robotFrame The target frame of all watched transforms.
+   * \param monitoredFrames The frames to watch.
+   * \param tfBuffer The TF buffer.
+   * \param unreachableFramesCheckRate Rate at which the requests watching unreachable frames are renewed
+   *                                   if they fail (e.g. after a time jump). Changes of the monitored frames
+   *                                   are handled immediately.
+   */
+  TFFramesWatchdog(std::string robotFrame,
+                   std::set<std::string>  monitoredFrames,
+                   std::shared_ptr<tf2_ros::Buffer> tfBuffer,
+                   ros::Rate unreachableFramesCheckRate = ros::Rate(1.0));
+
+  /**
+   * \deprecated Unreachable frames are not waited for, so unreachableTfLookupTimeout has no effect. Use the
+   *             constructor without it.
+   */
+  [[deprecated("unreachableTfLookupTimeout has no effect, use the constructor without it")]]
   TFFramesWatchdog(std::string robotFrame,
                    std::set<std::string>  monitoredFrames,
                    std::shared_ptr<tf2_ros::Buffer> tfBuffer,
-                   ros::Duration unreachableTfLookupTimeout = ros::Duration(0, 100000000),  // 0.1 sec
+                   ros::Duration unreachableTfLookupTimeout,
                    ros::Rate unreachableFramesCheckRate = ros::Rate(1.0));
 
   virtual ~TFFramesWatchdog();
@@ -63,7 +89,7 @@ public:
   void stop();
 
   /**
-   * \brief Clear shapes_to_links, reachable_frames and tf_buffer.
+   * \brief Clear shapes_to_links, reachable_frames, tf_buffer and the transform memo (if set).
    */
   void clear();
 
@@ -94,6 +120,14 @@ public:
    */
   bool isReachable(const std::string& frame) const;
 
+  /**
+   * \brief Set the memo of resolved transforms consulted before looking up transforms of reachable frames.
+   * \param transformMemo The memo (it can be shared with other watchdogs). If null, no memo is used.
+   * \param stampTolerance Transforms memoized at most this far from the looked up time are used.
+   */
+  void setTransformMemo(std::shared_ptr<TransformMemo> transformMemo,
+                        const ros::Duration& stampTolerance = ros::Duration(0));
+
   /**
    * \brief Return whether all monitored frames are reachable.
    * \return Whether all monitored frames are reachable.
@@ -120,6 +154,28 @@ public:
       const ros::Duration& timeout,
       std::string* errstr = nullptr);
 
+  /**
+   * \brief Look up transforms of multiple frames at the same time. Frames marked unreachable fail
+   *        immediately. The reachability of all frames is checked under a single lock, and transforms
+   *        already present in the buffer are resolved in a single pass (without a preceding canTransform).
+   * \param frames Source frames.
+   * \param time Time of the transforms.
+   * \param timeout Timeout for waiting for reachable transforms (computed from time, not from now).
+   * \param [out] transforms The transforms (indexed as frames). Only valid for the found frames.
+   * \param [out] found Whether the transform of each frame was found (indexed as frames).
+   * \return Number of found transforms.
+   * \throws tf2::TransformException If the first lookup of a frame fails with an invalid argument.
+   * \throws std::runtime_exception If you call this function before a call to start().
+   * \note Unmonitored frames start being monitored (and their lookup fails), frames that fail to be
+   *       looked up (with any other tf2::TransformException) are marked unreachable.
+   */
+  size_t lookupTransforms(
+      const std::vector<std::string>& frames,
+      const ros::Time& time,
+      const ros::Duration& timeout,
+      std::vector<geometry_msgs::TransformStamped>& transforms,
+      std::vector<std::uint8_t>& found);
+
 protected:
   /**
    * \brief Return whether the given frame is reachable.
@@ -158,10 +214,55 @@ protected:
   void markUnreachable(const std::string& frame);
 
   /**
-   * \brief Perform the search for reachable frames.
+   * \brief Perform the search for reachable frames. Frames that are transformable now are marked
+   *        reachable, the other unreachable frames get a transformable request. Does not block.
    */
   void searchForReachableFrames();
 
+  /**
+   * \brief Callback of the transformable requests issued by searchForReachableFrames().
+   * \param request The request.
+   * \param frame Source frame of the request.
+   * \param time Time of the request. Zero for requests waiting for the frame to get connected.
+   * \param result Whether the frame became transformable or the request failed.
+   */
+  void onTransformable(tf2::TransformableRequestHandle request, const std::string& frame,
+                       const ros::Time& time, tf2::TransformableResult result);
+
+  /**
+   * \brief Ask the watchdog thread to search for reachable frames as soon as possible.
+   * \note The caller has to hold a lock to framesMutex.
+   */
+  void requestSearchNoLock();
+
+  /**
+   * \brief Immutable copy of monitoredFrames and reachableFrames which can be read without locking framesMutex.
+   */
+  struct ReachabilitySnapshot
+  {
+    //! Dense IDs of the monitored frames.
+    std::unordered_map<std::string, size_t> frameIds;
+    //! Reachability of the monitored frames indexed by their IDs.
+    std::vector<bool> reachable;
+    //! Whether all monitored frames are reachable.
+    bool allReachable = true;
+
+    bool isMonitored(const std::string& frame) const;
+    bool isReachable(const std::string& frame) const;
+  };
+
+  /**
+   * \brief Get the current reachability snapshot. Does not lock framesMutex.
+   * \return The snapshot. It does not change even if the frames change.
+   */
+  std::shared_ptr<const ReachabilitySnapshot> getReachabilitySnapshot() const;
+
+  /**
+   * \brief Publish a new reachability snapshot made of monitoredFrames and reachableFrames.
+   * \note The caller has to hold a lock to framesMutex. Call this after any change of the frames.
+   */
+  void publishReachabilitySnapshotNoLock();
+
   //! The target frame of all watched transforms.
   std::string robotFrame;
   //! List of source frames for which TFs to robot_frame are available.
@@ -180,13 +281,29 @@ protected:
   //! TF buffer
   std::shared_ptr<tf2_ros::Buffer> tfBuffer;
 
-  //! Timeout for canTransform() for figuring out if an unreachable frame became reachable.
-  ros::Duration unreachableTfLookupTimeout;
+  //! Memo of resolved transforms (null if not used).
+  std::shared_ptr<TransformMemo> transformMemo;
+  //! Maximum difference between the looked up time and the stamp of a memoized transform.
+  ros::Duration transformMemoStampTolerance;
+
   //! Rate at which checking for unreachable frames will be done.
   ros::Rate unreachableFramesCheckRate;
 
   //! Lock this mutex any time you want to work with monitoredFrames or reachableFrames.
   mutable std::mutex framesMutex;
+  //! The latest snapshot of monitoredFrames and reachableFrames. Only access it via std::atomic_load/store.
+  std::shared_ptr<const ReachabilitySnapshot> reachabilitySnapshot;
+
+  //! Handle of onTransformable() registered in tfBuffer.
+  tf2::TransformableCallbackHandle transformableCallbackHandle;
+  //! Transformable requests of unreachable frames waiting for the frames to become reachable.
+  std::map<std::string, tf2::TransformableRequestHandle> pendingRequests;
+  //! Requests whose callback came before they were added to pendingRequests.
+  std::set<tf2::TransformableRequestHandle> finishedRequests;
+  //! If true, the watchdog thread should search for reachable frames without waiting for the next check.
+  bool searchRequested = true;
+  //! Wakes up the watchdog thread (used with framesMutex).
+  std::condition_variable searchCondition;
 
 private:
   std::thread thisThread;
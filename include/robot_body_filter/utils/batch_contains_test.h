@@ -0,0 +1,177 @@
+#ifndef ROBOT_BODY_FILTER_UTILS_BATCH_CONTAINS_TEST_H
+#define ROBOT_BODY_FILTER_UTILS_BATCH_CONTAINS_TEST_H
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace robot_body_filter
+{
+
+/**
+ * \brief Contains test of blocks of points against posed spheres, boxes and cylinders stored in
+ *        structure-of-arrays form. Bodies of other shapes can be added via their bounding volumes,
+ *        which serves as a fast first-stage reject before their exact test.
+ *
+ * The test is evaluated in single precision on blocks of BLOCK_SIZE points. Eigen maps the block
+ * operations to AVX (8 floats per instruction) or NEON (4 floats per instruction) if the compiler
+ * is allowed to use these instruction sets, and to scalar code otherwise.
+ *
+ * To give exactly the same answers as bodies::Body::containsPoint(), each body is tested with a
+ * safety margin that covers the rounding errors of the single-precision evaluation. Points
+ * farther than the margin from the body surface get a definite INSIDE or OUTSIDE answer, points
+ * closer than that are reported as UNSURE and have to be resolved by the exact test.
+ */
+class BatchContainsTest
+{
+public:
+  enum class Result : std::uint8_t
+  {
+    OUTSIDE = 0, //!< The point is definitely outside the body.
+    INSIDE = 1, //!< The point is definitely inside the body.
+    UNSURE = 2, //!< The point is too close to the body surface, an exact test has to decide.
+  };
+
+  //! Number of points classified by one call to classify().
+  static constexpr size_t BLOCK_SIZE = 8;
+
+  //! Relative size of the safety margin around body surfaces.
+  static constexpr float RELATIVE_MARGIN = 1e-5f;
+
+  /**
+   * \brief Remove all bodies.
+   */
+  void clear();
+
+  /**
+   * \brief Set whether the safety margin should be used for bodies added after this call.
+   * \param useSafetyMargin If false, no point of a sphere, box or cylinder is reported as UNSURE
+   *                        (except for points exactly on the float surface), so the results are
+   *                        only correct up to the rounding errors of single precision.
+   */
+  void setUseSafetyMargin(bool useSafetyMargin);
+
+  /**
+   * \brief Add a sphere.
+   * \param center Center of the sphere.
+   * \param radius Radius of the sphere (including scale and padding).
+   * \return Index of the body (bodies are indexed in the order they were added).
+   */
+  size_t addSphere(const Eigen::Vector3d& center, double radius);
+
+  /**
+   * \brief Add a box.
+   * \param pose Pose of the box center.
+   * \param halfExtents Half of the box dimensions (including scale and padding).
+   * \return Index of the body (bodies are indexed in the order they were added).
+   */
+  size_t addBox(const Eigen::Isometry3d& pose, const Eigen::Vector3d& halfExtents);
+
+  /**
+   * \brief Add a cylinder whose axis is the z axis of the given pose.
+   * \param pose Pose of the cylinder center.
+   * \param radius Radius of the cylinder (including scale and padding).
+   * \param halfLength Half of the cylinder length (including scale and padding).
+   * \return Index of the body (bodies are indexed in the order they were added).
+   */
+  size_t addCylinder(const Eigen::Isometry3d& pose, double radius, double halfLength);
+
+  /**
+   * \brief Add a body of a general shape represented just by its bounding volumes. Points outside
+   *        the bounding sphere or the bounding box are reported as OUTSIDE, all other points as
+   *        UNSURE (so that only these have to be tested by the exact test).
+   * \param sphereCenter Center of the bounding sphere.
+   * \param sphereRadius Radius of the bounding sphere.
+   * \param box The axis-aligned bounding box.
+   * \return Index of the body (bodies are indexed in the order they were added).
+   */
+  size_t addBounds(const Eigen::Vector3d& sphereCenter, double sphereRadius,
+                   const Eigen::AlignedBox3d& box);
+
+  /**
+   * \brief Number of added bodies.
+   */
+  size_t size() const;
+
+  /**
+   * \brief Whether no bodies were added.
+   */
+  bool empty() const;
+
+  /**
+   * \brief Classify a block of BLOCK_SIZE points against all bodies.
+   * \param [in] x X coordinates of the points (BLOCK_SIZE values).
+   * \param [in] y Y coordinates of the points (BLOCK_SIZE values).
+   * \param [in] z Z coordinates of the points (BLOCK_SIZE values).
+   * \param [out] results Array of at least size() * BLOCK_SIZE values. The result for the i-th
+   *                      point and b-th body is written to results[b * BLOCK_SIZE + i].
+   * \note Points with NaN coordinates are reported as UNSURE.
+   */
+  void classify(const float* x, const float* y, const float* z, Result* results) const;
+
+protected:
+  /**
+   * \brief Compute the safety margin for a body.
+   * \param center Center of the body.
+   * \param boundingRadius Radius of the body's bounding sphere.
+   * \return The margin (zero if the safety margin is not used).
+   */
+  float computeMargin(const Eigen::Vector3d& center, double boundingRadius) const;
+
+  //! Posed spheres.
+  struct
+  {
+    std::vector<float> cx, cy, cz;
+    std::vector<float> innerRadiusSquared; //!< Squared radius minus margin (negative if none).
+    std::vector<float> outerRadiusSquared; //!< Squared radius plus margin.
+    std::vector<size_t> index; //!< Index of the body returned by addSphere().
+  } spheres;
+
+  //! Posed boxes.
+  struct
+  {
+    std::vector<float> cx, cy, cz;
+    std::vector<float> xx, xy, xz; //!< X axis of the box.
+    std::vector<float> yx, yy, yz; //!< Y axis of the box.
+    std::vector<float> zx, zy, zz; //!< Z axis of the box.
+    std::vector<float> hx, hy, hz; //!< Half extents.
+    std::vector<float> margin;
+    std::vector<size_t> index; //!< Index of the body returned by addBox().
+  } boxes;
+
+  //! Posed cylinders.
+  struct
+  {
+    std::vector<float> cx, cy, cz;
+    std::vector<float> xx, xy, xz; //!< X axis of the cylinder pose.
+    std::vector<float> yx, yy, yz; //!< Y axis of the cylinder pose.
+    std::vector<float> zx, zy, zz; //!< Z axis (the cylinder axis).
+    std::vector<float> halfLength;
+    std::vector<float> innerRadiusSquared; //!< Squared radius minus margin (negative if none).
+    std::vector<float> outerRadiusSquared; //!< Squared radius plus margin.
+    std::vector<float> margin;
+    std::vector<size_t> index; //!< Index of the body returned by addCylinder().
+  } cylinders;
+
+  //! Bounding volumes of bodies of general shapes.
+  struct
+  {
+    std::vector<float> cx, cy, cz; //!< Center of the bounding sphere.
+    std::vector<float> outerRadiusSquared; //!< Squared radius of the bounding sphere plus margin.
+    std::vector<float> minx, miny, minz; //!< Minimum corner of the bounding box minus margin.
+    std::vector<float> maxx, maxy, maxz; //!< Maximum corner of the bounding box plus margin.
+    std::vector<size_t> index; //!< Index of the body returned by addBounds().
+  } bounds;
+
+  //! Total number of bodies.
+  size_t numBodies = 0;
+
+  //! Whether the safety margin is used.
+  bool useSafetyMargin = true;
+};
+
+}
+
+#endif //ROBOT_BODY_FILTER_UTILS_BATCH_CONTAINS_TEST_H
@@ -0,0 +1,125 @@
+#ifndef ROBOT_BODY_FILTER_UTILS_BOUNDING_VOLUME_HIERARCHY_H
+#define ROBOT_BODY_FILTER_UTILS_BOUNDING_VOLUME_HIERARCHY_H
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace robot_body_filter
+{
+
+/**
+ * \brief Hierarchy of axis-aligned bounding boxes for finding items whose boxes are crossed by
+ *        a line segment.
+ *
+ * The tree is built top-down by splitting the items at the median of the box centers along the
+ * longest axis, so its depth is logarithmic in the number of items. It is meant to be rebuilt
+ * whenever the boxes change (building is O(n log n) and cheap for the usual tens to hundreds of
+ * robot links).
+ */
+class BoundingVolumeHierarchy
+{
+public:
+  typedef Eigen::AlignedBox3d Box;
+
+  //! Maximum number of items in a leaf node.
+  static constexpr size_t MAX_LEAF_SIZE = 2;
+
+  /**
+   * \brief Build the hierarchy.
+   * \param boxes Bounding boxes of the items. Index of the box is the index of the item.
+   */
+  void build(const std::vector<Box>& boxes);
+
+  /**
+   * \brief Remove all items.
+   */
+  void clear();
+
+  /**
+   * \brief Number of items in the hierarchy.
+   */
+  size_t size() const;
+
+  /**
+   * \brief Whether the hierarchy contains no items.
+   */
+  bool empty() const;
+
+  /**
+   * \brief Call `test(item)` for exactly the items whose bounding boxes are crossed by the line
+   *        segment `origin + t * direction` for t in [0, length].
+   * \param origin Start of the segment.
+   * \param direction Direction of the segment (doesn't need to be normalized).
+   * \param length Length of the segment in units of `direction`.
+   * \param test The function to call. If it returns true, the search stops.
+   * \return Whether any call to test() returned true.
+   */
+  template<typename TestFn>
+  bool anySegmentHit(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction,
+                     double length, TestFn&& test) const;
+
+protected:
+  struct Node
+  {
+    Box box;
+    size_t firstItem; //!< Index of the first item of a leaf in `items`.
+    size_t numItems; //!< Number of items of a leaf (0 for inner nodes).
+    size_t rightChild; //!< Index of the right child of an inner node (the left child follows the node).
+  };
+
+  /**
+   * \brief Recursively build the subtree from items [begin, end).
+   * \return Index of the subtree root node.
+   */
+  size_t buildNode(const std::vector<Box>& boxes, size_t begin, size_t end);
+
+  /**
+   * \brief Whether the segment crosses the box.
+   */
+  static bool segmentCrossesBox(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction,
+                                double length, const Box& box);
+
+  std::vector<Node> nodes; //!< Nodes in depth-first order, the root is the first one.
+  std::vector<size_t> items; //!< Item indices referenced by the leaves.
+  std::vector<Box> itemBoxes; //!< Bounding boxes of the items in `items`.
+};
+
+template<typename TestFn>
+bool BoundingVolumeHierarchy::anySegmentHit(const Eigen::Vector3d& origin,
+    const Eigen::Vector3d& direction, const double length, TestFn&& test) const
+{
+  if (this->nodes.empty())
+    return false;
+
+  // the depth of the tree is logarithmic, so 64 levels are more than enough
+  size_t stack[64];
+  size_t stackSize = 0;
+  stack[stackSize++] = 0;
+
+  while (stackSize > 0)
+  {
+    const auto& node = this->nodes[stack[--stackSize]];
+    if (!segmentCrossesBox(origin, direction, length, node.box))
+      continue;
+
+    if (node.numItems > 0)
+    {
+      for (size_t i = node.firstItem; i < node.firstItem + node.numItems; ++i)
+        if (segmentCrossesBox(origin, direction, length, this->itemBoxes[i]) && test(this->items[i]))
+          return true;
+    }
+    else
+    {
+      stack[stackSize++] = node.rightChild;
+      stack[stackSize++] = static_cast<size_t>(&node - this->nodes.data()) + 1;
+    }
+  }
+
+  return false;
+}
+
+}
+
+#endif //ROBOT_BODY_FILTER_UTILS_BOUNDING_VOLUME_HIERARCHY_H
@@ -0,0 +1,146 @@
+#ifndef ROBOT_BODY_FILTER_UTILS_DEPTH_IMAGE_RASTERIZER_H
+#define ROBOT_BODY_FILTER_UTILS_DEPTH_IMAGE_RASTERIZER_H
+
+#include <limits>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <geometric_shapes/bodies.h>
+
+namespace robot_body_filter
+{
+
+/**
+ * \brief Intrinsics of a pinhole depth camera (as in sensor_msgs/CameraInfo, without distortion).
+ *
+ * Pixel (u, v) sees the points `z * ((u - cx) / fx, (v - cy) / fy, 1)` of the camera optical frame.
+ */
+struct DepthCamera
+{
+  size_t width {0};
+  size_t height {0};
+  double fx {0.0};
+  double fy {0.0};
+  double cx {0.0};
+  double cy {0.0};
+
+  bool operator==(const DepthCamera& other) const;
+  bool operator!=(const DepthCamera& other) const;
+};
+
+/**
+ * \brief CPU rasterizer of convex bodies into entry and exit depths of the pixel rays of a depth camera.
+ *
+ * For each pixel whose center ray crosses the body, the depths (z coordinates in the camera optical
+ * frame) at which the ray enters and exits the body are reported. All coordinates passed to the
+ * rasterizer are in the camera optical frame.
+ */
+class DepthImageRasterizer
+{
+public:
+  //! Bodies closer to the camera plane than this (m) cannot be rasterized.
+  static constexpr double NEAR_PLANE = 1e-3;
+
+  /**
+   * \brief Create the rasterizer.
+   * \param camera Intrinsics of the camera.
+   */
+  explicit DepthImageRasterizer(const DepthCamera& camera);
+
+  /**
+   * \brief Intrinsics of the camera.
+   */
+  const DepthCamera& getCamera() const;
+
+  /**
+   * \brief Get the pixel which sees the given point.
+   * \param point The point.
+   * \param [out] pixel Index of the pixel (row-major).
+   * \return Whether the point is in front of the camera and projects into the image.
+   */
+  bool getPixel(const Eigen::Vector3d& point, size_t& pixel) const;
+
+  /**
+   * \brief Direction of the ray through the center of the given pixel, scaled so that its z is 1.
+   * \param pixel Index of the pixel (row-major).
+   * \return The ray direction.
+   */
+  Eigen::Vector3d getPixelRay(size_t pixel) const;
+
+  /**
+   * \brief Get the pixels onto which the given sphere can project.
+   * \param center Center of the sphere.
+   * \param radius Radius of the sphere.
+   * \param [out] minPixel Minimum column and row (inclusive).
+   * \param [out] maxPixel Maximum column and row (inclusive). Less than minPixel if the sphere is out
+   *                       of the image.
+   * \return False if the sphere crosses the near plane (and could project anywhere).
+   */
+  bool getSphereScreenBox(const Eigen::Vector3d& center, double radius,
+                          Eigen::Vector2i& minPixel, Eigen::Vector2i& maxPixel) const;
+
+  /**
+   * \brief Rasterize a closed convex triangle mesh.
+   * \param vertices Vertices of the mesh.
+   * \param triangles Indices of triangle vertices (3 per triangle).
+   * \param fn Function called as `fn(pixel, entryDepth, exitDepth)` for each pixel whose center ray
+   *           crosses the mesh.
+   * \return False if the mesh crosses the near plane and could not be rasterized (fn is not called).
+   */
+  template<typename Fn>
+  bool rasterizeConvexMesh(const EigenSTL::vector_Vector3d& vertices,
+                           const std::vector<unsigned int>& triangles, Fn&& fn);
+
+protected:
+  /**
+   * \brief Update entry and exit depths of the pixels covered by the triangle (vertices projected to
+   *        pixel coordinates, z holds the inverse depth). Extends the dirty box by the covered pixels.
+   */
+  void rasterizeTriangle(const Eigen::Vector3d& a, const Eigen::Vector3d& b, const Eigen::Vector3d& c);
+
+  DepthCamera camera;
+  std::vector<float> entryDepths; //!< Scratch buffer, +inf for pixels not covered by the current mesh.
+  std::vector<float> exitDepths; //!< Scratch buffer, -inf for pixels not covered by the current mesh.
+  Eigen::Vector2i dirtyMin; //!< Minimum column and row of the pixels touched by the current mesh.
+  Eigen::Vector2i dirtyMax; //!< Maximum column and row of the pixels touched by the current mesh.
+};
+
+template<typename Fn>
+bool DepthImageRasterizer::rasterizeConvexMesh(const EigenSTL::vector_Vector3d& vertices,
+                                               const std::vector<unsigned int>& triangles, Fn&& fn)
+{
+  EigenSTL::vector_Vector3d projected;
+  projected.reserve(vertices.size());
+  for (const auto& vertex : vertices)
+  {
+    if (vertex.z() < NEAR_PLANE)
+      return false;
+    projected.emplace_back(this->camera.fx * vertex.x() / vertex.z() + this->camera.cx,
+                           this->camera.fy * vertex.y() / vertex.z() + this->camera.cy,
+                           1.0 / vertex.z());
+  }
+
+  this->dirtyMin.setConstant(std::numeric_limits<int>::max());
+  this->dirtyMax.setConstant(std::numeric_limits<int>::min());
+  for (size_t t = 0; t + 2 < triangles.size(); t += 3)
+    this->rasterizeTriangle(projected[triangles[t]], projected[triangles[t + 1]], projected[triangles[t + 2]]);
+
+  for (int v = this->dirtyMin.y(); v <= this->dirtyMax.y(); ++v)
+  {
+    for (int u = this->dirtyMin.x(); u <= this->dirtyMax.x(); ++u)
+    {
+      const auto pixel = static_cast<size_t>(v) * this->camera.width + static_cast<size_t>(u);
+      if (this->entryDepths[pixel] <= this->exitDepths[pixel])
+        fn(pixel, this->entryDepths[pixel], this->exitDepths[pixel]);
+      this->entryDepths[pixel] = std::numeric_limits<float>::infinity();
+      this->exitDepths[pixel] = -std::numeric_limits<float>::infinity();
+    }
+  }
+
+  return true;
+}
+
+}
+
+#endif //ROBOT_BODY_FILTER_UTILS_DEPTH_IMAGE_RASTERIZER_H
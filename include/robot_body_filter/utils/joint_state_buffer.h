@@ -0,0 +1,107 @@
+#ifndef ROBOT_BODY_FILTER_UTILS_JOINT_STATE_BUFFER_H
+#define ROBOT_BODY_FILTER_UTILS_JOINT_STATE_BUFFER_H
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <ros/duration.h>
+#include <ros/time.h>
+#include <sensor_msgs/JointState.h>
+
+namespace robot_body_filter
+{
+
+/**
+ * \brief Time-ordered history of joint positions that can be interpolated at any time it covers.
+ *
+ * Each joint has its own history, so the joint states can come from several publishers, each
+ * reporting a subset of the joints. The buffer is thread-safe.
+ */
+class JointStateBuffer
+{
+public:
+  /**
+   * \brief Create the buffer.
+   * \param length How long history is kept (relative to the newest position of each joint).
+   */
+  explicit JointStateBuffer(const ros::Duration& length = ros::Duration(10.0));
+
+  /**
+   * \brief Add the positions of the joints in the message. Messages without positions are ignored.
+   * \param jointState The joint states. They can come out of order.
+   */
+  void add(const sensor_msgs::JointState& jointState);
+
+  /**
+   * \brief Linearly interpolate the positions of the given joints at the given time.
+   * \param time The time.
+   * \param jointNames Names of the joints.
+   * \param [out] positions Positions of the joints (in the order of jointNames).
+   * \return Whether the history of all the joints contains the given time (or the time is at most the hold
+   *         duration after the newest position of each of them). If not, positions are invalid.
+   */
+  bool getPositions(const ros::Time& time, const std::vector<std::string>& jointNames,
+                    std::vector<double>& positions) const;
+
+  /**
+   * \brief Linearly interpolate the positions of those of the given joints whose history contains the given
+   *        time (or the time is at most the hold duration after their newest position).
+   * \param time The time.
+   * \param jointNames Names of the joints.
+   * \param [out] positions Positions of the joints (in the order of jointNames). Only valid if found.
+   * \param [out] found Whether the position of each joint was found (in the order of jointNames).
+   * \return The number of joints whose positions were found.
+   */
+  size_t getPositions(const ros::Time& time, const std::vector<std::string>& jointNames,
+                      std::vector<double>& positions, std::vector<std::uint8_t>& found) const;
+
+  /**
+   * \brief Set for how long after its newest position a joint keeps this position. Without it, a joint
+   *        has no position at times newer than its newest joint state, which is typical for scans
+   *        captured in between two joint states.
+   * \param holdDuration The duration (zero means no hold).
+   */
+  void setHoldDuration(const ros::Duration& holdDuration);
+
+  /**
+   * \brief Set the joints whose positions are angles without limits (e.g. continuous revolute joints).
+   *        Positions of these joints are interpolated along the shorter arc, so that a wrap-around
+   *        between -pi and pi does not interpolate through the whole circle.
+   * \param jointNames Names of the joints.
+   */
+  void setContinuousJoints(const std::vector<std::string>& jointNames);
+
+  /**
+   * \brief Forget all positions (e.g. when the time jumps back).
+   */
+  void clear();
+
+protected:
+  typedef std::deque<std::pair<ros::Time, double>> History;
+
+  /**
+   * \brief Interpolate the position of one joint.
+   * \param time The time.
+   * \param jointName Name of the joint.
+   * \param [out] position Position of the joint.
+   * \return Whether the position was found.
+   * \note The caller has to hold a lock to mutex.
+   */
+  bool getPositionNoLock(const ros::Time& time, const std::string& jointName, double& position) const;
+
+  ros::Duration length;
+  ros::Duration holdDuration;
+  std::unordered_map<std::string, History> histories;
+  std::unordered_set<std::string> continuousJoints;
+  mutable std::mutex mutex;
+};
+
+}
+
+#endif //ROBOT_BODY_FILTER_UTILS_JOINT_STATE_BUFFER_H
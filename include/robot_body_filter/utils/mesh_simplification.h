@@ -0,0 +1,49 @@
+#ifndef ROBOT_BODY_FILTER_UTILS_MESH_SIMPLIFICATION_H
+#define ROBOT_BODY_FILTER_UTILS_MESH_SIMPLIFICATION_H
+
+#include <vector>
+
+#include <eigen_stl_containers/eigen_stl_vector_container.h>
+#include <geometric_shapes/shapes.h>
+
+namespace robot_body_filter
+{
+
+/**
+ * \brief Simplify a triangle mesh by quadric edge collapse with a bounded geometric error.
+ *
+ * Edges are collapsed in the order of their quadric error (sum of squared distances of the merged
+ * vertex from the planes of the original triangles around it) while this error is below maxError^2.
+ * After the simplification, the distance of every original vertex from the simplified surface is
+ * measured. If it exceeds maxError, the simplification is repeated with a stricter quadric threshold
+ * (and if that doesn't help, the mesh is returned unchanged).
+ *
+ * As the original vertices are at most `error` far from the simplified surface, the convex hull of
+ * the original mesh is contained in the convex hull of the simplified mesh padded by `error`.
+ *
+ * \param vertices Vertices of the mesh. Duplicate vertices are merged.
+ * \param triangles Vertex indices of the triangles (3 per triangle).
+ * \param maxError Maximum allowed distance of the original vertices from the simplified surface (m).
+ * \param [out] simplifiedVertices Vertices of the simplified mesh.
+ * \param [out] simplifiedTriangles Vertex indices of the triangles of the simplified mesh.
+ * \return The distance bound of the original vertices from the simplified surface (at most maxError).
+ */
+double simplifyMesh(const EigenSTL::vector_Vector3d& vertices, const std::vector<unsigned int>& triangles,
+                    double maxError, EigenSTL::vector_Vector3d& simplifiedVertices,
+                    std::vector<unsigned int>& simplifiedTriangles);
+
+/**
+ * \brief Simplify a triangle mesh by quadric edge collapse with a bounded geometric error.
+ *
+ * See the other overload for details.
+ *
+ * \param mesh The mesh to simplify.
+ * \param maxError Maximum allowed distance of the original vertices from the simplified surface (m).
+ * \param [out] error The distance bound of the original vertices from the simplified surface.
+ * \return The simplified mesh.
+ */
+shapes::Mesh* simplifyMesh(const shapes::Mesh& mesh, double maxError, double& error);
+
+}
+
+#endif //ROBOT_BODY_FILTER_UTILS_MESH_SIMPLIFICATION_H
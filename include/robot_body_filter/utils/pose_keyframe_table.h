@@ -0,0 +1,98 @@
+#ifndef ROBOT_BODY_FILTER_UTILS_POSE_KEYFRAME_TABLE_H
+#define ROBOT_BODY_FILTER_UTILS_POSE_KEYFRAME_TABLE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+namespace robot_body_filter
+{
+
+/**
+ * \brief Table of poses of multiple bodies sampled at keyframes uniformly spread over an interval.
+ *
+ * Each row holds the keyframes of one body. The poses are stored decomposed to a translation and a
+ * quaternion, so that interpolating them does not need any conversions from rotation matrices. The
+ * interval is parametrized by a ratio in [0, 1], keyframe `k` of `N` lies at ratio `k / (N - 1)`.
+ */
+class PoseKeyframeTable
+{
+public:
+  /**
+   * \brief Resize the table and mark all rows invalid.
+   * \param numRows Number of rows (bodies).
+   * \param numKeyframes Number of keyframes of each row (at least 1).
+   */
+  void reset(size_t numRows, size_t numKeyframes);
+
+  /**
+   * \brief Set one keyframe of a row. A row becomes valid when all its keyframes are set.
+   * \param row The row.
+   * \param keyframe Index of the keyframe.
+   * \param pose The pose at the keyframe.
+   */
+  void setKeyframe(size_t row, size_t keyframe, const Eigen::Isometry3d& pose);
+
+  /**
+   * \brief Whether all keyframes of the row have been set since the last reset().
+   */
+  bool isValid(size_t row) const;
+
+  /**
+   * \brief Interpolate the pose of a row. Translation is interpolated linearly and rotation spherically
+   *        between the two keyframes surrounding the ratio.
+   * \param row The row.
+   * \param ratio Position in the interval (clamped to [0, 1]).
+   * \param [out] pose The interpolated pose.
+   * \return Whether the row is valid. If not, pose is not changed.
+   */
+  bool interpolate(size_t row, double ratio, Eigen::Isometry3d& pose) const;
+
+  /**
+   * \brief Interpolate only the translation of a row (cheaper than interpolate()).
+   * \param row The row.
+   * \param ratio Position in the interval (clamped to [0, 1]).
+   * \param [out] translation The interpolated translation.
+   * \return Whether the row is valid. If not, translation is not changed.
+   */
+  bool interpolateTranslation(size_t row, double ratio, Eigen::Vector3d& translation) const;
+
+  /**
+   * \brief Ratio at which the given keyframe lies.
+   */
+  double getKeyframeRatio(size_t keyframe) const;
+
+  size_t getNumRows() const;
+  size_t getNumKeyframes() const;
+
+protected:
+  struct Keyframe
+  {
+    Eigen::Quaterniond rotation;
+    Eigen::Vector3d translation;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  size_t numKeyframes = 1;
+  //! Keyframes of all rows, row-major.
+  std::vector<Keyframe, Eigen::aligned_allocator<Keyframe>> keyframes;
+  //! Whether each keyframe has been set.
+  std::vector<std::uint8_t> keyframeSet;
+  //! Number of keyframes set in each row.
+  std::vector<size_t> numSetKeyframes;
+
+  /**
+   * \brief Find the two keyframes surrounding the ratio.
+   * \param ratio Position in the interval (clamped to [0, 1]).
+   * \param [out] t Position between the two keyframes (0 = the first one).
+   * \return Index of the first of the two keyframes (the second one is the next one).
+   */
+  size_t getSegment(double ratio, double& t) const;
+};
+
+}
+
+#endif //ROBOT_BODY_FILTER_UTILS_POSE_KEYFRAME_TABLE_H
@@ -0,0 +1,91 @@
+#ifndef ROBOT_BODY_FILTER_UTILS_SIGNED_DISTANCE_FIELD_H
+#define ROBOT_BODY_FILTER_UTILS_SIGNED_DISTANCE_FIELD_H
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <geometric_shapes/bodies.h>
+
+namespace robot_body_filter
+{
+
+/**
+ * \brief Sampled signed distance field of a convex mesh body in its own frame.
+ *
+ * The field stores the signed distance from the planes of the mesh (the maximum of the signed distances
+ * from the planes of all triangles) in the nodes of a regular grid, quantized to 16 bits. Inside the body,
+ * it is the exact distance from the surface, outside it is a lower bound of the distance. The field is
+ * trilinearly interpolated between the nodes. The error of the interpolated value is bounded by
+ * getTolerance(), so points further from zero than this tolerance (and the body padding) are classified
+ * exactly as by bodies::Body::containsPoint(). The others have to be tested by the exact test.
+ */
+class SignedDistanceField
+{
+public:
+  enum class Containment : std::uint8_t
+  {
+    OUTSIDE, //!< The point is definitely outside the body (also points outside the grid).
+    INSIDE, //!< The point is definitely inside the body.
+    UNSURE, //!< The point is too close to the body surface, an exact test has to decide.
+  };
+
+  //! Maximum number of nodes of the grid. If the requested resolution is finer, it is coarsened.
+  static constexpr size_t MAX_NODES = 1u << 23u;
+
+  /**
+   * \brief Sample the signed distance field of the body.
+   * \param body The body. Its pose is ignored, the field is built in the body frame.
+   * \param resolution Distance of the grid nodes (m).
+   */
+  SignedDistanceField(const bodies::ConvexMesh& body, double resolution);
+
+  /**
+   * \brief Get the interpolated signed distance of the point from the body surface.
+   * \param point The point in the body frame.
+   * \return The distance (negative inside), within getTolerance() of the sampled function. Far from
+   *         the body, the distance is clamped, and for points outside the grid, it is infinite.
+   */
+  double getDistance(const Eigen::Vector3d& point) const;
+
+  /**
+   * \brief Decide whether the point is inside the body.
+   * \param point The point in the body frame.
+   * \return The containment. UNSURE for points near the surface.
+   */
+  Containment classify(const Eigen::Vector3d& point) const;
+
+  /**
+   * \brief Maximum error of getDistance() (caused by interpolation and quantization).
+   */
+  double getTolerance() const;
+
+  /**
+   * \brief Distance of the grid nodes (it can be coarser than the requested one).
+   */
+  double getResolution() const;
+
+  /**
+   * \brief Number of grid nodes along each axis of the body frame.
+   */
+  const Eigen::Vector3i& getSize() const;
+
+protected:
+  /**
+   * \brief Index of the node with the given coordinates.
+   */
+  size_t getIndex(int x, int y, int z) const;
+
+  Eigen::Vector3d origin; //!< The node with minimum coordinates (in body frame).
+  double resolution;
+  double quantum; //!< Distance corresponding to one unit of the quantized values.
+  double tolerance;
+  double margin; //!< Distance between the planes of the mesh and the surface tested by containsPoint().
+  Eigen::Vector3i size;
+  std::vector<std::int16_t> values;
+};
+
+}
+
+#endif //ROBOT_BODY_FILTER_UTILS_SIGNED_DISTANCE_FIELD_H
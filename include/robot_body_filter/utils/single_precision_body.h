@@ -0,0 +1,88 @@
+#ifndef ROBOT_BODY_FILTER_UTILS_SINGLE_PRECISION_BODY_H
+#define ROBOT_BODY_FILTER_UTILS_SINGLE_PRECISION_BODY_H
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <geometric_shapes/bodies.h>
+
+namespace robot_body_filter
+{
+
+/**
+ * \brief Single-precision copy of a posed sphere, box or cylinder for fast point and ray tests.
+ *
+ * The results equal those of the corresponding double-precision bodies::Body tests except for
+ * points (or rays) closer to the body surface than the rounding error of the float computation.
+ * This error is a few float epsilons (1.2e-7) times the magnitude of the involved coordinates, so
+ * e.g. for points and bodies within 10 m from the origin, only points closer than approx. 1e-5 m
+ * to the body surface can be classified differently.
+ */
+class SinglePrecisionBody
+{
+public:
+  enum class Type : std::uint8_t
+  {
+    UNSUPPORTED, //!< The body is not a sphere, box or cylinder and has to be tested in double.
+    SPHERE,
+    BOX,
+    CYLINDER,
+  };
+
+  SinglePrecisionBody() = default;
+
+  /**
+   * \brief Create the single-precision copy of the given body in its current pose.
+   * \param body The body. If it is not a sphere, box or cylinder, type will be UNSUPPORTED.
+   */
+  explicit SinglePrecisionBody(const bodies::Body& body);
+
+  /**
+   * \brief Type of the body.
+   */
+  Type getType() const;
+
+  /**
+   * \brief Whether the point is inside the body (or on its surface).
+   * \param point The point.
+   * \return Whether the point is inside. Always false for UNSUPPORTED bodies.
+   */
+  bool containsPoint(const Eigen::Vector3f& point) const;
+
+  /**
+   * \brief Whether the first intersection of the ray `origin + t * direction`, t > 0, with the body
+   *        surface has t <= maxDistance. This is the float counterpart of calling
+   *        bodies::Body::intersectsRay() with count 1 and checking the distance of the intersection.
+   * \param origin Origin of the ray.
+   * \param direction Unit direction of the ray.
+   * \param maxDistance Maximum distance of the intersection.
+   * \return Whether there is such intersection. Always false for UNSUPPORTED bodies.
+   */
+  bool intersectsRay(const Eigen::Vector3f& origin, const Eigen::Vector3f& direction,
+                     float maxDistance) const;
+
+  /**
+   * \brief Compute the interval of the parameter t in which the (infinite) line
+   *        `origin + t * direction` is inside the body.
+   * \param origin A point on the line.
+   * \param direction Direction of the line (doesn't need to be normalized).
+   * \param [out] tEnter The parameter at which the line enters the body.
+   * \param [out] tExit The parameter at which the line exits the body.
+   * \return Whether the line intersects the body. Always false for UNSUPPORTED bodies.
+   */
+  bool lineInterval(const Eigen::Vector3f& origin, const Eigen::Vector3f& direction,
+                    float& tEnter, float& tExit) const;
+
+protected:
+
+  Type type {Type::UNSUPPORTED};
+  Eigen::Vector3f center {Eigen::Vector3f::Zero()};
+  Eigen::Matrix3f rotation {Eigen::Matrix3f::Identity()}; //!< Columns are the body axes.
+  Eigen::Vector3f halfExtents {Eigen::Vector3f::Zero()}; //!< Box half extents.
+  float radius {0.0f}; //!< Sphere or cylinder radius.
+  float halfLength {0.0f}; //!< Cylinder half length.
+};
+
+}
+
+#endif //ROBOT_BODY_FILTER_UTILS_SINGLE_PRECISION_BODY_H
@@ -0,0 +1,100 @@
+#ifndef ROBOT_BODY_FILTER_UTILS_SPHERICAL_DEPTH_MAP_H
+#define ROBOT_BODY_FILTER_UTILS_SPHERICAL_DEPTH_MAP_H
+
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace robot_body_filter
+{
+
+/**
+ * \brief Conservative spherical depth map of bodies as seen from a fixed origin.
+ *
+ * The sphere of directions around the origin is split into bins of the given angular size (in
+ * azimuth and elevation). Each bin stores a lower bound of the distance from the origin to any
+ * body visible in the directions of the bin. If a point is closer to the origin than this bound,
+ * the line segment between the origin and the point cannot intersect any body.
+ *
+ * Bodies are "rendered" via their bounding spheres, and each sphere is drawn to all bins its
+ * angular footprint could overlap (plus one bin around), so the bounds are always conservative.
+ */
+class SphericalDepthMap
+{
+public:
+  /**
+   * \brief Create the map.
+   * \param angularResolution Angular size of the bins (rad).
+   */
+  explicit SphericalDepthMap(double angularResolution = 0.01);
+
+  /**
+   * \brief Change the angular size of the bins. Clears the map.
+   * \param angularResolution Angular size of the bins (rad).
+   */
+  void setAngularResolution(double angularResolution);
+
+  /**
+   * \brief Get the angular size of the bins.
+   * \return The angular size of the bins (rad).
+   */
+  double getAngularResolution() const;
+
+  /**
+   * \brief Remove all bodies from the map and set its origin.
+   * \param origin The origin (e.g. position of the sensor).
+   */
+  void reset(const Eigen::Vector3d& origin);
+
+  /**
+   * \brief Get the origin of the map.
+   */
+  const Eigen::Vector3d& getOrigin() const;
+
+  /**
+   * \brief Draw a sphere to the map.
+   * \param center Center of the sphere.
+   * \param radius Radius of the sphere.
+   */
+  void addSphere(const Eigen::Vector3d& center, double radius);
+
+  /**
+   * \brief Get a lower bound of the distance from the origin to the bodies in the direction of
+   *        the given point.
+   * \param point The point.
+   * \return The lower bound (infinity if there is no body in the direction).
+   */
+  float getMinDistance(const Eigen::Vector3d& point) const;
+
+  /**
+   * \brief Get a lower bound of the distance from the origin to the bodies in the direction of
+   *        the given point.
+   * \param point The point.
+   * \return The lower bound (infinity if there is no body in the direction).
+   */
+  float getMinDistance(const Eigen::Vector3f& point) const;
+
+protected:
+  /**
+   * \brief Get the bin row corresponding to the given elevation.
+   */
+  size_t getRow(double elevation) const;
+
+  /**
+   * \brief Get the bin column corresponding to the given azimuth.
+   */
+  size_t getCol(double azimuth) const;
+
+  double angularResolution;
+  double rowResolution; //!< Actual angular size of the bins in elevation (<= angularResolution).
+  double colResolution; //!< Actual angular size of the bins in azimuth (<= angularResolution).
+  size_t numRows; //!< Number of bins in elevation (-pi/2 to pi/2).
+  size_t numCols; //!< Number of bins in azimuth (-pi to pi).
+  Eigen::Vector3d origin {Eigen::Vector3d::Zero()};
+  Eigen::Vector3f originFloat {Eigen::Vector3f::Zero()};
+  std::vector<float> minDistances; //!< Row-major array of the bins.
+};
+
+}
+
+#endif //ROBOT_BODY_FILTER_UTILS_SPHERICAL_DEPTH_MAP_H
@@ -0,0 +1,88 @@
+#ifndef ROBOT_BODY_FILTER_UTILS_THREAD_POOL_H
+#define ROBOT_BODY_FILTER_UTILS_THREAD_POOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace robot_body_filter
+{
+
+/**
+ * \brief A persistent pool of worker threads for running data-parallel loops.
+ *
+ * The worker threads are started in the constructor and sleep on a condition variable when there
+ * is no work, so no threads are spawned per parallelFor() call and idle workers do not consume CPU.
+ *
+ * Tasks of a parallelFor() call are distributed evenly among the threads. A thread that finishes
+ * its share steals half of the remaining tasks of another thread, so uneven task durations are
+ * balanced automatically.
+ */
+class ThreadPool
+{
+public:
+  /**
+   * \brief Create the pool and start the worker threads.
+   * \param numThreads Total number of threads running the tasks, including the thread calling
+   *                   parallelFor() (so numThreads - 1 workers are started). Zero means the number
+   *                   of CPU cores minus one. The value is capped at the number of CPU cores.
+   * \param cpuAffinity If not empty, the i-th worker thread is pinned to CPU
+   *                    cpuAffinity[i % cpuAffinity.size()]. The calling thread is never pinned.
+   */
+  explicit ThreadPool(size_t numThreads, const std::vector<int>& cpuAffinity = {});
+
+  /**
+   * \brief Stop and join the worker threads.
+   */
+  virtual ~ThreadPool();
+
+  /**
+   * \brief Total number of threads running the tasks (including the calling thread).
+   */
+  size_t getNumThreads() const;
+
+  /**
+   * \brief Run fn(task, thread) for all task in [0, numTasks) and wait until all tasks finish.
+   * \param numTasks Number of tasks.
+   * \param fn The function to run. `thread` is the index of the thread running the task
+   *           (0 is the calling thread), it can be used to index per-thread scratch buffers.
+   * \note Concurrent calls from multiple threads are serialized.
+   * \throws Rethrows the first exception thrown by fn (after all tasks finish).
+   */
+  void parallelFor(size_t numTasks, const std::function<void(size_t task, size_t thread)>& fn);
+
+protected:
+  //! Range of tasks not yet started by a thread. Other threads can steal from its end.
+  struct TaskRange
+  {
+    std::mutex mutex;
+    size_t begin {0};
+    size_t end {0};
+  };
+
+  void workerLoop(size_t thread);
+  void runTasks(size_t thread);
+  bool popTask(size_t thread, size_t& task);
+  bool stealTasks(size_t thread);
+
+  std::vector<std::thread> workers;
+  std::vector<std::unique_ptr<TaskRange>> taskRanges;
+
+  std::mutex callMutex;  //!< Serializes parallelFor() calls.
+  std::mutex mutex;  //!< Protects the members below.
+  std::condition_variable workAvailable;
+  std::condition_variable workDone;
+  const std::function<void(size_t, size_t)>* task {nullptr};
+  size_t generation {0};
+  size_t busyWorkers {0};
+  bool stop {false};
+  std::exception_ptr exception;
+};
+
+}
+
+#endif //ROBOT_BODY_FILTER_UTILS_THREAD_POOL_H
@@ -0,0 +1,134 @@
+#ifndef ROBOT_BODY_FILTER_UTILS_TRANSFORM_MEMO_H
+#define ROBOT_BODY_FILTER_UTILS_TRANSFORM_MEMO_H
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <geometry_msgs/TransformStamped.h>
+#include <ros/time.h>
+
+namespace robot_body_filter
+{
+
+/**
+ * \brief Thread-safe memo of transforms resolved from TF, with a bounded size. When full, the least
+ *        recently used entries are forgotten.
+ *
+ * The process-wide instance allows multiple filters running in the same process (e.g. in one nodelet
+ * manager or in one filter chain node) to share the lookups of the same frames at the same stamps. Sensors
+ * are seldom synchronized, so a lookup can accept a transform memoized at a nearby stamp.
+ */
+class TransformMemo
+{
+public:
+  /**
+   * \brief Create an empty memo.
+   * \param capacity Maximum number of entries. If zero, nothing is memoized.
+   */
+  explicit TransformMemo(size_t capacity = 0);
+
+  /**
+   * \brief Get the memo shared by the whole process. It is created with zero capacity.
+   */
+  static const std::shared_ptr<TransformMemo>& getProcessWide();
+
+  /**
+   * \brief Get a memoized transform.
+   * \param targetFrame Target frame of the transform.
+   * \param sourceFrame Source frame of the transform.
+   * \param stamp Time of the transform.
+   * \param [out] transform The transform. Only valid if found.
+   * \return Whether the transform was found.
+   */
+  bool get(const std::string& targetFrame, const std::string& sourceFrame, const ros::Time& stamp,
+           geometry_msgs::TransformStamped& transform);
+
+  /**
+   * \brief Get the memoized transform with the stamp closest to the given one.
+   * \param targetFrame Target frame of the transform.
+   * \param sourceFrame Source frame of the transform.
+   * \param stamp Time of the transform.
+   * \param stampTolerance Maximum difference between stamp and the stamp of the memoized transform.
+   * \param [out] transform The transform. Only valid if found. Its header keeps the memoized stamp.
+   * \return Whether the transform was found.
+   */
+  bool get(const std::string& targetFrame, const std::string& sourceFrame, const ros::Time& stamp,
+           const ros::Duration& stampTolerance, geometry_msgs::TransformStamped& transform);
+
+  /**
+   * \brief Memoize a transform.
+   * \param targetFrame Target frame of the transform.
+   * \param sourceFrame Source frame of the transform.
+   * \param stamp Time of the transform. Zero time (latest available transform) is not memoized.
+   * \param transform The transform.
+   */
+  void put(const std::string& targetFrame, const std::string& sourceFrame, const ros::Time& stamp,
+           const geometry_msgs::TransformStamped& transform);
+
+  /**
+   * \brief Set the maximum number of entries. If the memo is larger, the least recently used entries are dropped.
+   */
+  void setCapacity(size_t capacity);
+
+  /**
+   * \brief Make sure the memo can hold at least the given number of entries.
+   */
+  void reserveCapacity(size_t capacity);
+
+  size_t getCapacity() const;
+
+  /**
+   * \brief Number of memoized entries.
+   */
+  size_t size() const;
+
+  /**
+   * \brief Forget all entries (e.g. when the time jumps back).
+   */
+  void clear();
+
+protected:
+  struct Key
+  {
+    std::string targetFrame;
+    std::string sourceFrame;
+
+    bool operator==(const Key& other) const;
+  };
+
+  struct KeyHash
+  {
+    size_t operator()(const Key& key) const;
+  };
+
+  /**
+   * \brief Drop the least recently used entries so that at most capacity entries remain.
+   * \note The caller has to hold a lock to mutex.
+   */
+  void shrinkNoLock();
+
+  struct Entry
+  {
+    Key key;
+    ros::Time stamp;
+    geometry_msgs::TransformStamped transform;
+  };
+
+  typedef std::list<Entry> Entries;
+
+  //! The entries, the most recently used first.
+  Entries entries;
+  //! Position of the entries of each pair of frames in entries, ordered by stamp.
+  std::unordered_map<Key, std::map<ros::Time, Entries::iterator>, KeyHash> index;
+  size_t capacity;
+  mutable std::mutex mutex;
+};
+
+}
+
+#endif //ROBOT_BODY_FILTER_UTILS_TRANSFORM_MEMO_H
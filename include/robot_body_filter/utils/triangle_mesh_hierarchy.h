@@ -0,0 +1,60 @@
+#ifndef ROBOT_BODY_FILTER_UTILS_TRIANGLE_MESH_HIERARCHY_H
+#define ROBOT_BODY_FILTER_UTILS_TRIANGLE_MESH_HIERARCHY_H
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <geometric_shapes/bodies.h>
+#include <robot_body_filter/utils/bounding_volume_hierarchy.h>
+
+namespace robot_body_filter
+{
+
+/**
+ * \brief Bounding volume hierarchy of the triangles of a mesh body in its own frame for fast
+ *        segment intersection tests.
+ *
+ * bodies::ConvexMesh::intersectsRay() tests all triangles of the mesh, which gets slow for detailed
+ * meshes with thousands of triangles. This hierarchy only tests the triangles whose bounding boxes
+ * are crossed by the segment. The tested triangles are those of the scaled and padded mesh (as
+ * returned by bodies::ConvexMesh::getScaledVertices()).
+ */
+class TriangleMeshHierarchy
+{
+public:
+  /**
+   * \brief Build the hierarchy.
+   * \param body The body. Its pose is ignored, the hierarchy is built in the body frame.
+   */
+  explicit TriangleMeshHierarchy(const bodies::ConvexMesh& body);
+
+  /**
+   * \brief Whether the segment `origin + t * direction` for t in (0, length] crosses any triangle.
+   * \param origin Start of the segment in the body frame.
+   * \param direction Direction of the segment in the body frame (doesn't need to be normalized).
+   * \param length Length of the segment in units of `direction`.
+   * \return Whether the segment crosses the surface of the mesh.
+   */
+  bool intersectsSegment(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction,
+                         double length) const;
+
+  /**
+   * \brief Number of (non-degenerate) triangles in the hierarchy.
+   */
+  size_t getNumTriangles() const;
+
+protected:
+  /**
+   * \brief Whether the segment crosses the given triangle (Möller-Trumbore test).
+   */
+  bool segmentCrossesTriangle(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction,
+                              double length, size_t triangle) const;
+
+  BoundingVolumeHierarchy hierarchy;
+  EigenSTL::vector_Vector3d vertices; //!< Three vertices of each triangle.
+};
+
+}
+
+#endif //ROBOT_BODY_FILTER_UTILS_TRIANGLE_MESH_HIERARCHY_H
@@ -0,0 +1,83 @@
+#ifndef ROBOT_BODY_FILTER_UTILS_VOXEL_OCCUPANCY_GRID_H
+#define ROBOT_BODY_FILTER_UTILS_VOXEL_OCCUPANCY_GRID_H
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <geometric_shapes/bodies.h>
+
+namespace robot_body_filter
+{
+
+/**
+ * \brief Voxelization of a convex mesh body in its own frame for constant-time contains tests.
+ *
+ * Each voxel is either fully inside the body, fully outside of it, or it is a surface voxel which
+ * the body surface could pass through. The voxels are classified conservatively against the same
+ * padded mesh planes and padded bounding box that bodies::Body::containsPoint() uses, so points in
+ * INSIDE and OUTSIDE voxels are classified exactly as by the exact test, even next to sharp
+ * vertices where the padded body reaches far beyond the mesh triangles. Points in SURFACE voxels
+ * have to be tested by the exact test.
+ *
+ * The occupancy is stored as two bitmaps, so even fine grids of robot links take only tens of kB.
+ */
+class VoxelOccupancyGrid
+{
+public:
+  enum class Occupancy : std::uint8_t
+  {
+    OUTSIDE, //!< The whole voxel is outside the body (also points outside the grid).
+    INSIDE, //!< The whole voxel is inside the body.
+    SURFACE, //!< The voxel may contain a part of the body surface.
+  };
+
+  //! Maximum number of voxels of a grid. If the requested resolution is finer, it is coarsened.
+  static constexpr size_t MAX_VOXELS = 1u << 24u;
+
+  /**
+   * \brief Voxelize the body.
+   * \param body The body. Its pose is ignored, the grid is built in the body frame.
+   * \param resolution Edge length of the voxels (m).
+   */
+  VoxelOccupancyGrid(const bodies::ConvexMesh& body, double resolution);
+
+  /**
+   * \brief Get the occupancy of the voxel containing the given point.
+   * \param point The point in the body frame.
+   * \return The occupancy. OUTSIDE for points outside the grid.
+   */
+  Occupancy getOccupancy(const Eigen::Vector3d& point) const;
+
+  /**
+   * \brief Edge length of the voxels (it can be coarser than the requested one).
+   */
+  double getResolution() const;
+
+  /**
+   * \brief Number of voxels along each axis of the body frame.
+   */
+  const Eigen::Vector3i& getSize() const;
+
+protected:
+  /**
+   * \brief Index of the voxel with the given coordinates in the bitmaps.
+   */
+  size_t getIndex(int x, int y, int z) const;
+
+  /**
+   * \brief Whether the bit of the given voxel is set in the bitmap.
+   */
+  static bool isSet(const std::vector<std::uint64_t>& bitmap, size_t index);
+
+  Eigen::Vector3d origin; //!< Corner of the grid with minimum coordinates (in body frame).
+  double resolution;
+  Eigen::Vector3i size;
+  std::vector<std::uint64_t> insideBitmap;
+  std::vector<std::uint64_t> surfaceBitmap;
+};
+
+}
+
+#endif //ROBOT_BODY_FILTER_UTILS_VOXEL_OCCUPANCY_GRID_H
@@ -6,9 +6,20 @@
 #undef private
 /* HACK END HACK */
 
+#include <algorithm>
+#include <limits>
 #include <list>
+#include <unordered_map>
 
 #include <robot_body_filter/RayCastingShapeMask.h>
+#include <robot_body_filter/utils/bounding_volume_hierarchy.h>
+#include <robot_body_filter/utils/depth_image_rasterizer.h>
+#include <robot_body_filter/utils/signed_distance_field.h>
+#include <robot_body_filter/utils/single_precision_body.h>
+#include <robot_body_filter/utils/spherical_depth_map.h>
+#include <robot_body_filter/utils/thread_pool.h>
+#include <robot_body_filter/utils/triangle_mesh_hierarchy.h>
+#include <robot_body_filter/utils/voxel_occupancy_grid.h>
 
 #include <geometric_shapes/body_operations.h>
 
@@ -33,8 +44,130 @@ struct RayCastingShapeMask::RayCastingShapeMaskPIMPL
 
   bodies::BoundingSphere boundingSphere;
   bodies::BoundingSphere boundingSphereForContainsTest;
+
+  //! Index of each posed body for contains test in bspheresForContainsTest and bboxesForContainsTest.
+  std::unordered_map<const bodies::Body*, size_t> containsTestBoundsIndices;
+
+  //! Primitive bodies for contains test evaluated in batches of points.
+  BatchContainsTest batchContainsTest;
+  //! The body corresponding to each body of batchContainsTest (used for resolving UNSURE results).
+  std::vector<const bodies::Body*> batchContainsTestBodies;
+  //! Voxel grid of each body of batchContainsTest (null if the body has none).
+  std::vector<const VoxelOccupancyGrid*> batchContainsTestGrids;
+  //! Distance field of each body of batchContainsTest (null if the body has none).
+  std::vector<const SignedDistanceField*> batchContainsTestDistanceFields;
+  //! Inverse poses of the bodies of batchContainsTest (only valid for bodies with a grid or distance field).
+  EigenSTL::vector_Isometry3d batchContainsTestInversePoses;
+
+  //! Voxel grids of the mesh bodies for contains test, in their own frames.
+  std::map<point_containment_filter::ShapeHandle, std::unique_ptr<VoxelOccupancyGrid>> containsTestGrids;
+  //! Distance fields of the mesh bodies for contains test, in their own frames.
+  std::map<point_containment_filter::ShapeHandle, std::unique_ptr<SignedDistanceField>> containsTestDistanceFields;
+
+  //! Hierarchy of bounding boxes of bodiesForShadowTest.
+  BoundingVolumeHierarchy shadowTestHierarchy;
+  //! The body corresponding to each item of shadowTestHierarchy.
+  std::vector<const bodies::Body*> shadowTestHierarchyBodies;
+  //! Single-precision copies of shadowTestHierarchyBodies (only filled in single-precision mode).
+  std::vector<SinglePrecisionBody> shadowTestHierarchyFloatBodies;
+  //! Triangle hierarchy of each item of shadowTestHierarchy (null if the body is not a mesh).
+  std::vector<const TriangleMeshHierarchy*> shadowTestHierarchyMeshes;
+  //! Inverse poses of the items of shadowTestHierarchy (only valid for meshes).
+  EigenSTL::vector_Isometry3d shadowTestHierarchyInversePoses;
+
+  //! Triangle hierarchies of the mesh bodies for shadow test, in their own frames.
+  std::map<point_containment_filter::ShapeHandle, std::unique_ptr<TriangleMeshHierarchy>> shadowTestMeshes;
+
+  //! Depth map of bodiesForShadowTest as seen from the sensor of the last classified pointcloud.
+  SphericalDepthMap shadowDepthMap;
+
+  //! Rasterizer for the depth camera of the last pointcloud classified by rasterization.
+  std::unique_ptr<DepthImageRasterizer> depthImageRasterizer;
+  //! Index of the point seen by each pixel of the depth camera.
+  std::vector<size_t> depthImagePixelPoints;
+
+  //! Thread pool for classifying pointclouds (null if not running in parallel).
+  std::unique_ptr<ThreadPool> threadPool;
+  //! Scratch buffers of the batched contains test, one for each thread.
+  std::vector<std::vector<BatchContainsTest::Result>> containsTestResults;
+  //! Scratch buffer for viewpoints of points of pointclouds captured point by point.
+  EigenSTL::vector_Vector3d viewpoints;
+
+  //! Static shapes whose bodies have already been posed.
+  std::unordered_set<MultiShapeHandle> posedStaticShapes;
+  //! Bounding spheres of the bodies of posedStaticShapes.
+  std::unordered_map<point_containment_filter::ShapeHandle, bodies::BoundingSphere> staticBoundingSpheres;
+  //! Bounding boxes of the bodies of posedStaticShapes.
+  std::unordered_map<point_containment_filter::ShapeHandle, bodies::AxisAlignedBoundingBox> staticBoundingBoxes;
 };
 
+constexpr size_t RayCastingShapeMask::POINTS_PER_TASK;
+
+namespace
+{
+
+/**
+ * \brief Rasterize the body into the pixels of the depth camera.
+ * \param body The body.
+ * \param rasterizer The rasterizer.
+ * \param sensorPose Pose of the camera optical frame in the filtering frame.
+ * \param cameraFromFiltering Inverse of sensorPose.
+ * \param fn Function called as `fn(pixel, entryDepth, exitDepth)` for each pixel seeing the body.
+ * \return Whether the body could be rasterized. If not, fn is not called.
+ */
+template<typename Fn>
+bool rasterizeBody(const bodies::Body& body, DepthImageRasterizer& rasterizer,
+                   const Eigen::Isometry3d& sensorPose, const Eigen::Isometry3d& cameraFromFiltering, Fn&& fn)
+{
+  switch (body.getType())
+  {
+    case shapes::SPHERE:
+    case shapes::BOX:
+    case shapes::CYLINDER:
+    {
+      // primitives are intersected analytically with the rays of the pixels they can project to
+      const SinglePrecisionBody floatBody(body);
+      bodies::BoundingSphere bsphere;
+      body.computeBoundingSphere(bsphere);
+
+      const auto& camera = rasterizer.getCamera();
+      Eigen::Vector2i minPixel(0, 0);
+      Eigen::Vector2i maxPixel(static_cast<int>(camera.width) - 1, static_cast<int>(camera.height) - 1);
+      rasterizer.getSphereScreenBox(cameraFromFiltering * bsphere.center, bsphere.radius, minPixel, maxPixel);
+
+      const Eigen::Vector3f origin = sensorPose.translation().cast<float>();
+      const Eigen::Matrix3f rotation = sensorPose.linear().cast<float>();
+      float entryDepth, exitDepth;
+      for (int v = minPixel.y(); v <= maxPixel.y(); ++v)
+      {
+        for (int u = minPixel.x(); u <= maxPixel.x(); ++u)
+        {
+          const auto pixel = static_cast<size_t>(v) * camera.width + static_cast<size_t>(u);
+          // the ray has unit z in the camera frame, so the line parameter is the depth
+          const Eigen::Vector3f direction = rotation * rasterizer.getPixelRay(pixel).cast<float>();
+          if (floatBody.lineInterval(origin, direction, entryDepth, exitDepth))
+            fn(pixel, entryDepth, exitDepth);
+        }
+      }
+      return true;
+    }
+    case shapes::MESH:
+    {
+      const auto& mesh = static_cast<const bodies::ConvexMesh&>(body);
+      const Eigen::Isometry3d cameraFromBody = cameraFromFiltering * body.getPose();
+      EigenSTL::vector_Vector3d vertices;
+      vertices.reserve(mesh.getScaledVertices().size());
+      for (const auto& vertex : mesh.getScaledVertices())
+        vertices.push_back(cameraFromBody * vertex);
+      return rasterizer.rasterizeConvexMesh(vertices, mesh.getTriangles(), fn);
+    }
+    default:
+      return false;
+  }
+}
+
+}
+
 RayCastingShapeMask::RayCastingShapeMask(
     const TransformCallback& transformCallback,
     const double minSensorDist, const double maxSensorDist,
@@ -49,6 +182,7 @@ RayCastingShapeMask::RayCastingShapeMask(
       maxShadowDist(maxShadowDist)
 {
   this->data = std::make_unique<RayCastingShapeMaskPIMPL>();
+  this->data->containsTestResults.resize(1);
 }
 
 RayCastingShapeMask::~RayCastingShapeMask() = default;
@@ -135,8 +269,18 @@ void RayCastingShapeMask::updateBodyPosesNoLock()
     bsphereBody = std::get<3>(multiBody).body;
     bboxBody = std::get<4>(multiBody).body;
 
+    // static shapes keep the pose they got in the first successful update
+    if (this->data->posedStaticShapes.find(std::get<0>(multiBody)) != this->data->posedStaticShapes.end())
+    {
+      validBodies.insert({containsBody, shadowBody, bsphereBody, bboxBody});
+      continue;
+    }
+
     if (this->transform_callback_(containsHandle, transform))
     {
+      if (this->staticShapes.find(std::get<0>(multiBody)) != this->staticShapes.end())
+        this->data->posedStaticShapes.insert(std::get<0>(multiBody));
+
       containsBody->setPose(transform);
       validBodies.insert(containsBody);
 
@@ -185,6 +329,8 @@ void RayCastingShapeMask::updateBodyPosesNoLock()
   this->bspheresBodyIndices.resize(this->bodies_.size());
   this->bspheresForContainsTest.resize(this->bodies_.size());
   this->bspheresForContainsTestBodyIndices.resize(this->bodies_.size());
+  this->bboxesForContainsTest.resize(this->bodies_.size());
+  this->data->containsTestBoundsIndices.clear();
 
   size_t bodyIdx = 0, validBodyIdx = 0, validContainsTestIdx = 0;
   for (const auto& seeShape : this->bodies_)
@@ -195,13 +341,15 @@ void RayCastingShapeMask::updateBodyPosesNoLock()
     if (validBodies.find(body) != validBodies.end())
     {
       this->bspheresBodyIndices[validBodyIdx] = bodyIdx;
-      body->computeBoundingSphere(this->bspheres_[validBodyIdx]);
+      this->computeBoundingSphereNoLock(shapeHandle, *body, this->bspheres_[validBodyIdx]);
 
       if (shapeHandle == multiShape.contains &&
         this->ignoreInContainsTest.find(multiShape) == this->ignoreInContainsTest.end())
       {
         this->bspheresForContainsTestBodyIndices[validContainsTestIdx] = bodyIdx;
         this->bspheresForContainsTest[validContainsTestIdx] = this->bspheres_[validBodyIdx];
+        this->computeBoundingBoxNoLock(shapeHandle, *body, this->bboxesForContainsTest[validContainsTestIdx]);
+        this->data->containsTestBoundsIndices[body] = validContainsTestIdx;
         validContainsTestIdx++;
       }
 
@@ -214,10 +362,275 @@ void RayCastingShapeMask::updateBodyPosesNoLock()
   this->bspheresForContainsTest.resize(validContainsTestIdx);
   this->bspheresBodyIndices.resize(validBodyIdx);
   this->bspheresForContainsTestBodyIndices.resize(validContainsTestIdx);
+  this->bboxesForContainsTest.resize(validContainsTestIdx);
 
   bodies::mergeBoundingSpheres(this->bspheres_, this->data->boundingSphere);
   bodies::mergeBoundingSpheres(this->bspheresForContainsTest,
                                this->data->boundingSphereForContainsTest);
+
+  this->updateBatchContainsTestNoLock();
+  this->updateShadowTestHierarchyNoLock();
+}
+
+void RayCastingShapeMask::updateShadowTestHierarchyNoLock()
+{
+  // rounding errors of intersectsRay() could place an intersection a tiny bit outside the body's
+  // bounding box, so the boxes are padded a little to not change the results of the shadow test
+  const double padding = 1e-6;
+
+  std::vector<BoundingVolumeHierarchy::Box> boxes;
+  boxes.reserve(this->data->bodiesForShadowTest.size());
+  this->data->shadowTestHierarchyBodies.clear();
+  this->data->shadowTestHierarchyFloatBodies.clear();
+  this->data->shadowTestHierarchyMeshes.clear();
+  this->data->shadowTestHierarchyInversePoses.clear();
+
+  bodies::AxisAlignedBoundingBox box;
+  for (const auto& seeShape : this->data->bodiesForShadowTest)
+  {
+    this->computeBoundingBoxNoLock(seeShape.handle, *seeShape.body, box);
+    box.min().array() -= padding;
+    box.max().array() += padding;
+    boxes.push_back(box);
+    this->data->shadowTestHierarchyBodies.push_back(seeShape.body);
+    if (this->singlePrecision)
+      this->data->shadowTestHierarchyFloatBodies.emplace_back(*seeShape.body);
+
+    const auto mesh = this->data->shadowTestMeshes.find(seeShape.handle);
+    if (mesh != this->data->shadowTestMeshes.end())
+    {
+      this->data->shadowTestHierarchyMeshes.push_back(mesh->second.get());
+      this->data->shadowTestHierarchyInversePoses.push_back(seeShape.body->getPose().inverse());
+    }
+    else
+    {
+      this->data->shadowTestHierarchyMeshes.push_back(nullptr);
+      this->data->shadowTestHierarchyInversePoses.push_back(Eigen::Isometry3d::Identity());
+    }
+  }
+
+  this->data->shadowTestHierarchy.build(boxes);
+}
+
+void RayCastingShapeMask::updateShadowDepthMapNoLock(const Eigen::Vector3d& sensorPos)
+{
+  auto& depthMap = this->data->shadowDepthMap;
+  depthMap.reset(sensorPos);
+
+  bodies::BoundingSphere bsphere;
+  for (const auto& seeShape : this->data->bodiesForShadowTest)
+  {
+    this->computeBoundingSphereNoLock(seeShape.handle, *seeShape.body, bsphere);
+    depthMap.addSphere(bsphere.center, bsphere.radius);
+  }
+}
+
+void RayCastingShapeMask::computeBoundingSphereNoLock(const point_containment_filter::ShapeHandle handle,
+    const bodies::Body& body, bodies::BoundingSphere& bsphere)
+{
+  const auto& multiShape = this->data->shapesToMultiShapes.at(handle);
+  if (this->data->posedStaticShapes.find(multiShape) == this->data->posedStaticShapes.end())
+  {
+    body.computeBoundingSphere(bsphere);
+    return;
+  }
+
+  const auto cachedBsphere = this->data->staticBoundingSpheres.find(handle);
+  if (cachedBsphere != this->data->staticBoundingSpheres.end())
+  {
+    bsphere = cachedBsphere->second;
+    return;
+  }
+
+  body.computeBoundingSphere(bsphere);
+  this->data->staticBoundingSpheres[handle] = bsphere;
+}
+
+void RayCastingShapeMask::computeBoundingBoxNoLock(const point_containment_filter::ShapeHandle handle,
+    const bodies::Body& body, bodies::AxisAlignedBoundingBox& box)
+{
+  const auto& multiShape = this->data->shapesToMultiShapes.at(handle);
+  if (this->data->posedStaticShapes.find(multiShape) == this->data->posedStaticShapes.end())
+  {
+    body.computeBoundingBox(box);
+    return;
+  }
+
+  const auto cachedBox = this->data->staticBoundingBoxes.find(handle);
+  if (cachedBox != this->data->staticBoundingBoxes.end())
+  {
+    box = cachedBox->second;
+    return;
+  }
+
+  body.computeBoundingBox(box);
+  this->data->staticBoundingBoxes[handle] = box;
+}
+
+void RayCastingShapeMask::updateBatchContainsTestNoLock()
+{
+  auto& batch = this->data->batchContainsTest;
+  batch.clear();
+  batch.setUseSafetyMargin(!this->singlePrecision);
+  this->data->batchContainsTestBodies.clear();
+  this->data->batchContainsTestGrids.clear();
+  this->data->batchContainsTestDistanceFields.clear();
+  this->data->batchContainsTestInversePoses.clear();
+
+  // bodies without a valid pose get no bounds, the exact test decides all points
+  const auto infinity = std::numeric_limits<double>::infinity();
+  const bodies::AxisAlignedBoundingBox unboundedBox(Eigen::Vector3d::Constant(-infinity),
+                                                    Eigen::Vector3d::Constant(infinity));
+
+  for (const auto& seeShape : this->data->bodiesForContainsTest)
+  {
+    const auto body = seeShape.body;
+    const auto dims = body->getDimensions();
+    const auto scale = body->getScale();
+    const auto padding = body->getPadding();
+
+    switch (body->getType())
+    {
+      case shapes::SPHERE:
+        batch.addSphere(body->getPose().translation(), dims[0] * scale + padding);
+        break;
+      case shapes::BOX:
+        batch.addBox(body->getPose(),
+          Eigen::Vector3d(dims[0], dims[1], dims[2]) * scale / 2.0 + Eigen::Vector3d::Constant(padding));
+        break;
+      case shapes::CYLINDER:
+        batch.addCylinder(body->getPose(), dims[0] * scale + padding, dims[1] * scale / 2.0 + padding);
+        break;
+      default:
+      {
+        // meshes are only prefiltered by their bounding volumes, the exact test decides the rest
+        const auto boundsIndex = this->data->containsTestBoundsIndices.find(body);
+        if (boundsIndex != this->data->containsTestBoundsIndices.end())
+        {
+          const auto& bsphere = this->bspheresForContainsTest[boundsIndex->second];
+          batch.addBounds(bsphere.center, bsphere.radius, this->bboxesForContainsTest[boundsIndex->second]);
+        }
+        else
+        {
+          batch.addBounds(Eigen::Vector3d::Zero(), infinity, unboundedBox);
+        }
+        break;
+      }
+    }
+    this->data->batchContainsTestBodies.push_back(body);
+
+    const auto grid = this->data->containsTestGrids.find(seeShape.handle);
+    const auto field = this->data->containsTestDistanceFields.find(seeShape.handle);
+    const auto hasGrid = grid != this->data->containsTestGrids.end();
+    const auto hasField = field != this->data->containsTestDistanceFields.end();
+    this->data->batchContainsTestGrids.push_back(hasGrid ? grid->second.get() : nullptr);
+    this->data->batchContainsTestDistanceFields.push_back(hasField ? field->second.get() : nullptr);
+    this->data->batchContainsTestInversePoses.push_back(
+      (hasGrid || hasField) ? body->getPose().inverse() : Eigen::Isometry3d::Identity());
+  }
+}
+
+bool RayCastingShapeMask::batchBodyContainsPointNoLock(const size_t body, const Eigen::Vector3d& point) const
+{
+  const auto grid = this->data->batchContainsTestGrids[body];
+  if (grid != nullptr)
+  {
+    switch (grid->getOccupancy(this->data->batchContainsTestInversePoses[body] * point))
+    {
+      case VoxelOccupancyGrid::Occupancy::INSIDE:
+        return true;
+      case VoxelOccupancyGrid::Occupancy::OUTSIDE:
+        return false;
+      default:
+        break;  // near the surface, the exact test has to decide
+    }
+  }
+  const auto field = this->data->batchContainsTestDistanceFields[body];
+  if (field != nullptr)
+  {
+    switch (field->classify(this->data->batchContainsTestInversePoses[body] * point))
+    {
+      case SignedDistanceField::Containment::INSIDE:
+        return true;
+      case SignedDistanceField::Containment::OUTSIDE:
+        return false;
+      default:
+        break;  // near the surface, the exact test has to decide
+    }
+  }
+  return this->data->batchContainsTestBodies[body]->containsPoint(point);
+}
+
+void RayCastingShapeMask::updateContainsTestGridNoLock(const point_containment_filter::ShapeHandle handle,
+    const bodies::Body* body)
+{
+  this->data->containsTestGrids.erase(handle);
+  this->data->containsTestDistanceFields.erase(handle);
+  if (body->getType() != shapes::MESH)
+    return;
+
+  // the voxel grid is a cheaper lookup, so it wins if both are configured
+  const auto& mesh = *static_cast<const bodies::ConvexMesh*>(body);
+  if (this->containsTestVoxelResolution > 0.0)
+    this->data->containsTestGrids[handle] = std::make_unique<VoxelOccupancyGrid>(
+      mesh, this->containsTestVoxelResolution);
+  else if (this->containsTestDistanceFieldResolution > 0.0)
+    this->data->containsTestDistanceFields[handle] = std::make_unique<SignedDistanceField>(
+      mesh, this->containsTestDistanceFieldResolution);
+}
+
+namespace
+{
+
+//! Sequential reader of the coordinates of pointcloud points.
+class PointReader
+{
+public:
+  PointReader(const Cloud& cloud, const size_t start) : x(cloud, "x"), y(cloud, "y"), z(cloud, "z")
+  {
+    this->x += start;
+    this->y += start;
+    this->z += start;
+  }
+
+  void read(float& px, float& py, float& pz)
+  {
+    px = *this->x; py = *this->y; pz = *this->z;
+    ++this->x; ++this->y; ++this->z;
+  }
+
+private:
+  CloudConstIter x, y, z;
+};
+
+//! Sequential reader of the coordinates of points in an array.
+class PointArrayReader
+{
+public:
+  PointArrayReader(const std::vector<Eigen::Vector3f>& points, const size_t start) : point(points.data() + start)
+  {
+  }
+
+  void read(float& px, float& py, float& pz)
+  {
+    px = this->point->x(); py = this->point->y(); pz = this->point->z();
+    ++this->point;
+  }
+
+private:
+  const Eigen::Vector3f* point;
+};
+
+PointReader makePointReader(const Cloud& data, const size_t start)
+{
+  return {data, start};
+}
+
+PointArrayReader makePointReader(const std::vector<Eigen::Vector3f>& data, const size_t start)
+{
+  return {data, start};
+}
+
 }
 
 void RayCastingShapeMask::maskContainmentAndShadows(
@@ -225,27 +638,269 @@ void RayCastingShapeMask::maskContainmentAndShadows(
     const Eigen::Vector3d& sensorPos)
 {
   boost::mutex::scoped_lock _(this->shapes_lock_);
+  this->maskAllContainmentAndShadowsNoLock(data, num_points(data), mask, sensorPos);
+}
 
-  const auto np = num_points(data);
+void RayCastingShapeMask::maskContainmentAndShadows(
+    const std::vector<Eigen::Vector3f>& data, std::vector<RayCastingShapeMask::MaskValue>& mask,
+    const Eigen::Vector3d& sensorPos)
+{
+  boost::mutex::scoped_lock _(this->shapes_lock_);
+  this->maskAllContainmentAndShadowsNoLock(data, data.size(), mask, sensorPos);
+}
+
+template<typename Points>
+void RayCastingShapeMask::maskAllContainmentAndShadowsNoLock(
+    const Points& data, const size_t np, std::vector<RayCastingShapeMask::MaskValue>& mask,
+    const Eigen::Vector3d& sensorPos)
+{
   mask.resize(np);
 
   this->updateBodyPosesNoLock();
 
+  // all points share the sensor position, so the depth map can be built once for all
+  const SphericalDepthMap* shadowDepthMap = nullptr;
+  if (this->doShadowTest && this->useShadowDepthMap)
+  {
+    this->updateShadowDepthMapNoLock(sensorPos);
+    shadowDepthMap = &this->data->shadowDepthMap;
+  }
+
+  if (this->data->threadPool == nullptr)
+  {
+    this->maskContainmentAndShadowsNoLock(data, 0, np, mask, sensorPos,
+                                          this->data->containsTestResults[0], shadowDepthMap);
+    return;
+  }
+
+  const auto numTasks = (np + POINTS_PER_TASK - 1) / POINTS_PER_TASK;
+  this->data->threadPool->parallelFor(numTasks, [&](const size_t task, const size_t thread)
+  {
+    const auto start = task * POINTS_PER_TASK;
+    this->maskContainmentAndShadowsNoLock(data, start, std::min(start + POINTS_PER_TASK, np), mask,
+                                          sensorPos, this->data->containsTestResults[thread],
+                                          shadowDepthMap);
+  });
+}
+
+template<typename Points>
+void RayCastingShapeMask::maskContainmentAndShadowsNoLock(
+    const Points& data, const size_t start, const size_t end,
+    std::vector<RayCastingShapeMask::MaskValue>& mask, const Eigen::Vector3d& sensorPos,
+    std::vector<BatchContainsTest::Result>& containsTestResults,
+    const SphericalDepthMap* shadowDepthMap, const EigenSTL::vector_Vector3d* viewpoints)
+{
   // we now decide which points we keep
-  CloudConstIter iter_x(data, "x");
-  CloudConstIter iter_y(data, "y");
-  CloudConstIter iter_z(data, "z");
+  auto points = makePointReader(data, start);
+
+  // Points are processed in blocks so that the contains test of primitive bodies can be vectorized.
+  constexpr auto BLOCK_SIZE = BatchContainsTest::BLOCK_SIZE;
+  const auto& batch = this->data->batchContainsTest;
+  const auto useBatch = this->doContainsTest && !batch.empty();
+  const auto& bsphere = this->data->boundingSphereForContainsTest;
+  const auto radiusSquared = bsphere.radius * bsphere.radius;
+  const Eigen::Vector3f bsphereCenterFloat = bsphere.center.cast<float>();
+  const auto radiusSquaredFloat = static_cast<float>(radiusSquared);
+  const Eigen::Vector3f sensorPosFloat = sensorPos.cast<float>();
+
+  containsTestResults.resize(batch.size() * BLOCK_SIZE);
+  float x[BLOCK_SIZE], y[BLOCK_SIZE], z[BLOCK_SIZE];
+
+  for (size_t blockStart = start; blockStart < end; blockStart += BLOCK_SIZE)
+  {
+    const auto blockLength = std::min(BLOCK_SIZE, end - blockStart);
+    bool blockInBsphere = false;
+    for (size_t j = 0; j < BLOCK_SIZE; ++j)
+    {
+      if (j < blockLength)
+      {
+        points.read(x[j], y[j], z[j]);
+        if (this->singlePrecision)
+          blockInBsphere |= (bsphereCenterFloat - Eigen::Vector3f(x[j], y[j], z[j])).squaredNorm() < radiusSquaredFloat;
+        else
+          blockInBsphere |= (bsphere.center - Eigen::Vector3d(x[j], y[j], z[j])).squaredNorm() < radiusSquared;
+      }
+      else
+      {
+        x[j] = y[j] = z[j] = std::numeric_limits<float>::quiet_NaN();
+      }
+    }
+
+    // no need to run the batched test if no point of the block can be inside the bodies
+    const auto classifyBlock = useBatch && blockInBsphere;
+    if (classifyBlock)
+      batch.classify(x, y, z, containsTestResults.data());
+
+    for (size_t j = 0; j < blockLength; ++j)
+    {
+      const auto results = classifyBlock ? containsTestResults.data() + j : nullptr;
+      if (this->singlePrecision)
+      {
+        const Eigen::Vector3f viewpoint = (viewpoints != nullptr) ?
+          (*viewpoints)[blockStart + j].cast<float>() : sensorPosFloat;
+        this->classifyPointSinglePrecisionNoLock(Eigen::Vector3f(x[j], y[j], z[j]), mask[blockStart + j],
+                                                 viewpoint, results, shadowDepthMap);
+      }
+      else
+      {
+        const Eigen::Vector3d pt(static_cast<double>(x[j]), static_cast<double>(y[j]),
+                                 static_cast<double>(z[j]));
+        const auto& viewpoint = (viewpoints != nullptr) ? (*viewpoints)[blockStart + j] : sensorPos;
+        this->classifyPointNoLock(pt, mask[blockStart + j], viewpoint, results, shadowDepthMap);
+      }
+    }
+  }
+}
+
+void RayCastingShapeMask::maskContainmentAndShadows(
+    const Cloud& data, std::vector<RayCastingShapeMask::MaskValue>& mask,
+    const Eigen::Isometry3d& sensorPose, const DepthCamera& camera)
+{
+  boost::mutex::scoped_lock _(this->shapes_lock_);
+
+  const auto np = num_points(data);
+  mask.resize(np);
+
+  this->updateBodyPosesNoLock();
+
+  auto& rasterizer = this->data->depthImageRasterizer;
+  if (rasterizer == nullptr || rasterizer->getCamera() != camera)
+    rasterizer = std::make_unique<DepthImageRasterizer>(camera);
+
+  const Eigen::Vector3d sensorPos = sensorPose.translation();
+  const Eigen::Isometry3d cameraFromFiltering = sensorPose.inverse();
+
+  // assign the points to the pixels that see them; points that share a pixel with another point or
+  // are not seen by any pixel are classified by the per-point tests
+  constexpr auto NO_POINT = std::numeric_limits<size_t>::max();
+  auto& pixelPoints = this->data->depthImagePixelPoints;
+  pixelPoints.assign(camera.width * camera.height, NO_POINT);
+  std::vector<float> depths(np);
+  std::vector<float> distances(np);
+  std::vector<size_t> perPointTestPoints;
+
+  CloudConstIter x_it(data, "x");
+  CloudConstIter y_it(data, "y");
+  CloudConstIter z_it(data, "z");
+  size_t pixel;
+  for (size_t i = 0; i < np; ++i, ++x_it, ++y_it, ++z_it)
+  {
+    mask[i] = MaskValue::OUTSIDE;
+    const Eigen::Vector3d point(*x_it, *y_it, *z_it);
+    if (point.hasNaN())
+      continue;
+
+    const auto distance = (sensorPos - point).norm();
+    if (this->doClipping && (distance < this->minSensorDist ||
+      (this->maxSensorDist > 0.0 && distance > this->maxSensorDist)))
+    {
+      mask[i] = MaskValue::CLIP;
+      continue;
+    }
+
+    const Eigen::Vector3d cameraPoint = cameraFromFiltering * point;
+    if (!rasterizer->getPixel(cameraPoint, pixel) || pixelPoints[pixel] != NO_POINT)
+    {
+      perPointTestPoints.push_back(i);
+      continue;
+    }
+    pixelPoints[pixel] = i;
+    depths[i] = static_cast<float>(cameraPoint.z());
+    distances[i] = static_cast<float>(distance);
+  }
+
+  CloudConstIter x_begin(data, "x");
+  CloudConstIter y_begin(data, "y");
+  CloudConstIter z_begin(data, "z");
+  const auto getPoint = [&](const size_t i) -> Eigen::Vector3d
+  {
+    const auto offset = static_cast<int>(i);
+    return {*(x_begin + offset), *(y_begin + offset), *(z_begin + offset)};
+  };
+
+  if (this->doContainsTest)
+  {
+    std::vector<const bodies::Body*> notRasterizedBodies;
+    for (const auto& seeShape : this->data->bodiesForContainsTest)
+    {
+      const auto rasterized = rasterizeBody(*seeShape.body, *rasterizer, sensorPose, cameraFromFiltering,
+        [&](const size_t pixel, const float entryDepth, const float exitDepth)
+        {
+          const auto i = pixelPoints[pixel];
+          if (i != NO_POINT && entryDepth <= depths[i] && depths[i] <= exitDepth)
+            mask[i] = MaskValue::INSIDE;
+        });
+      if (!rasterized)
+        notRasterizedBodies.push_back(seeShape.body);
+    }
+
+    if (!notRasterizedBodies.empty())
+    {
+      for (const auto i : pixelPoints)
+      {
+        if (i == NO_POINT || mask[i] != MaskValue::OUTSIDE)
+          continue;
+        const auto point = getPoint(i);
+        for (const auto body : notRasterizedBodies)
+        {
+          if (body->containsPoint(point))
+          {
+            mask[i] = MaskValue::INSIDE;
+            break;
+          }
+        }
+      }
+    }
+  }
 
-  // Cloud iterators are not incremented in the for loop, because of the pragma
-  // Comment out below parallelization as it can result in very high CPU consumption
-  //#pragma omp parallel for schedule(dynamic)
-  for (size_t i = 0; i < np; ++i)
+  if (this->doShadowTest)
   {
-    const Eigen::Vector3d pt(static_cast<double>(*(iter_x + i)),
-                             static_cast<double>(*(iter_y + i)),
-                             static_cast<double>(*(iter_z + i)));
-    this->classifyPointNoLock(pt, mask[i], sensorPos);
+    const auto isShadowCandidate = [&](const size_t i)
+    {
+      return i != NO_POINT && mask[i] == MaskValue::OUTSIDE &&
+        (this->maxShadowDist <= 0.0 || distances[i] <= this->maxShadowDist);
+    };
+
+    std::vector<const bodies::Body*> notRasterizedBodies;
+    for (const auto& body : this->data->shadowTestHierarchyBodies)
+    {
+      // the segment sensor->point crosses the body if the body starts before the point (and doesn't end
+      // behind the sensor)
+      const auto rasterized = rasterizeBody(*body, *rasterizer, sensorPose, cameraFromFiltering,
+        [&](const size_t pixel, const float entryDepth, const float exitDepth)
+        {
+          const auto i = pixelPoints[pixel];
+          if (isShadowCandidate(i) && entryDepth < depths[i] && exitDepth > 0.0f)
+            mask[i] = MaskValue::SHADOW;
+        });
+      if (!rasterized)
+        notRasterizedBodies.push_back(body);
+    }
+
+    if (!notRasterizedBodies.empty())
+    {
+      EigenSTL::vector_Vector3d intersections;
+      for (const auto i : pixelPoints)
+      {
+        if (!isShadowCandidate(i))
+          continue;
+        const auto point = getPoint(i);
+        const Eigen::Vector3d dir = (sensorPos - point).normalized();
+        for (const auto body : notRasterizedBodies)
+        {
+          intersections.clear(); // intersectsRay doesn't clear the vector...
+          if (body->intersectsRay(point, dir, &intersections, 1) && dir.dot(sensorPos - intersections[0]) >= 0.0)
+          {
+            mask[i] = MaskValue::SHADOW;
+            break;
+          }
+        }
+      }
+    }
   }
+
+  for (const auto i : perPointTestPoints)
+    this->classifyPointNoLock(getPoint(i), mask[i], sensorPos);
 }
 
 void RayCastingShapeMask::maskContainmentAndShadows(const Eigen::Vector3f& data,
@@ -263,11 +918,180 @@ void RayCastingShapeMask::maskContainmentAndShadows(const Eigen::Vector3f& data,
   if (updateBodyPoses)
     this->updateBodyPosesNoLock();
 
-  this->classifyPointNoLock(data.cast<double>(), mask, sensorPos);
+  if (!this->singlePrecision)
+  {
+    this->classifyPointNoLock(data.cast<double>(), mask, sensorPos);
+    return;
+  }
+
+  // run the batched contains test on a block containing just this point
+  const auto& batch = this->data->batchContainsTest;
+  auto& containsTestResults = this->data->containsTestResults[0];
+  float x[BatchContainsTest::BLOCK_SIZE], y[BatchContainsTest::BLOCK_SIZE], z[BatchContainsTest::BLOCK_SIZE];
+  std::fill_n(x, BatchContainsTest::BLOCK_SIZE, data.x());
+  std::fill_n(y, BatchContainsTest::BLOCK_SIZE, data.y());
+  std::fill_n(z, BatchContainsTest::BLOCK_SIZE, data.z());
+  containsTestResults.resize(batch.size() * BatchContainsTest::BLOCK_SIZE);
+  batch.classify(x, y, z, containsTestResults.data());
+
+  this->classifyPointSinglePrecisionNoLock(data, mask, sensorPos.cast<float>(), containsTestResults.data());
+}
+
+void RayCastingShapeMask::maskContainmentAndShadows(
+    const Cloud& data, std::vector<RayCastingShapeMask::MaskValue>& mask,
+    const std::vector<size_t>& binStarts, const std::function<void(size_t)>& beforeBodyPosesUpdate,
+    const EigenSTL::vector_Vector3d* givenViewpoints)
+{
+  boost::mutex::scoped_lock _(this->shapes_lock_);
+
+  const auto np = num_points(data);
+  mask.resize(np);
+
+  if (givenViewpoints == nullptr)
+  {
+    auto& cloudViewpoints = this->data->viewpoints;
+    cloudViewpoints.resize(np);
+    CloudConstIter iter_vp_x(data, "vp_x");
+    CloudConstIter iter_vp_y(data, "vp_y");
+    CloudConstIter iter_vp_z(data, "vp_z");
+    for (size_t i = 0; i < np; ++i, ++iter_vp_x, ++iter_vp_y, ++iter_vp_z)
+      cloudViewpoints[i] = Eigen::Vector3d(static_cast<double>(*iter_vp_x), static_cast<double>(*iter_vp_y),
+                                           static_cast<double>(*iter_vp_z));
+  }
+  const auto& viewpoints = (givenViewpoints != nullptr) ? *givenViewpoints : this->data->viewpoints;
+
+  const auto classifyRange = [&](const size_t start, const size_t end)
+  {
+    if (start >= end)
+      return;
+
+    if (this->data->threadPool == nullptr || end - start <= POINTS_PER_TASK)
+    {
+      this->maskContainmentAndShadowsNoLock(data, start, end, mask, Eigen::Vector3d::Zero(),
+                                            this->data->containsTestResults[0], nullptr, &viewpoints);
+      return;
+    }
+
+    const auto numTasks = (end - start + POINTS_PER_TASK - 1) / POINTS_PER_TASK;
+    this->data->threadPool->parallelFor(numTasks, [&](const size_t task, const size_t thread)
+    {
+      const auto taskStart = start + task * POINTS_PER_TASK;
+      this->maskContainmentAndShadowsNoLock(data, taskStart, std::min(taskStart + POINTS_PER_TASK, end), mask,
+                                            Eigen::Vector3d::Zero(), this->data->containsTestResults[thread],
+                                            nullptr, &viewpoints);
+    });
+  };
+
+  size_t start = 0;
+  for (const auto binStart : binStarts)
+  {
+    if (binStart >= np)
+      break;
+
+    classifyRange(start, binStart);
+    start = std::max(start, binStart);
+
+    if (beforeBodyPosesUpdate)
+      beforeBodyPosesUpdate(binStart);
+    this->updateBodyPosesNoLock();
+  }
+  classifyRange(start, np);
+}
+
+void RayCastingShapeMask::classifyPointSinglePrecisionNoLock(const Eigen::Vector3f& data,
+    RayCastingShapeMask::MaskValue &mask, const Eigen::Vector3f& sensorPos,
+    const BatchContainsTest::Result* containsTestResults, const SphericalDepthMap* shadowDepthMap)
+{
+  mask = MaskValue::OUTSIDE;
+
+  if (data.hasNaN()) {
+    return;
+  }
+
+  // direction from measured point to sensor
+  Eigen::Vector3f dir(sensorPos - data);
+  const auto distance = dir.norm();
+
+  if (this->doClipping && (distance < static_cast<float>(this->minSensorDist) ||
+    (this->maxSensorDist > 0.0 && distance > static_cast<float>(this->maxSensorDist))))
+  {
+    // check if the point is inside measurement range
+    mask = MaskValue::CLIP;
+    return;
+  }
+
+  // check if it is inside the scaled body
+  const auto& bsphere = this->data->boundingSphereForContainsTest;
+  const auto radiusSquared = static_cast<float>(bsphere.radius * bsphere.radius);
+  if (this->doContainsTest && (bsphere.center.cast<float>() - data).squaredNorm() < radiusSquared)
+  {
+    if (containsTestResults == nullptr)
+    {
+      for (const auto &seeShape : this->data->bodiesForContainsTest)
+      {
+        if (seeShape.body->containsPoint(data.cast<double>()))
+        {
+          mask = MaskValue::INSIDE;
+          return;
+        }
+      }
+    }
+    else
+    {
+      // UNSURE results are only reported for meshes (or points exactly on the surface)
+      const auto& batchBodies = this->data->batchContainsTestBodies;
+      for (size_t b = 0; b < batchBodies.size(); ++b)
+      {
+        const auto result = containsTestResults[b * BatchContainsTest::BLOCK_SIZE];
+        if (result == BatchContainsTest::Result::INSIDE ||
+          (result == BatchContainsTest::Result::UNSURE && this->batchBodyContainsPointNoLock(b, data.cast<double>())))
+        {
+          mask = MaskValue::INSIDE;
+          return;
+        }
+      }
+    }
+  }
+
+  // the segment pt->sensor can't cross any body if the point is nearer than all bodies in its direction
+  if (this->doShadowTest && (this->maxShadowDist <= 0.0 || distance <= static_cast<float>(this->maxShadowDist)) &&
+    (shadowDepthMap == nullptr || distance >= shadowDepthMap->getMinDistance(data))) {
+    // point is not inside the robot, check if it is a shadow point
+    dir /= distance;
+    const Eigen::Vector3d dataDouble = data.cast<double>();
+    const Eigen::Vector3d dirDouble = dir.cast<double>();
+    EigenSTL::vector_Vector3d intersections;
+    const auto& shadowBodies = this->data->shadowTestHierarchyBodies;
+    const auto& floatBodies = this->data->shadowTestHierarchyFloatBodies;
+    const auto& meshes = this->data->shadowTestHierarchyMeshes;
+    const auto& inversePoses = this->data->shadowTestHierarchyInversePoses;
+    // only bodies whose bounding boxes are crossed by the segment pt->sensor are tested
+    const auto isShadow = this->data->shadowTestHierarchy.anySegmentHit(dataDouble, dirDouble, distance,
+      [&](const size_t i)
+      {
+        if (floatBodies[i].getType() != SinglePrecisionBody::Type::UNSUPPORTED)
+          return floatBodies[i].intersectsRay(data, dir, distance);
+
+        // meshes are tested in double
+        if (meshes[i] != nullptr)
+          return meshes[i]->intersectsSegment(inversePoses[i] * dataDouble, inversePoses[i].linear() * dirDouble,
+                                              static_cast<double>(distance));
+
+        intersections.clear(); // intersectsRay doesn't clear the vector...
+        return shadowBodies[i]->intersectsRay(dataDouble, dirDouble, &intersections, 1) &&
+          dirDouble.dot(sensorPos.cast<double>() - intersections[0]) >= 0.0;
+      });
+
+    if (isShadow) {
+      mask = MaskValue::SHADOW;
+      return;
+    }
+  }
 }
 
 void RayCastingShapeMask::classifyPointNoLock(const Eigen::Vector3d& data,
-    RayCastingShapeMask::MaskValue &mask, const Eigen::Vector3d& sensorPos)
+    RayCastingShapeMask::MaskValue &mask, const Eigen::Vector3d& sensorPos,
+    const BatchContainsTest::Result* containsTestResults, const SphericalDepthMap* shadowDepthMap)
 {
   mask = MaskValue::OUTSIDE;
 
@@ -292,34 +1116,132 @@ void RayCastingShapeMask::classifyPointNoLock(const Eigen::Vector3d& data,
   if (this->doContainsTest &&
     (this->data->boundingSphereForContainsTest.center - data).squaredNorm() < radiusSquared)
   {
-    for (const auto &seeShape : this->data->bodiesForContainsTest)
+    if (containsTestResults == nullptr)
     {
-      if (seeShape.body->containsPoint(data))
+      for (const auto &seeShape : this->data->bodiesForContainsTest)
       {
-        mask = MaskValue::INSIDE;
-        return;
+        if (seeShape.body->containsPoint(data))
+        {
+          mask = MaskValue::INSIDE;
+          return;
+        }
+      }
+    }
+    else
+    {
+      const auto& batchBodies = this->data->batchContainsTestBodies;
+      for (size_t b = 0; b < batchBodies.size(); ++b)
+      {
+        const auto result = containsTestResults[b * BatchContainsTest::BLOCK_SIZE];
+        if (result == BatchContainsTest::Result::INSIDE ||
+          (result == BatchContainsTest::Result::UNSURE && this->batchBodyContainsPointNoLock(b, data)))
+        {
+          mask = MaskValue::INSIDE;
+          return;
+        }
       }
     }
   }
 
-  if (this->doShadowTest && (this->maxShadowDist <= 0.0 || distance <= this->maxShadowDist)) {
+  // the segment pt->sensor can't cross any body if the point is nearer than all bodies in its direction
+  if (this->doShadowTest && (this->maxShadowDist <= 0.0 || distance <= this->maxShadowDist) &&
+    (shadowDepthMap == nullptr || distance >= shadowDepthMap->getMinDistance(data))) {
     // point is not inside the robot, check if it is a shadow point
     dir /= distance;
     EigenSTL::vector_Vector3d intersections;
-    for (const auto &seeShape : this->data->bodiesForShadowTest) {
-      // get the 1st intersection of ray pt->sensor
-      intersections.clear(); // intersectsRay doesn't clear the vector...
-      if (seeShape.body->intersectsRay(data, dir, &intersections, 1)) {
+    const auto& shadowBodies = this->data->shadowTestHierarchyBodies;
+    const auto& meshes = this->data->shadowTestHierarchyMeshes;
+    const auto& inversePoses = this->data->shadowTestHierarchyInversePoses;
+    // only bodies whose bounding boxes are crossed by the segment pt->sensor are tested
+    const auto isShadow = this->data->shadowTestHierarchy.anySegmentHit(data, dir, distance,
+      [&](const size_t i)
+      {
+        // meshes only test the triangles near the segment
+        if (meshes[i] != nullptr)
+          return meshes[i]->intersectsSegment(inversePoses[i] * data, inversePoses[i].linear() * dir, distance);
+
+        // get the 1st intersection of ray pt->sensor
+        intersections.clear(); // intersectsRay doesn't clear the vector...
         // is the intersection between point and sensor?
-        if (dir.dot(sensorPos - intersections[0]) >= 0.0) {
-          mask = MaskValue::SHADOW;
-          return;
-        }
-      }
+        return shadowBodies[i]->intersectsRay(data, dir, &intersections, 1) &&
+          dir.dot(sensorPos - intersections[0]) >= 0.0;
+      });
+
+    if (isShadow) {
+      mask = MaskValue::SHADOW;
+      return;
     }
   }
 }
 
+void RayCastingShapeMask::setNumThreads(const size_t numThreads, const std::vector<int>& cpuAffinity)
+{
+  boost::mutex::scoped_lock _(this->shapes_lock_);
+
+  // stop the old workers before starting new ones so that the core limit is never exceeded
+  this->data->threadPool.reset();
+  if (numThreads != 1)
+    this->data->threadPool = std::make_unique<ThreadPool>(numThreads, cpuAffinity);
+
+  if (this->data->threadPool != nullptr && this->data->threadPool->getNumThreads() == 1)
+    this->data->threadPool.reset();
+
+  this->data->containsTestResults.resize(this->getNumThreadsNoLock());
+}
+
+void RayCastingShapeMask::setSinglePrecision(const bool singlePrecision)
+{
+  boost::mutex::scoped_lock _(this->shapes_lock_);
+  this->singlePrecision = singlePrecision;
+  this->updateBatchContainsTestNoLock();
+  this->updateShadowTestHierarchyNoLock();
+}
+
+void RayCastingShapeMask::setShadowDepthMap(const bool useShadowDepthMap, const double angularResolution)
+{
+  boost::mutex::scoped_lock _(this->shapes_lock_);
+  this->useShadowDepthMap = useShadowDepthMap;
+  if (useShadowDepthMap)
+    this->data->shadowDepthMap.setAngularResolution(angularResolution);
+}
+
+void RayCastingShapeMask::setContainsTestVoxelResolution(const double resolution)
+{
+  boost::mutex::scoped_lock _(this->shapes_lock_);
+  this->containsTestVoxelResolution = resolution;
+  this->data->containsTestGrids.clear();
+  for (const auto& multiBody : this->data->multiBodies)
+  {
+    const auto& containsSeeShape = std::get<1>(multiBody);
+    this->updateContainsTestGridNoLock(containsSeeShape.handle, containsSeeShape.body);
+  }
+  this->updateBatchContainsTestNoLock();
+}
+
+void RayCastingShapeMask::setContainsTestDistanceFieldResolution(const double resolution)
+{
+  boost::mutex::scoped_lock _(this->shapes_lock_);
+  this->containsTestDistanceFieldResolution = resolution;
+  this->data->containsTestDistanceFields.clear();
+  for (const auto& multiBody : this->data->multiBodies)
+  {
+    const auto& containsSeeShape = std::get<1>(multiBody);
+    this->updateContainsTestGridNoLock(containsSeeShape.handle, containsSeeShape.body);
+  }
+  this->updateBatchContainsTestNoLock();
+}
+
+size_t RayCastingShapeMask::getNumThreads() const
+{
+  boost::mutex::scoped_lock _(this->shapes_lock_);
+  return this->getNumThreadsNoLock();
+}
+
+size_t RayCastingShapeMask::getNumThreadsNoLock() const
+{
+  return this->data->threadPool == nullptr ? 1 : this->data->threadPool->getNumThreads();
+}
+
 void RayCastingShapeMask::setIgnoreInContainsTest(
     std::unordered_set<MultiShapeHandle> ignoreInContainsTest,
     const bool updateInternalStructures)
@@ -329,6 +1251,15 @@ void RayCastingShapeMask::setIgnoreInContainsTest(
     this->updateInternalShapeLists();
 }
 
+void RayCastingShapeMask::setStaticShapes(std::unordered_set<MultiShapeHandle> staticShapes)
+{
+  boost::mutex::scoped_lock _(this->shapes_lock_);
+  this->staticShapes = std::move(staticShapes);
+  this->data->posedStaticShapes.clear();
+  this->data->staticBoundingSpheres.clear();
+  this->data->staticBoundingBoxes.clear();
+}
+
 void RayCastingShapeMask::setIgnoreInShadowTest(
     std::unordered_set<MultiShapeHandle> ignoreInShadowTest,
     const bool updateInternalStructures)
@@ -381,7 +1312,18 @@ MultiShapeHandle RayCastingShapeMask::addShape(
   }
 
   auto containsSeeShape = *this->used_handles_.at(result.contains);
+  if (this->containsTestVoxelResolution > 0.0 || this->containsTestDistanceFieldResolution > 0.0)
+  {
+    boost::mutex::scoped_lock _(this->shapes_lock_);
+    this->updateContainsTestGridNoLock(result.contains, containsSeeShape.body);
+  }
   auto shadowSeeShape = *this->used_handles_.at(result.shadow);
+  if (shadowSeeShape.body->getType() == shapes::MESH)
+  {
+    boost::mutex::scoped_lock _(this->shapes_lock_);
+    this->data->shadowTestMeshes[result.shadow] = std::make_unique<TriangleMeshHierarchy>(
+      *static_cast<const bodies::ConvexMesh*>(shadowSeeShape.body));
+  }
   auto bsphereSeeShape = *this->used_handles_.at(result.bsphere);
   auto bboxSeeShape = *this->used_handles_.at(result.bbox);
   this->data->multiBodies.emplace_back(result, containsSeeShape, shadowSeeShape, bsphereSeeShape, bboxSeeShape);
@@ -405,6 +1347,16 @@ void RayCastingShapeMask::removeShape(const MultiShapeHandle& handle,
 
   ShapeMask::removeShape(handle.contains);
   this->data->shapeNames.erase(handle.contains);
+  {
+    boost::mutex::scoped_lock _(this->shapes_lock_);
+    this->data->containsTestGrids.erase(handle.contains);
+    this->data->containsTestDistanceFields.erase(handle.contains);
+    this->data->shadowTestMeshes.erase(handle.shadow);
+    // the handles of the removed shapes can be reused by new shapes
+    this->data->posedStaticShapes.erase(handle);
+    this->data->staticBoundingSpheres.clear();
+    this->data->staticBoundingBoxes.clear();
+  }
   this->data->shapesToMultiShapes.erase(handle.contains);
 
   if (handle.contains != handle.shadow)
@@ -446,6 +1398,8 @@ void RayCastingShapeMask::updateInternalShapeLists()
   this->data->bodiesForShadowTest.clear();
   this->data->bodiesForBsphere.clear();
   this->data->bodiesForBbox.clear();
+  // the bounds of the bodies are only known again after the next updateBodyPoses()
+  this->data->containsTestBoundsIndices.clear();
 
   for (const auto& multiBody : this->data->multiBodies) {
     const auto handle = std::get<0>(multiBody);
@@ -463,6 +1417,9 @@ void RayCastingShapeMask::updateInternalShapeLists()
     if (this->ignoreInBbox.find(handle) == this->ignoreInBbox.end())
       this->data->bodiesForBbox.insert(bboxSeeShape);
   }
+
+  this->updateBatchContainsTestNoLock();
+  this->updateShadowTestHierarchyNoLock();
 }
 
 std::map<point_containment_filter::ShapeHandle, const bodies::Body*>
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <utility>
 
 #include <functional>
@@ -20,19 +21,23 @@
 #include <sensor_msgs/point_cloud_conversion.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
 
+#include <moveit/robot_model/revolute_joint_model.h>
 #include <pcl_conversions/pcl_conversions.h>
+#include <srdfdom/model.h>
 #include <tf2/LinearMath/Transform.h>
 #include <tf2_sensor_msgs/tf2_sensor_msgs.h>
 #include <tf2_eigen/tf2_eigen.h>
 
 #include <robot_body_filter/utils/bodies.h>
 #include <robot_body_filter/utils/crop_box.h>
+#include <robot_body_filter/utils/mesh_simplification.h>
 #include <robot_body_filter/utils/set_utils.hpp>
 #include <robot_body_filter/utils/shapes.h>
 #include <robot_body_filter/utils/string_utils.hpp>
 #include <robot_body_filter/utils/tf2_eigen.h>
 #include <robot_body_filter/utils/tf2_sensor_msgs.h>
 #include <robot_body_filter/utils/time_utils.hpp>
+#include <robot_body_filter/utils/transform_memo.h>
 #include <robot_body_filter/utils/urdf_eigen.hpp>
 
 using namespace std;
@@ -57,8 +62,18 @@ bool RobotBodyFilter<T>::configure() {
   } else {
     // clear the TF buffer (useful if calling configure() after receiving old TF data)
     this->tfBuffer->clear();
+    // the memoized transforms come from the cleared data, too
+    TransformMemo::getProcessWide()->clear();
   }
 
+  // joint states are kept as long as TF data
+  if (this->jointStates == nullptr)
+    this->jointStates = std::make_unique<JointStateBuffer>(this->tfBufferLength);
+  else
+    this->jointStates->clear();
+  this->jointStates->setHoldDuration(
+      this->getParamVerbose("transforms/forward_kinematics/hold_duration", ros::Duration(0.1), "s"));
+
   this->fixedFrame = this->getParamVerbose("frames/fixed", "base_link");
   stripLeadingSlash(this->fixedFrame, true);
   this->sensorFrame = this->getParamVerbose("frames/sensor", "");
@@ -68,15 +83,39 @@ bool RobotBodyFilter<T>::configure() {
   this->minDistance = this->getParamVerbose("sensor/min_distance", 0.0, "m");
   this->maxDistance = this->getParamVerbose("sensor/max_distance", 0.0, "m");
   this->robotDescriptionParam = this->getParamVerbose("body_model/robot_description_param", "robot_description");
+  this->meshSimplificationMaxError = this->getParamVerbose("body_model/mesh_simplification/max_error", 0.0, "m");
   this->keepCloudsOrganized = this->getParamVerbose("filter/keep_clouds_organized", true);
   this->modelPoseUpdateInterval = this->getParamVerbose("filter/model_pose_update_interval", ros::Duration(0, 0), "s");
-  const bool doClipping = this->getParamVerbose("filter/do_clipping", true);
+  this->numScanKeyframes = std::max(2u, this->getParamVerbose("transforms/scan_keyframes", 2u));
+  this->cacheFixedLinkTransforms = this->getParamVerbose("transforms/cache_fixed_links", false);
+  this->forwardKinematics = this->getParamVerbose("transforms/forward_kinematics/enable", false);
+  const auto jointStatesTopic = this->getParamVerbose("transforms/forward_kinematics/joint_states_topic", "joint_states");
+  this->viewpointsFromTf = this->getParamVerbose("sensor/viewpoints_from_tf", false);
+  if (this->viewpointsFromTf && this->sensorFrame.empty()) {
+    ROS_ERROR("RobotBodyFilter: Parameter sensor/viewpoints_from_tf requires frames/sensor to be set. "
+              "Viewpoints will be read from the vp_x, vp_y and vp_z fields instead.");
+    this->viewpointsFromTf = false;
+  }
+  this->doClipping = this->getParamVerbose("filter/do_clipping", true);
   const bool doContainsTest = this->getParamVerbose("filter/do_contains_test", true);
   const bool doShadowTest = this->getParamVerbose("filter/do_shadow_test", true);
   const double maxShadowDistance = this->getParamVerbose("filter/max_shadow_distance", this->maxDistance, "m");
+  const auto numThreads = this->getParamVerbose("filter/num_threads", 1u);
+  const auto cpuAffinity = this->getParamVerbose("filter/cpu_affinity", std::vector<int>());
+  const bool singlePrecision = this->getParamVerbose("filter/single_precision", false);
+  const bool useShadowDepthMap = this->getParamVerbose("filter/shadow_depth_map/enable", false);
+  const double shadowDepthMapResolution = this->getParamVerbose("filter/shadow_depth_map/angular_resolution", 0.01, "rad");
+  const double containsTestVoxelResolution = this->getParamVerbose("filter/contains_test_voxel_resolution", 0.0, "m");
+  const double containsTestDistanceFieldResolution = this->getParamVerbose("filter/contains_test_distance_field_resolution", 0.0, "m");
   this->reachableTransformTimeout = this->getParamVerbose("transforms/timeout/reachable", ros::Duration(0.1), "s");
-  this->unreachableTransformTimeout = this->getParamVerbose("transforms/timeout/unreachable", ros::Duration(0.2), "s");
+  bool unreachableTransformTimeoutUnset;
+  this->getParamVerbose("transforms/timeout/unreachable", ros::Duration(0.2), "s", &unreachableTransformTimeoutUnset);
+  if (!unreachableTransformTimeoutUnset)
+    ROS_WARN("RobotBodyFilter: Parameter transforms/timeout/unreachable is deprecated and has no effect. "
+             "Unreachable frames are not waited for.");
   this->requireAllFramesReachable = this->getParamVerbose("transforms/require_all_reachable", false);
+  const auto transformMemoSize = this->getParamVerbose("transforms/memo_size", 0u);
+  const auto transformMemoStampTolerance = this->getParamVerbose("transforms/memo_stamp_tolerance", ros::Duration(0.005), "s");
   this->publishNoBoundingSpherePointcloud = this->getParamVerbose("bounding_sphere/publish_cut_out_pointcloud", false);
   this->publishNoBoundingBoxPointcloud = this->getParamVerbose("bounding_box/publish_cut_out_pointcloud", false);
   this->publishNoOrientedBoundingBoxPointcloud = this->getParamVerbose("oriented_bounding_box/publish_cut_out_pointcloud", false);
@@ -203,6 +242,12 @@ bool RobotBodyFilter<T>::configure() {
   this->robotDescriptionUpdatesListener = this->nodeHandle.subscribe(
     "dynamic_robot_model_server/parameter_updates", 10, &RobotBodyFilter::robotDescriptionUpdated, this);
 
+  this->jointStatesSubscriber.shutdown();
+  if (this->forwardKinematics) {
+    this->jointStatesSubscriber = this->nodeHandle.subscribe(
+      jointStatesTopic, 100, &RobotBodyFilter::jointStatesReceived, this);
+  }
+
   this->reloadRobotModelServiceServer = this->privateNodeHandle.advertiseService(
       "reload_model", &RobotBodyFilter::triggerModelReload, this);
 
@@ -317,7 +362,14 @@ bool RobotBodyFilter<T>::configure() {
   auto getShapeTransformCallback = std::bind(&RobotBodyFilter::getShapeTransform, this, std::placeholders::_1, std::placeholders::_2);
   shapeMask = std::make_unique<RayCastingShapeMask>(getShapeTransformCallback,
       this->minDistance, this->maxDistance,
-      doClipping, doContainsTest, doShadowTest, maxShadowDistance);
+      this->doClipping, doContainsTest, doShadowTest, maxShadowDistance);
+  shapeMask->setNumThreads(numThreads, cpuAffinity);
+  shapeMask->setSinglePrecision(singlePrecision);
+  shapeMask->setShadowDepthMap(useShadowDepthMap, shadowDepthMapResolution);
+  shapeMask->setContainsTestVoxelResolution(containsTestVoxelResolution);
+  shapeMask->setContainsTestDistanceFieldResolution(containsTestDistanceFieldResolution);
+  if (shapeMask->getNumThreads() != numThreads)
+    ROS_INFO("Classifying pointclouds using %zu threads", shapeMask->getNumThreads());
 
   // the other case happens when configure() is called again from update() (e.g. when a new bag file
   // started playing)
@@ -329,11 +381,18 @@ bool RobotBodyFilter<T>::configure() {
     }
 
     this->tfFramesWatchdog = std::make_shared<TFFramesWatchdog>(this->filteringFrame,
-        initialMonitoredFrames, this->tfBuffer,
-        this->unreachableTransformTimeout, ros::Rate(ros::Duration(1.0)));
+        initialMonitoredFrames, this->tfBuffer, ros::Rate(ros::Duration(1.0)));
     this->tfFramesWatchdog->start();
   }
 
+  // filters running in the same process share the transforms they resolve
+  if (transformMemoSize > 0) {
+    TransformMemo::getProcessWide()->reserveCapacity(transformMemoSize);
+    this->tfFramesWatchdog->setTransformMemo(TransformMemo::getProcessWide(), transformMemoStampTolerance);
+  } else {
+    this->tfFramesWatchdog->setTransformMemo(nullptr);
+  }
+
   { // initialize the robot body to be masked out
 
     string robotUrdf;
@@ -362,7 +421,7 @@ bool RobotBodyFilter<T>::configure() {
   ROS_INFO("Filtering data in frame %s", this->filteringFrame.c_str());
   ROS_INFO("RobotBodyFilter: Filtering into the following categories:");
   ROS_INFO("RobotBodyFilter: \tOUTSIDE");
-  if (doClipping) ROS_INFO("RobotBodyFilter: \tCLIP");
+  if (this->doClipping) ROS_INFO("RobotBodyFilter: \tCLIP");
   if (doContainsTest) ROS_INFO("RobotBodyFilter: \tINSIDE");
   if (doShadowTest) ROS_INFO("RobotBodyFilter: \tSHADOW");
 
@@ -387,9 +446,23 @@ bool RobotBodyFilter<T>::configure() {
 
 bool RobotBodyFilterLaserScan::configure() {
   this->pointByPointScan = this->getParamVerbose("sensor/point_by_point", true);
+  this->directScanClassification = this->getParamVerbose("sensor/direct_scan_classification", true);
 
   bool success = RobotBodyFilter::configure();
-  return success;
+  if (!success)
+    return false;
+
+  // the debug and cut-out pointclouds are made of the projected scan
+  if (this->directScanClassification && (this->publishDebugPclInside || this->publishDebugPclClip ||
+      this->publishDebugPclShadow || this->publishNoBoundingSpherePointcloud || this->publishNoBoundingBoxPointcloud ||
+      this->publishNoOrientedBoundingBoxPointcloud || this->publishNoLocalBoundingBoxPointcloud))
+  {
+    ROS_INFO("RobotBodyFilter: Debug or cut-out pointclouds are published, so laser scans are projected to "
+             "pointclouds before classification.");
+    this->directScanClassification = false;
+  }
+
+  return true;
 }
 
 bool RobotBodyFilterPointCloud2::configure() {
@@ -411,6 +484,55 @@ bool RobotBodyFilterPointCloud2::configure() {
 
   stripLeadingSlash(this->outputFrame, true);
 
+  const auto cameraInfoTopic = this->getParamVerbose("sensor/camera_info_topic", std::string());
+  {
+    std::lock_guard<std::mutex> guard(this->cameraInfoMutex);
+    this->cameraInfo.reset();
+  }
+  this->cameraInfoSubscriber.shutdown();
+  if (!cameraInfoTopic.empty())
+  {
+    if (this->pointByPointScan)
+      ROS_WARN("RobotBodyFilter: sensor/camera_info_topic is ignored for point-by-point scans.");
+    else
+      this->cameraInfoSubscriber = this->nodeHandle.subscribe(
+          cameraInfoTopic, 1, &RobotBodyFilterPointCloud2::cameraInfoReceived, this);
+  }
+
+  return true;
+}
+
+void RobotBodyFilterPointCloud2::cameraInfoReceived(const sensor_msgs::CameraInfoConstPtr& msg)
+{
+  std::lock_guard<std::mutex> guard(this->cameraInfoMutex);
+  this->cameraInfo = msg;
+}
+
+bool RobotBodyFilterPointCloud2::getDepthCamera(const sensor_msgs::PointCloud2& cloud, DepthCamera& camera)
+{
+  sensor_msgs::CameraInfoConstPtr info;
+  {
+    std::lock_guard<std::mutex> guard(this->cameraInfoMutex);
+    info = this->cameraInfo;
+  }
+
+  if (info == nullptr || cloud.height <= 1)
+    return false;
+
+  if (info->width != cloud.width || info->height != cloud.height || info->K[0] <= 0.0 || info->K[4] <= 0.0)
+  {
+    ROS_WARN_THROTTLE(3, "RobotBodyFilter: The camera info (%ux%u) doesn't match the organized cloud "
+                         "(%ux%u), the cloud is filtered point by point.",
+                      info->width, info->height, cloud.width, cloud.height);
+    return false;
+  }
+
+  camera.width = info->width;
+  camera.height = info->height;
+  camera.fx = info->K[0];
+  camera.fy = info->K[4];
+  camera.cx = info->K[2];
+  camera.cy = info->K[5];
   return true;
 }
 
@@ -418,7 +540,7 @@ template <typename T>
 bool RobotBodyFilter<T>::computeMask(
     const sensor_msgs::PointCloud2 &projectedPointCloud,
     std::vector<RayCastingShapeMask::MaskValue> &pointMask,
-    const std::string &sensorFrame) {
+    const std::string &sensorFrame, const DepthCamera* depthCamera) {
 
   // this->modelMutex has to be already locked!
 
@@ -430,12 +552,12 @@ bool RobotBodyFilter<T>::computeMask(
 
   if (!this->pointByPointScan)
   {
-    Eigen::Vector3d sensorPosition;
+    Eigen::Isometry3d sensorPose;
     try {
       const auto sensorTf = this->tfBuffer->lookupTransform(
           this->filteringFrame, sensorFrame, scanTime,
           remainingTime(scanTime, this->reachableTransformTimeout));
-      tf2::fromMsg(sensorTf.transform.translation, sensorPosition);
+      sensorPose = tf2::transformToEigen(sensorTf.transform);
     } catch (tf2::TransformException& e) {
       ROS_ERROR("RobotBodyFilter: Could not compute filtering mask due to this "
                 "TF exception: %s", e.what());
@@ -447,18 +569,13 @@ bool RobotBodyFilter<T>::computeMask(
 
     // updates shapes according to tf cache (by calling getShapeTransform
     // for each shape) and masks contained points
-    this->shapeMask->maskContainmentAndShadows(projectedPointCloud, pointMask, sensorPosition);
+    if (depthCamera != nullptr)
+      this->shapeMask->maskContainmentAndShadows(projectedPointCloud, pointMask, sensorPose, *depthCamera);
+    else
+      this->shapeMask->maskContainmentAndShadows(projectedPointCloud, pointMask, sensorPose.translation());
   } else {
-    CloudConstIter x_it(projectedPointCloud, "x");
-    CloudConstIter y_it(projectedPointCloud, "y");
-    CloudConstIter z_it(projectedPointCloud, "z");
-    CloudConstIter vp_x_it(projectedPointCloud, "vp_x");
-    CloudConstIter vp_y_it(projectedPointCloud, "vp_y");
-    CloudConstIter vp_z_it(projectedPointCloud, "vp_z");
     CloudConstIter stamps_it(projectedPointCloud, "stamps");
 
-    pointMask.resize(num_points(projectedPointCloud));
-
     double scanDuration = 0.0;
     for (CloudConstIter stamps_end_it(projectedPointCloud, "stamps"); stamps_end_it != stamps_end_it.end(); ++stamps_end_it)
     {
@@ -489,32 +606,32 @@ bool RobotBodyFilter<T>::computeMask(
     // update transforms cache, which is then used in body masking
     this->updateTransformCache(scanTime, afterScanTime);
 
-    Eigen::Vector3f point;
-    Eigen::Vector3d viewPoint;
-    RayCastingShapeMask::MaskValue mask;
-
-    this->cacheLookupBetweenScansRatio = 0.0;
-    for (size_t i = 0; i < num_points(projectedPointCloud); ++i, ++x_it, ++y_it, ++z_it, ++vp_x_it, ++vp_y_it, ++vp_z_it, ++stamps_it)
+    const EigenSTL::vector_Vector3d* viewpoints = nullptr;
+    if (this->viewpointsFromTf)
     {
-      point.x() = *x_it;
-      point.y() = *y_it;
-      point.z() = *z_it;
-
-      // TODO viewpoint can be autocomputed from stamps
-      viewPoint.x() = static_cast<double>(*vp_x_it);
-      viewPoint.y() = static_cast<double>(*vp_y_it);
-      viewPoint.z() = static_cast<double>(*vp_z_it);
-
-      const auto updateBodyPoses = i % updateBodyPosesEvery == 0;
-
-      if (updateBodyPoses && scanDuration > 0.0)
-        this->cacheLookupBetweenScansRatio = static_cast<double>(*stamps_it) / scanDuration;
+      if (!this->computeViewpoints(projectedPointCloud, scanDuration, this->viewpoints))
+        return false;
+      viewpoints = &this->viewpoints;
+    }
 
-      // updates shapes according to tf cache (by calling getShapeTransform
-      // for each shape) and masks contained points
-      this->shapeMask->maskContainmentAndShadows(point, mask, viewPoint, updateBodyPoses);
-      pointMask[i] = mask;
+    // the points are classified in bins sharing the body poses computed for the first point of the bin
+    std::vector<size_t> binStarts;
+    std::vector<double> binRatios;
+    for (size_t i = 0; i < num_points(projectedPointCloud); i += updateBodyPosesEvery, stamps_it += updateBodyPosesEvery)
+    {
+      binStarts.push_back(i);
+      binRatios.push_back(scanDuration > 0.0 ? static_cast<double>(*stamps_it) / scanDuration : 0.0);
+      if (updateBodyPosesEvery > num_points(projectedPointCloud) - i)
+        break;
     }
+
+    // updates shapes according to tf cache (by calling getShapeTransform
+    // for each shape) at the start of each bin and masks contained points
+    this->cacheLookupBetweenScansRatio = 0.0;
+    this->shapeMask->maskContainmentAndShadows(projectedPointCloud, pointMask, binStarts, [&](const size_t binStart)
+    {
+      this->cacheLookupBetweenScansRatio = binRatios[binStart / updateBodyPosesEvery];
+    }, viewpoints);
   }
 
   ROS_DEBUG("RobotBodyFilter: Mask computed in %.5f secs.", double(clock()-stopwatchOverall) / CLOCKS_PER_SEC);
@@ -615,6 +732,9 @@ bool RobotBodyFilterLaserScan::update(const LaserScan &inputScan, LaserScan &fil
       }
     }
 
+    if (!this->pointByPointScan && this->directScanClassification)
+      return this->classifyScanDirectly(inputScan, filteredScan, scanFrame);
+
     // The point cloud will have fields x, y, z, intensity (float32) and index (int32)
     // and for point-by-point scans also timestamp and viewpoint
     sensor_msgs::PointCloud2 projectedPointCloud;
@@ -705,6 +825,113 @@ bool RobotBodyFilterLaserScan::update(const LaserScan &inputScan, LaserScan &fil
   return true;
 }
 
+bool RobotBodyFilterLaserScan::classifyScanDirectly(const LaserScan& inputScan, LaserScan& filteredScan,
+                                                    const std::string& scanFrame) {
+  // this->modelMutex has to be already locked!
+
+  ROS_INFO_ONCE("RobotBodyFilter: Classifying laser scan beams directly.");
+
+  const clock_t stopwatchOverall = clock();
+  const auto& scanTime = inputScan.header.stamp;
+
+  Eigen::Isometry3d sensorPose;
+  try {
+    const auto sensorTf = this->tfBuffer->lookupTransform(
+        this->filteringFrame, scanFrame, scanTime,
+        remainingTime(scanTime, this->reachableTransformTimeout));
+    sensorPose = tf2::transformToEigen(sensorTf.transform);
+  } catch (tf2::TransformException& e) {
+    ROS_ERROR("RobotBodyFilter: Could not compute filtering mask due to this "
+              "TF exception: %s", e.what());
+    return false;
+  }
+
+  this->updateBeamTables(inputScan);
+
+  // project the beams directly to the filtering frame; the beams laser_geometry would skip (invalid
+  // measurements) and the clipped beams are not projected and get NaN points, which are OUTSIDE
+  const float INVALID_POINT_VALUE = std::numeric_limits<float>::quiet_NaN();
+  const Eigen::Vector3f invalidPoint = Eigen::Vector3f::Constant(INVALID_POINT_VALUE);
+  const Eigen::Isometry3f sensorPoseFloat = sensorPose.cast<float>();
+  const Eigen::Vector3f sensorOrigin = sensorPoseFloat.translation();
+  const Eigen::Vector3f sensorX = sensorPoseFloat.linear().col(0);
+  const Eigen::Vector3f sensorY = sensorPoseFloat.linear().col(1);
+  const auto minDistance = static_cast<float>(this->minDistance);
+  const auto maxDistance = static_cast<float>(this->maxDistance);
+
+  const auto numBeams = inputScan.ranges.size();
+  this->beamPoints.resize(numBeams);
+  for (size_t i = 0; i < numBeams; ++i) {
+    const auto range = inputScan.ranges[i];
+    if (!(range >= inputScan.range_min && range < inputScan.range_max)) {
+      this->beamPoints[i] = invalidPoint;
+      continue;
+    }
+
+    // the distance of the beam endpoint from the sensor is the range, so clipping needs no projection
+    if (this->doClipping && (range < minDistance || (maxDistance > 0.0f && range > maxDistance))) {
+      filteredScan.ranges[i] = INVALID_POINT_VALUE;
+      this->beamPoints[i] = invalidPoint;
+      continue;
+    }
+
+    this->beamPoints[i] = sensorOrigin + range * (this->beamCosines[i] * sensorX + this->beamSines[i] * sensorY);
+  }
+
+  ROS_DEBUG("RobotBodyFilter: Scan projection run time is %.5f secs.", double(clock()-stopwatchOverall) / CLOCKS_PER_SEC);
+
+  // update transforms cache, which is then used in body masking
+  this->updateTransformCache(scanTime);
+
+  // updates shapes according to tf cache (by calling getShapeTransform
+  // for each shape) and masks contained points
+  this->shapeMask->maskContainmentAndShadows(this->beamPoints, this->beamMask, sensorPose.translation());
+
+  ROS_DEBUG("RobotBodyFilter: Mask computed in %.5f secs.", double(clock()-stopwatchOverall) / CLOCKS_PER_SEC);
+
+  for (size_t i = 0; i < numBeams; ++i) {
+    switch (this->beamMask[i]) {
+      case RayCastingShapeMask::MaskValue::INSIDE:
+      case RayCastingShapeMask::MaskValue::SHADOW:
+      case RayCastingShapeMask::MaskValue::CLIP:
+        filteredScan.ranges[i] = INVALID_POINT_VALUE;
+        break;
+      case RayCastingShapeMask::MaskValue::OUTSIDE:
+        break;
+    }
+  }
+
+  this->publishDebugMarkers(scanTime);
+
+  // no cut-out pointclouds are published in this mode, so the bounding shapes only need the header
+  sensor_msgs::PointCloud2 scanHeaderCloud;
+  scanHeaderCloud.header = inputScan.header;
+  scanHeaderCloud.header.frame_id = this->filteringFrame;
+  this->computeAndPublishBoundingSphere(scanHeaderCloud);
+  this->computeAndPublishBoundingBox(scanHeaderCloud);
+  this->computeAndPublishOrientedBoundingBox(scanHeaderCloud);
+  this->computeAndPublishLocalBoundingBox(scanHeaderCloud);
+
+  ROS_DEBUG("RobotBodyFilter: Filtering run time is %.5f secs.", double(clock()-stopwatchOverall) / CLOCKS_PER_SEC);
+  return true;
+}
+
+void RobotBodyFilterLaserScan::updateBeamTables(const LaserScan& scan) {
+  if (this->beamCosines.size() == scan.ranges.size() && this->beamTablesAngleMin == scan.angle_min &&
+      this->beamTablesAngleIncrement == scan.angle_increment)
+    return;
+
+  this->beamCosines.resize(scan.ranges.size());
+  this->beamSines.resize(scan.ranges.size());
+  for (size_t i = 0; i < scan.ranges.size(); ++i) {
+    const auto angle = static_cast<double>(scan.angle_min) + static_cast<double>(i) * scan.angle_increment;
+    this->beamCosines[i] = static_cast<float>(cos(angle));
+    this->beamSines[i] = static_cast<float>(sin(angle));
+  }
+  this->beamTablesAngleMin = scan.angle_min;
+  this->beamTablesAngleIncrement = scan.angle_increment;
+}
+
 bool RobotBodyFilterPointCloud2::update(const sensor_msgs::PointCloud2 &inputCloud,
                                         sensor_msgs::PointCloud2 &filteredCloud)
 {
@@ -771,9 +998,10 @@ bool RobotBodyFilterPointCloud2::update(const sensor_msgs::PointCloud2 &inputClo
                     " Consider setting 'point_by_point_scan' to false to get a "
                     "more efficient computation.");
     }
-    if (!hasStampsField || !hasVpXField || !hasVpYField || !hasVpZField) {
+    if (!hasStampsField || (!this->viewpointsFromTf && (!hasVpXField || !hasVpYField || !hasVpZField))) {
       throw std::runtime_error("A point-by-point scan has to contain float32"
-                               "fields 'stamps', 'vp_x', 'vp_y' and 'vp_z'.");
+                               "fields 'stamps', 'vp_x', 'vp_y' and 'vp_z' (the viewpoint fields "
+                               "are not needed if sensor/viewpoints_from_tf is true).");
     }
   } else if (hasStampsField) {
     ROS_WARN_ONCE("RobotBodyFilter: The pointcloud has a 'stamps' field, "
@@ -815,7 +1043,12 @@ bool RobotBodyFilterPointCloud2::update(const sensor_msgs::PointCloud2 &inputClo
   {
     std::lock_guard<std::mutex> guard(*this->modelMutex);
 
-    const auto success = this->computeMask(transformedCloud, pointMask, inputCloudFrame);
+    // organized clouds from a depth camera with known intrinsics are filtered by rasterization
+    DepthCamera depthCamera;
+    const auto useDepthCamera = !this->pointByPointScan && this->getDepthCamera(inputCloud, depthCamera);
+
+    const auto success = this->computeMask(transformedCloud, pointMask, inputCloudFrame,
+                                           useDepthCamera ? &depthCamera : nullptr);
     if (!success)
       return false;
   }
@@ -851,42 +1084,52 @@ bool RobotBodyFilterPointCloud2::update(const sensor_msgs::PointCloud2 &inputClo
 }
 
 template<typename T>
-bool RobotBodyFilter<T>::getShapeTransform(point_containment_filter::ShapeHandle shapeHandle, Eigen::Isometry3d &transform) const {
+bool RobotBodyFilter<T>::computeViewpoints(const sensor_msgs::PointCloud2& projectedPointCloud,
+                                           const double scanDuration, EigenSTL::vector_Vector3d& viewpoints) {
   // make sure you locked this->modelMutex
 
-  // check if the given shapeHandle has been registered to a link during addRobotMaskFromUrdf call.
-  if (this->shapesToLinks.find(shapeHandle) == this->shapesToLinks.end()) {
-    ROS_ERROR_STREAM_THROTTLE(3, "RobotBodyFilter: Invalid shape handle: " << to_string(shapeHandle));
+  // the sensor poses have been looked up by updateTransformCache() together with the link poses
+  if (this->numSensorKeyframesFound < this->sensorKeyframes.getNumKeyframes())
+  {
+    ROS_ERROR_DELAYED_THROTTLE(3, "RobotBodyFilter: Could not compute viewpoints of the scan because "
+                                  "transform %s->%s is not available.",
+                               this->sensorFrame.c_str(), this->filteringFrame.c_str());
     return false;
   }
 
-  const auto& collision = this->shapesToLinks.at(shapeHandle);
+  viewpoints.resize(num_points(projectedPointCloud));
+  CloudConstIter stamps_it(projectedPointCloud, "stamps");
+  for (size_t i = 0; i < num_points(projectedPointCloud); ++i, ++stamps_it)
+  {
+    const auto ratio = scanDuration > 0.0 ? static_cast<double>(*stamps_it) / scanDuration : 0.0;
+    this->sensorKeyframes.interpolateTranslation(0, ratio, viewpoints[i]);
+  }
 
-  if (this->transformCache.find(collision.cacheKey) == this->transformCache.end()) {
-    // do not log the error because shape mask would do it for us
+  return true;
+}
+
+template<typename T>
+bool RobotBodyFilter<T>::getShapeTransform(point_containment_filter::ShapeHandle shapeHandle, Eigen::Isometry3d &transform) const {
+  // make sure you locked this->modelMutex
+
+  // this is called for each shape at each pose update, so it only reads the dense caches
+
+  // check if the given shapeHandle has been registered to a link during addRobotMaskFromUrdf call.
+  if (shapeHandle >= this->shapeCacheSlots.size() || this->shapeCacheSlots[shapeHandle] < 0) {
+    ROS_ERROR_STREAM_THROTTLE(3, "RobotBodyFilter: Invalid shape handle: " << to_string(shapeHandle));
     return false;
   }
 
-  if (!this->pointByPointScan) {
-    transform = *this->transformCache.at(collision.cacheKey);
-  } else {
-    if (this->transformCacheAfterScan.find(collision.cacheKey) ==
-        this->transformCacheAfterScan.end()) {
-      // do not log the error because shape mask would do it for us
-      return false;
-    }
+  const auto slot = static_cast<size_t>(this->shapeCacheSlots[shapeHandle]);
 
-    const auto& tf1 = *this->transformCache.at(collision.cacheKey);
-    const auto& tf2 = *this->transformCacheAfterScan.at(collision.cacheKey);
-    const Eigen::Quaterniond quat1(tf1.rotation().matrix());
-    const Eigen::Quaterniond quat2(tf1.rotation().matrix());
-    const auto r = this->cacheLookupBetweenScansRatio;
+  // do not log the error if the transform is missing because shape mask would do it for us
+  if (this->pointByPointScan)
+    return this->scanKeyframes.interpolate(slot, this->cacheLookupBetweenScansRatio, transform);
 
-    transform.translation() = tf1.translation() * (1 - r) + tf2.translation() * r;
-    const Eigen::Quaterniond quat3 = quat1.slerp(r, quat2);
-    transform.linear() = quat3.toRotationMatrix();
-  }
+  if (slot >= this->transformCacheValid.size() || !this->transformCacheValid[slot])
+    return false;
 
+  transform = this->transformCache[slot];
   return true;
 }
 
@@ -894,60 +1137,197 @@ template<typename T>
 void RobotBodyFilter<T>::updateTransformCache(const ros::Time &time, const ros::Time& afterScanTime) {
   // make sure you locked this->modelMutex
 
-  // clear the cache so that maskContainment always uses only these tf data and not some older
-  this->transformCache.clear();
+  // invalidate the cache so that maskContainment always uses only these tf data and not some older
+  const auto numSlots = this->collisionBodies.size();
+  this->transformCache.resize(numSlots);
+  this->transformCacheValid.assign(numSlots, false);
   if (afterScanTime.sec != 0)
-    this->transformCacheAfterScan.clear();
+    this->scanKeyframes.reset(numSlots, this->numScanKeyframes);
+  const auto numKeyframes = (afterScanTime.sec != 0) ? this->scanKeyframes.getNumKeyframes() : 1;
+
+  // the sensor poses needed by computeViewpoints() are looked up at the same keyframes as the links
+  const auto lookupSensor = this->viewpointsFromTf && afterScanTime.sec != 0;
+  this->numSensorKeyframesFound = 0;
+  if (lookupSensor)
+    this->sensorKeyframes.reset(1, this->numScanKeyframes);
+
+  // resolve each link frame only once per keyframe; all collision bodies of the link share the result
+  const auto numLinks = this->collisionLinkFrames.size();
+  this->linkTransforms.resize(numLinks * numKeyframes);
+  this->linkTransformsValid.assign(numLinks * numKeyframes, false);
+
+  // links attached to the filtering frame by fixed joints do not need to be looked up
+  for (size_t linkSlot = 0; linkSlot < numLinks; ++linkSlot) {
+    if (!this->staticLinks[linkSlot])
+      continue;
+    for (size_t keyframe = 0; keyframe < numKeyframes; ++keyframe) {
+      this->linkTransforms[linkSlot * numKeyframes + keyframe] = this->staticLinkTransforms[linkSlot];
+      this->linkTransformsValid[linkSlot * numKeyframes + keyframe] = true;
+    }
+  }
 
-  // iterate over all links corresponding to some masking shape and update their cached transforms relative
-  // to fixed_frame
-  for (auto &shapeToLink : this->shapesToLinks) {
+  // the keyframes after the first one are spread uniformly up to the scan end
+  for (size_t keyframe = 0; keyframe < numKeyframes; ++keyframe) {
+    const auto keyframeTime = (keyframe == 0) ? time :
+        time + (afterScanTime - time) * this->scanKeyframes.getKeyframeRatio(keyframe);
 
-    const auto &collisionBody = shapeToLink.second;
-    const auto &collision = collisionBody.collision;
-    const auto &link = collisionBody.link;
+    if (this->forwardKinematics)
+      this->updateLinkTransformsFromJointStates(keyframeTime, time, keyframe, numKeyframes);
 
-    // here we assume the tf frames' names correspond to the link names
-    const auto linkFrame = link->name;
+    // look up the links not resolved by forward kinematics in TF, all of them in a single call
+    size_t numLookups = 0;
+    for (size_t linkSlot = 0; linkSlot < numLinks; ++linkSlot) {
+      const auto index = linkSlot * numKeyframes + keyframe;
+      if (this->linkTransformsValid[index])
+        continue;
 
-    // the collision object may have a different origin than the visual, we need to account for that
-    const auto &collisionOffsetTransform = urdfPose2EigenTransform(collision->origin);
+      // the later keyframes of a link are useless if an earlier one is missing
+      if (keyframe > 0 && !this->linkTransformsValid[index - 1])
+        continue;
 
-    {
-      auto linkTransformTfOptional = this->tfFramesWatchdog->lookupTransform(
-          linkFrame, time, remainingTime(time, this->reachableTransformTimeout));
+      // here we assume the tf frames' names correspond to the link names
+      if (numLookups == this->lookupFrames.size()) {
+        this->lookupFrames.push_back(this->collisionLinkFrames[linkSlot]);
+        this->lookupLinkSlots.push_back(linkSlot);
+      } else {
+        this->lookupFrames[numLookups] = this->collisionLinkFrames[linkSlot];
+        this->lookupLinkSlots[numLookups] = linkSlot;
+      }
+      ++numLookups;
+    }
 
-      if (!linkTransformTfOptional)  // has no value
-        continue;
+    // the sensor is looked up in the same call; its slot is one past the last link slot
+    if (lookupSensor && this->numSensorKeyframesFound == keyframe) {
+      if (numLookups == this->lookupFrames.size()) {
+        this->lookupFrames.push_back(this->sensorFrame);
+        this->lookupLinkSlots.push_back(numLinks);
+      } else {
+        this->lookupFrames[numLookups] = this->sensorFrame;
+        this->lookupLinkSlots[numLookups] = numLinks;
+      }
+      ++numLookups;
+    }
+
+    if (numLookups == 0)
+      continue;
 
-      const auto &linkTransformTf = linkTransformTfOptional.value();
-      const auto &linkTransformEigen = tf2::transformToEigen(linkTransformTf);
+    this->lookupFrames.resize(numLookups);
+    this->lookupLinkSlots.resize(numLookups);
+    this->tfFramesWatchdog->lookupTransforms(this->lookupFrames, keyframeTime,
+        remainingTime(time, this->reachableTransformTimeout), this->lookupResults, this->lookupFound);
 
-      const auto &transform = linkTransformEigen * collisionOffsetTransform;
+    for (size_t i = 0; i < numLookups; ++i) {
+      if (!this->lookupFound[i])
+        continue;
+
+      if (this->lookupLinkSlots[i] == numLinks) {
+        this->sensorKeyframes.setKeyframe(0, keyframe, tf2::transformToEigen(this->lookupResults[i]));
+        ++this->numSensorKeyframesFound;
+        continue;
+      }
 
-      this->transformCache[collisionBody.cacheKey] =
-          std::allocate_shared<Eigen::Isometry3d>(Eigen::aligned_allocator<Eigen::Isometry3d>(), transform);
+      const auto index = this->lookupLinkSlots[i] * numKeyframes + keyframe;
+      this->linkTransforms[index] = tf2::transformToEigen(this->lookupResults[i]);
+      this->linkTransformsValid[index] = true;
     }
+  }
 
-    if (afterScanTime.sec != 0)
-    {
-      auto linkTransformTfOptional = this->tfFramesWatchdog->lookupTransform(
-          linkFrame, afterScanTime, remainingTime(time, this->reachableTransformTimeout));
+  // update the cached transforms of all collision bodies relative to fixed_frame
+  for (size_t slot = 0; slot < numSlots; ++slot) {
+    const auto &collisionBody = this->collisionBodies[slot];
 
-      if (!linkTransformTfOptional)  // has no value
-        continue;
+    // the collision object may have a different origin than the visual, we need to account for that
+    const auto &collisionOffsetTransform = urdfPose2EigenTransform(collisionBody.collision->origin);
 
-      const auto &linkTransformTf = linkTransformTfOptional.value();
-      const auto &linkTransformEigen = tf2::transformToEigen(linkTransformTf);
+    for (size_t keyframe = 0; keyframe < numKeyframes; ++keyframe) {
+      const auto index = collisionBody.linkSlot * numKeyframes + keyframe;
+      if (!this->linkTransformsValid[index])
+        break;
 
-      const auto &transform = linkTransformEigen * collisionOffsetTransform;
+      const Eigen::Isometry3d transform = this->linkTransforms[index] * collisionOffsetTransform;
 
-      this->transformCacheAfterScan[collisionBody.cacheKey] =
-        std::allocate_shared<Eigen::Isometry3d>(Eigen::aligned_allocator<Eigen::Isometry3d>(), transform);
+      if (keyframe == 0) {
+        this->transformCache[slot] = transform;
+        this->transformCacheValid[slot] = true;
+      }
+      if (afterScanTime.sec != 0)
+        this->scanKeyframes.setKeyframe(slot, keyframe, transform);
     }
   }
 }
 
+template<typename T>
+bool RobotBodyFilter<T>::updateLinkTransformsFromJointStates(const ros::Time& time, const ros::Time& scanTime,
+                                                             const size_t keyframe, const size_t numKeyframes) {
+  // make sure you locked this->modelMutex
+
+  if (this->fkRobotModel == nullptr)
+    return false;
+
+  // joints missing in the joint states (e.g. floating joints) only prevent computing the links they move
+  this->jointStates->getPositions(time, this->fkVariableNames, this->fkVariablePositions, this->fkVariablesFound);
+
+  size_t variableIndex = 0;
+  this->fkJointsFound.resize(this->fkJoints.size());
+  for (size_t jointIndex = 0; jointIndex < this->fkJoints.size(); ++jointIndex) {
+    const auto joint = this->fkJoints[jointIndex];
+    const auto variablesBegin = this->fkVariablesFound.begin() + variableIndex;
+    const auto found = std::all_of(variablesBegin, variablesBegin + joint->getVariableCount(),
+                                   [](const std::uint8_t variableFound) { return variableFound != 0; });
+    this->fkJointsFound[jointIndex] = found;
+    if (found)
+      this->fkRobotState->setJointPositions(joint, &this->fkVariablePositions[variableIndex]);
+    variableIndex += joint->getVariableCount();
+  }
+
+  bool anyLinkFound = false;
+  this->fkLinksFound.assign(this->fkLinks.size(), false);
+  for (size_t linkSlot = 0; linkSlot < this->fkLinks.size(); ++linkSlot) {
+    const auto index = linkSlot * numKeyframes + keyframe;
+    if (this->staticLinks[linkSlot] || this->fkLinks[linkSlot] == nullptr || this->linkTransformsValid[index])
+      continue;
+
+    const auto& linkJoints = this->fkLinkJoints[linkSlot];
+    this->fkLinksFound[linkSlot] = std::all_of(linkJoints.begin(), linkJoints.end(),
+        [this](const size_t jointIndex) { return this->fkJointsFound[jointIndex] != 0; });
+    anyLinkFound |= (this->fkLinksFound[linkSlot] != 0);
+  }
+
+  if (!anyLinkFound)
+    return false;
+
+  // one TF lookup places the whole model
+  Eigen::Isometry3d rootTransform = Eigen::Isometry3d::Identity();
+  const auto& rootFrame = this->fkRobotModel->getRootLinkName();
+  if (rootFrame != this->filteringFrame) {
+    auto rootTransformTfOptional = this->tfFramesWatchdog->lookupTransform(
+        rootFrame, time, remainingTime(scanTime, this->reachableTransformTimeout));
+
+    if (!rootTransformTfOptional)  // has no value
+      return false;
+
+    rootTransform = tf2::transformToEigen(rootTransformTfOptional.value());
+  }
+
+  this->fkRobotState->updateLinkTransforms();
+
+  for (size_t linkSlot = 0; linkSlot < this->fkLinks.size(); ++linkSlot) {
+    if (!this->fkLinksFound[linkSlot])
+      continue;
+
+    const auto index = linkSlot * numKeyframes + keyframe;
+    this->linkTransforms[index] = rootTransform * this->fkRobotState->getGlobalLinkTransform(this->fkLinks[linkSlot]);
+    this->linkTransformsValid[index] = true;
+  }
+
+  return true;
+}
+
+template<typename T>
+void RobotBodyFilter<T>::jointStatesReceived(const sensor_msgs::JointStateConstPtr& jointState) {
+  this->jointStates->add(*jointState);
+}
+
 template<typename T>
 void RobotBodyFilter<T>::addRobotMaskFromUrdf(const string& urdfModel) {
   if (urdfModel.empty()) {
@@ -1026,21 +1406,44 @@ void RobotBodyFilter<T>::addRobotMaskFromUrdf(const string& urdfModel) {
           continue;
         }
 
-        const auto collisionShape = constructShape(*collision->geometry);
+        auto collisionShape = constructShape(*collision->geometry);
         const auto shapeName = collision->name.empty() ? NAME_LINK_COLLISION_NR : NAME_LINK_COLLISON_NAME;
 
+        double meshSimplificationError = 0.0;
+        if (this->meshSimplificationMaxError > 0.0 && collisionShape != nullptr &&
+            collisionShape->type == shapes::MESH)
+        {
+          const auto& mesh = static_cast<const shapes::Mesh&>(*collisionShape);
+          const auto numTriangles = mesh.triangle_count;
+          collisionShape.reset(simplifyMesh(mesh, this->meshSimplificationMaxError, meshSimplificationError));
+          ROS_DEBUG("RobotBodyFilter: Simplified mesh of %s from %u to %u triangles (error %f m).",
+                    shapeName.c_str(), numTriangles,
+                    static_cast<const shapes::Mesh&>(*collisionShape).triangle_count, meshSimplificationError);
+        }
+
         // add the collision shape to shapeMask; the inflation parameters come into play here
-        const auto containsTestInflation = this->getLinkInflationForContainsTest(collisionNames);
-        const auto shadowTestInflation = this->getLinkInflationForShadowTest(collisionNames);
-        const auto bsphereInflation = this->getLinkInflationForBoundingSphere(collisionNames);
-        const auto bboxInflation = this->getLinkInflationForBoundingBox(collisionNames);
+        auto containsTestInflation = this->getLinkInflationForContainsTest(collisionNames);
+        auto shadowTestInflation = this->getLinkInflationForShadowTest(collisionNames);
+        auto bsphereInflation = this->getLinkInflationForBoundingSphere(collisionNames);
+        auto bboxInflation = this->getLinkInflationForBoundingBox(collisionNames);
+
+        // padding by the simplification error keeps the simplified model around the original one
+        for (auto inflation : {&containsTestInflation, &shadowTestInflation, &bsphereInflation, &bboxInflation})
+          inflation->padding += meshSimplificationError * inflation->scale;
+
         const auto shapeHandle = this->shapeMask->addShape(collisionShape,
             containsTestInflation.scale, containsTestInflation.padding, shadowTestInflation.scale,
             shadowTestInflation.padding, bsphereInflation.scale, bsphereInflation.padding,
             bboxInflation.scale, bboxInflation.padding, false, shapeName);
+        this->collisionBodies.emplace_back(collision, link, collisionIndex, shapeHandle);
+        this->collisionBodies.back().cacheSlot = this->collisionBodies.size() - 1;
+        const auto linkFrame = std::find(this->collisionLinkFrames.begin(), this->collisionLinkFrames.end(), link->name);
+        this->collisionBodies.back().linkSlot = static_cast<size_t>(linkFrame - this->collisionLinkFrames.begin());
+        if (linkFrame == this->collisionLinkFrames.end())
+          this->collisionLinkFrames.push_back(link->name);
         this->shapesToLinks[shapeHandle.contains] = this->shapesToLinks[shapeHandle.shadow] =
             this->shapesToLinks[shapeHandle.bsphere] = this->shapesToLinks[shapeHandle.bbox] =
-                CollisionBodyWithLink(collision, link, collisionIndex, shapeHandle);
+                this->collisionBodies.back();
 
         if (!isSetIntersectionEmpty(collisionNamesSet, this->linksIgnoredInBoundingSphere)) {
           this->shapesIgnoredInBoundingSphere.insert(shapeHandle.bsphere);
@@ -1072,14 +1475,113 @@ void RobotBodyFilter<T>::addRobotMaskFromUrdf(const string& urdfModel) {
       }
     }
 
+    // links connected to the filtering frame only by fixed joints never move relative to it, so their
+    // poses can be computed from the URDF once instead of being looked up in TF for every scan
+    const auto numLinksBefore = this->staticLinks.size();
+    this->staticLinks.resize(this->collisionLinkFrames.size(), false);
+    this->staticLinkTransforms.resize(this->collisionLinkFrames.size());
+    const auto filteringLink = parsedUrdfModel.getLink(this->filteringFrame);
+    if (this->cacheFixedLinkTransforms && filteringLink != nullptr) {
+      // returns the furthest ancestor connected to the link by fixed joints, and the link pose relative to it
+      const auto getFixedRoot = [](urdf::LinkConstSharedPtr link, Eigen::Isometry3d& pose) {
+        pose.setIdentity();
+        while (link->parent_joint != nullptr && link->parent_joint->type == urdf::Joint::FIXED) {
+          pose = urdfPose2EigenTransform(link->parent_joint->parent_to_joint_origin_transform) * pose;
+          link = link->getParent();
+        }
+        return link;
+      };
+
+      Eigen::Isometry3d filteringFramePose;
+      const auto filteringRoot = getFixedRoot(filteringLink, filteringFramePose);
+      for (size_t linkSlot = numLinksBefore; linkSlot < this->collisionLinkFrames.size(); ++linkSlot) {
+        const auto link = parsedUrdfModel.getLink(this->collisionLinkFrames[linkSlot]);
+        Eigen::Isometry3d linkPose;
+        if (link == nullptr || getFixedRoot(link, linkPose) != filteringRoot)
+          continue;
+
+        this->staticLinks[linkSlot] = true;
+        this->staticLinkTransforms[linkSlot] = filteringFramePose.inverse() * linkPose;
+        ROS_INFO("RobotBodyFilter: Link %s is fixed to the filtering frame, its pose will not be looked up in TF.",
+                 this->collisionLinkFrames[linkSlot].c_str());
+      }
+    }
+
+    // the kinematic model is only built from the first robot model, links added later are looked up in TF
+    if (this->forwardKinematics && this->fkRobotModel == nullptr) {
+      const auto urdf = std::make_shared<urdf::Model>(parsedUrdfModel);
+      const auto srdf = std::make_shared<srdf::Model>();
+      srdf->initString(*urdf, "<?xml version=\"1.0\"?><robot name=\"" + urdf->getName() + "\"/>");
+      this->fkRobotModel = std::make_shared<moveit::core::RobotModel>(urdf, srdf);
+      this->fkRobotState = std::make_unique<moveit::core::RobotState>(this->fkRobotModel);
+      this->fkRobotState->setToDefaultValues();
+      this->fkJoints = this->fkRobotModel->getActiveJointModels();
+      this->fkVariableNames.clear();
+      std::vector<std::string> continuousJoints;
+      for (const auto joint : this->fkJoints) {
+        this->fkVariableNames.insert(this->fkVariableNames.end(),
+                                     joint->getVariableNames().begin(), joint->getVariableNames().end());
+        if (joint->getType() == moveit::core::JointModel::REVOLUTE &&
+            static_cast<const moveit::core::RevoluteJointModel*>(joint)->isContinuous())
+          continuousJoints.push_back(joint->getName());
+      }
+      this->jointStates->setContinuousJoints(continuousJoints);
+    }
+
+    this->fkLinks.resize(this->collisionLinkFrames.size(), nullptr);
+    this->fkLinkJoints.resize(this->collisionLinkFrames.size());
+    if (this->fkRobotModel != nullptr) {
+      for (size_t linkSlot = numLinksBefore; linkSlot < this->collisionLinkFrames.size(); ++linkSlot) {
+        if (!this->fkRobotModel->hasLinkModel(this->collisionLinkFrames[linkSlot]))
+          continue;
+
+        // the link can only be computed if the joint states contain all joints between it and the root;
+        // mimic joints follow the joints they mimic
+        const auto link = this->fkRobotModel->getLinkModel(this->collisionLinkFrames[linkSlot]);
+        bool allJointsActive = true;
+        auto joint = link->getParentJointModel();
+        while (joint != nullptr && allJointsActive) {
+          const auto activeJoint = (joint->getMimic() != nullptr) ? joint->getMimic() : joint;
+          if (activeJoint->getVariableCount() > 0) {
+            const auto jointIndex = std::find(this->fkJoints.begin(), this->fkJoints.end(), activeJoint);
+            if (jointIndex != this->fkJoints.end())
+              this->fkLinkJoints[linkSlot].push_back(static_cast<size_t>(jointIndex - this->fkJoints.begin()));
+            else
+              allJointsActive = false;
+          }
+          const auto parentLink = joint->getParentLinkModel();
+          joint = (parentLink != nullptr) ? parentLink->getParentJointModel() : nullptr;
+        }
+
+        if (allJointsActive)
+          this->fkLinks[linkSlot] = link;
+        else
+          this->fkLinkJoints[linkSlot].clear();
+      }
+    }
+
+    std::unordered_set<MultiShapeHandle> staticShapes;
+    for (const auto& collisionBody : this->collisionBodies)
+      if (this->staticLinks[collisionBody.linkSlot])
+        staticShapes.insert(collisionBody.multiHandle);
+
     this->shapeMask->setIgnoreInContainsTest(ignoreInContainsTest);
     this->shapeMask->setIgnoreInShadowTest(ignoreInShadowTest);
+    this->shapeMask->setStaticShapes(staticShapes);
 
     this->shapeMask->updateInternalShapeLists();
 
-    std::set<std::string> monitoredFrames;
+    // shape handles are small integers, so the slots of the shapes can be looked up in a vector
+    this->shapeCacheSlots.assign(this->shapesToLinks.empty() ? 0 : this->shapesToLinks.rbegin()->first + 1, -1);
     for (const auto& shapeToLink : this->shapesToLinks)
-      monitoredFrames.insert(shapeToLink.second.link->name);
+      this->shapeCacheSlots[shapeToLink.first] = static_cast<int>(shapeToLink.second.cacheSlot);
+
+    std::set<std::string> monitoredFrames;
+    for (const auto& collisionBody : this->collisionBodies)
+      if (!this->staticLinks[collisionBody.linkSlot])
+        monitoredFrames.insert(collisionBody.link->name);
+    if (this->fkRobotModel != nullptr && this->fkRobotModel->getRootLinkName() != this->filteringFrame)
+      monitoredFrames.insert(this->fkRobotModel->getRootLinkName());
     // Issue #6: Monitor sensor frame even if it is not a part of the model
     if (!this->sensorFrame.empty())
       monitoredFrames.insert(this->sensorFrame);
@@ -1107,8 +1609,20 @@ void RobotBodyFilter<T>::clearRobotMask() {
     this->shapesToLinks.clear();
     this->shapesIgnoredInBoundingSphere.clear();
     this->shapesIgnoredInBoundingBox.clear();
+    this->collisionBodies.clear();
+    this->collisionLinkFrames.clear();
+    this->staticLinks.clear();
+    this->staticLinkTransforms.clear();
+    this->fkLinks.clear();
+    this->fkLinkJoints.clear();
+    this->fkJoints.clear();
+    this->fkVariableNames.clear();
+    this->fkRobotState.reset();
+    this->fkRobotModel.reset();
+    this->shapeCacheSlots.clear();
     this->transformCache.clear();
-    this->transformCacheAfterScan.clear();
+    this->transformCacheValid.clear();
+    this->scanKeyframes.reset(0, 2);
   }
 
   this->tfFramesWatchdog->clear();
@@ -1,4 +1,8 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <utility>
+#include <vector>
 
 #include <robot_body_filter/TfFramesWatchdog.h>
 
@@ -9,13 +13,26 @@ namespace robot_body_filter
 TFFramesWatchdog::TFFramesWatchdog(std::string robotFrame,
                                    std::set<std::string>  monitoredFrames,
                                    std::shared_ptr<tf2_ros::Buffer> tfBuffer,
-                                   ros::Duration unreachableTfLookupTimeout,
                                    ros::Rate unreachableFramesCheckRate):
     robotFrame(std::move(robotFrame)),
     monitoredFrames(std::move(monitoredFrames)),
     tfBuffer(tfBuffer),
-    unreachableTfLookupTimeout(std::move(unreachableTfLookupTimeout)),
     unreachableFramesCheckRate(std::move(unreachableFramesCheckRate)) {
+  this->publishReachabilitySnapshotNoLock();
+  this->transformableCallbackHandle = this->tfBuffer->addTransformableCallback(
+      [this](tf2::TransformableRequestHandle request, const std::string&, const std::string& sourceFrame,
+             ros::Time time, tf2::TransformableResult result) {
+        this->onTransformable(request, sourceFrame, time, result);
+      });
+}
+
+TFFramesWatchdog::TFFramesWatchdog(std::string robotFrame,
+                                   std::set<std::string>  monitoredFrames,
+                                   std::shared_ptr<tf2_ros::Buffer> tfBuffer,
+                                   ros::Duration /*unreachableTfLookupTimeout*/,
+                                   ros::Rate unreachableFramesCheckRate):
+    TFFramesWatchdog(std::move(robotFrame), std::move(monitoredFrames), std::move(tfBuffer),
+                     std::move(unreachableFramesCheckRate)) {
 }
 
 void TFFramesWatchdog::start() {
@@ -27,11 +44,17 @@ void TFFramesWatchdog::start() {
 void TFFramesWatchdog::run() {
   this->started = true;
 
+  const auto checkPeriod = std::chrono::nanoseconds(this->unreachableFramesCheckRate.expectedCycleTime().toNSec());
   while (!this->shouldStop && ros::ok()) {
     if (!this->paused) { // the thread is paused when we want to change the stuff protected by framesMutex.
       this->searchForReachableFrames();
     }
-    this->unreachableFramesCheckRate.sleep();
+
+    // the transformable requests notice reachable frames, this thread only needs to renew the requests
+    std::unique_lock<std::mutex> lock(this->framesMutex);
+    this->searchCondition.wait_for(lock, checkPeriod, [this]() {
+      return (this->searchRequested && !this->paused) || this->shouldStop;
+    });
   }
 }
 
@@ -41,39 +64,117 @@ bool TFFramesWatchdog::isRunning() const {
 
 void TFFramesWatchdog::searchForReachableFrames()
 {
-
   const ros::Time time = ros::Time::now();
 
-  // detect all unreachable frames
-  // we can't join this loop with the following one, because we need to lock the framesMutex, but
-  // canTransform can hang for pretty long, which would result in deadlocks
+  // find unreachable frames not watched by a request
+  // we can't issue the requests with framesMutex locked, because the TF buffer locks its own mutexes
+  // and it calls onTransformable() which locks framesMutex
 
-  std::set<std::string> unreachableFrames;
+  std::vector<std::string> unwatchedFrames;
   {
     std::lock_guard<std::mutex> guard(this->framesMutex);
-    std::set_difference(
-        this->monitoredFrames.begin(), this->monitoredFrames.end(),
-        this->reachableFrames.begin(), this->reachableFrames.end(),
-        std::inserter(unreachableFrames, unreachableFrames.end()));
+    this->searchRequested = false;
+    for (const auto& frame : this->monitoredFrames) {
+      if (this->isReachableNoLock(frame))
+        continue;
+
+      if (this->pendingRequests.find(frame) == this->pendingRequests.end())
+        unwatchedFrames.push_back(frame);
+      else
+        ROS_WARN_DELAYED_THROTTLE(3,
+            "TFFramesWatchdog (%s): Frame %s is not reachable!", this->robotFrame.c_str(), frame.c_str());
+    }
   }
 
-  // now, the mutex is unlocked and we try to get transforms to all of the unreachable links... that
-  // could take a while
-  for (auto &frame : unreachableFrames) {
+  // the requests only check the current state of the buffer, so this does not block and a sweep
+  // takes about the same time no matter how many frames are unreachable
+  std::vector<std::string> transformableFrames;
+  std::vector<std::pair<std::string, tf2::TransformableRequestHandle>> newRequests;
+  bool connectedMeanwhile = false;
+  for (const auto& frame : unwatchedFrames) {
     if (this->paused) {
       break;
     }
-    std::string err;
-    if (this->tfBuffer->canTransform(this->robotFrame, frame, time, this->unreachableTfLookupTimeout, &err)) {
-      this->markReachable(frame);
-      ROS_DEBUG("TFFramesWatchdog (%s): Frame %s became reachable at %i.%i",
-          this->robotFrame.c_str(), frame.c_str(), time.sec, time.nsec);
-    } else {
+
+    // a frame not connected to robotFrame at all is watched until any connecting transform arrives,
+    // a connected frame is watched until it is transformable at the current time
+    const auto connected = this->tfBuffer->canTransform(this->robotFrame, frame, ros::Time(0), ros::Duration(0));
+    const auto requestTime = connected ? time : ros::Time(0);
+
+    const auto request = this->tfBuffer->addTransformableRequest(
+        this->transformableCallbackHandle, this->robotFrame, frame, requestTime);
+
+    if (request == 0) {  // transformable right now
+      if (connected)
+        transformableFrames.push_back(frame);
+      else  // got connected in the meantime
+        connectedMeanwhile = true;
+    } else if (request == 0xffffffffffffffffULL) {  // can never be transformable, will be retried at the next check
       ROS_WARN_DELAYED_THROTTLE(3,
-          "TFFramesWatchdog (%s): Frame %s is not reachable! Cause: %s",
-          this->robotFrame.c_str(), frame.c_str(), err.c_str());
+          "TFFramesWatchdog (%s): Frame %s is not reachable! Cause: the request time is too old",
+          this->robotFrame.c_str(), frame.c_str());
+    } else {
+      newRequests.emplace_back(frame, request);
     }
   }
+
+  // publish the results of the whole sweep at once
+  std::vector<tf2::TransformableRequestHandle> cancelledRequests;
+  {
+    std::lock_guard<std::mutex> guard(this->framesMutex);
+    for (const auto& frame : transformableFrames) {
+      if (this->isMonitoredNoLock(frame)) {
+        this->reachableFrames.insert(frame);
+        ROS_DEBUG("TFFramesWatchdog (%s): Frame %s became reachable at %i.%i",
+                  this->robotFrame.c_str(), frame.c_str(), time.sec, time.nsec);
+      }
+    }
+    if (!transformableFrames.empty())
+      this->publishReachabilitySnapshotNoLock();
+
+    for (const auto& request : newRequests) {
+      // the callback could have come in the meantime
+      if (this->finishedRequests.erase(request.second) == 0 && this->isMonitoredNoLock(request.first) &&
+          !this->isReachableNoLock(request.first))
+        this->pendingRequests[request.first] = request.second;
+      else
+        cancelledRequests.push_back(request.second);
+    }
+
+    if (connectedMeanwhile)
+      this->requestSearchNoLock();
+  }
+
+  for (const auto request : cancelledRequests)
+    this->tfBuffer->cancelTransformableRequest(request);
+}
+
+void TFFramesWatchdog::onTransformable(const tf2::TransformableRequestHandle request, const std::string& frame,
+                                       const ros::Time& time, const tf2::TransformableResult result)
+{
+  // called from the thread that fills the TF buffer
+  std::lock_guard<std::mutex> guard(this->framesMutex);
+
+  const auto pendingRequest = this->pendingRequests.find(frame);
+  if (pendingRequest != this->pendingRequests.end() && pendingRequest->second == request)
+    this->pendingRequests.erase(pendingRequest);
+  else
+    this->finishedRequests.insert(request);
+
+  if (result == tf2::TransformAvailable && !time.isZero() && this->isMonitoredNoLock(frame)) {
+    if (this->reachableFrames.insert(frame).second)
+      this->publishReachabilitySnapshotNoLock();
+    ROS_DEBUG("TFFramesWatchdog (%s): Frame %s became reachable", this->robotFrame.c_str(), frame.c_str());
+  } else {
+    // the frame got connected, or the request timed out; either way, a new request is needed
+    this->requestSearchNoLock();
+  }
+}
+
+void TFFramesWatchdog::requestSearchNoLock()
+{
+  this->searchRequested = true;
+  this->searchCondition.notify_all();
 }
 
 void TFFramesWatchdog::pause() {
@@ -81,13 +182,19 @@ void TFFramesWatchdog::pause() {
 }
 
 void TFFramesWatchdog::unpause() {
+  std::lock_guard<std::mutex> guard(this->framesMutex);
   this->paused = false;
+  this->searchCondition.notify_all();
 }
 
 void TFFramesWatchdog::stop() {
   ROS_INFO("Stopping TF watchdog.");
-  this->shouldStop = true;
-  this->paused = true;
+  {
+    std::lock_guard<std::mutex> guard(this->framesMutex);
+    this->shouldStop = true;
+    this->paused = true;
+    this->searchCondition.notify_all();
+  }
 
   if (this->started && this->thisThread.joinable())
     this->thisThread.join(); // segfaults without this line
@@ -95,10 +202,21 @@ void TFFramesWatchdog::stop() {
 }
 
 void TFFramesWatchdog::clear() {
-  std::lock_guard<std::mutex> guard(this->framesMutex);
-  monitoredFrames.clear();
-  tfBuffer->clear();
-  reachableFrames.clear();
+  std::map<std::string, tf2::TransformableRequestHandle> requests;
+  {
+    std::lock_guard<std::mutex> guard(this->framesMutex);
+    monitoredFrames.clear();
+    tfBuffer->clear();
+    if (this->transformMemo != nullptr)
+      this->transformMemo->clear();
+    reachableFrames.clear();
+    requests.swap(this->pendingRequests);
+    this->finishedRequests.clear();
+    this->publishReachabilitySnapshotNoLock();
+  }
+
+  for (const auto& request : requests)
+    this->tfBuffer->cancelTransformableRequest(request.second);
 }
 
 optional<geometry_msgs::TransformStamped> TFFramesWatchdog::lookupTransform(
@@ -110,22 +228,27 @@ optional<geometry_msgs::TransformStamped> TFFramesWatchdog::lookupTransform(
   if (!this->started)
     throw std::runtime_error("TFFramesWatchdog has not been started.");
 
+  // the snapshot is read without locking, so the lookups don't wait for the watchdog thread
+  const auto snapshot = this->getReachabilitySnapshot();
+  if (!snapshot->isMonitored(frame))
   {
     std::lock_guard<std::mutex> guard(this->framesMutex);
-    if (!this->isMonitoredNoLock(frame))
-    {
-      ROS_WARN("TFFramesWatchdog (%s): Frame %s is not yet monitored, starting "
-          "monitoring it.", this->robotFrame.c_str(), frame.c_str());
-      this->addMonitoredFrameNoLock(frame);
-      // this lookup is lost, same as if the frame is unreachable
-      return nullopt;
-    }
-
-    // Return immediately for unreachable frames
-    if (!this->isReachableNoLock(frame))
-      return nullopt;
+    ROS_WARN("TFFramesWatchdog (%s): Frame %s is not yet monitored, starting "
+        "monitoring it.", this->robotFrame.c_str(), frame.c_str());
+    this->addMonitoredFrameNoLock(frame);
+    // this lookup is lost, same as if the frame is unreachable
+    return nullopt;
   }
 
+  // Return immediately for unreachable frames
+  if (!snapshot->isReachable(frame))
+    return nullopt;
+
+  geometry_msgs::TransformStamped memoizedTransform;
+  if (this->transformMemo != nullptr &&
+      this->transformMemo->get(this->robotFrame, frame, time, this->transformMemoStampTolerance, memoizedTransform))
+    return memoizedTransform;
+
   std::string tmpErrstr;
   if (errstr == nullptr) {
     errstr = &tmpErrstr;
@@ -144,8 +267,11 @@ optional<geometry_msgs::TransformStamped> TFFramesWatchdog::lookupTransform(
 
   try
   {
-    return this->tfBuffer->lookupTransform(
+    const auto transform = this->tfBuffer->lookupTransform(
         this->robotFrame, frame, time, remainingTime(time, timeout));
+    if (this->transformMemo != nullptr)
+      this->transformMemo->put(this->robotFrame, frame, time, transform);
+    return transform;
   } catch (tf2::LookupException&) {
     ROS_WARN_DELAYED_THROTTLE(3,
         "TFFramesWatchdog (%s): Frame %s is not reachable. Cause: %s",
@@ -157,16 +283,145 @@ optional<geometry_msgs::TransformStamped> TFFramesWatchdog::lookupTransform(
   }
 }
 
+size_t TFFramesWatchdog::lookupTransforms(
+    const std::vector<std::string>& frames,
+    const ros::Time& time,
+    const ros::Duration& timeout,
+    std::vector<geometry_msgs::TransformStamped>& transforms,
+    std::vector<std::uint8_t>& found)
+{
+  if (!this->started)
+    throw std::runtime_error("TFFramesWatchdog has not been started.");
+
+  transforms.resize(frames.size());
+  found.assign(frames.size(), false);
+
+  // found marks the frames to be looked up until the lookups are done
+  const auto snapshot = this->getReachabilitySnapshot();
+  for (size_t i = 0; i < frames.size(); ++i)
+  {
+    if (!snapshot->isMonitored(frames[i]))
+    {
+      std::lock_guard<std::mutex> guard(this->framesMutex);
+      ROS_WARN("TFFramesWatchdog (%s): Frame %s is not yet monitored, starting "
+          "monitoring it.", this->robotFrame.c_str(), frames[i].c_str());
+      this->addMonitoredFrameNoLock(frames[i]);
+      // this lookup is lost, same as if the frame is unreachable
+      continue;
+    }
+
+    // Return immediately for unreachable frames
+    found[i] = snapshot->isReachable(frames[i]);
+  }
+
+  // the non-waiting lookup of BufferCore resolves the chain only once
+  const tf2::BufferCore& bufferCore = *this->tfBuffer;
+  std::vector<size_t> unreachableFrames;
+  size_t numFound = 0;
+  std::string errstr;
+  for (size_t i = 0; i < frames.size(); ++i)
+  {
+    if (!found[i])
+      continue;
+
+    // other filters in the process may have already resolved the same transform
+    if (this->transformMemo != nullptr && this->transformMemo->get(
+        this->robotFrame, frames[i], time, this->transformMemoStampTolerance, transforms[i]))
+    {
+      ++numFound;
+      continue;
+    }
+
+    try
+    {
+      transforms[i] = bufferCore.lookupTransform(this->robotFrame, frames[i], time);
+      if (this->transformMemo != nullptr)
+        this->transformMemo->put(this->robotFrame, frames[i], time, transforms[i]);
+      ++numFound;
+      continue;
+    }
+    catch (tf2::ExtrapolationException&)
+    {
+      // the data for the given time may not have arrived yet, so wait for them below
+    }
+    catch (tf2::LookupException& e)
+    {
+      errstr = e.what();
+    }
+    catch (tf2::ConnectivityException& e)
+    {
+      errstr = e.what();
+    }
+
+    if (errstr.empty() && this->tfBuffer->canTransform(this->robotFrame, frames[i], time,
+        remainingTime(time, timeout), &errstr))
+    {
+      try
+      {
+        transforms[i] = bufferCore.lookupTransform(this->robotFrame, frames[i], time);
+        if (this->transformMemo != nullptr)
+          this->transformMemo->put(this->robotFrame, frames[i], time, transforms[i]);
+        ++numFound;
+        continue;
+      }
+      catch (tf2::TransformException& e)
+      {
+        // the data may have been dropped from the buffer since canTransform() succeeded
+        errstr = e.what();
+      }
+    }
+
+    ROS_WARN_THROTTLE(3,
+        "TFFramesWatchdog (%s): Frame %s became unreachable. Cause: %s",
+        this->robotFrame.c_str(), frames[i].c_str(), errstr.c_str());
+    errstr.clear();
+
+    // if we couldn't get TF for this reachable frame, mark it unreachable
+    found[i] = false;
+    unreachableFrames.push_back(i);
+  }
+
+  if (!unreachableFrames.empty())
+  {
+    std::lock_guard<std::mutex> guard(this->framesMutex);
+    for (const auto i : unreachableFrames)
+      this->reachableFrames.erase(frames[i]);
+    this->publishReachabilitySnapshotNoLock();
+    this->requestSearchNoLock();
+  }
+
+  return numFound;
+}
+
 void TFFramesWatchdog::setMonitoredFrames(std::set<std::string> monitoredFrames)
 {
-  std::lock_guard<std::mutex> guard(this->framesMutex);
-  this->monitoredFrames = std::move(monitoredFrames);
+  std::vector<tf2::TransformableRequestHandle> cancelledRequests;
+  {
+    std::lock_guard<std::mutex> guard(this->framesMutex);
+    this->monitoredFrames = std::move(monitoredFrames);
+
+    // if some monitored frames disappeared, delete them also from reachableFrames and stop watching them
+    for (auto it = this->reachableFrames.begin(); it != this->reachableFrames.end();) {
+      if (this->monitoredFrames.find(*it) == this->monitoredFrames.end())
+        it = this->reachableFrames.erase(it);
+      else
+        ++it;
+    }
+    for (auto it = this->pendingRequests.begin(); it != this->pendingRequests.end();) {
+      if (this->monitoredFrames.find(it->first) == this->monitoredFrames.end()) {
+        cancelledRequests.push_back(it->second);
+        it = this->pendingRequests.erase(it);
+      } else {
+        ++it;
+      }
+    }
 
-  // if some monitored frames disappeared, delete them also from reachableFrames
-  for (auto& frame: this->reachableFrames) {
-    if (this->monitoredFrames.find(frame) == this->monitoredFrames.end())
-      this->reachableFrames.erase(frame);
+    this->publishReachabilitySnapshotNoLock();
+    this->requestSearchNoLock();
   }
+
+  for (const auto request : cancelledRequests)
+    this->tfBuffer->cancelTransformableRequest(request);
 }
 
 void TFFramesWatchdog::addMonitoredFrame(const std::string& monitoredFrame)
@@ -177,13 +432,16 @@ void TFFramesWatchdog::addMonitoredFrame(const std::string& monitoredFrame)
 
 void TFFramesWatchdog::addMonitoredFrameNoLock(const std::string& monitoredFrame)
 {
-  this->monitoredFrames.insert(monitoredFrame);
+  if (this->monitoredFrames.insert(monitoredFrame).second)
+  {
+    this->publishReachabilitySnapshotNoLock();
+    this->requestSearchNoLock();
+  }
 }
 
 bool TFFramesWatchdog::isReachable(const std::string &frame) const
 {
-  std::lock_guard<std::mutex> guard(this->framesMutex);
-  return this->isReachableNoLock(frame);
+  return this->getReachabilitySnapshot()->isReachable(frame);
 }
 bool TFFramesWatchdog::isReachableNoLock(const std::string &frame) const
 {
@@ -192,32 +450,74 @@ bool TFFramesWatchdog::isReachableNoLock(const std::string &frame) const
 void TFFramesWatchdog::markReachable(const std::string &frame)
 {
   std::lock_guard<std::mutex> guard(this->framesMutex);
-  this->reachableFrames.insert(frame);
+  if (this->reachableFrames.insert(frame).second)
+    this->publishReachabilitySnapshotNoLock();
 }
 void TFFramesWatchdog::markUnreachable(const std::string &frame)
 {
   std::lock_guard<std::mutex> guard(this->framesMutex);
-  this->reachableFrames.erase(frame);
+  if (this->reachableFrames.erase(frame) > 0)
+  {
+    this->publishReachabilitySnapshotNoLock();
+    this->requestSearchNoLock();
+  }
+}
+
+void TFFramesWatchdog::setTransformMemo(std::shared_ptr<TransformMemo> transformMemo,
+                                        const ros::Duration& stampTolerance)
+{
+  this->transformMemo = std::move(transformMemo);
+  this->transformMemoStampTolerance = stampTolerance;
 }
 
 bool TFFramesWatchdog::areAllFramesReachable() const
 {
-  std::lock_guard<std::mutex> guard(this->framesMutex);
-  return this->reachableFrames.size() == this->monitoredFrames.size();
+  return this->getReachabilitySnapshot()->allReachable;
 }
 bool TFFramesWatchdog::isMonitored(const std::string &frame) const
 {
-  std::lock_guard<std::mutex> guard(this->framesMutex);
-  return this->isMonitoredNoLock(frame);
+  return this->getReachabilitySnapshot()->isMonitored(frame);
 }
 bool TFFramesWatchdog::isMonitoredNoLock(const std::string &frame) const
 {
   return this->monitoredFrames.find(frame) != this->monitoredFrames.end();
 }
 
+std::shared_ptr<const TFFramesWatchdog::ReachabilitySnapshot> TFFramesWatchdog::getReachabilitySnapshot() const
+{
+  return std::atomic_load(&this->reachabilitySnapshot);
+}
+
+void TFFramesWatchdog::publishReachabilitySnapshotNoLock()
+{
+  const auto snapshot = std::make_shared<ReachabilitySnapshot>();
+  snapshot->frameIds.reserve(this->monitoredFrames.size());
+  snapshot->reachable.reserve(this->monitoredFrames.size());
+  for (const auto& frame : this->monitoredFrames)
+  {
+    snapshot->frameIds.emplace(frame, snapshot->reachable.size());
+    snapshot->reachable.push_back(this->isReachableNoLock(frame));
+    snapshot->allReachable &= snapshot->reachable.back();
+  }
+  std::atomic_store(&this->reachabilitySnapshot, std::shared_ptr<const ReachabilitySnapshot>(snapshot));
+}
+
+bool TFFramesWatchdog::ReachabilitySnapshot::isMonitored(const std::string& frame) const
+{
+  return this->frameIds.find(frame) != this->frameIds.end();
+}
+
+bool TFFramesWatchdog::ReachabilitySnapshot::isReachable(const std::string& frame) const
+{
+  const auto id = this->frameIds.find(frame);
+  return id != this->frameIds.end() && this->reachable[id->second];
+}
+
 TFFramesWatchdog::~TFFramesWatchdog()
 {
   this->stop();
+  // also cancels all pending requests
+  this->tfBuffer->removeTransformableCallback(this->transformableCallbackHandle);
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include <robot_body_filter/utils/batch_contains_test.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace robot_body_filter
+{
+
+namespace
+{
+typedef Eigen::Array<float, BatchContainsTest::BLOCK_SIZE, 1> Block;
+typedef Eigen::Map<const Block, Eigen::Unaligned> ConstBlockMap;
+
+template<typename InsideExpr, typename OutsideExpr>
+inline void storeResults(const InsideExpr& inside, const OutsideExpr& outside,
+                         BatchContainsTest::Result* results)
+{
+  for (size_t i = 0; i < BatchContainsTest::BLOCK_SIZE; ++i)
+  {
+    if (inside(i))
+      results[i] = BatchContainsTest::Result::INSIDE;
+    else if (outside(i))
+      results[i] = BatchContainsTest::Result::OUTSIDE;
+    else
+      results[i] = BatchContainsTest::Result::UNSURE;
+  }
+}
+}
+
+constexpr size_t BatchContainsTest::BLOCK_SIZE;
+constexpr float BatchContainsTest::RELATIVE_MARGIN;
+
+void BatchContainsTest::clear()
+{
+  for (auto* v : {&spheres.cx, &spheres.cy, &spheres.cz, &spheres.innerRadiusSquared,
+                  &spheres.outerRadiusSquared})
+    v->clear();
+  spheres.index.clear();
+
+  for (auto* v : {&boxes.cx, &boxes.cy, &boxes.cz, &boxes.xx, &boxes.xy, &boxes.xz,
+                  &boxes.yx, &boxes.yy, &boxes.yz, &boxes.zx, &boxes.zy, &boxes.zz,
+                  &boxes.hx, &boxes.hy, &boxes.hz, &boxes.margin})
+    v->clear();
+  boxes.index.clear();
+
+  for (auto* v : {&cylinders.cx, &cylinders.cy, &cylinders.cz,
+                  &cylinders.xx, &cylinders.xy, &cylinders.xz,
+                  &cylinders.yx, &cylinders.yy, &cylinders.yz,
+                  &cylinders.zx, &cylinders.zy, &cylinders.zz,
+                  &cylinders.halfLength, &cylinders.innerRadiusSquared,
+                  &cylinders.outerRadiusSquared, &cylinders.margin})
+    v->clear();
+  cylinders.index.clear();
+
+  for (auto* v : {&bounds.cx, &bounds.cy, &bounds.cz, &bounds.outerRadiusSquared,
+                  &bounds.minx, &bounds.miny, &bounds.minz, &bounds.maxx, &bounds.maxy, &bounds.maxz})
+    v->clear();
+  bounds.index.clear();
+
+  this->numBodies = 0;
+}
+
+void BatchContainsTest::setUseSafetyMargin(const bool useSafetyMargin)
+{
+  this->useSafetyMargin = useSafetyMargin;
+}
+
+float BatchContainsTest::computeMargin(const Eigen::Vector3d& center, const double boundingRadius) const
+{
+  if (!this->useSafetyMargin)
+    return 0.0f;
+
+  // Single-precision evaluation of the tests below has relative error in the order of 1e-7 wrt.
+  // the magnitude of the body center and size, so this margin is very conservative. Absolute 1e-6
+  // covers bodies at the origin with (nearly) zero size.
+  return RELATIVE_MARGIN * static_cast<float>(center.cwiseAbs().maxCoeff() + boundingRadius) + 1e-6f;
+}
+
+size_t BatchContainsTest::addSphere(const Eigen::Vector3d& center, const double radius)
+{
+  const auto margin = computeMargin(center, radius);
+  const auto r = static_cast<float>(radius);
+
+  spheres.cx.push_back(static_cast<float>(center.x()));
+  spheres.cy.push_back(static_cast<float>(center.y()));
+  spheres.cz.push_back(static_cast<float>(center.z()));
+  spheres.innerRadiusSquared.push_back(r > margin ? (r - margin) * (r - margin) : -1.0f);
+  spheres.outerRadiusSquared.push_back((r + margin) * (r + margin));
+  spheres.index.push_back(this->numBodies);
+
+  return this->numBodies++;
+}
+
+size_t BatchContainsTest::addBox(const Eigen::Isometry3d& pose, const Eigen::Vector3d& halfExtents)
+{
+  const Eigen::Vector3d center = pose.translation();
+  const auto margin = computeMargin(center, halfExtents.norm());
+  const auto rot = pose.linear();
+
+  boxes.cx.push_back(static_cast<float>(center.x()));
+  boxes.cy.push_back(static_cast<float>(center.y()));
+  boxes.cz.push_back(static_cast<float>(center.z()));
+  boxes.xx.push_back(static_cast<float>(rot(0, 0)));
+  boxes.xy.push_back(static_cast<float>(rot(1, 0)));
+  boxes.xz.push_back(static_cast<float>(rot(2, 0)));
+  boxes.yx.push_back(static_cast<float>(rot(0, 1)));
+  boxes.yy.push_back(static_cast<float>(rot(1, 1)));
+  boxes.yz.push_back(static_cast<float>(rot(2, 1)));
+  boxes.zx.push_back(static_cast<float>(rot(0, 2)));
+  boxes.zy.push_back(static_cast<float>(rot(1, 2)));
+  boxes.zz.push_back(static_cast<float>(rot(2, 2)));
+  boxes.hx.push_back(static_cast<float>(halfExtents.x()));
+  boxes.hy.push_back(static_cast<float>(halfExtents.y()));
+  boxes.hz.push_back(static_cast<float>(halfExtents.z()));
+  boxes.margin.push_back(margin);
+  boxes.index.push_back(this->numBodies);
+
+  return this->numBodies++;
+}
+
+size_t BatchContainsTest::addCylinder(const Eigen::Isometry3d& pose, const double radius,
+                                      const double halfLength)
+{
+  const Eigen::Vector3d center = pose.translation();
+  const auto margin = computeMargin(center, std::hypot(radius, halfLength));
+  const auto rot = pose.linear();
+  const auto r = static_cast<float>(radius);
+
+  cylinders.cx.push_back(static_cast<float>(center.x()));
+  cylinders.cy.push_back(static_cast<float>(center.y()));
+  cylinders.cz.push_back(static_cast<float>(center.z()));
+  cylinders.xx.push_back(static_cast<float>(rot(0, 0)));
+  cylinders.xy.push_back(static_cast<float>(rot(1, 0)));
+  cylinders.xz.push_back(static_cast<float>(rot(2, 0)));
+  cylinders.yx.push_back(static_cast<float>(rot(0, 1)));
+  cylinders.yy.push_back(static_cast<float>(rot(1, 1)));
+  cylinders.yz.push_back(static_cast<float>(rot(2, 1)));
+  cylinders.zx.push_back(static_cast<float>(rot(0, 2)));
+  cylinders.zy.push_back(static_cast<float>(rot(1, 2)));
+  cylinders.zz.push_back(static_cast<float>(rot(2, 2)));
+  cylinders.halfLength.push_back(static_cast<float>(halfLength));
+  cylinders.innerRadiusSquared.push_back(r > margin ? (r - margin) * (r - margin) : -1.0f);
+  cylinders.outerRadiusSquared.push_back((r + margin) * (r + margin));
+  cylinders.margin.push_back(margin);
+  cylinders.index.push_back(this->numBodies);
+
+  return this->numBodies++;
+}
+
+size_t BatchContainsTest::addBounds(const Eigen::Vector3d& sphereCenter, const double sphereRadius,
+                                    const Eigen::AlignedBox3d& box)
+{
+  const auto margin = computeMargin(sphereCenter, sphereRadius);
+  const auto r = static_cast<float>(sphereRadius);
+
+  bounds.cx.push_back(static_cast<float>(sphereCenter.x()));
+  bounds.cy.push_back(static_cast<float>(sphereCenter.y()));
+  bounds.cz.push_back(static_cast<float>(sphereCenter.z()));
+  bounds.outerRadiusSquared.push_back((r + margin) * (r + margin));
+  bounds.minx.push_back(static_cast<float>(box.min().x()) - margin);
+  bounds.miny.push_back(static_cast<float>(box.min().y()) - margin);
+  bounds.minz.push_back(static_cast<float>(box.min().z()) - margin);
+  bounds.maxx.push_back(static_cast<float>(box.max().x()) + margin);
+  bounds.maxy.push_back(static_cast<float>(box.max().y()) + margin);
+  bounds.maxz.push_back(static_cast<float>(box.max().z()) + margin);
+  bounds.index.push_back(this->numBodies);
+
+  return this->numBodies++;
+}
+
+size_t BatchContainsTest::size() const
+{
+  return this->numBodies;
+}
+
+bool BatchContainsTest::empty() const
+{
+  return this->numBodies == 0;
+}
+
+void BatchContainsTest::classify(const float* x, const float* y, const float* z,
+                                 BatchContainsTest::Result* results) const
+{
+  const Block px = ConstBlockMap(x);
+  const Block py = ConstBlockMap(y);
+  const Block pz = ConstBlockMap(z);
+
+  for (size_t k = 0; k < spheres.index.size(); ++k)
+  {
+    const Block dx = px - spheres.cx[k];
+    const Block dy = py - spheres.cy[k];
+    const Block dz = pz - spheres.cz[k];
+    const Block d2 = dx * dx + dy * dy + dz * dz;
+
+    storeResults(d2 < spheres.innerRadiusSquared[k], d2 > spheres.outerRadiusSquared[k],
+                 results + spheres.index[k] * BLOCK_SIZE);
+  }
+
+  for (size_t k = 0; k < boxes.index.size(); ++k)
+  {
+    const Block dx = px - boxes.cx[k];
+    const Block dy = py - boxes.cy[k];
+    const Block dz = pz - boxes.cz[k];
+
+    // distance of the point outside each pair of box faces (negative inside)
+    const Block ax = (dx * boxes.xx[k] + dy * boxes.xy[k] + dz * boxes.xz[k]).abs() - boxes.hx[k];
+    const Block ay = (dx * boxes.yx[k] + dy * boxes.yy[k] + dz * boxes.yz[k]).abs() - boxes.hy[k];
+    const Block az = (dx * boxes.zx[k] + dy * boxes.zy[k] + dz * boxes.zz[k]).abs() - boxes.hz[k];
+    const Block outsideDist = ax.max(ay).max(az);
+
+    const auto m = boxes.margin[k];
+    storeResults(outsideDist < -m, outsideDist > m, results + boxes.index[k] * BLOCK_SIZE);
+  }
+
+  for (size_t k = 0; k < cylinders.index.size(); ++k)
+  {
+    const Block dx = px - cylinders.cx[k];
+    const Block dy = py - cylinders.cy[k];
+    const Block dz = pz - cylinders.cz[k];
+
+    const Block u = dx * cylinders.xx[k] + dy * cylinders.xy[k] + dz * cylinders.xz[k];
+    const Block v = dx * cylinders.yx[k] + dy * cylinders.yy[k] + dz * cylinders.yz[k];
+    const Block axialDist =
+      (dx * cylinders.zx[k] + dy * cylinders.zy[k] + dz * cylinders.zz[k]).abs() - cylinders.halfLength[k];
+    const Block radial2 = u * u + v * v;
+
+    const auto m = cylinders.margin[k];
+    storeResults(
+      (axialDist < -m) && (radial2 < cylinders.innerRadiusSquared[k]),
+      (axialDist > m) || (radial2 > cylinders.outerRadiusSquared[k]),
+      results + cylinders.index[k] * BLOCK_SIZE);
+  }
+
+  const Eigen::Array<bool, BLOCK_SIZE, 1> neverInside = Eigen::Array<bool, BLOCK_SIZE, 1>::Constant(false);
+  for (size_t k = 0; k < bounds.index.size(); ++k)
+  {
+    const Block dx = px - bounds.cx[k];
+    const Block dy = py - bounds.cy[k];
+    const Block dz = pz - bounds.cz[k];
+    const Block d2 = dx * dx + dy * dy + dz * dz;
+
+    storeResults(neverInside,
+      (d2 > bounds.outerRadiusSquared[k]) ||
+      (px < bounds.minx[k]) || (px > bounds.maxx[k]) ||
+      (py < bounds.miny[k]) || (py > bounds.maxy[k]) ||
+      (pz < bounds.minz[k]) || (pz > bounds.maxz[k]),
+      results + bounds.index[k] * BLOCK_SIZE);
+  }
+}
+
+}
@@ -0,0 +1,117 @@
+#include <robot_body_filter/utils/bounding_volume_hierarchy.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace robot_body_filter
+{
+
+constexpr size_t BoundingVolumeHierarchy::MAX_LEAF_SIZE;
+
+void BoundingVolumeHierarchy::build(const std::vector<Box>& boxes)
+{
+  this->clear();
+  if (boxes.empty())
+    return;
+
+  this->items.resize(boxes.size());
+  std::iota(this->items.begin(), this->items.end(), 0);
+  this->nodes.reserve(2 * boxes.size());
+
+  this->buildNode(boxes, 0, boxes.size());
+
+  this->itemBoxes.reserve(boxes.size());
+  for (const auto item : this->items)
+    this->itemBoxes.push_back(boxes[item]);
+}
+
+size_t BoundingVolumeHierarchy::buildNode(const std::vector<Box>& boxes, const size_t begin,
+                                          const size_t end)
+{
+  const auto nodeIndex = this->nodes.size();
+  this->nodes.emplace_back();
+
+  Box box;
+  Box centers;
+  for (size_t i = begin; i < end; ++i)
+  {
+    box.extend(boxes[this->items[i]]);
+    centers.extend(boxes[this->items[i]].center());
+  }
+  this->nodes[nodeIndex].box = box;
+
+  if (end - begin <= MAX_LEAF_SIZE)
+  {
+    this->nodes[nodeIndex].firstItem = begin;
+    this->nodes[nodeIndex].numItems = end - begin;
+    this->nodes[nodeIndex].rightChild = 0;
+    return nodeIndex;
+  }
+
+  // split at the median center along the longest axis
+  Eigen::Index axis;
+  centers.sizes().maxCoeff(&axis);
+  const auto mid = begin + (end - begin) / 2;
+  std::nth_element(this->items.begin() + begin, this->items.begin() + mid, this->items.begin() + end,
+    [&](const size_t a, const size_t b)
+    {
+      return boxes[a].center()[axis] < boxes[b].center()[axis];
+    });
+
+  this->buildNode(boxes, begin, mid);
+  const auto rightChild = this->buildNode(boxes, mid, end);
+
+  this->nodes[nodeIndex].firstItem = 0;
+  this->nodes[nodeIndex].numItems = 0;
+  this->nodes[nodeIndex].rightChild = rightChild;
+  return nodeIndex;
+}
+
+void BoundingVolumeHierarchy::clear()
+{
+  this->nodes.clear();
+  this->items.clear();
+  this->itemBoxes.clear();
+}
+
+size_t BoundingVolumeHierarchy::size() const
+{
+  return this->items.size();
+}
+
+bool BoundingVolumeHierarchy::empty() const
+{
+  return this->items.empty();
+}
+
+bool BoundingVolumeHierarchy::segmentCrossesBox(const Eigen::Vector3d& origin,
+    const Eigen::Vector3d& direction, const double length, const Box& box)
+{
+  // slab test
+  double tMin = 0.0;
+  double tMax = length;
+  for (Eigen::Index i = 0; i < 3; ++i)
+  {
+    if (direction[i] == 0.0)
+    {
+      if (origin[i] < box.min()[i] || origin[i] > box.max()[i])
+        return false;
+      continue;
+    }
+
+    const auto invDir = 1.0 / direction[i];
+    auto t1 = (box.min()[i] - origin[i]) * invDir;
+    auto t2 = (box.max()[i] - origin[i]) * invDir;
+    if (t1 > t2)
+      std::swap(t1, t2);
+
+    tMin = std::max(tMin, t1);
+    tMax = std::min(tMax, t2);
+    if (tMin > tMax)
+      return false;
+  }
+  return true;
+}
+
+}
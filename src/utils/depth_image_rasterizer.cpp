@@ -0,0 +1,125 @@
+#include <robot_body_filter/utils/depth_image_rasterizer.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace robot_body_filter
+{
+
+constexpr double DepthImageRasterizer::NEAR_PLANE;
+
+bool DepthCamera::operator==(const DepthCamera& other) const
+{
+  return this->width == other.width && this->height == other.height && this->fx == other.fx &&
+    this->fy == other.fy && this->cx == other.cx && this->cy == other.cy;
+}
+
+bool DepthCamera::operator!=(const DepthCamera& other) const
+{
+  return !(*this == other);
+}
+
+DepthImageRasterizer::DepthImageRasterizer(const DepthCamera& camera) : camera(camera)
+{
+  this->entryDepths.assign(camera.width * camera.height, std::numeric_limits<float>::infinity());
+  this->exitDepths.assign(camera.width * camera.height, -std::numeric_limits<float>::infinity());
+}
+
+const DepthCamera& DepthImageRasterizer::getCamera() const
+{
+  return this->camera;
+}
+
+bool DepthImageRasterizer::getPixel(const Eigen::Vector3d& point, size_t& pixel) const
+{
+  if (!(point.z() > 0.0))
+    return false;
+
+  // pixel centers are at integer coordinates
+  const auto u = std::floor(this->camera.fx * point.x() / point.z() + this->camera.cx + 0.5);
+  const auto v = std::floor(this->camera.fy * point.y() / point.z() + this->camera.cy + 0.5);
+  if (!(u >= 0.0 && v >= 0.0 && u < static_cast<double>(this->camera.width) &&
+        v < static_cast<double>(this->camera.height)))
+    return false;
+
+  pixel = static_cast<size_t>(v) * this->camera.width + static_cast<size_t>(u);
+  return true;
+}
+
+Eigen::Vector3d DepthImageRasterizer::getPixelRay(const size_t pixel) const
+{
+  const auto u = static_cast<double>(pixel % this->camera.width);
+  const auto v = static_cast<double>(pixel / this->camera.width);
+  return {(u - this->camera.cx) / this->camera.fx, (v - this->camera.cy) / this->camera.fy, 1.0};
+}
+
+bool DepthImageRasterizer::getSphereScreenBox(const Eigen::Vector3d& center, const double radius,
+    Eigen::Vector2i& minPixel, Eigen::Vector2i& maxPixel) const
+{
+  if (center.z() - radius < NEAR_PLANE)
+    return false;
+
+  // the sphere projects inside the projection of its bounding box, which is the hull of the projected
+  // corners of the box (all of them are in front of the camera)
+  Eigen::Vector2d minCoords = Eigen::Vector2d::Constant(std::numeric_limits<double>::infinity());
+  Eigen::Vector2d maxCoords = -minCoords;
+  for (const auto dx : {-radius, radius})
+    for (const auto dy : {-radius, radius})
+      for (const auto dz : {-radius, radius})
+      {
+        const Eigen::Vector3d corner = center + Eigen::Vector3d(dx, dy, dz);
+        const Eigen::Vector2d coords(this->camera.fx * corner.x() / corner.z() + this->camera.cx,
+                                     this->camera.fy * corner.y() / corner.z() + this->camera.cy);
+        minCoords = minCoords.cwiseMin(coords);
+        maxCoords = maxCoords.cwiseMax(coords);
+      }
+
+  const Eigen::Vector2d imageMax(static_cast<double>(this->camera.width) - 1.0,
+                                 static_cast<double>(this->camera.height) - 1.0);
+  minPixel = minCoords.array().ceil().max(0.0).min(imageMax.array() + 1.0).cast<int>();
+  maxPixel = maxCoords.array().floor().min(imageMax.array()).max(-1.0).cast<int>();
+  return true;
+}
+
+void DepthImageRasterizer::rasterizeTriangle(const Eigen::Vector3d& a, const Eigen::Vector3d& b,
+                                             const Eigen::Vector3d& c)
+{
+  const auto area = (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+  // triangles seen edge-on are covered by their neighbors
+  if (std::abs(area) < 1e-12)
+    return;
+
+  const auto width = static_cast<double>(this->camera.width);
+  const auto height = static_cast<double>(this->camera.height);
+  const auto minU = std::max(0.0, std::ceil(std::min({a.x(), b.x(), c.x()})));
+  const auto maxU = std::min(width - 1.0, std::floor(std::max({a.x(), b.x(), c.x()})));
+  const auto minV = std::max(0.0, std::ceil(std::min({a.y(), b.y(), c.y()})));
+  const auto maxV = std::min(height - 1.0, std::floor(std::max({a.y(), b.y(), c.y()})));
+  if (minU > maxU || minV > maxV)
+    return;
+
+  this->dirtyMin = this->dirtyMin.cwiseMin(Eigen::Vector2i(static_cast<int>(minU), static_cast<int>(minV)));
+  this->dirtyMax = this->dirtyMax.cwiseMax(Eigen::Vector2i(static_cast<int>(maxU), static_cast<int>(maxV)));
+
+  // pixels exactly on an edge are covered by both triangles sharing it, so the mesh has no holes
+  const auto edgeTolerance = -1e-9;
+  for (auto v = minV; v <= maxV; v += 1.0)
+  {
+    for (auto u = minU; u <= maxU; u += 1.0)
+    {
+      const auto wa = ((b.x() - u) * (c.y() - v) - (b.y() - v) * (c.x() - u)) / area;
+      const auto wb = ((c.x() - u) * (a.y() - v) - (c.y() - v) * (a.x() - u)) / area;
+      const auto wc = 1.0 - wa - wb;
+      if (wa < edgeTolerance || wb < edgeTolerance || wc < edgeTolerance)
+        continue;
+
+      // inverse depth is linear in screen space
+      const auto depth = static_cast<float>(1.0 / (wa * a.z() + wb * b.z() + wc * c.z()));
+      const auto pixel = static_cast<size_t>(v) * this->camera.width + static_cast<size_t>(u);
+      this->entryDepths[pixel] = std::min(this->entryDepths[pixel], depth);
+      this->exitDepths[pixel] = std::max(this->exitDepths[pixel], depth);
+    }
+  }
+}
+
+}
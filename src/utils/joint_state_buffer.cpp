@@ -0,0 +1,131 @@
+#include <robot_body_filter/utils/joint_state_buffer.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace robot_body_filter
+{
+
+JointStateBuffer::JointStateBuffer(const ros::Duration& length) : length(length)
+{
+}
+
+void JointStateBuffer::add(const sensor_msgs::JointState& jointState)
+{
+  if (jointState.position.size() != jointState.name.size())
+    return;
+
+  const auto& stamp = jointState.header.stamp;
+  const auto earlier = [](const ros::Time& time, const std::pair<ros::Time, double>& item)
+  {
+    return time < item.first;
+  };
+
+  std::lock_guard<std::mutex> guard(this->mutex);
+  for (size_t i = 0; i < jointState.name.size(); ++i)
+  {
+    auto& history = this->histories[jointState.name[i]];
+
+    // messages mostly come in order, so the position is appended in most cases
+    if (history.empty() || history.back().first < stamp)
+    {
+      history.emplace_back(stamp, jointState.position[i]);
+    }
+    else
+    {
+      const auto position = std::upper_bound(history.begin(), history.end(), stamp, earlier);
+      if (position != history.begin() && (position - 1)->first == stamp)
+        (position - 1)->second = jointState.position[i];
+      else
+        history.emplace(position, stamp, jointState.position[i]);
+    }
+
+    while (history.front().first + this->length < history.back().first)
+      history.pop_front();
+  }
+}
+
+bool JointStateBuffer::getPositions(const ros::Time& time, const std::vector<std::string>& jointNames,
+                                    std::vector<double>& positions) const
+{
+  positions.resize(jointNames.size());
+
+  std::lock_guard<std::mutex> guard(this->mutex);
+  for (size_t i = 0; i < jointNames.size(); ++i)
+  {
+    if (!this->getPositionNoLock(time, jointNames[i], positions[i]))
+      return false;
+  }
+
+  return true;
+}
+
+size_t JointStateBuffer::getPositions(const ros::Time& time, const std::vector<std::string>& jointNames,
+                                      std::vector<double>& positions, std::vector<std::uint8_t>& found) const
+{
+  positions.resize(jointNames.size());
+  found.resize(jointNames.size());
+
+  size_t numFound = 0;
+  std::lock_guard<std::mutex> guard(this->mutex);
+  for (size_t i = 0; i < jointNames.size(); ++i)
+  {
+    found[i] = this->getPositionNoLock(time, jointNames[i], positions[i]);
+    if (found[i])
+      ++numFound;
+  }
+
+  return numFound;
+}
+
+bool JointStateBuffer::getPositionNoLock(const ros::Time& time, const std::string& jointName,
+                                         double& position) const
+{
+  const auto earlier = [](const ros::Time& t, const std::pair<ros::Time, double>& item)
+  {
+    return t < item.first;
+  };
+
+  const auto history = this->histories.find(jointName);
+  if (history == this->histories.end() || history->second.empty())
+    return false;
+
+  const auto& items = history->second;
+  if (time < items.front().first || items.back().first + this->holdDuration < time)
+    return false;
+
+  const auto after = std::upper_bound(items.begin(), items.end(), time, earlier);
+  if (after == items.end())  // time is the stamp of the last item or it is held after it
+  {
+    position = items.back().second;
+    return true;
+  }
+
+  const auto& before = *(after - 1);
+  const auto ratio = (time - before.first).toSec() / (after->first - before.first).toSec();
+  auto difference = after->second - before.second;
+  if (this->continuousJoints.find(jointName) != this->continuousJoints.end())
+    difference = std::remainder(difference, 2 * M_PI);
+  position = before.second + ratio * difference;
+  return true;
+}
+
+void JointStateBuffer::setHoldDuration(const ros::Duration& holdDuration)
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+  this->holdDuration = holdDuration;
+}
+
+void JointStateBuffer::setContinuousJoints(const std::vector<std::string>& jointNames)
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+  this->continuousJoints = std::unordered_set<std::string>(jointNames.begin(), jointNames.end());
+}
+
+void JointStateBuffer::clear()
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+  this->histories.clear();
+}
+
+}
@@ -0,0 +1,477 @@
+#include <robot_body_filter/utils/mesh_simplification.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <queue>
+#include <set>
+
+#include <Eigen/Geometry>
+
+#include <geometric_shapes/mesh_operations.h>
+
+namespace robot_body_filter
+{
+
+namespace
+{
+
+typedef Eigen::Matrix4d Quadric;
+typedef std::array<unsigned int, 3> Triangle;
+
+/**
+ * \brief Distance of point p from triangle abc.
+ */
+double pointTriangleDistance(const Eigen::Vector3d& p, const Eigen::Vector3d& a, const Eigen::Vector3d& b,
+                             const Eigen::Vector3d& c)
+{
+  // find the closest point by the Voronoi regions of the triangle features (Ericson, Real-Time Collision
+  // Detection, 5.1.5)
+  const Eigen::Vector3d ab = b - a, ac = c - a, ap = p - a;
+  const auto d1 = ab.dot(ap), d2 = ac.dot(ap);
+  if (d1 <= 0.0 && d2 <= 0.0)
+    return ap.norm();
+
+  const Eigen::Vector3d bp = p - b;
+  const auto d3 = ab.dot(bp), d4 = ac.dot(bp);
+  if (d3 >= 0.0 && d4 <= d3)
+    return bp.norm();
+
+  const auto vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+    return (p - (a + ab * (d1 / (d1 - d3)))).norm();
+
+  const Eigen::Vector3d cp = p - c;
+  const auto d5 = ab.dot(cp), d6 = ac.dot(cp);
+  if (d6 >= 0.0 && d5 <= d6)
+    return cp.norm();
+
+  const auto vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+    return (p - (a + ac * (d2 / (d2 - d6)))).norm();
+
+  const auto va = d3 * d6 - d5 * d4;
+  if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+    return (p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))))).norm();
+
+  const auto denominator = va + vb + vc;
+  if (std::abs(denominator) < 1e-300)  // degenerate triangle
+    return std::min({ap.norm(), bp.norm(), cp.norm()});
+  const auto v = vb / denominator, w = vc / denominator;
+  return (p - (a + ab * v + ac * w)).norm();
+}
+
+/**
+ * \brief Quadric edge collapse of a welded triangle mesh.
+ */
+class QuadricSimplifier
+{
+public:
+  QuadricSimplifier(const EigenSTL::vector_Vector3d& vertices, const std::vector<Triangle>& triangles)
+    : originalVertices(vertices), originalTriangles(triangles)
+  {
+  }
+
+  /**
+   * \brief Collapse edges while their quadric error is at most maxQuadricError.
+   */
+  void simplify(double maxQuadricError);
+
+  /**
+   * \brief Upper bound of the distance of the original vertices from the simplified surface.
+   */
+  double measureError() const;
+
+  void getResult(EigenSTL::vector_Vector3d& vertices, std::vector<unsigned int>& triangles) const;
+
+protected:
+  struct Collapse
+  {
+    double cost;
+    unsigned int v1;
+    unsigned int v2;
+    unsigned int version1;
+    unsigned int version2;
+    Eigen::Vector3d target;
+
+    bool operator>(const Collapse& other) const { return this->cost > other.cost; }
+  };
+
+  void initialize();
+  void pushCollapse(unsigned int v1, unsigned int v2);
+  bool canCollapse(const Collapse& collapse) const;
+  void collapse(const Collapse& collapse);
+  std::set<unsigned int> getNeighbors(unsigned int v) const;
+  unsigned int getRepresentative(unsigned int v) const;
+
+  const EigenSTL::vector_Vector3d& originalVertices;
+  const std::vector<Triangle>& originalTriangles;
+
+  EigenSTL::vector_Vector3d positions;
+  std::vector<Quadric, Eigen::aligned_allocator<Quadric>> quadrics;
+  std::vector<Triangle> triangles;
+  std::vector<bool> triangleRemoved;
+  std::vector<std::vector<size_t>> vertexTriangles;  //!< Triangles around each vertex (incl. removed).
+  std::vector<unsigned int> versions;  //!< Incremented whenever the vertex changes.
+  std::vector<unsigned int> collapsedInto;  //!< The vertex each vertex was collapsed into (itself if alive).
+  size_t numTriangles {0};
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+};
+
+void QuadricSimplifier::initialize()
+{
+  const auto numVertices = this->originalVertices.size();
+  this->positions = this->originalVertices;
+  this->quadrics.assign(numVertices, Quadric::Zero());
+  this->triangles = this->originalTriangles;
+  this->triangleRemoved.assign(this->triangles.size(), false);
+  this->vertexTriangles.assign(numVertices, {});
+  this->versions.assign(numVertices, 0);
+  this->collapsedInto.resize(numVertices);
+  for (unsigned int v = 0; v < numVertices; ++v)
+    this->collapsedInto[v] = v;
+  this->numTriangles = this->triangles.size();
+  this->queue = {};
+
+  std::map<std::pair<unsigned int, unsigned int>, size_t> edgeTriangles;
+  for (size_t t = 0; t < this->triangles.size(); ++t)
+  {
+    const auto& tri = this->triangles[t];
+    const auto& a = this->positions[tri[0]];
+    const auto& b = this->positions[tri[1]];
+    const auto& c = this->positions[tri[2]];
+    Eigen::Vector3d normal = (b - a).cross(c - a);
+    const auto norm = normal.norm();
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+      this->vertexTriangles[tri[i]].push_back(t);
+      const auto edge = std::minmax(tri[i], tri[(i + 1) % 3]);
+      edgeTriangles[edge]++;
+    }
+
+    if (norm < 1e-12)
+      continue;
+    normal /= norm;
+    const Eigen::Vector4d plane(normal.x(), normal.y(), normal.z(), -normal.dot(a));
+    const Quadric quadric = plane * plane.transpose();
+    for (const auto v : tri)
+      this->quadrics[v] += quadric;
+  }
+
+  // boundary edges of open meshes are kept in place by planes perpendicular to their triangles
+  for (size_t t = 0; t < this->triangles.size(); ++t)
+  {
+    const auto& tri = this->triangles[t];
+    const Eigen::Vector3d normal = (this->positions[tri[1]] - this->positions[tri[0]]).cross(
+      this->positions[tri[2]] - this->positions[tri[0]]);
+    for (size_t i = 0; i < 3; ++i)
+    {
+      const auto edge = std::minmax(tri[i], tri[(i + 1) % 3]);
+      if (edgeTriangles[edge] != 1)
+        continue;
+      const auto& a = this->positions[edge.first];
+      Eigen::Vector3d edgeNormal = (this->positions[edge.second] - a).cross(normal);
+      if (edgeNormal.norm() < 1e-12)
+        continue;
+      edgeNormal.normalize();
+      const Eigen::Vector4d plane(edgeNormal.x(), edgeNormal.y(), edgeNormal.z(), -edgeNormal.dot(a));
+      const Quadric quadric = plane * plane.transpose();
+      this->quadrics[edge.first] += quadric;
+      this->quadrics[edge.second] += quadric;
+    }
+  }
+
+  for (const auto& edge : edgeTriangles)
+    this->pushCollapse(edge.first.first, edge.first.second);
+}
+
+void QuadricSimplifier::pushCollapse(const unsigned int v1, const unsigned int v2)
+{
+  const Quadric quadric = this->quadrics[v1] + this->quadrics[v2];
+  const auto cost = [&](const Eigen::Vector3d& p)
+  {
+    const Eigen::Vector4d h(p.x(), p.y(), p.z(), 1.0);
+    return std::max(0.0, h.dot(quadric * h));
+  };
+
+  // the optimal position minimizes the quadric, but it can be far away for (nearly) flat neighborhoods,
+  // so the edge endpoints and midpoint are candidates, too
+  Collapse collapse {cost(this->positions[v1]), v1, v2, this->versions[v1], this->versions[v2], this->positions[v1]};
+  const auto tryTarget = [&](const Eigen::Vector3d& target)
+  {
+    const auto targetCost = cost(target);
+    if (targetCost < collapse.cost)
+    {
+      collapse.cost = targetCost;
+      collapse.target = target;
+    }
+  };
+  tryTarget(this->positions[v2]);
+  tryTarget((this->positions[v1] + this->positions[v2]) / 2);
+
+  const Eigen::Matrix3d A = quadric.topLeftCorner<3, 3>();
+  const Eigen::FullPivLU<Eigen::Matrix3d> lu(A);
+  if (lu.rank() == 3)
+  {
+    const Eigen::Vector3d optimum = lu.solve(-quadric.topRightCorner<3, 1>());
+    const auto edgeLength = (this->positions[v1] - this->positions[v2]).norm();
+    if ((optimum - (this->positions[v1] + this->positions[v2]) / 2).norm() <= edgeLength)
+      tryTarget(optimum);
+  }
+
+  this->queue.push(collapse);
+}
+
+std::set<unsigned int> QuadricSimplifier::getNeighbors(const unsigned int v) const
+{
+  std::set<unsigned int> neighbors;
+  for (const auto t : this->vertexTriangles[v])
+    if (!this->triangleRemoved[t])
+      for (const auto w : this->triangles[t])
+        if (w != v)
+          neighbors.insert(w);
+  return neighbors;
+}
+
+bool QuadricSimplifier::canCollapse(const Collapse& collapse) const
+{
+  const auto v1 = collapse.v1, v2 = collapse.v2;
+
+  // link condition: the only common neighbors of the endpoints are the apexes of the edge triangles,
+  // otherwise the collapse would make the mesh non-manifold
+  size_t numEdgeTriangles = 0;
+  for (const auto t : this->vertexTriangles[v1])
+  {
+    const auto& tri = this->triangles[t];
+    if (!this->triangleRemoved[t] && std::find(tri.begin(), tri.end(), v2) != tri.end())
+      numEdgeTriangles++;
+  }
+  if (numEdgeTriangles == 0)
+    return false;
+
+  const auto neighbors1 = this->getNeighbors(v1);
+  const auto neighbors2 = this->getNeighbors(v2);
+  size_t numCommonNeighbors = 0;
+  for (const auto w : neighbors1)
+    numCommonNeighbors += neighbors2.count(w);
+  if (numCommonNeighbors != numEdgeTriangles)
+    return false;
+
+  // the triangles that stay must not flip or degenerate
+  for (const auto v : {v1, v2})
+  {
+    for (const auto t : this->vertexTriangles[v])
+    {
+      const auto& tri = this->triangles[t];
+      if (this->triangleRemoved[t] || std::find(tri.begin(), tri.end(), v == v1 ? v2 : v1) != tri.end())
+        continue;
+
+      std::array<Eigen::Vector3d, 3> corners;
+      for (size_t i = 0; i < 3; ++i)
+        corners[i] = this->positions[tri[i]];
+      const Eigen::Vector3d oldNormal = (corners[1] - corners[0]).cross(corners[2] - corners[0]);
+      for (size_t i = 0; i < 3; ++i)
+        if (tri[i] == v)
+          corners[i] = collapse.target;
+      const Eigen::Vector3d newNormal = (corners[1] - corners[0]).cross(corners[2] - corners[0]);
+      if (newNormal.dot(oldNormal) <= 0.2 * newNormal.norm() * oldNormal.norm())
+        return false;
+    }
+  }
+
+  return true;
+}
+
+void QuadricSimplifier::collapse(const Collapse& collapse)
+{
+  const auto v1 = collapse.v1, v2 = collapse.v2;
+  this->positions[v1] = collapse.target;
+  this->quadrics[v1] += this->quadrics[v2];
+  this->collapsedInto[v2] = v1;
+  this->versions[v1]++;
+  this->versions[v2]++;
+
+  for (const auto t : this->vertexTriangles[v2])
+  {
+    if (this->triangleRemoved[t])
+      continue;
+    auto& tri = this->triangles[t];
+    if (std::find(tri.begin(), tri.end(), v1) != tri.end())
+    {
+      this->triangleRemoved[t] = true;
+      this->numTriangles--;
+      continue;
+    }
+    std::replace(tri.begin(), tri.end(), v2, v1);
+    this->vertexTriangles[v1].push_back(t);
+  }
+  this->vertexTriangles[v2].clear();
+
+  auto& triangles1 = this->vertexTriangles[v1];
+  triangles1.erase(std::remove_if(triangles1.begin(), triangles1.end(),
+                                  [&](const size_t t) { return this->triangleRemoved[t]; }), triangles1.end());
+
+  // the costs of all edges around the moved vertex have changed
+  for (const auto w : this->getNeighbors(v1))
+    this->pushCollapse(v1, w);
+}
+
+void QuadricSimplifier::simplify(const double maxQuadricError)
+{
+  this->initialize();
+
+  // a tetrahedron is the simplest closed mesh
+  while (!this->queue.empty() && this->numTriangles > 4)
+  {
+    const auto collapse = this->queue.top();
+    this->queue.pop();
+    if (collapse.cost > maxQuadricError)
+      break;
+    if (this->versions[collapse.v1] != collapse.version1 || this->versions[collapse.v2] != collapse.version2)
+      continue;
+    if (!this->canCollapse(collapse))
+      continue;
+    this->collapse(collapse);
+  }
+}
+
+unsigned int QuadricSimplifier::getRepresentative(unsigned int v) const
+{
+  while (this->collapsedInto[v] != v)
+    v = this->collapsedInto[v];
+  return v;
+}
+
+double QuadricSimplifier::measureError() const
+{
+  // the distance to the triangles around the vertex an original vertex was collapsed into (and around its
+  // neighbors) is an upper bound of the distance to the whole simplified surface
+  double error = 0.0;
+  for (unsigned int v = 0; v < this->originalVertices.size(); ++v)
+  {
+    const auto& point = this->originalVertices[v];
+    const auto representative = this->getRepresentative(v);
+    auto region = this->getNeighbors(representative);
+    region.insert(representative);
+
+    auto distance = std::numeric_limits<double>::infinity();
+    for (const auto w : region)
+    {
+      for (const auto t : this->vertexTriangles[w])
+      {
+        if (this->triangleRemoved[t])
+          continue;
+        const auto& tri = this->triangles[t];
+        distance = std::min(distance, pointTriangleDistance(
+          point, this->positions[tri[0]], this->positions[tri[1]], this->positions[tri[2]]));
+      }
+    }
+
+    // vertices of removed components have no triangles around, so all are searched
+    if (!std::isfinite(distance))
+    {
+      for (size_t t = 0; t < this->triangles.size(); ++t)
+      {
+        if (this->triangleRemoved[t])
+          continue;
+        const auto& tri = this->triangles[t];
+        distance = std::min(distance, pointTriangleDistance(
+          point, this->positions[tri[0]], this->positions[tri[1]], this->positions[tri[2]]));
+      }
+    }
+
+    error = std::max(error, distance);
+  }
+  return error;
+}
+
+void QuadricSimplifier::getResult(EigenSTL::vector_Vector3d& vertices, std::vector<unsigned int>& triangles) const
+{
+  vertices.clear();
+  triangles.clear();
+  std::vector<unsigned int> newIndices(this->positions.size(), std::numeric_limits<unsigned int>::max());
+  for (size_t t = 0; t < this->triangles.size(); ++t)
+  {
+    if (this->triangleRemoved[t])
+      continue;
+    for (const auto v : this->triangles[t])
+    {
+      if (newIndices[v] == std::numeric_limits<unsigned int>::max())
+      {
+        newIndices[v] = static_cast<unsigned int>(vertices.size());
+        vertices.push_back(this->positions[v]);
+      }
+      triangles.push_back(newIndices[v]);
+    }
+  }
+}
+
+}
+
+double simplifyMesh(const EigenSTL::vector_Vector3d& vertices, const std::vector<unsigned int>& triangles,
+                    const double maxError, EigenSTL::vector_Vector3d& simplifiedVertices,
+                    std::vector<unsigned int>& simplifiedTriangles)
+{
+  // mesh loaders usually duplicate vertices shared by triangles with different normals
+  EigenSTL::vector_Vector3d weldedVertices;
+  std::vector<Triangle> weldedTriangles;
+  std::map<std::array<double, 3>, unsigned int> vertexIndices;
+  std::vector<unsigned int> weldedIndices(vertices.size());
+  for (size_t v = 0; v < vertices.size(); ++v)
+  {
+    const std::array<double, 3> key {vertices[v].x(), vertices[v].y(), vertices[v].z()};
+    const auto inserted = vertexIndices.emplace(key, static_cast<unsigned int>(weldedVertices.size()));
+    if (inserted.second)
+      weldedVertices.push_back(vertices[v]);
+    weldedIndices[v] = inserted.first->second;
+  }
+  for (size_t t = 0; t + 2 < triangles.size(); t += 3)
+  {
+    const Triangle tri {weldedIndices[triangles[t]], weldedIndices[triangles[t + 1]], weldedIndices[triangles[t + 2]]};
+    if (tri[0] != tri[1] && tri[1] != tri[2] && tri[0] != tri[2])
+      weldedTriangles.push_back(tri);
+  }
+
+  if (maxError > 0.0)
+  {
+    QuadricSimplifier simplifier(weldedVertices, weldedTriangles);
+    // the quadric error only approximates the distance from the original surface, so it is tightened
+    // until the measured error is within the limit
+    auto maxQuadricError = maxError * maxError;
+    for (size_t attempt = 0; attempt < 5; ++attempt, maxQuadricError /= 4)
+    {
+      simplifier.simplify(maxQuadricError);
+      const auto error = simplifier.measureError();
+      if (error <= maxError)
+      {
+        simplifier.getResult(simplifiedVertices, simplifiedTriangles);
+        return error;
+      }
+    }
+  }
+
+  simplifiedVertices = weldedVertices;
+  simplifiedTriangles.clear();
+  for (const auto& tri : weldedTriangles)
+    simplifiedTriangles.insert(simplifiedTriangles.end(), tri.begin(), tri.end());
+  return 0.0;
+}
+
+shapes::Mesh* simplifyMesh(const shapes::Mesh& mesh, const double maxError, double& error)
+{
+  EigenSTL::vector_Vector3d vertices;
+  vertices.reserve(mesh.vertex_count);
+  for (unsigned int v = 0; v < mesh.vertex_count; ++v)
+    vertices.emplace_back(mesh.vertices[3 * v], mesh.vertices[3 * v + 1], mesh.vertices[3 * v + 2]);
+  const std::vector<unsigned int> triangles(mesh.triangles, mesh.triangles + 3 * mesh.triangle_count);
+
+  EigenSTL::vector_Vector3d simplifiedVertices;
+  std::vector<unsigned int> simplifiedTriangles;
+  error = simplifyMesh(vertices, triangles, maxError, simplifiedVertices, simplifiedTriangles);
+  return shapes::createMeshFromVertices(simplifiedVertices, simplifiedTriangles);
+}
+
+}
@@ -0,0 +1,103 @@
+#include <robot_body_filter/utils/pose_keyframe_table.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace robot_body_filter
+{
+
+void PoseKeyframeTable::reset(const size_t numRows, const size_t numKeyframes)
+{
+  this->numKeyframes = std::max<size_t>(1, numKeyframes);
+  this->keyframes.resize(numRows * this->numKeyframes);
+  this->keyframeSet.assign(numRows * this->numKeyframes, false);
+  this->numSetKeyframes.assign(numRows, 0);
+}
+
+void PoseKeyframeTable::setKeyframe(const size_t row, const size_t keyframe, const Eigen::Isometry3d& pose)
+{
+  const auto index = row * this->numKeyframes + keyframe;
+  auto& frame = this->keyframes[index];
+  frame.translation = pose.translation();
+  frame.rotation = Eigen::Quaterniond(pose.linear());
+
+  if (!this->keyframeSet[index])
+  {
+    this->keyframeSet[index] = true;
+    this->numSetKeyframes[row]++;
+  }
+}
+
+bool PoseKeyframeTable::isValid(const size_t row) const
+{
+  return this->numSetKeyframes[row] == this->numKeyframes;
+}
+
+bool PoseKeyframeTable::interpolate(const size_t row, double ratio, Eigen::Isometry3d& pose) const
+{
+  if (!this->isValid(row))
+    return false;
+
+  const auto* frames = this->keyframes.data() + row * this->numKeyframes;
+  if (this->numKeyframes == 1)
+  {
+    pose.linear() = frames[0].rotation.toRotationMatrix();
+    pose.translation() = frames[0].translation;
+    return true;
+  }
+
+  double t;
+  const auto segment = this->getSegment(ratio, t);
+  const auto& frame1 = frames[segment];
+  const auto& frame2 = frames[segment + 1];
+  pose.linear() = frame1.rotation.slerp(t, frame2.rotation).toRotationMatrix();
+  pose.translation() = frame1.translation * (1 - t) + frame2.translation * t;
+  return true;
+}
+
+bool PoseKeyframeTable::interpolateTranslation(const size_t row, const double ratio,
+                                               Eigen::Vector3d& translation) const
+{
+  if (!this->isValid(row))
+    return false;
+
+  const auto* frames = this->keyframes.data() + row * this->numKeyframes;
+  if (this->numKeyframes == 1)
+  {
+    translation = frames[0].translation;
+    return true;
+  }
+
+  double t;
+  const auto segment = this->getSegment(ratio, t);
+  translation = frames[segment].translation * (1 - t) + frames[segment + 1].translation * t;
+  return true;
+}
+
+size_t PoseKeyframeTable::getSegment(double ratio, double& t) const
+{
+  ratio = std::min(1.0, std::max(0.0, ratio));
+  const auto position = ratio * static_cast<double>(this->numKeyframes - 1);
+  const auto segment = std::min(static_cast<size_t>(position), this->numKeyframes - 2);
+  t = position - static_cast<double>(segment);
+  return segment;
+}
+
+double PoseKeyframeTable::getKeyframeRatio(const size_t keyframe) const
+{
+  if (this->numKeyframes == 1)
+    return 0.0;
+  return static_cast<double>(keyframe) / static_cast<double>(this->numKeyframes - 1);
+}
+
+size_t PoseKeyframeTable::getNumRows() const
+{
+  return this->numSetKeyframes.size();
+}
+
+size_t PoseKeyframeTable::getNumKeyframes() const
+{
+  return this->numKeyframes;
+}
+
+}
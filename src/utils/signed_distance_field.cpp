@@ -0,0 +1,197 @@
+#include <robot_body_filter/utils/signed_distance_field.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <Eigen/Geometry>
+
+#include <ros/console.h>
+
+namespace robot_body_filter
+{
+
+constexpr size_t SignedDistanceField::MAX_NODES;
+
+SignedDistanceField::SignedDistanceField(const bodies::ConvexMesh& body, double resolution)
+{
+  const auto& vertices = body.getScaledVertices();
+  const auto& triangles = body.getTriangles();
+
+  // containsPoint() pads the planes of the mesh while the scaled vertices are padded radially, so the
+  // surface of the tested body can be up to twice the (scaled) padding away from the triangles
+  const auto scale = std::max(1.0, body.getScale());
+  this->margin = 2 * std::abs(body.getPadding()) * scale + 1e-5 * scale;
+
+  Eigen::AlignedBox3d box;
+  Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+  for (const auto& vertex : vertices)
+  {
+    box.extend(vertex);
+    centroid += vertex;
+  }
+  centroid /= static_cast<double>(std::max<size_t>(1, vertices.size()));
+
+  // outward planes of the triangles; triangulated faces of the hull share their planes
+  std::vector<Eigen::Vector4d, Eigen::aligned_allocator<Eigen::Vector4d>> planes;
+  for (size_t t = 0; t + 2 < triangles.size(); t += 3)
+  {
+    const auto& a = vertices[triangles[t]];
+    Eigen::Vector3d normal = (vertices[triangles[t + 1]] - a).cross(vertices[triangles[t + 2]] - a);
+    if (normal.norm() < 1e-12)
+      continue;
+    normal.normalize();
+    if (normal.dot(centroid - a) > 0.0)
+      normal = -normal;
+    const Eigen::Vector4d plane(normal.x(), normal.y(), normal.z(), -normal.dot(a));
+    const auto samePlane = [&](const Eigen::Vector4d& other) { return (other - plane).cwiseAbs().maxCoeff() < 1e-9; };
+    if (std::none_of(planes.begin(), planes.end(), samePlane))
+      planes.push_back(plane);
+  }
+
+  // interpolation mixes the values of all 8 corners of a cell, and each of them is at most the cell diagonal
+  // from the point, which bounds the error for a 1-Lipschitz function; quantization adds half a quantum
+  const auto toleranceForResolution = [](const double res) { return std::sqrt(3.0) * res + res / 128.0; };
+
+  // the grid reaches beyond the band where the exact test is needed, so points out of it are outside
+  const auto paddingForResolution = [&](const double res) { return this->margin + toleranceForResolution(res) + res; };
+  const auto numNodesForResolution = [&](const double res)
+  {
+    return ((box.sizes().array() + 2 * paddingForResolution(res)) / res + 2.0).prod();
+  };
+
+  const auto requestedResolution = resolution;
+  while (numNodesForResolution(resolution) > static_cast<double>(MAX_NODES))
+    resolution *= std::cbrt(numNodesForResolution(resolution) / static_cast<double>(MAX_NODES)) * 1.01;
+  if (resolution != requestedResolution)
+    ROS_WARN("Distance field of a mesh with resolution %f m would be too large. Using resolution %f m instead.",
+             requestedResolution, resolution);
+
+  const auto padding = paddingForResolution(resolution);
+  const Eigen::Vector3d extent = box.sizes() + Eigen::Vector3d::Constant(2 * padding);
+
+  this->resolution = resolution;
+  this->quantum = resolution / 64.0;
+  this->tolerance = toleranceForResolution(resolution);
+  this->size = ((extent / resolution).array().ceil() + 1.0).cast<int>();
+  this->origin = box.min() - Eigen::Vector3d::Constant(padding);
+
+  // along a row of nodes, the planes are lines with slopes given by their normals, and the field is their
+  // upper envelope; sorting the planes by the slope once allows building the envelope of each row in
+  // linear time instead of evaluating all planes in all nodes
+  std::sort(planes.begin(), planes.end(), [](const Eigen::Vector4d& a, const Eigen::Vector4d& b)
+  {
+    return a.x() < b.x();
+  });
+
+  // the distance is 1-Lipschitz, and clamping it keeps it so
+  const auto maxValue = static_cast<double>(std::numeric_limits<std::int16_t>::max());
+  this->values.resize(static_cast<size_t>(this->size.prod()), static_cast<std::int16_t>(maxValue));
+  if (planes.empty())
+    return;
+
+  std::vector<double> slopes, intercepts;
+  slopes.reserve(planes.size());
+  intercepts.reserve(planes.size());
+  for (int z = 0; z < this->size.z(); ++z)
+    for (int y = 0; y < this->size.y(); ++y)
+    {
+      const auto nodeY = this->origin.y() + y * resolution;
+      const auto nodeZ = this->origin.z() + z * resolution;
+
+      // upper envelope of the lines (distance as a function of x)
+      slopes.clear();
+      intercepts.clear();
+      for (const auto& plane : planes)
+      {
+        const auto slope = plane.x();
+        const auto intercept = plane.y() * nodeY + plane.z() * nodeZ + plane.w() + slope * this->origin.x();
+        if (!slopes.empty() && slope - slopes.back() < 1e-12)
+        {
+          if (intercept <= intercepts.back())
+            continue;
+          slopes.pop_back();
+          intercepts.pop_back();
+        }
+        // the last line is useless if the new line overtakes it before it overtakes the one before it
+        while (slopes.size() >= 2)
+        {
+          const auto n = slopes.size();
+          if ((intercepts[n - 2] - intercepts[n - 1]) * (slope - slopes[n - 1]) <
+              (intercepts[n - 1] - intercept) * (slopes[n - 1] - slopes[n - 2]))
+            break;
+          slopes.pop_back();
+          intercepts.pop_back();
+        }
+        slopes.push_back(slope);
+        intercepts.push_back(intercept);
+      }
+
+      size_t line = 0;
+      for (int x = 0; x < this->size.x(); ++x)
+      {
+        const auto offset = x * resolution;
+        while (line + 1 < slopes.size() &&
+               slopes[line + 1] * offset + intercepts[line + 1] >= slopes[line] * offset + intercepts[line])
+          ++line;
+        const auto distance = slopes[line] * offset + intercepts[line];
+        const auto quantized = std::max(-maxValue, std::min(maxValue, std::round(distance / this->quantum)));
+        this->values[this->getIndex(x, y, z)] = static_cast<std::int16_t>(quantized);
+      }
+    }
+}
+
+double SignedDistanceField::getDistance(const Eigen::Vector3d& point) const
+{
+  const Eigen::Vector3d coords = (point - this->origin) / this->resolution;
+  // written so that NaNs end up outside
+  if (!(coords.x() >= 0.0 && coords.y() >= 0.0 && coords.z() >= 0.0 &&
+    coords.x() <= this->size.x() - 1 && coords.y() <= this->size.y() - 1 && coords.z() <= this->size.z() - 1))
+    return std::numeric_limits<double>::infinity();
+
+  // the last node is handled by the cell before it
+  const Eigen::Vector3i cell = coords.cast<int>().cwiseMin(this->size - Eigen::Vector3i::Constant(2)).cwiseMax(0);
+  const Eigen::Vector3d t = coords - cell.cast<double>();
+
+  double value = 0.0;
+  for (int corner = 0; corner < 8; ++corner)
+  {
+    const int dx = corner & 1, dy = (corner >> 1) & 1, dz = (corner >> 2) & 1;
+    const auto weight = (dx ? t.x() : 1.0 - t.x()) * (dy ? t.y() : 1.0 - t.y()) * (dz ? t.z() : 1.0 - t.z());
+    value += weight * this->values[this->getIndex(cell.x() + dx, cell.y() + dy, cell.z() + dz)];
+  }
+  return value * this->quantum;
+}
+
+SignedDistanceField::Containment SignedDistanceField::classify(const Eigen::Vector3d& point) const
+{
+  const auto distance = this->getDistance(point);
+  if (distance > this->tolerance + this->margin)
+    return Containment::OUTSIDE;
+  if (distance < -(this->tolerance + this->margin))
+    return Containment::INSIDE;
+  return Containment::UNSURE;
+}
+
+double SignedDistanceField::getTolerance() const
+{
+  return this->tolerance;
+}
+
+double SignedDistanceField::getResolution() const
+{
+  return this->resolution;
+}
+
+const Eigen::Vector3i& SignedDistanceField::getSize() const
+{
+  return this->size;
+}
+
+size_t SignedDistanceField::getIndex(const int x, const int y, const int z) const
+{
+  return static_cast<size_t>(x) + static_cast<size_t>(this->size.x()) *
+    (static_cast<size_t>(y) + static_cast<size_t>(this->size.y()) * static_cast<size_t>(z));
+}
+
+}
@@ -0,0 +1,140 @@
+#include <robot_body_filter/utils/single_precision_body.h>
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace robot_body_filter
+{
+
+SinglePrecisionBody::SinglePrecisionBody(const bodies::Body& body)
+{
+  const auto dims = body.getDimensions();
+  const auto scale = body.getScale();
+  const auto padding = body.getPadding();
+
+  switch (body.getType())
+  {
+    case shapes::SPHERE:
+      this->type = Type::SPHERE;
+      this->radius = static_cast<float>(dims[0] * scale + padding);
+      break;
+    case shapes::BOX:
+      this->type = Type::BOX;
+      this->halfExtents = (Eigen::Vector3d(dims[0], dims[1], dims[2]) * scale / 2.0 +
+                           Eigen::Vector3d::Constant(padding)).cast<float>();
+      break;
+    case shapes::CYLINDER:
+      this->type = Type::CYLINDER;
+      this->radius = static_cast<float>(dims[0] * scale + padding);
+      this->halfLength = static_cast<float>(dims[1] * scale / 2.0 + padding);
+      break;
+    default:
+      this->type = Type::UNSUPPORTED;
+      return;
+  }
+
+  this->center = body.getPose().translation().cast<float>();
+  this->rotation = body.getPose().linear().cast<float>();
+}
+
+SinglePrecisionBody::Type SinglePrecisionBody::getType() const
+{
+  return this->type;
+}
+
+bool SinglePrecisionBody::containsPoint(const Eigen::Vector3f& point) const
+{
+  const Eigen::Vector3f v = point - this->center;
+  switch (this->type)
+  {
+    case Type::SPHERE:
+      return v.squaredNorm() <= this->radius * this->radius;
+    case Type::BOX:
+      return ((this->rotation.transpose() * v).cwiseAbs() - this->halfExtents).maxCoeff() <= 0.0f;
+    case Type::CYLINDER:
+    {
+      const Eigen::Vector3f local = this->rotation.transpose() * v;
+      return std::abs(local.z()) <= this->halfLength &&
+        local.x() * local.x() + local.y() * local.y() <= this->radius * this->radius;
+    }
+    default:
+      return false;
+  }
+}
+
+bool SinglePrecisionBody::intersectsRay(const Eigen::Vector3f& origin,
+    const Eigen::Vector3f& direction, const float maxDistance) const
+{
+  float tEnter, tExit;
+  if (!this->lineInterval(origin, direction, tEnter, tExit))
+    return false;
+
+  // the first surface crossing in front of the origin
+  if (tEnter > 0.0f)
+    return tEnter <= maxDistance;
+  if (tExit > 0.0f)
+    return tExit <= maxDistance;
+  return false;
+}
+
+bool SinglePrecisionBody::lineInterval(const Eigen::Vector3f& origin,
+    const Eigen::Vector3f& direction, float& tEnter, float& tExit) const
+{
+  if (this->type == Type::UNSUPPORTED)
+    return false;
+
+  const Eigen::Vector3f o = this->rotation.transpose() * (origin - this->center);
+  const Eigen::Vector3f d = this->rotation.transpose() * direction;
+
+  tEnter = -std::numeric_limits<float>::infinity();
+  tExit = std::numeric_limits<float>::infinity();
+
+  // clip the line by a pair of parallel planes at +-halfWidth along the given local axis
+  const auto clipSlab = [&](const Eigen::Index axis, const float halfWidth) -> bool
+  {
+    if (d[axis] == 0.0f)
+      return std::abs(o[axis]) <= halfWidth;
+
+    auto t1 = (-halfWidth - o[axis]) / d[axis];
+    auto t2 = (halfWidth - o[axis]) / d[axis];
+    if (t1 > t2)
+      std::swap(t1, t2);
+    tEnter = std::max(tEnter, t1);
+    tExit = std::min(tExit, t2);
+    return tEnter <= tExit;
+  };
+
+  // clip the line by an infinite cylinder (or sphere) given by the quadratic a*t^2 + 2*b*t + c <= 0
+  const auto clipQuadratic = [&](const float a, const float b, const float c) -> bool
+  {
+    if (a == 0.0f)
+      return c <= 0.0f;
+
+    const auto discriminant = b * b - a * c;
+    if (discriminant < 0.0f)
+      return false;
+
+    const auto sqrtDiscriminant = std::sqrt(discriminant);
+    tEnter = std::max(tEnter, (-b - sqrtDiscriminant) / a);
+    tExit = std::min(tExit, (-b + sqrtDiscriminant) / a);
+    return tEnter <= tExit;
+  };
+
+  switch (this->type)
+  {
+    case Type::SPHERE:
+      return clipQuadratic(d.squaredNorm(), o.dot(d), o.squaredNorm() - this->radius * this->radius);
+    case Type::BOX:
+      return clipSlab(0, this->halfExtents.x()) && clipSlab(1, this->halfExtents.y()) &&
+        clipSlab(2, this->halfExtents.z());
+    case Type::CYLINDER:
+      return clipSlab(2, this->halfLength) &&
+        clipQuadratic(d.head<2>().squaredNorm(), o.head<2>().dot(d.head<2>()),
+                      o.head<2>().squaredNorm() - this->radius * this->radius);
+    default:
+      return false;
+  }
+}
+
+}
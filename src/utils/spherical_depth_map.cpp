@@ -0,0 +1,129 @@
+#include <robot_body_filter/utils/spherical_depth_map.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace robot_body_filter
+{
+
+SphericalDepthMap::SphericalDepthMap(const double angularResolution)
+{
+  this->setAngularResolution(angularResolution);
+}
+
+void SphericalDepthMap::setAngularResolution(const double angularResolution)
+{
+  if (!(angularResolution > 0.0))
+    throw std::runtime_error("Angular resolution of the spherical depth map has to be positive.");
+
+  this->angularResolution = angularResolution;
+  this->numRows = std::max<size_t>(1, static_cast<size_t>(std::ceil(M_PI / angularResolution)));
+  this->numCols = std::max<size_t>(1, static_cast<size_t>(std::ceil(2 * M_PI / angularResolution)));
+  // make the bins evenly cover the whole sphere
+  this->rowResolution = M_PI / static_cast<double>(this->numRows);
+  this->colResolution = 2 * M_PI / static_cast<double>(this->numCols);
+  this->minDistances.assign(this->numRows * this->numCols, std::numeric_limits<float>::infinity());
+}
+
+double SphericalDepthMap::getAngularResolution() const
+{
+  return this->angularResolution;
+}
+
+void SphericalDepthMap::reset(const Eigen::Vector3d& origin)
+{
+  this->origin = origin;
+  this->originFloat = origin.cast<float>();
+  std::fill(this->minDistances.begin(), this->minDistances.end(),
+            std::numeric_limits<float>::infinity());
+}
+
+const Eigen::Vector3d& SphericalDepthMap::getOrigin() const
+{
+  return this->origin;
+}
+
+void SphericalDepthMap::addSphere(const Eigen::Vector3d& center, const double radius)
+{
+  const Eigen::Vector3d v = center - this->origin;
+  const auto distance = v.norm();
+
+  // leave some room for the rounding errors of the distances computed by the users of the map
+  const auto minDistance = (distance - radius) * (1.0 - 1e-6) - 1e-6;
+  if (minDistance <= 0.0)
+  {
+    // the origin is (almost) inside the sphere, so it can be seen in all directions
+    std::fill(this->minDistances.begin(), this->minDistances.end(), 0.0f);
+    return;
+  }
+
+  auto value = static_cast<float>(minDistance);
+  if (value > minDistance)
+    value = std::nextafter(value, 0.0f);
+
+  const auto azimuth = std::atan2(v.y(), v.x());
+  const auto elevation = std::atan2(v.z(), std::hypot(v.x(), v.y()));
+
+  // angular radius of the sphere footprint, enlarged to cover the bin discretization
+  const auto alpha = std::asin(std::min(1.0, radius / distance)) + this->rowResolution;
+
+  const auto firstRow = this->getRow(elevation - alpha);
+  const auto lastRow = this->getRow(elevation + alpha);
+
+  // azimuthal half-width of a spherical cap; the cap covers all azimuths if it contains a pole
+  size_t firstCol = 0;
+  size_t numCols = this->numCols;
+  if (std::abs(elevation) + alpha < M_PI_2)
+  {
+    const auto halfWidth = std::asin(std::min(1.0, std::sin(alpha) / std::cos(elevation))) +
+      this->colResolution;
+    firstCol = this->getCol(azimuth - halfWidth);
+    numCols = std::min(this->numCols,
+                       static_cast<size_t>(std::ceil(2 * halfWidth / this->colResolution)) + 2);
+  }
+
+  for (size_t row = firstRow; row <= lastRow; ++row)
+  {
+    auto* rowData = this->minDistances.data() + row * this->numCols;
+    for (size_t i = 0, col = firstCol; i < numCols; ++i, col = (col + 1 == this->numCols) ? 0 : col + 1)
+      rowData[col] = std::min(rowData[col], value);
+  }
+}
+
+float SphericalDepthMap::getMinDistance(const Eigen::Vector3d& point) const
+{
+  const Eigen::Vector3d v = point - this->origin;
+  const auto row = this->getRow(std::atan2(v.z(), std::hypot(v.x(), v.y())));
+  const auto col = this->getCol(std::atan2(v.y(), v.x()));
+  return this->minDistances[row * this->numCols + col];
+}
+
+float SphericalDepthMap::getMinDistance(const Eigen::Vector3f& point) const
+{
+  const Eigen::Vector3f v = point - this->originFloat;
+  const auto row = this->getRow(std::atan2(v.z(), std::hypot(v.x(), v.y())));
+  const auto col = this->getCol(std::atan2(v.y(), v.x()));
+  return this->minDistances[row * this->numCols + col];
+}
+
+size_t SphericalDepthMap::getRow(const double elevation) const
+{
+  const auto row = std::floor((elevation + M_PI_2) / this->rowResolution);
+  if (row <= 0.0)
+    return 0;
+  return std::min(this->numRows - 1, static_cast<size_t>(row));
+}
+
+size_t SphericalDepthMap::getCol(const double azimuth) const
+{
+  auto col = std::floor((azimuth + M_PI) / this->colResolution);
+  // wrap around
+  col = std::fmod(col, static_cast<double>(this->numCols));
+  if (col < 0.0)
+    col += static_cast<double>(this->numCols);
+  return std::min(this->numCols - 1, static_cast<size_t>(col));
+}
+
+}
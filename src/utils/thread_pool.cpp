@@ -0,0 +1,211 @@
+#include <robot_body_filter/utils/thread_pool.h>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <ros/console.h>
+
+namespace robot_body_filter
+{
+
+ThreadPool::ThreadPool(size_t numThreads, const std::vector<int>& cpuAffinity)
+{
+  const size_t numCores = std::max(1u, std::thread::hardware_concurrency());
+  if (numThreads == 0)
+    numThreads = std::max(size_t(1), numCores - 1);
+  numThreads = std::min(numThreads, numCores);
+
+  for (size_t i = 0; i < numThreads; ++i)
+    this->taskRanges.emplace_back(new TaskRange);
+
+  for (size_t i = 1; i < numThreads; ++i)
+  {
+    this->workers.emplace_back(&ThreadPool::workerLoop, this, i);
+
+#ifdef __linux__
+    if (!cpuAffinity.empty())
+    {
+      const auto cpu = cpuAffinity[(i - 1) % cpuAffinity.size()];
+      cpu_set_t cpuSet;
+      CPU_ZERO(&cpuSet);
+      CPU_SET(cpu, &cpuSet);
+      const auto err = pthread_setaffinity_np(
+          this->workers.back().native_handle(), sizeof(cpu_set_t), &cpuSet);
+      if (err != 0)
+        ROS_WARN("Cannot pin worker thread %zu to CPU %i: %s", i, cpu, strerror(err));
+    }
+#else
+    if (!cpuAffinity.empty() && i == 1)
+      ROS_WARN("CPU affinity of worker threads is not supported on this platform");
+#endif
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stop = true;
+  }
+  this->workAvailable.notify_all();
+
+  for (auto& worker : this->workers)
+    worker.join();
+}
+
+size_t ThreadPool::getNumThreads() const
+{
+  return this->taskRanges.size();
+}
+
+void ThreadPool::parallelFor(const size_t numTasks,
+                             const std::function<void(size_t task, size_t thread)>& fn)
+{
+  if (numTasks == 0)
+    return;
+
+  if (this->workers.empty() || numTasks == 1)
+  {
+    std::exception_ptr exception;
+    for (size_t i = 0; i < numTasks; ++i)
+    {
+      try
+      {
+        fn(i, 0);
+      }
+      catch (...)
+      {
+        if (!exception)
+          exception = std::current_exception();
+      }
+    }
+    if (exception)
+      std::rethrow_exception(exception);
+    return;
+  }
+
+  std::lock_guard<std::mutex> callLock(this->callMutex);
+
+  // distribute the tasks evenly, the rest is balanced by stealing
+  const auto numThreads = this->getNumThreads();
+  for (size_t i = 0; i < numThreads; ++i)
+  {
+    std::lock_guard<std::mutex> lock(this->taskRanges[i]->mutex);
+    this->taskRanges[i]->begin = numTasks * i / numThreads;
+    this->taskRanges[i]->end = numTasks * (i + 1) / numThreads;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->task = &fn;
+    this->exception = nullptr;
+    this->busyWorkers = this->workers.size();
+    this->generation++;
+  }
+  this->workAvailable.notify_all();
+
+  this->runTasks(0);
+
+  std::exception_ptr exception;
+  {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->workDone.wait(lock, [this] { return this->busyWorkers == 0; });
+    this->task = nullptr;
+    exception = this->exception;
+  }
+
+  if (exception)
+    std::rethrow_exception(exception);
+}
+
+void ThreadPool::workerLoop(const size_t thread)
+{
+  size_t lastGeneration = 0;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->workAvailable.wait(lock, [&] { return this->stop || this->generation != lastGeneration; });
+      if (this->stop)
+        return;
+      lastGeneration = this->generation;
+    }
+
+    this->runTasks(thread);
+
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      if (--this->busyWorkers == 0)
+        this->workDone.notify_one();
+    }
+  }
+}
+
+void ThreadPool::runTasks(const size_t thread)
+{
+  size_t task;
+  while (true)
+  {
+    if (!this->popTask(thread, task))
+    {
+      // own tasks are finished, help the others; if there's nothing to steal, we're done
+      if (this->stealTasks(thread))
+        continue;
+      break;
+    }
+
+    try
+    {
+      (*this->task)(task, thread);
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      if (!this->exception)
+        this->exception = std::current_exception();
+    }
+  }
+}
+
+bool ThreadPool::popTask(const size_t thread, size_t& task)
+{
+  auto& range = *this->taskRanges[thread];
+  std::lock_guard<std::mutex> lock(range.mutex);
+  if (range.begin >= range.end)
+    return false;
+  task = range.begin++;
+  return true;
+}
+
+bool ThreadPool::stealTasks(const size_t thread)
+{
+  const auto numThreads = this->getNumThreads();
+  for (size_t i = 1; i < numThreads; ++i)
+  {
+    auto& victim = *this->taskRanges[(thread + i) % numThreads];
+    size_t begin, end;
+    {
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (victim.begin >= victim.end)
+        continue;
+      // take the second half of the victim's remaining tasks
+      end = victim.end;
+      victim.end -= (victim.end - victim.begin + 1) / 2;
+      begin = victim.end;
+    }
+
+    auto& range = *this->taskRanges[thread];
+    std::lock_guard<std::mutex> lock(range.mutex);
+    range.begin = begin;
+    range.end = end;
+    return true;
+  }
+  return false;
+}
+
+}
@@ -0,0 +1,143 @@
+#include <robot_body_filter/utils/transform_memo.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+namespace robot_body_filter
+{
+
+TransformMemo::TransformMemo(const size_t capacity) : capacity(capacity)
+{
+}
+
+const std::shared_ptr<TransformMemo>& TransformMemo::getProcessWide()
+{
+  static const auto memo = std::make_shared<TransformMemo>();
+  return memo;
+}
+
+bool TransformMemo::get(const std::string& targetFrame, const std::string& sourceFrame, const ros::Time& stamp,
+                        geometry_msgs::TransformStamped& transform)
+{
+  return this->get(targetFrame, sourceFrame, stamp, ros::Duration(0), transform);
+}
+
+bool TransformMemo::get(const std::string& targetFrame, const std::string& sourceFrame, const ros::Time& stamp,
+                        const ros::Duration& stampTolerance, geometry_msgs::TransformStamped& transform)
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+  if (this->index.empty())
+    return false;
+
+  const auto stamps = this->index.find({targetFrame, sourceFrame});
+  if (stamps == this->index.end())
+    return false;
+
+  // the closest stamp is either the first one not before stamp, or the one before it
+  auto closest = stamps->second.end();
+  ros::Duration closestDifference = stampTolerance;
+  const auto next = stamps->second.lower_bound(stamp);
+  if (next != stamps->second.end() && next->first - stamp <= closestDifference)
+  {
+    closest = next;
+    closestDifference = next->first - stamp;
+  }
+  if (next != stamps->second.begin())
+  {
+    const auto previous = std::prev(next);
+    if (stamp - previous->first <= closestDifference)
+      closest = previous;
+  }
+  if (closest == stamps->second.end())
+    return false;
+
+  this->entries.splice(this->entries.begin(), this->entries, closest->second);
+  transform = closest->second->transform;
+  return true;
+}
+
+void TransformMemo::put(const std::string& targetFrame, const std::string& sourceFrame, const ros::Time& stamp,
+                        const geometry_msgs::TransformStamped& transform)
+{
+  if (stamp.isZero())
+    return;
+
+  std::lock_guard<std::mutex> guard(this->mutex);
+  if (this->capacity == 0)
+    return;
+
+  Key key{targetFrame, sourceFrame};
+  auto& stamps = this->index[key];
+  const auto entry = stamps.find(stamp);
+  if (entry != stamps.end())
+  {
+    entry->second->transform = transform;
+    this->entries.splice(this->entries.begin(), this->entries, entry->second);
+    return;
+  }
+
+  this->entries.push_front({std::move(key), stamp, transform});
+  stamps.emplace(stamp, this->entries.begin());
+  this->shrinkNoLock();
+}
+
+void TransformMemo::setCapacity(const size_t capacity)
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+  this->capacity = capacity;
+  this->shrinkNoLock();
+}
+
+void TransformMemo::reserveCapacity(const size_t capacity)
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+  this->capacity = std::max(this->capacity, capacity);
+}
+
+size_t TransformMemo::getCapacity() const
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+  return this->capacity;
+}
+
+size_t TransformMemo::size() const
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+  return this->entries.size();
+}
+
+void TransformMemo::clear()
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+  this->index.clear();
+  this->entries.clear();
+}
+
+void TransformMemo::shrinkNoLock()
+{
+  while (this->entries.size() > this->capacity)
+  {
+    const auto& entry = this->entries.back();
+    const auto stamps = this->index.find(entry.key);
+    stamps->second.erase(entry.stamp);
+    if (stamps->second.empty())
+      this->index.erase(stamps);
+    this->entries.pop_back();
+  }
+}
+
+bool TransformMemo::Key::operator==(const TransformMemo::Key& other) const
+{
+  return this->sourceFrame == other.sourceFrame && this->targetFrame == other.targetFrame;
+}
+
+size_t TransformMemo::KeyHash::operator()(const TransformMemo::Key& key) const
+{
+  const std::hash<std::string> stringHash;
+  auto hash = stringHash(key.sourceFrame);
+  hash ^= stringHash(key.targetFrame) + 0x9e3779b9 + (hash << 6u) + (hash >> 2u);
+  return hash;
+}
+
+}
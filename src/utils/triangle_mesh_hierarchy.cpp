@@ -0,0 +1,89 @@
+#include <robot_body_filter/utils/triangle_mesh_hierarchy.h>
+
+#include <cmath>
+
+#include <Eigen/Geometry>
+
+namespace robot_body_filter
+{
+
+TriangleMeshHierarchy::TriangleMeshHierarchy(const bodies::ConvexMesh& body)
+{
+  const auto& scaledVertices = body.getScaledVertices();
+  const auto& triangles = body.getTriangles();
+
+  std::vector<BoundingVolumeHierarchy::Box> boxes;
+  boxes.reserve(triangles.size() / 3);
+  this->vertices.reserve(triangles.size());
+  for (size_t t = 0; t + 2 < triangles.size(); t += 3)
+  {
+    const auto& a = scaledVertices[triangles[t]];
+    const auto& b = scaledVertices[triangles[t + 1]];
+    const auto& c = scaledVertices[triangles[t + 2]];
+
+    // degenerate triangles can't be crossed by a segment (their neighbors cover them)
+    if ((b - a).cross(c - a).squaredNorm() < 1e-24)
+      continue;
+
+    this->vertices.push_back(a);
+    this->vertices.push_back(b);
+    this->vertices.push_back(c);
+
+    // triangles parallel to the axes have flat boxes, so the boxes are padded to not lose hits due to
+    // rounding errors of the slab test
+    BoundingVolumeHierarchy::Box box(a);
+    box.extend(b);
+    box.extend(c);
+    box.min().array() -= 1e-6;
+    box.max().array() += 1e-6;
+    boxes.push_back(box);
+  }
+
+  this->hierarchy.build(boxes);
+}
+
+bool TriangleMeshHierarchy::intersectsSegment(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction,
+                                              const double length) const
+{
+  return this->hierarchy.anySegmentHit(origin, direction, length, [&](const size_t triangle)
+  {
+    return this->segmentCrossesTriangle(origin, direction, length, triangle);
+  });
+}
+
+size_t TriangleMeshHierarchy::getNumTriangles() const
+{
+  return this->hierarchy.size();
+}
+
+bool TriangleMeshHierarchy::segmentCrossesTriangle(const Eigen::Vector3d& origin,
+    const Eigen::Vector3d& direction, const double length, const size_t triangle) const
+{
+  const auto& a = this->vertices[3 * triangle];
+  const Eigen::Vector3d ab = this->vertices[3 * triangle + 1] - a;
+  const Eigen::Vector3d ac = this->vertices[3 * triangle + 2] - a;
+
+  const Eigen::Vector3d p = direction.cross(ac);
+  const auto det = ab.dot(p);
+  // segments parallel to the triangle don't cross it (they can only touch its edges)
+  if (std::abs(det) < 1e-15)
+    return false;
+
+  // points exactly on shared edges count for both triangles, so the mesh has no holes
+  const auto tolerance = 1e-9;
+  const auto invDet = 1.0 / det;
+  const Eigen::Vector3d ao = origin - a;
+  const auto u = ao.dot(p) * invDet;
+  if (u < -tolerance || u > 1.0 + tolerance)
+    return false;
+
+  const Eigen::Vector3d q = ao.cross(ab);
+  const auto v = direction.dot(q) * invDet;
+  if (v < -tolerance || u + v > 1.0 + tolerance)
+    return false;
+
+  const auto t = ac.dot(q) * invDet;
+  return t > 0.0 && t <= length;
+}
+
+}
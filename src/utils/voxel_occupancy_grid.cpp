@@ -0,0 +1,165 @@
+#include <robot_body_filter/utils/voxel_occupancy_grid.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <Eigen/Geometry>
+
+#include <ros/console.h>
+
+namespace robot_body_filter
+{
+
+constexpr size_t VoxelOccupancyGrid::MAX_VOXELS;
+
+namespace
+{
+/**
+ * \brief Interval of x coordinates along a column of voxels.
+ */
+struct Interval
+{
+  double min = -std::numeric_limits<double>::infinity();
+  double max = std::numeric_limits<double>::infinity();
+
+  /**
+   * \brief Intersect the interval with the half-line {x : a * x <= b}.
+   */
+  void clip(const double a, const double b)
+  {
+    if (a > 0.0)
+      this->max = std::min(this->max, b / a);
+    else if (a < 0.0)
+      this->min = std::max(this->min, b / a);
+    else if (b < 0.0)
+      this->max = -std::numeric_limits<double>::infinity();
+  }
+};
+}
+
+VoxelOccupancyGrid::VoxelOccupancyGrid(const bodies::ConvexMesh& body, double resolution)
+{
+  // containsPoint() tests the point against the padded bounding box of the mesh and against the mesh planes
+  // moved outwards by the padding in the unscaled mesh frame; both are half-spaces in the body frame
+  const auto localBody = body.cloneAt(Eigen::Isometry3d::Identity());
+  bodies::AxisAlignedBoundingBox box;
+  localBody->computeBoundingBox(box);
+  bodies::BoundingSphere boundingSphere;
+  localBody->computeBoundingSphere(boundingSphere);
+  const Eigen::Vector3d& meshCenter = boundingSphere.center;
+  const auto scale = body.getScale();
+  const auto padding = body.getPadding();
+
+  EigenSTL::vector_Vector3d normals;
+  std::vector<double> offsets;  // the body is {q : normal.dot(q) <= offset} for all half-spaces
+  for (const auto& plane : body.getPlanes())
+  {
+    const Eigen::Vector3d normal = plane.head<3>();
+    normals.push_back(normal);
+    offsets.push_back(scale * (padding + 1e-6 - plane.w() - normal.dot(meshCenter)) + normal.dot(meshCenter));
+  }
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    normals.push_back(Eigen::Vector3d::Unit(axis));
+    offsets.push_back(box.max()[axis]);
+    normals.push_back(-Eigen::Vector3d::Unit(axis));
+    offsets.push_back(-box.min()[axis]);
+  }
+
+  // covers rounding errors of containsPoint(), voxels closer to the surface are just marked as SURFACE
+  const auto tolerance = 1e-5 * std::max(1.0, scale);
+
+  // there is at least one OUTSIDE voxel around the body, so points out of the grid are outside
+  const Eigen::Vector3d extent = box.sizes();
+  const auto numVoxels = ((extent / resolution).array() + 3.0).prod();
+  if (numVoxels > static_cast<double>(MAX_VOXELS))
+  {
+    const auto coarserResolution = resolution * std::cbrt(numVoxels / static_cast<double>(MAX_VOXELS)) * 1.01;
+    ROS_WARN("Voxel grid of a mesh with resolution %f m would be too large. Using resolution %f m instead.",
+             resolution, coarserResolution);
+    resolution = coarserResolution;
+  }
+
+  this->resolution = resolution;
+  this->size = ((extent / resolution).array().ceil() + 2.0).cast<int>();
+  this->origin = box.min() - Eigen::Vector3d::Constant(resolution);
+
+  const auto totalVoxels = static_cast<size_t>(this->size.prod());
+  this->insideBitmap.assign((totalVoxels + 63) / 64, 0);
+  this->surfaceBitmap.assign((totalVoxels + 63) / 64, 0);
+
+  // The body is convex, so in each column of voxels along the x axis, the x coordinates where the whole
+  // cross-section of the column is inside all half-spaces form an interval, and so do the x coordinates where
+  // the cross-section touches each of them. Voxels within the first interval are INSIDE, voxels out of the
+  // second one are OUTSIDE, and only the voxels in between can contain a part of the surface.
+  for (int z = 0; z < this->size.z(); ++z)
+  {
+    const auto zMin = this->origin.z() + z * resolution;
+    const auto zMax = zMin + resolution;
+    for (int y = 0; y < this->size.y(); ++y)
+    {
+      const auto yMin = this->origin.y() + y * resolution;
+      const auto yMax = yMin + resolution;
+
+      Interval inside, touched;
+      for (size_t i = 0; i < normals.size(); ++i)
+      {
+        const auto& n = normals[i];
+        const auto nearest = n.y() * (n.y() > 0.0 ? yMin : yMax) + n.z() * (n.z() > 0.0 ? zMin : zMax);
+        const auto farthest = n.y() * (n.y() > 0.0 ? yMax : yMin) + n.z() * (n.z() > 0.0 ? zMax : zMin);
+        inside.clip(n.x(), offsets[i] - farthest - tolerance);
+        touched.clip(n.x(), offsets[i] - nearest + tolerance);
+      }
+
+      for (int x = 0; x < this->size.x(); ++x)
+      {
+        const auto xMin = this->origin.x() + x * resolution;
+        const auto xMax = xMin + resolution;
+        const auto index = this->getIndex(x, y, z);
+        if (inside.min <= xMin && xMax <= inside.max)
+          this->insideBitmap[index / 64] |= std::uint64_t(1) << (index % 64);
+        else if (xMax >= touched.min && xMin <= touched.max)
+          this->surfaceBitmap[index / 64] |= std::uint64_t(1) << (index % 64);
+      }
+    }
+  }
+}
+
+VoxelOccupancyGrid::Occupancy VoxelOccupancyGrid::getOccupancy(const Eigen::Vector3d& point) const
+{
+  const Eigen::Vector3d voxel = (point - this->origin) / this->resolution;
+  // written so that NaNs end up outside
+  if (!(voxel.x() >= 0.0 && voxel.y() >= 0.0 && voxel.z() >= 0.0 &&
+    voxel.x() < this->size.x() && voxel.y() < this->size.y() && voxel.z() < this->size.z()))
+    return Occupancy::OUTSIDE;
+
+  const auto index = this->getIndex(static_cast<int>(voxel.x()), static_cast<int>(voxel.y()),
+                                    static_cast<int>(voxel.z()));
+  if (isSet(this->surfaceBitmap, index))
+    return Occupancy::SURFACE;
+  return isSet(this->insideBitmap, index) ? Occupancy::INSIDE : Occupancy::OUTSIDE;
+}
+
+double VoxelOccupancyGrid::getResolution() const
+{
+  return this->resolution;
+}
+
+const Eigen::Vector3i& VoxelOccupancyGrid::getSize() const
+{
+  return this->size;
+}
+
+size_t VoxelOccupancyGrid::getIndex(const int x, const int y, const int z) const
+{
+  return static_cast<size_t>(x) + static_cast<size_t>(this->size.x()) *
+    (static_cast<size_t>(y) + static_cast<size_t>(this->size.y()) * static_cast<size_t>(z));
+}
+
+bool VoxelOccupancyGrid::isSet(const std::vector<std::uint64_t>& bitmap, const size_t index)
+{
+  return (bitmap[index / 64] >> (index % 64)) & 1u;
+}
+
+}
@@ -0,0 +1,98 @@
+#include "gtest/gtest.h"
+
+#include <set>
+
+#include <robot_body_filter/utils/bounding_volume_hierarchy.h>
+
+using namespace robot_body_filter;
+
+class TestHierarchy : public BoundingVolumeHierarchy
+{
+public:
+  using BoundingVolumeHierarchy::segmentCrossesBox;
+  using BoundingVolumeHierarchy::nodes;
+};
+
+TEST(BoundingVolumeHierarchy, SegmentCrossesBox)
+{
+  const TestHierarchy::Box box(Eigen::Vector3d(-1, -1, -1), Eigen::Vector3d(1, 1, 1));
+
+  // segment starting inside
+  EXPECT_TRUE(TestHierarchy::segmentCrossesBox({0, 0, 0}, {1, 0, 0}, 0.1, box));
+  // segment going through
+  EXPECT_TRUE(TestHierarchy::segmentCrossesBox({-2, 0, 0}, {1, 0, 0}, 4, box));
+  EXPECT_TRUE(TestHierarchy::segmentCrossesBox({-2, -2, -2}, {1, 1, 1}, 4, box));
+  // segment too short
+  EXPECT_FALSE(TestHierarchy::segmentCrossesBox({-2, 0, 0}, {1, 0, 0}, 0.9, box));
+  // segment pointing away
+  EXPECT_FALSE(TestHierarchy::segmentCrossesBox({-2, 0, 0}, {-1, 0, 0}, 10, box));
+  // segment parallel to a face outside of the box
+  EXPECT_FALSE(TestHierarchy::segmentCrossesBox({-2, 2, 0}, {1, 0, 0}, 10, box));
+  // segment parallel to a face inside of the box
+  EXPECT_TRUE(TestHierarchy::segmentCrossesBox({-2, 0.5, 0}, {1, 0, 0}, 10, box));
+  // segment passing by a corner
+  EXPECT_FALSE(TestHierarchy::segmentCrossesBox({-2, 0, 0}, {1, 1.1, 0}, 10, box));
+  // empty box
+  EXPECT_FALSE(TestHierarchy::segmentCrossesBox({0, 0, 0}, {1, 0, 0}, 10, TestHierarchy::Box()));
+}
+
+TEST(BoundingVolumeHierarchy, Empty)
+{
+  TestHierarchy bvh;
+  EXPECT_TRUE(bvh.empty());
+  EXPECT_EQ(0, bvh.size());
+
+  size_t numTests = 0;
+  EXPECT_FALSE(bvh.anySegmentHit({0, 0, 0}, {1, 0, 0}, 10, [&](size_t) { numTests++; return true; }));
+  EXPECT_EQ(0, numTests);
+}
+
+TEST(BoundingVolumeHierarchy, AnySegmentHit)
+{
+  std::vector<TestHierarchy::Box> boxes;
+  for (size_t i = 0; i < 100; ++i)
+  {
+    const Eigen::Vector3d center = Eigen::Vector3d::Random() * 5;
+    const Eigen::Vector3d halfExtents = (Eigen::Vector3d::Random().array() + 1.1).matrix() * 0.3;
+    boxes.emplace_back(center - halfExtents, center + halfExtents);
+  }
+
+  TestHierarchy bvh;
+  bvh.build(boxes);
+  EXPECT_FALSE(bvh.empty());
+  EXPECT_EQ(boxes.size(), bvh.size());
+  EXPECT_TRUE(bvh.nodes[0].box.contains(boxes[0]));
+
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    const Eigen::Vector3d origin = Eigen::Vector3d::Random() * 6;
+    const Eigen::Vector3d direction = Eigen::Vector3d::Random().normalized();
+    const double length = (Eigen::Vector2d::Random()[0] + 1) * 5;
+
+    std::set<size_t> expected;
+    for (size_t j = 0; j < boxes.size(); ++j)
+      if (TestHierarchy::segmentCrossesBox(origin, direction, length, boxes[j]))
+        expected.insert(j);
+
+    // all items crossed by the segment are tested exactly once and no other items are tested
+    std::multiset<size_t> tested;
+    EXPECT_FALSE(bvh.anySegmentHit(origin, direction, length,
+      [&](size_t item) { tested.insert(item); return false; }));
+    EXPECT_EQ(std::multiset<size_t>(expected.begin(), expected.end()), tested);
+
+    // the search stops at the first successful test
+    size_t numTests = 0;
+    EXPECT_EQ(!expected.empty(), bvh.anySegmentHit(origin, direction, length,
+      [&](size_t) { numTests++; return true; }));
+    EXPECT_EQ(expected.empty() ? 0 : 1, numTests);
+  }
+
+  bvh.clear();
+  EXPECT_TRUE(bvh.empty());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
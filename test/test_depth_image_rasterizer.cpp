@@ -0,0 +1,194 @@
+#include "gtest/gtest.h"
+
+#include <robot_body_filter/utils/depth_image_rasterizer.h>
+
+using namespace robot_body_filter;
+
+namespace
+{
+
+DepthCamera createCamera()
+{
+  DepthCamera camera;
+  camera.width = 64;
+  camera.height = 48;
+  camera.fx = camera.fy = 50.0;
+  camera.cx = 31.5;
+  camera.cy = 23.5;
+  return camera;
+}
+
+// axis-aligned box with the given center and half extents
+void createBox(const Eigen::Vector3d& center, const Eigen::Vector3d& halfExtents,
+               EigenSTL::vector_Vector3d& vertices, std::vector<unsigned int>& triangles)
+{
+  vertices.clear();
+  for (int i = 0; i < 8; ++i)
+    vertices.emplace_back(center + Eigen::Vector3d(i & 1 ? 1 : -1, i & 2 ? 1 : -1, i & 4 ? 1 : -1)
+      .cwiseProduct(halfExtents));
+
+  triangles = {
+    0, 2, 1, 1, 2, 3,  // -z
+    4, 5, 6, 5, 7, 6,  // +z
+    0, 1, 4, 1, 5, 4,  // -y
+    2, 6, 3, 3, 6, 7,  // +y
+    0, 4, 2, 2, 4, 6,  // -x
+    1, 3, 5, 3, 7, 5,  // +x
+  };
+}
+
+// entry and exit depths of the ray z * dir in the axis-aligned box
+bool intersectBox(const Eigen::Vector3d& dir, const Eigen::Vector3d& min, const Eigen::Vector3d& max,
+                  double& entry, double& exit)
+{
+  entry = 0.0;
+  exit = std::numeric_limits<double>::infinity();
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    if (dir[axis] == 0.0)
+    {
+      if (0.0 < min[axis] || 0.0 > max[axis])
+        return false;
+      continue;
+    }
+    auto t1 = min[axis] / dir[axis];
+    auto t2 = max[axis] / dir[axis];
+    if (t1 > t2)
+      std::swap(t1, t2);
+    entry = std::max(entry, t1);
+    exit = std::min(exit, t2);
+  }
+  return entry <= exit;
+}
+
+}
+
+TEST(DepthImageRasterizer, GetPixel)
+{
+  const DepthImageRasterizer rasterizer(createCamera());
+
+  size_t pixel;
+  ASSERT_TRUE(rasterizer.getPixel({0.0, 0.0, 1.0}, pixel));
+  EXPECT_EQ(24u * 64u + 32u, pixel);  // the principal point is on the boundary of pixels, rounded up
+  ASSERT_TRUE(rasterizer.getPixel({-31.5 / 50.0, -23.5 / 50.0, 1.0}, pixel));
+  EXPECT_EQ(0u, pixel);
+  ASSERT_TRUE(rasterizer.getPixel({2 * 31.5 / 50.0, 2 * 23.5 / 50.0, 2.0}, pixel));
+  EXPECT_EQ(64u * 48u - 1u, pixel);
+
+  EXPECT_FALSE(rasterizer.getPixel({0.0, 0.0, -1.0}, pixel));
+  EXPECT_FALSE(rasterizer.getPixel({0.0, 0.0, 0.0}, pixel));
+  EXPECT_FALSE(rasterizer.getPixel({10.0, 0.0, 1.0}, pixel));
+  EXPECT_FALSE(rasterizer.getPixel({0.0, NAN, 1.0}, pixel));
+
+  // the pixel ray passes through the points seen by the pixel
+  for (const auto& point : {Eigen::Vector3d(0.1, 0.2, 1.0), Eigen::Vector3d(-0.5, 0.3, 2.0)})
+  {
+    ASSERT_TRUE(rasterizer.getPixel(point, pixel));
+    const Eigen::Vector3d ray = rasterizer.getPixelRay(pixel) * point.z();
+    EXPECT_NEAR(point.x(), ray.x(), 0.5 * point.z() / 50.0);
+    EXPECT_NEAR(point.y(), ray.y(), 0.5 * point.z() / 50.0);
+    EXPECT_DOUBLE_EQ(point.z(), ray.z());
+  }
+}
+
+TEST(DepthImageRasterizer, SphereScreenBox)
+{
+  const DepthImageRasterizer rasterizer(createCamera());
+
+  Eigen::Vector2i minPixel, maxPixel;
+  ASSERT_TRUE(rasterizer.getSphereScreenBox({0.0, 0.0, 2.0}, 0.2, minPixel, maxPixel));
+  EXPECT_LE(minPixel.x(), maxPixel.x());
+  EXPECT_LE(minPixel.y(), maxPixel.y());
+
+  // all pixels seeing the sphere are in the box
+  for (size_t pixel = 0; pixel < 64 * 48; ++pixel)
+  {
+    const Eigen::Vector3d dir = rasterizer.getPixelRay(pixel).normalized();
+    const Eigen::Vector3d closest = dir * dir.dot(Eigen::Vector3d(0.0, 0.0, 2.0));
+    if ((closest - Eigen::Vector3d(0.0, 0.0, 2.0)).norm() > 0.2)
+      continue;
+    const int u = static_cast<int>(pixel % 64), v = static_cast<int>(pixel / 64);
+    EXPECT_LE(minPixel.x(), u);
+    EXPECT_GE(maxPixel.x(), u);
+    EXPECT_LE(minPixel.y(), v);
+    EXPECT_GE(maxPixel.y(), v);
+  }
+
+  // out of the image
+  ASSERT_TRUE(rasterizer.getSphereScreenBox({10.0, 0.0, 1.0}, 0.1, minPixel, maxPixel));
+  EXPECT_GT(minPixel.x(), maxPixel.x());
+
+  // crossing the near plane
+  EXPECT_FALSE(rasterizer.getSphereScreenBox({0.0, 0.0, 0.1}, 0.2, minPixel, maxPixel));
+}
+
+TEST(DepthImageRasterizer, RasterizeBox)
+{
+  DepthImageRasterizer rasterizer(createCamera());
+
+  const Eigen::Vector3d center(0.1, -0.05, 1.5);
+  const Eigen::Vector3d halfExtents(0.2, 0.15, 0.3);
+  EigenSTL::vector_Vector3d vertices;
+  std::vector<unsigned int> triangles;
+  createBox(center, halfExtents, vertices, triangles);
+
+  std::vector<std::pair<float, float>> depths(64 * 48, {NAN, NAN});
+  ASSERT_TRUE(rasterizer.rasterizeConvexMesh(vertices, triangles,
+    [&](const size_t pixel, const float entry, const float exit)
+    {
+      EXPECT_TRUE(std::isnan(depths[pixel].first)) << "pixel " << pixel << " reported twice";
+      depths[pixel] = {entry, exit};
+    }));
+
+  size_t numCovered = 0;
+  for (size_t pixel = 0; pixel < 64 * 48; ++pixel)
+  {
+    double entry, exit;
+    const auto hit = intersectBox(rasterizer.getPixelRay(pixel), center - halfExtents, center + halfExtents,
+                                  entry, exit);
+    const auto covered = !std::isnan(depths[pixel].first);
+    // pixel centers exactly on the silhouette may be reported either way
+    if (hit && exit - entry < 1e-6)
+      continue;
+    EXPECT_EQ(hit, covered) << "pixel " << pixel;
+    if (hit && covered)
+    {
+      EXPECT_NEAR(entry, depths[pixel].first, 1e-5);
+      EXPECT_NEAR(exit, depths[pixel].second, 1e-5);
+      ++numCovered;
+    }
+  }
+  EXPECT_LT(100u, numCovered);
+
+  // the scratch buffers are cleared, so rasterizing another mesh does not see the first one
+  createBox({-0.5, 0.0, 2.0}, {0.05, 0.05, 0.05}, vertices, triangles);
+  numCovered = 0;
+  ASSERT_TRUE(rasterizer.rasterizeConvexMesh(vertices, triangles,
+    [&](const size_t pixel, const float entry, const float exit)
+    {
+      EXPECT_LE(1.95 - 1e-5, entry);
+      EXPECT_GE(2.05 + 1e-5, exit);
+      ++numCovered;
+    }));
+  EXPECT_LT(0u, numCovered);
+}
+
+TEST(DepthImageRasterizer, NearPlane)
+{
+  DepthImageRasterizer rasterizer(createCamera());
+
+  EigenSTL::vector_Vector3d vertices;
+  std::vector<unsigned int> triangles;
+  createBox({0.0, 0.0, 0.1}, {0.2, 0.2, 0.2}, vertices, triangles);
+
+  bool called = false;
+  EXPECT_FALSE(rasterizer.rasterizeConvexMesh(vertices, triangles,
+    [&](size_t, float, float) { called = true; }));
+  EXPECT_FALSE(called);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
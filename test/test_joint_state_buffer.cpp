@@ -0,0 +1,183 @@
+#include "gtest/gtest.h"
+
+#include <robot_body_filter/utils/joint_state_buffer.h>
+
+using namespace robot_body_filter;
+
+namespace
+{
+
+sensor_msgs::JointState createJointState(const double stamp, const std::vector<std::string>& names,
+                                         const std::vector<double>& positions)
+{
+  sensor_msgs::JointState jointState;
+  jointState.header.stamp = ros::Time(stamp);
+  jointState.name = names;
+  jointState.position = positions;
+  return jointState;
+}
+
+}
+
+TEST(JointStateBuffer, Interpolate)
+{
+  JointStateBuffer buffer;
+  buffer.add(createJointState(1.0, {"a", "b"}, {0.0, 1.0}));
+  buffer.add(createJointState(2.0, {"a", "b"}, {1.0, -1.0}));
+  buffer.add(createJointState(4.0, {"a", "b"}, {2.0, -1.0}));
+
+  std::vector<double> positions;
+  ASSERT_TRUE(buffer.getPositions(ros::Time(1.0), {"a", "b"}, positions));
+  ASSERT_EQ(2u, positions.size());
+  EXPECT_DOUBLE_EQ(0.0, positions[0]);
+  EXPECT_DOUBLE_EQ(1.0, positions[1]);
+
+  ASSERT_TRUE(buffer.getPositions(ros::Time(1.25), {"b", "a"}, positions));
+  EXPECT_DOUBLE_EQ(0.5, positions[0]);
+  EXPECT_DOUBLE_EQ(0.25, positions[1]);
+
+  ASSERT_TRUE(buffer.getPositions(ros::Time(3.0), {"a"}, positions));
+  ASSERT_EQ(1u, positions.size());
+  EXPECT_DOUBLE_EQ(1.5, positions[0]);
+
+  ASSERT_TRUE(buffer.getPositions(ros::Time(4.0), {"a", "b"}, positions));
+  EXPECT_DOUBLE_EQ(2.0, positions[0]);
+  EXPECT_DOUBLE_EQ(-1.0, positions[1]);
+
+  // no extrapolation
+  EXPECT_FALSE(buffer.getPositions(ros::Time(0.5), {"a"}, positions));
+  EXPECT_FALSE(buffer.getPositions(ros::Time(4.5), {"a"}, positions));
+  // unknown joint
+  EXPECT_FALSE(buffer.getPositions(ros::Time(2.0), {"a", "c"}, positions));
+
+  buffer.clear();
+  EXPECT_FALSE(buffer.getPositions(ros::Time(2.0), {"a"}, positions));
+}
+
+TEST(JointStateBuffer, MultiplePublishers)
+{
+  JointStateBuffer buffer;
+  buffer.add(createJointState(1.0, {"arm"}, {0.0}));
+  buffer.add(createJointState(1.5, {"wheel"}, {10.0}));
+  buffer.add(createJointState(2.0, {"arm"}, {1.0}));
+  buffer.add(createJointState(2.5, {"wheel"}, {11.0}));
+
+  std::vector<double> positions;
+  ASSERT_TRUE(buffer.getPositions(ros::Time(1.75), {"arm", "wheel"}, positions));
+  EXPECT_DOUBLE_EQ(0.75, positions[0]);
+  EXPECT_DOUBLE_EQ(10.25, positions[1]);
+
+  // each joint only covers its own history
+  EXPECT_FALSE(buffer.getPositions(ros::Time(1.25), {"arm", "wheel"}, positions));
+  EXPECT_FALSE(buffer.getPositions(ros::Time(2.25), {"arm", "wheel"}, positions));
+
+  // messages without positions are ignored
+  sensor_msgs::JointState velocities;
+  velocities.header.stamp = ros::Time(3.0);
+  velocities.name = {"arm"};
+  velocities.velocity = {1.0};
+  buffer.add(velocities);
+  EXPECT_FALSE(buffer.getPositions(ros::Time(2.5), {"arm"}, positions));
+}
+
+TEST(JointStateBuffer, OutOfOrder)
+{
+  JointStateBuffer buffer;
+  buffer.add(createJointState(1.0, {"a"}, {0.0}));
+  buffer.add(createJointState(3.0, {"a"}, {2.0}));
+  buffer.add(createJointState(2.0, {"a"}, {4.0}));
+  // a message with the same stamp replaces the previous one
+  buffer.add(createJointState(3.0, {"a"}, {6.0}));
+
+  std::vector<double> positions;
+  ASSERT_TRUE(buffer.getPositions(ros::Time(1.5), {"a"}, positions));
+  EXPECT_DOUBLE_EQ(2.0, positions[0]);
+  ASSERT_TRUE(buffer.getPositions(ros::Time(2.5), {"a"}, positions));
+  EXPECT_DOUBLE_EQ(5.0, positions[0]);
+}
+
+TEST(JointStateBuffer, Length)
+{
+  JointStateBuffer buffer(ros::Duration(2.0));
+  for (size_t i = 0; i < 10; ++i)
+    buffer.add(createJointState(1.0 + i, {"a"}, {static_cast<double>(i)}));
+
+  std::vector<double> positions;
+  EXPECT_FALSE(buffer.getPositions(ros::Time(7.5), {"a"}, positions));
+  ASSERT_TRUE(buffer.getPositions(ros::Time(8.5), {"a"}, positions));
+  EXPECT_DOUBLE_EQ(7.5, positions[0]);
+}
+
+TEST(JointStateBuffer, Hold)
+{
+  JointStateBuffer buffer;
+  buffer.add(createJointState(1.0, {"a"}, {0.0}));
+  buffer.add(createJointState(2.0, {"a"}, {1.0}));
+
+  std::vector<double> positions;
+  EXPECT_FALSE(buffer.getPositions(ros::Time(2.05), {"a"}, positions));
+
+  buffer.setHoldDuration(ros::Duration(0.1));
+  ASSERT_TRUE(buffer.getPositions(ros::Time(2.05), {"a"}, positions));
+  EXPECT_DOUBLE_EQ(1.0, positions[0]);
+  ASSERT_TRUE(buffer.getPositions(ros::Time(2.1), {"a"}, positions));
+  EXPECT_DOUBLE_EQ(1.0, positions[0]);
+  EXPECT_FALSE(buffer.getPositions(ros::Time(2.15), {"a"}, positions));
+  // the positions are only held forward in time
+  EXPECT_FALSE(buffer.getPositions(ros::Time(0.95), {"a"}, positions));
+
+  // interpolation is not affected
+  ASSERT_TRUE(buffer.getPositions(ros::Time(1.5), {"a"}, positions));
+  EXPECT_DOUBLE_EQ(0.5, positions[0]);
+}
+
+TEST(JointStateBuffer, ContinuousJoints)
+{
+  JointStateBuffer buffer;
+  buffer.setContinuousJoints({"wheel"});
+  buffer.add(createJointState(1.0, {"wheel", "arm"}, {M_PI - 0.1, M_PI - 0.1}));
+  buffer.add(createJointState(2.0, {"wheel", "arm"}, {-M_PI + 0.1, -M_PI + 0.1}));
+
+  std::vector<double> positions;
+  ASSERT_TRUE(buffer.getPositions(ros::Time(1.25), {"wheel", "arm"}, positions));
+  // the wheel goes through pi, the arm through 0
+  EXPECT_NEAR(M_PI - 0.05, positions[0], 1e-9);
+  EXPECT_NEAR(M_PI / 2 - 0.05, positions[1], 1e-9);
+
+  ASSERT_TRUE(buffer.getPositions(ros::Time(1.75), {"wheel"}, positions));
+  EXPECT_NEAR(M_PI + 0.05, positions[0], 1e-9);
+
+  // the newest position is reported as it came
+  ASSERT_TRUE(buffer.getPositions(ros::Time(2.0), {"wheel"}, positions));
+  EXPECT_DOUBLE_EQ(-M_PI + 0.1, positions[0]);
+}
+
+TEST(JointStateBuffer, PartialPositions)
+{
+  JointStateBuffer buffer;
+  buffer.add(createJointState(1.0, {"a", "b"}, {0.0, 1.0}));
+  buffer.add(createJointState(2.0, {"a"}, {1.0}));
+
+  std::vector<double> positions;
+  std::vector<std::uint8_t> found;
+  EXPECT_EQ(1u, buffer.getPositions(ros::Time(1.5), {"b", "c", "a"}, positions, found));
+  ASSERT_EQ(3u, positions.size());
+  ASSERT_EQ(3u, found.size());
+  EXPECT_FALSE(found[0]);
+  EXPECT_FALSE(found[1]);
+  EXPECT_TRUE(found[2]);
+  EXPECT_DOUBLE_EQ(0.5, positions[2]);
+
+  EXPECT_EQ(2u, buffer.getPositions(ros::Time(1.0), {"b", "c", "a"}, positions, found));
+  EXPECT_TRUE(found[0]);
+  EXPECT_FALSE(found[1]);
+  EXPECT_TRUE(found[2]);
+  EXPECT_DOUBLE_EQ(1.0, positions[0]);
+  EXPECT_DOUBLE_EQ(0.0, positions[2]);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,129 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <map>
+#include <memory>
+
+#include <geometric_shapes/bodies.h>
+#include <geometric_shapes/mesh_operations.h>
+#include <robot_body_filter/utils/mesh_simplification.h>
+
+using namespace robot_body_filter;
+
+namespace
+{
+
+// UV sphere with the given number of rings and segments
+void createSphere(const double radius, const unsigned int rings, const unsigned int segments,
+                  EigenSTL::vector_Vector3d& vertices, std::vector<unsigned int>& triangles)
+{
+  vertices.emplace_back(0.0, 0.0, radius);
+  for (unsigned int r = 1; r < rings; ++r)
+  {
+    const auto theta = M_PI * r / rings;
+    for (unsigned int s = 0; s < segments; ++s)
+    {
+      const auto phi = 2 * M_PI * s / segments;
+      vertices.emplace_back(radius * std::sin(theta) * std::cos(phi), radius * std::sin(theta) * std::sin(phi),
+                            radius * std::cos(theta));
+    }
+  }
+  vertices.emplace_back(0.0, 0.0, -radius);
+
+  const auto ringVertex = [&](const unsigned int r, const unsigned int s) { return 1 + (r - 1) * segments + s % segments; };
+  const auto last = static_cast<unsigned int>(vertices.size() - 1);
+  for (unsigned int s = 0; s < segments; ++s)
+  {
+    triangles.insert(triangles.end(), {0, ringVertex(1, s), ringVertex(1, s + 1)});
+    for (unsigned int r = 1; r + 1 < rings; ++r)
+    {
+      triangles.insert(triangles.end(), {ringVertex(r, s), ringVertex(r + 1, s), ringVertex(r + 1, s + 1)});
+      triangles.insert(triangles.end(), {ringVertex(r, s), ringVertex(r + 1, s + 1), ringVertex(r, s + 1)});
+    }
+    triangles.insert(triangles.end(), {last, ringVertex(rings - 1, s + 1), ringVertex(rings - 1, s)});
+  }
+}
+
+// each directed edge has to be used exactly once and its reverse once
+void expectClosedManifold(const std::vector<unsigned int>& triangles)
+{
+  std::map<std::pair<unsigned int, unsigned int>, size_t> edges;
+  for (size_t t = 0; t + 2 < triangles.size(); t += 3)
+    for (size_t i = 0; i < 3; ++i)
+      edges[{triangles[t + i], triangles[t + (i + 1) % 3]}]++;
+
+  for (const auto& edge : edges)
+  {
+    EXPECT_EQ(1u, edge.second);
+    EXPECT_EQ(1u, edges.count({edge.first.second, edge.first.first}));
+  }
+}
+
+}
+
+TEST(MeshSimplification, Sphere)
+{
+  EigenSTL::vector_Vector3d vertices;
+  std::vector<unsigned int> triangles;
+  createSphere(0.5, 60, 80, vertices, triangles);
+
+  size_t lastNumTriangles = triangles.size();
+  for (const auto maxError : {0.001, 0.005, 0.02})
+  {
+    EigenSTL::vector_Vector3d simplifiedVertices;
+    std::vector<unsigned int> simplifiedTriangles;
+    const auto error = simplifyMesh(vertices, triangles, maxError, simplifiedVertices, simplifiedTriangles);
+    EXPECT_LE(error, maxError);
+    EXPECT_LT(simplifiedTriangles.size(), lastNumTriangles);
+    lastNumTriangles = simplifiedTriangles.size();
+    expectClosedManifold(simplifiedTriangles);
+
+    // the simplified sphere padded by the error contains the original one
+    const std::unique_ptr<shapes::Mesh> mesh(shapes::createMeshFromVertices(simplifiedVertices, simplifiedTriangles));
+    bodies::ConvexMesh body(mesh.get());
+    body.setPadding(error + 1e-9);
+    for (const auto& vertex : vertices)
+      EXPECT_TRUE(body.containsPoint(vertex)) << vertex.transpose() << ", max error " << maxError;
+  }
+  EXPECT_GT(triangles.size() / 5, lastNumTriangles);
+}
+
+TEST(MeshSimplification, ZeroError)
+{
+  EigenSTL::vector_Vector3d vertices;
+  std::vector<unsigned int> triangles;
+  createSphere(0.5, 10, 20, vertices, triangles);
+
+  EigenSTL::vector_Vector3d simplifiedVertices;
+  std::vector<unsigned int> simplifiedTriangles;
+  EXPECT_EQ(0.0, simplifyMesh(vertices, triangles, 0.0, simplifiedVertices, simplifiedTriangles));
+  EXPECT_EQ(vertices.size(), simplifiedVertices.size());
+  EXPECT_EQ(triangles, simplifiedTriangles);
+}
+
+TEST(MeshSimplification, BoxIsNotDeformed)
+{
+  // box (1.0, 2.0, 3.0)
+  const std::unique_ptr<const shapes::Shape> shape(shapes::createMeshFromResource(
+      "package://robot_body_filter/test/box.dae"));
+  const auto& mesh = static_cast<const shapes::Mesh&>(*shape);
+
+  // the faces of a box are flat, so it can only lose duplicate vertices
+  double error;
+  const std::unique_ptr<shapes::Mesh> simplified(simplifyMesh(mesh, 0.01, error));
+  EXPECT_NEAR(0.0, error, 1e-9);
+  EXPECT_EQ(8u, simplified->vertex_count);
+  EXPECT_EQ(12u, simplified->triangle_count);
+  for (unsigned int v = 0; v < simplified->vertex_count; ++v)
+  {
+    EXPECT_NEAR(0.5, std::abs(simplified->vertices[3 * v]), 1e-9);
+    EXPECT_NEAR(1.0, std::abs(simplified->vertices[3 * v + 1]), 1e-9);
+    EXPECT_NEAR(1.5, std::abs(simplified->vertices[3 * v + 2]), 1e-9);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+
+#include <robot_body_filter/utils/pose_keyframe_table.h>
+
+using namespace robot_body_filter;
+
+namespace
+{
+
+Eigen::Isometry3d pose(const double x, const double angle)
+{
+  return Eigen::Translation3d(x, 2.0, 3.0) * Eigen::AngleAxisd(angle, Eigen::Vector3d::UnitZ());
+}
+
+void expectPoseNear(const Eigen::Isometry3d& expected, const Eigen::Isometry3d& actual)
+{
+  EXPECT_TRUE(expected.isApprox(actual, 1e-9)) << expected.matrix() << "\n" << actual.matrix();
+}
+
+}
+
+TEST(PoseKeyframeTable, Validity)
+{
+  PoseKeyframeTable table;
+  table.reset(2, 3);
+  EXPECT_EQ(2u, table.getNumRows());
+  EXPECT_EQ(3u, table.getNumKeyframes());
+  EXPECT_FALSE(table.isValid(0));
+  EXPECT_FALSE(table.isValid(1));
+
+  Eigen::Isometry3d result = pose(5.0, 0.0);
+  table.setKeyframe(0, 0, pose(0.0, 0.0));
+  table.setKeyframe(0, 0, pose(0.0, 0.0));
+  table.setKeyframe(0, 2, pose(2.0, 0.0));
+  EXPECT_FALSE(table.isValid(0));
+  EXPECT_FALSE(table.interpolate(0, 0.5, result));
+  expectPoseNear(pose(5.0, 0.0), result);
+  Eigen::Vector3d translation(5.0, 0.0, 0.0);
+  EXPECT_FALSE(table.interpolateTranslation(0, 0.5, translation));
+  EXPECT_EQ(Eigen::Vector3d(5.0, 0.0, 0.0), translation);
+
+  table.setKeyframe(0, 1, pose(1.0, 0.0));
+  EXPECT_TRUE(table.isValid(0));
+  EXPECT_FALSE(table.isValid(1));
+
+  table.reset(2, 3);
+  EXPECT_FALSE(table.isValid(0));
+}
+
+TEST(PoseKeyframeTable, Interpolate)
+{
+  PoseKeyframeTable table;
+  table.reset(2, 3);
+  EXPECT_DOUBLE_EQ(0.0, table.getKeyframeRatio(0));
+  EXPECT_DOUBLE_EQ(0.5, table.getKeyframeRatio(1));
+  EXPECT_DOUBLE_EQ(1.0, table.getKeyframeRatio(2));
+
+  for (size_t k = 0; k < 3; ++k)
+  {
+    table.setKeyframe(0, k, pose(k, 0.4 * k));
+    table.setKeyframe(1, k, pose(-1.0 * k, -0.2 * k));
+  }
+
+  Eigen::Isometry3d result;
+  ASSERT_TRUE(table.interpolate(0, 0.0, result));
+  expectPoseNear(pose(0.0, 0.0), result);
+  ASSERT_TRUE(table.interpolate(0, 0.25, result));
+  expectPoseNear(pose(0.5, 0.2), result);
+  ASSERT_TRUE(table.interpolate(0, 0.5, result));
+  expectPoseNear(pose(1.0, 0.4), result);
+  ASSERT_TRUE(table.interpolate(0, 0.9, result));
+  expectPoseNear(pose(1.8, 0.72), result);
+  ASSERT_TRUE(table.interpolate(0, 1.0, result));
+  expectPoseNear(pose(2.0, 0.8), result);
+  ASSERT_TRUE(table.interpolate(1, 0.75, result));
+  expectPoseNear(pose(-1.5, -0.3), result);
+
+  Eigen::Vector3d translation;
+  ASSERT_TRUE(table.interpolateTranslation(0, 0.9, translation));
+  EXPECT_TRUE(translation.isApprox(Eigen::Vector3d(1.8, 2.0, 3.0)));
+
+  // the ratio is clamped
+  ASSERT_TRUE(table.interpolate(0, -1.0, result));
+  expectPoseNear(pose(0.0, 0.0), result);
+  ASSERT_TRUE(table.interpolate(0, 2.0, result));
+  expectPoseNear(pose(2.0, 0.8), result);
+}
+
+TEST(PoseKeyframeTable, SingleKeyframe)
+{
+  PoseKeyframeTable table;
+  table.reset(1, 1);
+  EXPECT_DOUBLE_EQ(0.0, table.getKeyframeRatio(0));
+  table.setKeyframe(0, 0, pose(1.0, 1.0));
+
+  Eigen::Isometry3d result;
+  ASSERT_TRUE(table.interpolate(0, 0.7, result));
+  expectPoseNear(pose(1.0, 1.0), result);
+}
+
+TEST(PoseKeyframeTable, ShortestRotation)
+{
+  // quaternions of the same rotation can have opposite signs, interpolation has to take the short way
+  PoseKeyframeTable table;
+  table.reset(1, 2);
+  table.setKeyframe(0, 0, pose(0.0, M_PI - 0.1));
+  table.setKeyframe(0, 1, pose(0.0, -M_PI + 0.1));
+
+  Eigen::Isometry3d result;
+  ASSERT_TRUE(table.interpolate(0, 0.5, result));
+  expectPoseNear(pose(0.0, M_PI), result);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 
+#include <thread>
+
 #include <robot_body_filter/RayCastingShapeMask.h>
 #include <robot_body_filter/utils/shapes.h>
 #include <urdf_model/model.h>
@@ -26,6 +28,7 @@ class TestMask : public RayCastingShapeMask
   friend class RayCastingShapeMask_Basic_Test;
   friend class RayCastingShapeMask_Bspheres_Test;
   friend class RayCastingShapeMask_ClassifyPoint_Test;
+  friend class RayCastingShapeMask_MaskBatchedContainsTest_Test;
 };
 
 TEST(RayCastingShapeMask, Basic)
@@ -63,6 +66,7 @@ TEST(RayCastingShapeMask, Basic)
   EXPECT_EQ(0, mask.bspheresBodyIndices.size());
   EXPECT_EQ(0, mask.bspheresForContainsTest.size());
   EXPECT_EQ(0, mask.bspheresForContainsTestBodyIndices.size());
+  EXPECT_EQ(0, mask.bboxesForContainsTest.size());
   EXPECT_EQ(handle.contains, handle.shadow);
 
   mask.setIgnoreInContainsTest({handle});
@@ -159,6 +163,16 @@ TEST(RayCastingShapeMask, Bspheres)
   ASSERT_NE(bspheresContains.end(), bspheresContains.find(handle3Contains));
   ASSERT_EQ(bspheresContains.end(), bspheresContains.find(handle3Shadow));
 
+  // the bounding boxes for contains test belong to the same bodies as bspheresForContainsTest
+  ASSERT_EQ(3, mask.bboxesForContainsTest.size());
+  for (size_t i = 0; i < mask.bboxesForContainsTest.size(); ++i)
+  {
+    const auto body = std::next(mask.bodies_.begin(), mask.bspheresForContainsTestBodyIndices[i])->body;
+    bodies::AxisAlignedBoundingBox box;
+    body->computeBoundingBox(box);
+    EXPECT_TRUE(box.isApprox(mask.bboxesForContainsTest[i]));
+  }
+
   EXPECT_NEAR(sqrt(0.5 * 0.5 + 1.0 * 1.0 + 1.5 * 1.5), bspheres[handle1].radius, 1e-9);
   EXPECT_DOUBLE_EQ(0.0, bspheres[handle1].center.x());
   EXPECT_DOUBLE_EQ(0.0, bspheres[handle1].center.y());
@@ -376,6 +390,58 @@ TEST(RayCastingShapeMask, UpdateBodyPoses)
   expectTransformsDoubleEq(t4, mask.getBodies()[handle2Shadow]->getPose());
 }
 
+TEST(RayCastingShapeMask, UpdateBodyPosesStaticShapes)
+{
+  ros::Time::init();
+  ros::Time::setNow(ros::Time(1));
+
+  size_t numCalled = 0;
+  bool hasTransform = false;
+  Eigen::Isometry3d t1 = randomPose();
+  auto cb = [&](point_containment_filter::ShapeHandle h, Eigen::Isometry3d &t) -> bool
+  {
+    numCalled++;
+    t = t1;
+    return hasTransform;
+  };
+  TestMask mask(cb, 1.0, 10.0, true, true, true);
+
+  shapes::ShapeConstPtr shape1(new shapes::Box(1.0, 2.0, 3.0));
+  const auto multiHandle1 = mask.addShape(shape1, 1.0, 0.0, false, "staticBox");
+  shapes::ShapeConstPtr shape2(new shapes::Sphere(2.0));
+  const auto multiHandle2 = mask.addShape(shape2, 1.0, 0.0, true, "sphere");
+  mask.setStaticShapes({multiHandle1});
+
+  // the static shape is updated until its transform is available for the first time
+  mask.updateBodyPoses();
+  EXPECT_EQ(2, numCalled);
+  hasTransform = true;
+  numCalled = 0;
+  mask.updateBodyPoses();
+  EXPECT_EQ(2, numCalled);
+  expectTransformsDoubleEq(t1, mask.getBodies()[multiHandle1.contains]->getPose());
+  expectTransformsDoubleEq(t1, mask.getBodies()[multiHandle2.contains]->getPose());
+  const auto bsphere1 = mask.getBoundingSpheres()[multiHandle1.contains];
+
+  // then it keeps its pose and bounding sphere
+  const Eigen::Isometry3d t2 = randomPose();
+  t1 = t2;
+  numCalled = 0;
+  mask.updateBodyPoses();
+  EXPECT_EQ(1, numCalled);
+  expectTransformsDoubleEq(t2, mask.getBodies()[multiHandle2.contains]->getPose());
+  EXPECT_NE(t2.translation(), mask.getBodies()[multiHandle1.contains]->getPose().translation());
+  EXPECT_EQ(bsphere1.center, mask.getBoundingSpheres()[multiHandle1.contains].center);
+  EXPECT_EQ(bsphere1.radius, mask.getBoundingSpheres()[multiHandle1.contains].radius);
+
+  // setting the static shapes again makes them update once more
+  mask.setStaticShapes({multiHandle1});
+  numCalled = 0;
+  mask.updateBodyPoses();
+  EXPECT_EQ(2, numCalled);
+  expectTransformsDoubleEq(t2, mask.getBodies()[multiHandle1.contains]->getPose());
+}
+
 TEST(RayCastingShapeMask, ClassifyPoint)
 {
   ros::Time::init();
@@ -842,6 +908,683 @@ TEST(RayCastingShapeMask, Mask)
   EXPECT_EQ(RayCastingShapeMask::MaskValue::OUTSIDE, vals[12]);
 }
 
+TEST(RayCastingShapeMask, MaskBatchedContainsTest)
+{
+  ros::Time::init();
+  ros::Time::setNow(ros::Time(1));
+
+  std::map<point_containment_filter::ShapeHandle, Eigen::Isometry3d> poses;
+  auto cb = [&](point_containment_filter::ShapeHandle h, Eigen::Isometry3d &t) -> bool
+  {
+    if (poses.find(h) == poses.end())
+    {
+      poses[h] = randomPose();
+      poses[h].translation() *= 2.0;
+    }
+    t = poses[h];
+    return true;
+  };
+  TestMask mask(cb, 0.1, 10.0, true, true, true);
+
+  std::vector<MultiShapeHandle> handles;
+  for (size_t i = 0; i < 5; ++i)
+  {
+    handles.push_back(mask.addShape(shapes::ShapeConstPtr(new shapes::Box(0.5, 1.0, 1.5)), 1.1, 0.02, false));
+    handles.push_back(mask.addShape(shapes::ShapeConstPtr(new shapes::Sphere(0.7)), 1.0, 0.05, false));
+    handles.push_back(mask.addShape(shapes::ShapeConstPtr(new shapes::Cylinder(0.3, 1.2)), 0.9, 0.01, false));
+  }
+  auto g = urdf::Mesh();
+  g.scale = {1.0, 2.0, 3.0};
+  g.filename = "package://robot_body_filter/test/box.dae";
+  handles.push_back(mask.addShape(robot_body_filter::constructShape(g), 1.0, 0.0, false, "mesh"));
+  mask.setIgnoreInContainsTest({handles[1]});
+  mask.updateInternalShapeLists();
+  mask.updateBodyPoses();
+
+  // 14 primitive bodies and bounds of the mesh
+  EXPECT_EQ(15, mask.data->batchContainsTest.size());
+  EXPECT_EQ(15, mask.data->batchContainsTestBodies.size());
+
+  const Eigen::Vector3d sensorPos(0.0, 0.0, 0.0);
+
+  // random points around the bodies and points very close to their surfaces
+  EigenSTL::vector_Vector3d points;
+  random_numbers::RandomNumberGenerator rng;
+  Eigen::Vector3d p;
+  for (const auto& body : mask.getBodiesForContainsTest())
+  {
+    const auto center = body.second->getPose().translation();
+    for (size_t i = 0; i < 100; ++i)
+    {
+      while (!body.second->samplePointInside(rng, 10, p)) {}
+      points.push_back(center + 1.5 * (p - center));
+      points.push_back(center + 0.5 * (p - center));
+    }
+    if (body.second->getType() == shapes::SPHERE)
+    {
+      const auto radius = body.second->getDimensions()[0] * body.second->getScale() + body.second->getPadding();
+      for (size_t i = 0; i < 100; ++i)
+        points.push_back(center + Eigen::Vector3d::Random().normalized() * radius);
+    }
+    else if (body.second->getType() == shapes::BOX)
+    {
+      const auto dims = body.second->getDimensions();
+      Eigen::Vector3d halfExtents(dims[0], dims[1], dims[2]);
+      halfExtents = halfExtents * body.second->getScale() / 2 + Eigen::Vector3d::Constant(body.second->getPadding());
+      for (size_t i = 0; i < 100; ++i)
+      {
+        Eigen::Vector3d q = Eigen::Vector3d::Random().cwiseProduct(halfExtents);
+        q[i % 3] = (i % 2 == 0 ? 1 : -1) * halfExtents[i % 3];
+        points.push_back(body.second->getPose() * q);
+      }
+    }
+  }
+  for (size_t i = 0; i < 1000; ++i)
+    points.push_back(Eigen::Vector3d::Random() * 4.0);
+  points.emplace_back(std::numeric_limits<double>::quiet_NaN(), 0, 0);
+
+  Cloud cloud;
+  CloudModifier mod(cloud);
+  mod.setPointCloud2FieldsByString(1, "xyz");
+  mod.resize(points.size());
+  CloudIter it_x(cloud, "x");
+  CloudIter it_y(cloud, "y");
+  CloudIter it_z(cloud, "z");
+  for (const auto& point : points)
+  {
+    *it_x = point.x(); *it_y = point.y(); *it_z = point.z();
+    ++it_x; ++it_y; ++it_z;
+  }
+
+  std::vector<RayCastingShapeMask::MaskValue> vals;
+  mask.maskContainmentAndShadows(cloud, vals, sensorPos);
+  ASSERT_EQ(points.size(), vals.size());
+
+  // the batched test has to give exactly the same results as the exact per-point test
+  RayCastingShapeMask::MaskValue val;
+  size_t numInside = 0;
+  CloudConstIter c_x(cloud, "x");
+  CloudConstIter c_y(cloud, "y");
+  CloudConstIter c_z(cloud, "z");
+  for (size_t i = 0; i < points.size(); ++i, ++c_x, ++c_y, ++c_z)
+  {
+    mask.classifyPointNoLock(Eigen::Vector3d(*c_x, *c_y, *c_z), val, sensorPos);
+    EXPECT_EQ(val, vals[i]) << "Point " << i;
+    if (val == RayCastingShapeMask::MaskValue::INSIDE)
+      numInside++;
+  }
+  EXPECT_LT(0, numInside);
+  EXPECT_GT(points.size(), numInside);
+}
+
+TEST(RayCastingShapeMask, MaskParallel)
+{
+  ros::Time::init();
+  ros::Time::setNow(ros::Time(1));
+
+  std::map<point_containment_filter::ShapeHandle, Eigen::Isometry3d> poses;
+  auto cb = [&](point_containment_filter::ShapeHandle h, Eigen::Isometry3d &t) -> bool
+  {
+    if (poses.find(h) == poses.end())
+      poses[h] = randomPose();
+    t = poses[h];
+    return true;
+  };
+  TestMask mask(cb, 0.1, 10.0, true, true, true);
+
+  for (size_t i = 0; i < 10; ++i)
+  {
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Box(0.5, 1.0, 1.5)), 1.0, 0.0, false);
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Sphere(0.7)), 1.0, 0.0, false);
+  }
+  mask.updateInternalShapeLists();
+
+  const Eigen::Vector3d sensorPos(3.0, 0.0, 0.0);
+
+  // the last task gets only a part of POINTS_PER_TASK points
+  const size_t numPoints = 20 * 1024 + 13;
+  Cloud cloud;
+  CloudModifier mod(cloud);
+  mod.setPointCloud2FieldsByString(1, "xyz");
+  mod.resize(numPoints);
+  CloudIter it_x(cloud, "x");
+  CloudIter it_y(cloud, "y");
+  CloudIter it_z(cloud, "z");
+  for (size_t i = 0; i < numPoints; ++i, ++it_x, ++it_y, ++it_z)
+  {
+    const Eigen::Vector3d p = Eigen::Vector3d::Random() * 3.0;
+    *it_x = p.x(); *it_y = p.y(); *it_z = p.z();
+  }
+
+  EXPECT_EQ(1, mask.getNumThreads());
+  std::vector<RayCastingShapeMask::MaskValue> serialVals;
+  mask.maskContainmentAndShadows(cloud, serialVals, sensorPos);
+
+  mask.setNumThreads(4);
+  EXPECT_EQ(std::min(4u, std::max(1u, std::thread::hardware_concurrency())), mask.getNumThreads());
+  std::vector<RayCastingShapeMask::MaskValue> parallelVals;
+  for (size_t i = 0; i < 3; ++i)  // the worker threads are reused between calls
+  {
+    mask.maskContainmentAndShadows(cloud, parallelVals, sensorPos);
+    ASSERT_EQ(serialVals.size(), parallelVals.size());
+    EXPECT_EQ(serialVals, parallelVals);
+  }
+
+  mask.setNumThreads(1);
+  EXPECT_EQ(1, mask.getNumThreads());
+  mask.maskContainmentAndShadows(cloud, parallelVals, sensorPos);
+  EXPECT_EQ(serialVals, parallelVals);
+}
+
+TEST(RayCastingShapeMask, MaskPointArray)
+{
+  ros::Time::init();
+  ros::Time::setNow(ros::Time(1));
+
+  std::map<point_containment_filter::ShapeHandle, Eigen::Isometry3d> poses;
+  auto cb = [&](point_containment_filter::ShapeHandle h, Eigen::Isometry3d &t) -> bool
+  {
+    if (poses.find(h) == poses.end())
+      poses[h] = randomPose();
+    t = poses[h];
+    return true;
+  };
+  TestMask mask(cb, 0.1, 10.0, true, true, true);
+
+  for (size_t i = 0; i < 10; ++i)
+  {
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Box(0.5, 1.0, 1.5)), 1.0, 0.0, false);
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Sphere(0.7)), 1.0, 0.0, false);
+  }
+  mask.updateInternalShapeLists();
+
+  const Eigen::Vector3d sensorPos(3.0, 0.0, 0.0);
+
+  const size_t numPoints = 3 * 1024 + 13;
+  std::vector<Eigen::Vector3f> points(numPoints);
+  Cloud cloud;
+  CloudModifier mod(cloud);
+  mod.setPointCloud2FieldsByString(1, "xyz");
+  mod.resize(numPoints);
+  CloudIter it_x(cloud, "x");
+  CloudIter it_y(cloud, "y");
+  CloudIter it_z(cloud, "z");
+  for (size_t i = 0; i < numPoints; ++i, ++it_x, ++it_y, ++it_z)
+  {
+    points[i] = (Eigen::Vector3d::Random() * 3.0).cast<float>();
+    if (i % 100 == 0)
+      points[i].x() = std::numeric_limits<float>::quiet_NaN();
+    *it_x = points[i].x(); *it_y = points[i].y(); *it_z = points[i].z();
+  }
+
+  std::vector<RayCastingShapeMask::MaskValue> cloudVals;
+  mask.maskContainmentAndShadows(cloud, cloudVals, sensorPos);
+
+  std::vector<RayCastingShapeMask::MaskValue> arrayVals;
+  mask.maskContainmentAndShadows(points, arrayVals, sensorPos);
+  ASSERT_EQ(numPoints, arrayVals.size());
+  EXPECT_EQ(cloudVals, arrayVals);
+  EXPECT_EQ(RayCastingShapeMask::MaskValue::OUTSIDE, arrayVals[0]);
+
+  mask.setNumThreads(4);
+  mask.maskContainmentAndShadows(points, arrayVals, sensorPos);
+  EXPECT_EQ(cloudVals, arrayVals);
+}
+
+TEST(RayCastingShapeMask, MaskPointByPoint)
+{
+  ros::Time::init();
+  ros::Time::setNow(ros::Time(1));
+
+  // the bodies move during the scan
+  double scanTime = 0.0;
+  std::map<point_containment_filter::ShapeHandle, Eigen::Isometry3d> poses;
+  auto cb = [&](point_containment_filter::ShapeHandle h, Eigen::Isometry3d &t) -> bool
+  {
+    if (poses.find(h) == poses.end())
+      poses[h] = randomPose();
+    t = Eigen::Translation3d(scanTime, 0.0, 0.0) * poses[h];
+    return true;
+  };
+  TestMask mask(cb, 0.1, 10.0, true, true, true);
+
+  for (size_t i = 0; i < 10; ++i)
+  {
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Box(0.5, 1.0, 1.5)), 1.0, 0.0, false);
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Sphere(0.7)), 1.0, 0.0, false);
+  }
+  mask.updateInternalShapeLists();
+
+  const size_t numPoints = 10 * 1024 + 13;
+  Cloud cloud;
+  CloudModifier mod(cloud);
+  mod.setPointCloud2Fields(6,
+                           "x", 1, sensor_msgs::PointField::FLOAT32,
+                           "y", 1, sensor_msgs::PointField::FLOAT32,
+                           "z", 1, sensor_msgs::PointField::FLOAT32,
+                           "vp_x", 1, sensor_msgs::PointField::FLOAT32,
+                           "vp_y", 1, sensor_msgs::PointField::FLOAT32,
+                           "vp_z", 1, sensor_msgs::PointField::FLOAT32);
+  mod.resize(numPoints);
+  CloudIter it_x(cloud, "x");
+  CloudIter it_y(cloud, "y");
+  CloudIter it_z(cloud, "z");
+  CloudIter it_vp_x(cloud, "vp_x");
+  CloudIter it_vp_y(cloud, "vp_y");
+  CloudIter it_vp_z(cloud, "vp_z");
+  for (size_t i = 0; i < numPoints; ++i, ++it_x, ++it_y, ++it_z, ++it_vp_x, ++it_vp_y, ++it_vp_z)
+  {
+    const Eigen::Vector3d p = Eigen::Vector3d::Random() * 3.0;
+    *it_x = p.x(); *it_y = p.y(); *it_z = p.z();
+    const auto angle = 2 * M_PI * i / numPoints;
+    *it_vp_x = 3.0 * std::cos(angle); *it_vp_y = 3.0 * std::sin(angle); *it_vp_z = 0.0;
+  }
+
+  const size_t binSize = 1000;
+  std::vector<size_t> binStarts;
+  for (size_t i = 0; i < numPoints; i += binSize)
+    binStarts.push_back(i);
+  const auto setScanTime = [&](const size_t binStart) { scanTime = static_cast<double>(binStart) / numPoints; };
+
+  for (const auto singlePrecision : {false, true})
+  {
+    mask.setSinglePrecision(singlePrecision);
+
+    std::vector<RayCastingShapeMask::MaskValue> pointVals(numPoints);
+    CloudConstIter x(cloud, "x"), y(cloud, "y"), z(cloud, "z");
+    CloudConstIter vp_x(cloud, "vp_x"), vp_y(cloud, "vp_y"), vp_z(cloud, "vp_z");
+    for (size_t i = 0; i < numPoints; ++i, ++x, ++y, ++z, ++vp_x, ++vp_y, ++vp_z)
+    {
+      const auto updateBodyPoses = i % binSize == 0;
+      if (updateBodyPoses)
+        setScanTime(i);
+      mask.maskContainmentAndShadows(Eigen::Vector3f(*x, *y, *z), pointVals[i],
+                                     Eigen::Vector3d(*vp_x, *vp_y, *vp_z), updateBodyPoses);
+    }
+
+    for (const auto numThreads : {1u, 4u})
+    {
+      mask.setNumThreads(numThreads);
+      std::vector<RayCastingShapeMask::MaskValue> binVals;
+      mask.maskContainmentAndShadows(cloud, binVals, binStarts, setScanTime);
+      ASSERT_EQ(numPoints, binVals.size());
+      EXPECT_EQ(pointVals, binVals) << "single precision " << singlePrecision << ", threads " << numThreads;
+    }
+    mask.setNumThreads(1);
+  }
+  EXPECT_DOUBLE_EQ(static_cast<double>(binStarts.back()) / numPoints, scanTime);
+}
+
+TEST(RayCastingShapeMask, MaskSinglePrecision)
+{
+  ros::Time::init();
+  ros::Time::setNow(ros::Time(1));
+
+  std::map<point_containment_filter::ShapeHandle, Eigen::Isometry3d> poses;
+  auto cb = [&](point_containment_filter::ShapeHandle h, Eigen::Isometry3d &t) -> bool
+  {
+    if (poses.find(h) == poses.end())
+    {
+      poses[h] = randomPose();
+      poses[h].translation() *= 2.0;
+    }
+    t = poses[h];
+    return true;
+  };
+  TestMask mask(cb, 0.1, 10.0, true, true, true);
+
+  for (size_t i = 0; i < 5; ++i)
+  {
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Box(0.5, 1.0, 1.5)), 1.0, 0.0, false);
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Sphere(0.7)), 1.0, 0.0, false);
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Cylinder(0.3, 1.2)), 1.0, 0.0, false);
+  }
+  auto g = urdf::Mesh();
+  g.scale = {1.0, 2.0, 3.0};
+  g.filename = "package://robot_body_filter/test/box.dae";
+  mask.addShape(robot_body_filter::constructShape(g), 1.0, 0.0, false, "mesh");
+  mask.updateInternalShapeLists();
+
+  const Eigen::Vector3d sensorPos(4.0, 0.0, 0.0);
+
+  const size_t numPoints = 10000;
+  Cloud cloud;
+  CloudModifier mod(cloud);
+  mod.setPointCloud2FieldsByString(1, "xyz");
+  mod.resize(numPoints);
+  CloudIter it_x(cloud, "x");
+  CloudIter it_y(cloud, "y");
+  CloudIter it_z(cloud, "z");
+  for (size_t i = 0; i < numPoints; ++i, ++it_x, ++it_y, ++it_z)
+  {
+    const Eigen::Vector3d p = Eigen::Vector3d::Random() * 5.0;
+    *it_x = p.x(); *it_y = p.y(); *it_z = p.z();
+  }
+
+  std::vector<RayCastingShapeMask::MaskValue> doubleVals;
+  mask.maskContainmentAndShadows(cloud, doubleVals, sensorPos);
+
+  mask.setSinglePrecision(true);
+  std::vector<RayCastingShapeMask::MaskValue> floatVals;
+  mask.maskContainmentAndShadows(cloud, floatVals, sensorPos);
+  ASSERT_EQ(numPoints, floatVals.size());
+
+  // random points are very unlikely to be closer than the float rounding errors to a surface
+  size_t numDifferent = 0;
+  std::map<RayCastingShapeMask::MaskValue, size_t> numVals;
+  for (size_t i = 0; i < numPoints; ++i)
+  {
+    numVals[doubleVals[i]]++;
+    if (floatVals[i] != doubleVals[i])
+      numDifferent++;
+  }
+  EXPECT_GE(1, numDifferent);
+  EXPECT_LT(0, numVals[RayCastingShapeMask::MaskValue::INSIDE]);
+  EXPECT_LT(0, numVals[RayCastingShapeMask::MaskValue::SHADOW]);
+
+  // single points are classified the same as points in clouds
+  RayCastingShapeMask::MaskValue val;
+  CloudConstIter c_x(cloud, "x");
+  CloudConstIter c_y(cloud, "y");
+  CloudConstIter c_z(cloud, "z");
+  for (size_t i = 0; i < 1000; ++i, ++c_x, ++c_y, ++c_z)
+  {
+    mask.maskContainmentAndShadows(Eigen::Vector3f(*c_x, *c_y, *c_z), val, sensorPos, false);
+    EXPECT_EQ(floatVals[i], val) << "Point " << i;
+  }
+}
+
+TEST(RayCastingShapeMask, MaskShadowDepthMap)
+{
+  ros::Time::init();
+  ros::Time::setNow(ros::Time(1));
+
+  std::map<point_containment_filter::ShapeHandle, Eigen::Isometry3d> poses;
+  auto cb = [&](point_containment_filter::ShapeHandle h, Eigen::Isometry3d &t) -> bool
+  {
+    if (poses.find(h) == poses.end())
+    {
+      poses[h] = randomPose();
+      poses[h].translation() *= 2.0;
+    }
+    t = poses[h];
+    return true;
+  };
+  TestMask mask(cb, 0.1, 10.0, true, true, true);
+
+  for (size_t i = 0; i < 5; ++i)
+  {
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Box(0.5, 1.0, 1.5)), 1.0, 0.0, false);
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Sphere(0.7)), 1.0, 0.0, false);
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Cylinder(0.3, 1.2)), 1.0, 0.0, false);
+  }
+  auto g = urdf::Mesh();
+  g.scale = {1.0, 2.0, 3.0};
+  g.filename = "package://robot_body_filter/test/box.dae";
+  mask.addShape(robot_body_filter::constructShape(g), 1.0, 0.0, false, "mesh");
+  mask.updateInternalShapeLists();
+
+  const Eigen::Vector3d sensorPos(6.0, 0.0, 0.0);
+
+  const size_t numPoints = 10000;
+  Cloud cloud;
+  CloudModifier mod(cloud);
+  mod.setPointCloud2FieldsByString(1, "xyz");
+  mod.resize(numPoints);
+  CloudIter it_x(cloud, "x");
+  CloudIter it_y(cloud, "y");
+  CloudIter it_z(cloud, "z");
+  for (size_t i = 0; i < numPoints; ++i, ++it_x, ++it_y, ++it_z)
+  {
+    const Eigen::Vector3d p = Eigen::Vector3d::Random() * 7.0;
+    *it_x = p.x(); *it_y = p.y(); *it_z = p.z();
+  }
+
+  for (const auto singlePrecision : {false, true})
+  {
+    mask.setSinglePrecision(singlePrecision);
+    mask.setShadowDepthMap(false);
+    std::vector<RayCastingShapeMask::MaskValue> exactVals;
+    mask.maskContainmentAndShadows(cloud, exactVals, sensorPos);
+
+    for (const auto resolution : {0.005, 0.05, 0.5})
+    {
+      mask.setShadowDepthMap(true, resolution);
+      std::vector<RayCastingShapeMask::MaskValue> depthMapVals;
+      mask.maskContainmentAndShadows(cloud, depthMapVals, sensorPos);
+      ASSERT_EQ(numPoints, depthMapVals.size());
+
+      // the depth map only skips ray tests that can't hit, so the results have to be the same
+      std::map<RayCastingShapeMask::MaskValue, size_t> numVals;
+      for (size_t i = 0; i < numPoints; ++i)
+      {
+        numVals[exactVals[i]]++;
+        EXPECT_EQ(exactVals[i], depthMapVals[i]) << "Point " << i << ", resolution " << resolution;
+      }
+      EXPECT_LT(0, numVals[RayCastingShapeMask::MaskValue::SHADOW]);
+    }
+  }
+}
+
+TEST(RayCastingShapeMask, MaskContainsTestVoxelGrid)
+{
+  ros::Time::init();
+  ros::Time::setNow(ros::Time(1));
+
+  std::map<point_containment_filter::ShapeHandle, Eigen::Isometry3d> poses;
+  auto cb = [&](point_containment_filter::ShapeHandle h, Eigen::Isometry3d &t) -> bool
+  {
+    if (poses.find(h) == poses.end())
+    {
+      poses[h] = randomPose();
+      poses[h].translation() *= 2.0;
+    }
+    t = poses[h];
+    return true;
+  };
+  TestMask mask(cb, 0.1, 10.0, true, true, true);
+
+  // voxels of the first meshes are built when setting the resolution, the others when they are added
+  auto g = urdf::Mesh();
+  g.filename = "package://robot_body_filter/test/box.dae";
+  for (size_t i = 0; i < 6; ++i)
+  {
+    if (i == 3)
+      mask.setContainsTestVoxelResolution(0.02);
+    g.scale = {0.5 + 0.1 * i, 1.0, 0.7};
+    mask.addShape(robot_body_filter::constructShape(g), 1.0 + 0.05 * i, 0.01 * i, false, "mesh");
+  }
+  mask.addShape(shapes::ShapeConstPtr(new shapes::Sphere(0.7)), 1.0, 0.0, false);
+  mask.updateInternalShapeLists();
+
+  const Eigen::Vector3d sensorPos(6.0, 0.0, 0.0);
+
+  const size_t numPoints = 10000;
+  Cloud cloud;
+  CloudModifier mod(cloud);
+  mod.setPointCloud2FieldsByString(1, "xyz");
+  mod.resize(numPoints);
+  CloudIter it_x(cloud, "x");
+  CloudIter it_y(cloud, "y");
+  CloudIter it_z(cloud, "z");
+  for (size_t i = 0; i < numPoints; ++i, ++it_x, ++it_y, ++it_z)
+  {
+    const Eigen::Vector3d p = Eigen::Vector3d::Random() * 4.0;
+    *it_x = p.x(); *it_y = p.y(); *it_z = p.z();
+  }
+
+  std::vector<RayCastingShapeMask::MaskValue> gridVals;
+  mask.maskContainmentAndShadows(cloud, gridVals, sensorPos);
+
+  mask.setContainsTestVoxelResolution(0.0);
+  std::vector<RayCastingShapeMask::MaskValue> exactVals;
+  mask.maskContainmentAndShadows(cloud, exactVals, sensorPos);
+
+  // the grids only decide points far from the surfaces, so the results have to be the same
+  ASSERT_EQ(numPoints, gridVals.size());
+  size_t numInside = 0;
+  for (size_t i = 0; i < numPoints; ++i)
+  {
+    EXPECT_EQ(exactVals[i], gridVals[i]) << "Point " << i;
+    if (exactVals[i] == RayCastingShapeMask::MaskValue::INSIDE)
+      numInside++;
+  }
+  EXPECT_LT(0, numInside);
+}
+
+TEST(RayCastingShapeMask, MaskContainsTestDistanceField)
+{
+  ros::Time::init();
+  ros::Time::setNow(ros::Time(1));
+
+  std::map<point_containment_filter::ShapeHandle, Eigen::Isometry3d> poses;
+  auto cb = [&](point_containment_filter::ShapeHandle h, Eigen::Isometry3d &t) -> bool
+  {
+    if (poses.find(h) == poses.end())
+    {
+      poses[h] = randomPose();
+      poses[h].translation() *= 2.0;
+    }
+    t = poses[h];
+    return true;
+  };
+  TestMask mask(cb, 0.1, 10.0, true, true, true);
+
+  // fields of the first meshes are built when setting the resolution, the others when they are added
+  auto g = urdf::Mesh();
+  g.filename = "package://robot_body_filter/test/box.dae";
+  for (size_t i = 0; i < 6; ++i)
+  {
+    if (i == 3)
+      mask.setContainsTestDistanceFieldResolution(0.02);
+    g.scale = {0.5 + 0.1 * i, 1.0, 0.7};
+    mask.addShape(robot_body_filter::constructShape(g), 1.0 + 0.05 * i, 0.01 * i, false, "mesh");
+  }
+  mask.addShape(shapes::ShapeConstPtr(new shapes::Sphere(0.7)), 1.0, 0.0, false);
+  mask.updateInternalShapeLists();
+
+  const Eigen::Vector3d sensorPos(6.0, 0.0, 0.0);
+
+  const size_t numPoints = 10000;
+  Cloud cloud;
+  CloudModifier mod(cloud);
+  mod.setPointCloud2FieldsByString(1, "xyz");
+  mod.resize(numPoints);
+  CloudIter it_x(cloud, "x");
+  CloudIter it_y(cloud, "y");
+  CloudIter it_z(cloud, "z");
+  for (size_t i = 0; i < numPoints; ++i, ++it_x, ++it_y, ++it_z)
+  {
+    const Eigen::Vector3d p = Eigen::Vector3d::Random() * 4.0;
+    *it_x = p.x(); *it_y = p.y(); *it_z = p.z();
+  }
+
+  std::vector<RayCastingShapeMask::MaskValue> fieldVals;
+  mask.maskContainmentAndShadows(cloud, fieldVals, sensorPos);
+
+  mask.setContainsTestDistanceFieldResolution(0.0);
+  std::vector<RayCastingShapeMask::MaskValue> exactVals;
+  mask.maskContainmentAndShadows(cloud, exactVals, sensorPos);
+
+  // the fields only decide points far from the surfaces, so the results have to be the same
+  ASSERT_EQ(numPoints, fieldVals.size());
+  size_t numInside = 0;
+  for (size_t i = 0; i < numPoints; ++i)
+  {
+    EXPECT_EQ(exactVals[i], fieldVals[i]) << "Point " << i;
+    if (exactVals[i] == RayCastingShapeMask::MaskValue::INSIDE)
+      numInside++;
+  }
+  EXPECT_LT(0, numInside);
+}
+
+TEST(RayCastingShapeMask, MaskDepthCamera)
+{
+  ros::Time::init();
+  ros::Time::setNow(ros::Time(1));
+
+  std::map<point_containment_filter::ShapeHandle, Eigen::Isometry3d> poses;
+  auto cb = [&](point_containment_filter::ShapeHandle h, Eigen::Isometry3d &t) -> bool
+  {
+    if (poses.find(h) == poses.end())
+    {
+      poses[h] = randomPose();
+      poses[h].translation() *= 2.0;
+    }
+    t = poses[h];
+    return true;
+  };
+  TestMask mask(cb, 0.1, 10.0, true, true, true);
+
+  for (size_t i = 0; i < 3; ++i)
+  {
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Box(0.5, 1.0, 1.5)), 1.0, 0.0, false);
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Sphere(0.7)), 1.0, 0.0, false);
+    mask.addShape(shapes::ShapeConstPtr(new shapes::Cylinder(0.3, 1.2)), 1.0, 0.0, false);
+  }
+  auto g = urdf::Mesh();
+  g.scale = {1.0, 2.0, 3.0};
+  g.filename = "package://robot_body_filter/test/box.dae";
+  mask.addShape(robot_body_filter::constructShape(g), 1.0, 0.0, false, "mesh");
+  mask.updateInternalShapeLists();
+
+  DepthCamera camera;
+  camera.width = 160;
+  camera.height = 120;
+  camera.fx = camera.fy = 100.0;
+  camera.cx = 79.5;
+  camera.cy = 59.5;
+
+  // the camera looks from +x towards the robot, optical x points to world y and optical y to world -z
+  Eigen::Isometry3d sensorPose = Eigen::Isometry3d::Identity();
+  sensorPose.linear() << 0, 0, -1,
+                         1, 0, 0,
+                         0, -1, 0;
+  sensorPose.translation() = Eigen::Vector3d(6.0, 0.0, 0.0);
+
+  // each pixel measures a point at random depth on its center ray
+  const DepthImageRasterizer rasterizer(camera);
+  const size_t numPoints = camera.width * camera.height;
+  Cloud cloud;
+  CloudModifier mod(cloud);
+  mod.setPointCloud2FieldsByString(1, "xyz");
+  mod.resize(numPoints);
+  cloud.width = static_cast<uint32_t>(camera.width);
+  cloud.height = static_cast<uint32_t>(camera.height);
+  cloud.row_step = cloud.width * cloud.point_step;
+  CloudIter it_x(cloud, "x");
+  CloudIter it_y(cloud, "y");
+  CloudIter it_z(cloud, "z");
+  for (size_t i = 0; i < numPoints; ++i, ++it_x, ++it_y, ++it_z)
+  {
+    Eigen::Vector3d p = sensorPose * (rasterizer.getPixelRay(i) * (6.0 + 5.0 * Eigen::Vector2d::Random().x()));
+    if (i % 97 == 0)
+      p.setConstant(std::numeric_limits<double>::quiet_NaN());
+    *it_x = p.x(); *it_y = p.y(); *it_z = p.z();
+  }
+
+  std::vector<RayCastingShapeMask::MaskValue> exactVals;
+  mask.maskContainmentAndShadows(cloud, exactVals, sensorPose.translation());
+
+  std::vector<RayCastingShapeMask::MaskValue> rasterVals;
+  mask.maskContainmentAndShadows(cloud, rasterVals, sensorPose, camera);
+  ASSERT_EQ(numPoints, rasterVals.size());
+
+  // the rasterizer tests the pixel center rays, which are the rays of the points up to rounding errors
+  std::map<RayCastingShapeMask::MaskValue, size_t> numVals;
+  size_t numDifferent = 0;
+  for (size_t i = 0; i < numPoints; ++i)
+  {
+    numVals[exactVals[i]]++;
+    if (exactVals[i] != rasterVals[i])
+      numDifferent++;
+  }
+  EXPECT_GE(numPoints / 1000, numDifferent);
+  EXPECT_LT(0, numVals[RayCastingShapeMask::MaskValue::INSIDE]);
+  EXPECT_LT(0, numVals[RayCastingShapeMask::MaskValue::SHADOW]);
+  EXPECT_LT(0, numVals[RayCastingShapeMask::MaskValue::CLIP]);
+}
+
 TEST(RayCastingShapeMask, MaskPerformancePoints)
 {
   ros::Time::init();
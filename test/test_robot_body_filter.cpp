@@ -1,6 +1,9 @@
 #include "gtest/gtest.h"
 
+#include <algorithm>
+
 #include <robot_body_filter/RobotBodyFilter.h>
+#include <tf2_eigen/tf2_eigen.h>
 #include <xmlrpcpp/XmlRpcValue.h>
 #include "utils.cpp"
 
@@ -112,7 +115,12 @@ class RobotBodyFilterLaserScanTest : public RobotBodyFilterLaserScan
   friend class RobotBodyFilter_ParseRobot_Test;
   friend class RobotBodyFilter_Transforms_Test;
   friend class RobotBodyFilter_ComputeMaskPointByPoint_Test;
+  friend class RobotBodyFilter_ComputeMaskPointByPointBins_Test;
+  friend class RobotBodyFilter_TransformCacheKeyframes_Test;
+  friend class RobotBodyFilter_ViewpointsFromTf_Test;
+  friend class RobotBodyFilter_ViewpointsFromTfWithoutSensorFrame_Test;
   friend class RobotBodyFilter_UpdateLaserScan_Test;
+  friend class RobotBodyFilter_UpdateLaserScanDirectly_Test;
 };
 
 class RobotBodyFilterPointCloud2Test : public RobotBodyFilterPointCloud2
@@ -130,7 +138,39 @@ class RobotBodyFilterPointCloud2Test : public RobotBodyFilterPointCloud2
   };
 
   friend class RobotBodyFilter_ComputeMaskAllAtOnce_Test;
+  friend class RobotBodyFilter_TransformCacheSlots_Test;
   friend class RobotBodyFilter_UpdatePointCloud2_Test;
+  friend class RobotBodyFilter_ComputeMaskDepthCamera_Test;
+  friend class RobotBodyFilter_ForwardKinematics_Test;
+};
+
+//! Collects the warnings logged while it is registered.
+class WarningsCollector : public ros::console::LogAppender
+{
+public:
+  WarningsCollector()
+  {
+    ros::console::register_appender(this);
+  }
+
+  ~WarningsCollector() override
+  {
+    ros::console::deregister_appender(this);
+  }
+
+  void log(ros::console::Level level, const char* str, const char*, const char*, int) override
+  {
+    if (level == ros::console::levels::Warn)
+      this->warnings.emplace_back(str);
+  }
+
+  bool contains(const std::string& text) const
+  {
+    return std::any_of(this->warnings.begin(), this->warnings.end(),
+                       [&](const std::string& warning) { return warning.find(text) != std::string::npos; });
+  }
+
+  std::vector<std::string> warnings;
 };
 
 TEST(RobotBodyFilter, InitFromArray)
@@ -195,8 +235,12 @@ TEST(RobotBodyFilter, LoadParams)
 
   // test that invalid robot model doesn't throw any exception, but also generates no filter shapes
   nh.setParam("test_robot_description", "<robot name='test'></robot>");
+  WarningsCollector warnings;
   filterBase->configure("test_dict_config", nh);
 
+  // the deprecated parameter is not set
+  EXPECT_FALSE(warnings.contains("transforms/timeout/unreachable"));
+
   EXPECT_EQ("odom", filter->fixedFrame);
   EXPECT_EQ("laser", filter->sensorFrame);
   EXPECT_EQ("odom", filter->filteringFrame);
@@ -231,7 +275,6 @@ TEST(RobotBodyFilter, LoadParams)
   EXPECT_EQ("robot_model", filter->robotDescriptionUpdatesFieldName);
   EXPECT_DOUBLE_EQ(60.0, filter->tfBufferLength.toSec());
   EXPECT_DOUBLE_EQ(0.2, filter->reachableTransformTimeout.toSec());
-  EXPECT_DOUBLE_EQ(0.2, filter->unreachableTransformTimeout.toSec());
   EXPECT_TRUE(filter->computeBoundingSphere);
   EXPECT_FALSE(filter->computeDebugBoundingSphere);
   EXPECT_FALSE(filter->publishBoundingSphereMarker);
@@ -291,8 +334,12 @@ TEST(RobotBodyFilter, LoadParamsAllConfig)
 
   // test that invalid robot model doesn't throw any exception, but also generates no filter shapes
   nh.setParam("test_robot_description", "<robot name='test'></robot>");
+  WarningsCollector warnings;
   filterBase->configure("all_config", nh);
 
+  // setting the deprecated parameter is reported
+  EXPECT_TRUE(warnings.contains("transforms/timeout/unreachable is deprecated"));
+
   EXPECT_EQ("odom", filter->fixedFrame);
   EXPECT_EQ("laser", filter->sensorFrame);
   EXPECT_EQ("base_link", filter->filteringFrame);
@@ -317,7 +364,6 @@ TEST(RobotBodyFilter, LoadParamsAllConfig)
   EXPECT_EQ("robot", filter->robotDescriptionUpdatesFieldName);
   EXPECT_DOUBLE_EQ(60.0, filter->tfBufferLength.toSec());
   EXPECT_DOUBLE_EQ(0.2, filter->reachableTransformTimeout.toSec());
-  EXPECT_DOUBLE_EQ(0.2, filter->unreachableTransformTimeout.toSec());
   EXPECT_TRUE(filter->computeBoundingSphere);
   EXPECT_TRUE(filter->computeDebugBoundingSphere);
   EXPECT_TRUE(filter->publishBoundingSphereMarker);
@@ -1469,6 +1515,456 @@ TEST(RobotBodyFilter, ComputeMaskPointByPoint)
   EXPECT_EQ(1, robotModelShadowTest->markers[1].frame_locked);
 }
 
+TEST(RobotBodyFilter, ComputeMaskPointByPointBins)
+{
+  ros::NodeHandle nh;
+
+  auto filter = std::make_shared<RobotBodyFilterLaserScanTest>();
+  auto filterBase = std::dynamic_pointer_cast<filters::FilterBase<sensor_msgs::LaserScan>>(filter);
+
+  nh.setParam("test_robot_description", ROBOT_URDF);
+  filterBase->configure("compute_mask_config_point_by_point_bins", nh);
+
+  // the bins of points sharing body poses are large enough to be split between the worker threads
+  const size_t numPoints = 10000;
+
+  Cloud cloud;
+  cloud.header.frame_id = filter->filteringFrame;
+  CloudModifier mod(cloud);
+  mod.setPointCloud2Fields(7,
+                           "x", 1, sensor_msgs::PointField::FLOAT32,
+                           "y", 1, sensor_msgs::PointField::FLOAT32,
+                           "z", 1, sensor_msgs::PointField::FLOAT32,
+                           "vp_x", 1, sensor_msgs::PointField::FLOAT32,
+                           "vp_y", 1, sensor_msgs::PointField::FLOAT32,
+                           "vp_z", 1, sensor_msgs::PointField::FLOAT32,
+                           "stamps", 1, sensor_msgs::PointField::FLOAT32);
+  mod.resize(numPoints);
+
+  const Eigen::Vector3f viewpoint(-2.5, 0, 0);
+  {
+    CloudIter x_it(cloud, "x");
+    CloudIter y_it(cloud, "y");
+    CloudIter z_it(cloud, "z");
+    CloudIter vp_x_it(cloud, "vp_x");
+    CloudIter vp_y_it(cloud, "vp_y");
+    CloudIter vp_z_it(cloud, "vp_z");
+    CloudIter stamps_it(cloud, "stamps");
+
+    for (size_t i = 0; i < numPoints; ++i, ++x_it, ++y_it, ++z_it, ++vp_x_it, ++vp_y_it, ++vp_z_it, ++stamps_it)
+    {
+      const Eigen::Vector3f point = Eigen::Vector3f::Random().cwiseProduct(Eigen::Vector3f(3.25, 2, 2)) +
+        Eigen::Vector3f(0.25, 0, 0);
+      *x_it = point.x(); *y_it = point.y(); *z_it = point.z();
+      *vp_x_it = viewpoint.x(); *vp_y_it = viewpoint.y(); *vp_z_it = viewpoint.z();
+      *stamps_it = static_cast<float>(i) / numPoints;
+    }
+  }
+
+  {
+    // the robot moves during the scan, so each bin sees different body poses
+    ros::Time now = ros::Time::now();
+    cloud.header.stamp = now;
+    geometry_msgs::TransformStamped tf;
+    tf.transform.rotation.w = 1.0;
+    for (double d = -5.0; d < 5.0; d += 0.1)
+    {
+      tf.header.stamp = now + ros::Duration(d);
+
+      tf.transform.translation.x = 0.122 + 0.5 * d;
+      tf.header.frame_id = "odom";
+      tf.child_frame_id = "base_link";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = -1.5 - 0.122;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "laser";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = 0.01864 - 0.122;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "antenna";
+      filter->tfBuffer->setTransform(tf, "test");
+    }
+  }
+
+  while (!filter->tfFramesWatchdog->isReachable("antenna"))
+    ros::WallDuration(0.01).sleep();
+
+  std::vector<RayCastingShapeMask::MaskValue> mask;
+  ASSERT_TRUE(filter->computeMask(cloud, mask));
+  ASSERT_EQ(numPoints, mask.size());
+
+  // classify each point alone with the body poses of the start of its bin
+  const auto scanDuration = static_cast<double>(static_cast<float>(numPoints - 1) / numPoints);
+  const auto binSize = static_cast<size_t>(
+      ceil(filter->modelPoseUpdateInterval.toSec() / scanDuration * numPoints));
+  ASSERT_LT(1u, numPoints / binSize);
+
+  std::map<RayCastingShapeMask::MaskValue, size_t> counts;
+  CloudConstIter x_it(cloud, "x");
+  CloudConstIter y_it(cloud, "y");
+  CloudConstIter z_it(cloud, "z");
+  for (size_t i = 0; i < numPoints; ++i, ++x_it, ++y_it, ++z_it)
+  {
+    const auto binStart = i / binSize * binSize;
+    filter->cacheLookupBetweenScansRatio = static_cast<double>(static_cast<float>(binStart) / numPoints) / scanDuration;
+
+    RayCastingShapeMask::MaskValue pointMask;
+    filter->shapeMask->maskContainmentAndShadows(
+        Eigen::Vector3f(*x_it, *y_it, *z_it), pointMask, viewpoint.cast<double>());
+    EXPECT_EQ(pointMask, mask[i]) << "Point " << i;
+    ++counts[pointMask];
+  }
+
+  // make sure the scan tests all kinds of points
+  EXPECT_LT(0u, counts[RayCastingShapeMask::MaskValue::INSIDE]);
+  EXPECT_LT(0u, counts[RayCastingShapeMask::MaskValue::SHADOW]);
+  EXPECT_LT(0u, counts[RayCastingShapeMask::MaskValue::OUTSIDE]);
+}
+
+TEST(RobotBodyFilter, TransformCacheKeyframes)
+{
+  ros::NodeHandle nh;
+
+  auto filter = std::make_shared<RobotBodyFilterLaserScanTest>();
+  auto filterBase = std::dynamic_pointer_cast<filters::FilterBase<sensor_msgs::LaserScan>>(filter);
+
+  nh.setParam("test_robot_description", ROBOT_URDF);
+  filterBase->configure("compute_mask_config_keyframes", nh);
+
+  ASSERT_EQ(5u, filter->numScanKeyframes);
+
+  // each link moves differently and non-linearly, so a keyframe of a wrong link or a wrong time is detected
+  ros::Time now = ros::Time::now();
+  {
+    geometry_msgs::TransformStamped tf;
+    tf.transform.rotation.w = 1.0;
+    for (int i = -100; i < 100; ++i)
+    {
+      const auto d = i * 0.05;
+      tf.header.stamp = now + ros::Duration(d);
+
+      tf.transform.translation.x = 0.122 + d * d;
+      tf.transform.translation.y = 0;
+      tf.transform.translation.z = 0;
+      tf.header.frame_id = "odom";
+      tf.child_frame_id = "base_link";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = -1.5 - 0.122;
+      tf.transform.translation.z = d * d * d;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "laser";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = 0.01864 - 0.122;
+      tf.transform.translation.y = std::sin(d);
+      tf.transform.translation.z = 0;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "antenna";
+      filter->tfBuffer->setTransform(tf, "test");
+    }
+  }
+
+  while (!filter->tfFramesWatchdog->isReachable("antenna"))
+    ros::WallDuration(0.01).sleep();
+  while (!filter->tfFramesWatchdog->isReachable("laser"))
+    ros::WallDuration(0.01).sleep();
+
+  const ros::Duration scanDuration(1.0);
+  filter->updateTransformCache(now, now + scanDuration);
+
+  // each link frame is looked up only once per keyframe, although base_link has two collisions
+  auto lookupFrames = filter->lookupFrames;
+  std::sort(lookupFrames.begin(), lookupFrames.end());
+  EXPECT_EQ((std::vector<std::string>{"antenna", "base_link", "laser"}), lookupFrames);
+
+  // poses of the collisions relative to their links
+  const std::map<std::string, Eigen::Vector3d> collisionOffsets = {
+      {"base_link-0", {-0.122, 0, 0}},
+      {"base_link-1", {-0.1, 0, 0}},
+      {"antenna-0", {-0.01864, 0, 0}},
+      {"laser-0", {0, 0, 0}},
+  };
+  ASSERT_EQ(4u, filter->collisionBodies.size());
+
+  // all shapes of all collisions have the poses of their links at the keyframes
+  const auto numKeyframes = filter->numScanKeyframes;
+  std::vector<std::map<point_containment_filter::ShapeHandle, Eigen::Vector3d>> keyframePositions(numKeyframes);
+  for (size_t keyframe = 0; keyframe < numKeyframes; ++keyframe)
+  {
+    const auto ratio = static_cast<double>(keyframe) / (numKeyframes - 1);
+    filter->cacheLookupBetweenScansRatio = ratio;
+    for (const auto& shapeToLink : filter->shapesToLinks)
+    {
+      SCOPED_TRACE(shapeToLink.second.cacheKey + " at keyframe " + std::to_string(keyframe));
+      ASSERT_NE(collisionOffsets.end(), collisionOffsets.find(shapeToLink.second.cacheKey));
+
+      const auto linkTf = filter->tfBuffer->lookupTransform(
+          "odom", shapeToLink.second.link->name, now + scanDuration * ratio);
+      const Eigen::Vector3d expectedPosition = tf2::transformToEigen(linkTf.transform) *
+          collisionOffsets.at(shapeToLink.second.cacheKey);
+
+      Eigen::Isometry3d transform;
+      ASSERT_TRUE(filter->getShapeTransform(shapeToLink.first, transform));
+      EXPECT_NEAR(expectedPosition.x(), transform.translation().x(), 1e-6);
+      EXPECT_NEAR(expectedPosition.y(), transform.translation().y(), 1e-6);
+      EXPECT_NEAR(expectedPosition.z(), transform.translation().z(), 1e-6);
+      keyframePositions[keyframe][shapeToLink.first] = transform.translation();
+    }
+  }
+
+  // between the keyframes, the poses are interpolated only from the two surrounding keyframes
+  for (size_t keyframe = 0; keyframe + 1 < numKeyframes; ++keyframe)
+  {
+    filter->cacheLookupBetweenScansRatio = (keyframe + 0.5) / (numKeyframes - 1);
+    for (const auto& shapeToLink : filter->shapesToLinks)
+    {
+      SCOPED_TRACE(shapeToLink.second.cacheKey + " after keyframe " + std::to_string(keyframe));
+      const Eigen::Vector3d expectedPosition = (keyframePositions[keyframe][shapeToLink.first] +
+          keyframePositions[keyframe + 1][shapeToLink.first]) / 2;
+
+      Eigen::Isometry3d transform;
+      ASSERT_TRUE(filter->getShapeTransform(shapeToLink.first, transform));
+      EXPECT_NEAR(expectedPosition.x(), transform.translation().x(), 1e-6);
+      EXPECT_NEAR(expectedPosition.y(), transform.translation().y(), 1e-6);
+      EXPECT_NEAR(expectedPosition.z(), transform.translation().z(), 1e-6);
+    }
+  }
+}
+
+TEST(RobotBodyFilter, ViewpointsFromTf)
+{
+  ros::NodeHandle nh;
+
+  auto filter = std::make_shared<RobotBodyFilterLaserScanTest>();
+  auto filterBase = std::dynamic_pointer_cast<filters::FilterBase<sensor_msgs::LaserScan>>(filter);
+
+  nh.setParam("test_robot_description", ROBOT_URDF);
+  filterBase->configure("compute_mask_config_keyframes", nh);
+
+  ASSERT_TRUE(filter->viewpointsFromTf);
+
+  // the cloud has no viewpoint channels
+  const std::vector<float> stamps = {0, 0.125, 0.25, 0.5, 0.6, 0.875, 1.0};
+  Cloud cloud;
+  cloud.header.frame_id = filter->filteringFrame;
+  CloudModifier mod(cloud);
+  mod.setPointCloud2Fields(4,
+                           "x", 1, sensor_msgs::PointField::FLOAT32,
+                           "y", 1, sensor_msgs::PointField::FLOAT32,
+                           "z", 1, sensor_msgs::PointField::FLOAT32,
+                           "stamps", 1, sensor_msgs::PointField::FLOAT32);
+  mod.resize(stamps.size());
+
+  {
+    CloudIter x_it(cloud, "x");
+    CloudIter y_it(cloud, "y");
+    CloudIter z_it(cloud, "z");
+    CloudIter stamps_it(cloud, "stamps");
+    for (const auto stamp : stamps)
+    {
+      *x_it = -3; *y_it = 0; *z_it = 0; *stamps_it = stamp;
+      ++x_it, ++y_it, ++z_it, ++stamps_it;
+    }
+  }
+
+  // the laser moves non-linearly during the scan
+  ros::Time now = ros::Time::now();
+  cloud.header.stamp = now;
+  {
+    geometry_msgs::TransformStamped tf;
+    tf.transform.rotation.w = 1.0;
+    for (int i = -100; i < 100; ++i)
+    {
+      const auto d = i * 0.05;
+      tf.header.stamp = now + ros::Duration(d);
+
+      tf.transform.translation.x = 0.122 + d * d;
+      tf.transform.translation.z = 0;
+      tf.header.frame_id = "odom";
+      tf.child_frame_id = "base_link";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = -1.5 - 0.122;
+      tf.transform.translation.z = d * d * d;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "laser";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = 0.01864 - 0.122;
+      tf.transform.translation.z = 0;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "antenna";
+      filter->tfBuffer->setTransform(tf, "test");
+    }
+  }
+
+  while (!filter->tfFramesWatchdog->isReachable("antenna"))
+    ros::WallDuration(0.01).sleep();
+  while (!filter->tfFramesWatchdog->isReachable("laser"))
+    ros::WallDuration(0.01).sleep();
+
+  std::vector<RayCastingShapeMask::MaskValue> mask;
+  ASSERT_TRUE(filter->computeMask(cloud, mask, "laser"));
+  ASSERT_EQ(stamps.size(), mask.size());
+  ASSERT_EQ(stamps.size(), filter->viewpoints.size());
+
+  // the sensor origin is sampled at the keyframes (every 0.25 s) and interpolated linearly between them
+  const auto getSensorPosition = [&](const double time)
+  {
+    const auto sensorTf = filter->tfBuffer->lookupTransform("odom", "laser", now + ros::Duration(time));
+    return tf2::transformToEigen(sensorTf.transform).translation();
+  };
+  const auto getInterpolatedSensorPosition = [&](const double time)
+  {
+    const auto keyframeTime = std::floor(time / 0.25) * 0.25;
+    const auto t = (time - keyframeTime) / 0.25;
+    return Eigen::Vector3d(getSensorPosition(keyframeTime) * (1 - t) + getSensorPosition(keyframeTime + 0.25) * t);
+  };
+
+  const EigenSTL::vector_Vector3d expectedViewpoints = {
+      getSensorPosition(0),
+      getInterpolatedSensorPosition(0.125),
+      getSensorPosition(0.25),
+      getSensorPosition(0.5),
+      getInterpolatedSensorPosition(0.6),
+      getInterpolatedSensorPosition(0.875),
+      getSensorPosition(1.0),
+  };
+
+  for (size_t i = 0; i < stamps.size(); ++i)
+  {
+    SCOPED_TRACE("Point " + std::to_string(i));
+    EXPECT_NEAR(expectedViewpoints[i].x(), filter->viewpoints[i].x(), 1e-5);
+    EXPECT_NEAR(expectedViewpoints[i].y(), filter->viewpoints[i].y(), 1e-5);
+    EXPECT_NEAR(expectedViewpoints[i].z(), filter->viewpoints[i].z(), 1e-5);
+  }
+
+  // the laser really moves non-linearly, so the keyframes in the middle of the scan make a difference
+  EXPECT_GT((getSensorPosition(0.125) - filter->viewpoints[1]).norm(), 1e-4);
+
+  // the sensor poses were looked up together with the link poses
+  EXPECT_EQ(5u, filter->numSensorKeyframesFound);
+
+  // if the sensor pose is not available, the scan is not filtered and nothing throws
+  cloud.header.stamp = now - ros::Duration(100);
+  EXPECT_FALSE(filter->computeMask(cloud, mask, "laser"));
+  EXPECT_EQ(0u, filter->numSensorKeyframesFound);
+}
+
+TEST(RobotBodyFilter, ViewpointsFromTfWithoutSensorFrame)
+{
+  ros::NodeHandle nh;
+
+  auto filter = std::make_shared<RobotBodyFilterLaserScanTest>();
+  auto filterBase = std::dynamic_pointer_cast<filters::FilterBase<sensor_msgs::LaserScan>>(filter);
+
+  nh.setParam("test_robot_description", ROBOT_URDF);
+  filterBase->configure("compute_mask_config_keyframes_no_sensor_frame", nh);
+
+  // the viewpoints can't be computed from TF without knowing the sensor frame
+  EXPECT_TRUE(filter->sensorFrame.empty());
+  EXPECT_FALSE(filter->viewpointsFromTf);
+}
+
+TEST(RobotBodyFilter, TransformCacheSlots)
+{
+  ros::NodeHandle nh;
+
+  auto filter = std::make_shared<RobotBodyFilterPointCloud2Test>();
+  auto filterBase = std::dynamic_pointer_cast<filters::FilterBase<sensor_msgs::PointCloud2>>(filter);
+
+  nh.setParam("test_robot_description", ROBOT_URDF);
+  filterBase->configure("compute_mask_config_all_at_once", nh);
+
+  // each collision has its own slot shared by all its shapes; collisions of one link share the link slot
+  ASSERT_EQ(4u, filter->collisionBodies.size());
+  ASSERT_EQ(3u, filter->collisionLinkFrames.size());
+  std::map<std::string, size_t> cacheSlots;
+  for (size_t slot = 0; slot < filter->collisionBodies.size(); ++slot)
+  {
+    const auto& collisionBody = filter->collisionBodies[slot];
+    EXPECT_EQ(slot, collisionBody.cacheSlot);
+    ASSERT_LT(collisionBody.linkSlot, filter->collisionLinkFrames.size());
+    EXPECT_EQ(collisionBody.link->name, filter->collisionLinkFrames[collisionBody.linkSlot]);
+    cacheSlots[collisionBody.cacheKey] = slot;
+  }
+  ASSERT_EQ(4u, cacheSlots.size());
+  EXPECT_EQ(filter->collisionBodies[cacheSlots["base_link-0"]].linkSlot,
+            filter->collisionBodies[cacheSlots["base_link-1"]].linkSlot);
+  EXPECT_NE(filter->collisionBodies[cacheSlots["base_link-0"]].linkSlot,
+            filter->collisionBodies[cacheSlots["antenna-0"]].linkSlot);
+
+  for (const auto& shapeToLink : filter->shapesToLinks)
+  {
+    ASSERT_LT(shapeToLink.first, filter->shapeCacheSlots.size());
+    EXPECT_EQ(static_cast<int>(cacheSlots[shapeToLink.second.cacheKey]), filter->shapeCacheSlots[shapeToLink.first]);
+  }
+
+  // the links move relative to each other
+  ros::Time now = ros::Time::now();
+  {
+    geometry_msgs::TransformStamped tf;
+    tf.transform.rotation.w = 1.0;
+    for (double d = -5.0; d < 5.0; d += 0.1)
+    {
+      tf.header.stamp = now + ros::Duration(d);
+
+      tf.transform.translation.x = 0.122;
+      tf.transform.translation.y = 0;
+      tf.header.frame_id = "odom";
+      tf.child_frame_id = "base_link";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = -1.5 - 0.122;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "laser";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = 0.01864 - 0.122;
+      tf.transform.translation.y = 0.5;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "antenna";
+      filter->tfBuffer->setTransform(tf, "test");
+    }
+  }
+
+  while (!filter->tfFramesWatchdog->isReachable("antenna"))
+    ros::WallDuration(0.01).sleep();
+  while (!filter->tfFramesWatchdog->isReachable("laser"))
+    ros::WallDuration(0.01).sleep();
+
+  filter->updateTransformCache(now);
+
+  // poses of the collisions relative to their links
+  const std::map<std::string, Eigen::Vector3d> collisionOffsets = {
+      {"base_link-0", {-0.122, 0, 0}},
+      {"base_link-1", {-0.1, 0, 0}},
+      {"antenna-0", {-0.01864, 0, 0}},
+      {"laser-0", {0, 0, 0}},
+  };
+
+  for (const auto& shapeToLink : filter->shapesToLinks)
+  {
+    SCOPED_TRACE(shapeToLink.second.cacheKey);
+    const auto linkTf = filter->tfBuffer->lookupTransform(filter->filteringFrame, shapeToLink.second.link->name, now);
+    const Eigen::Vector3d expectedPosition = tf2::transformToEigen(linkTf.transform) *
+        collisionOffsets.at(shapeToLink.second.cacheKey);
+
+    Eigen::Isometry3d transform;
+    ASSERT_TRUE(filter->getShapeTransform(shapeToLink.first, transform));
+    EXPECT_NEAR(expectedPosition.x(), transform.translation().x(), 1e-6);
+    EXPECT_NEAR(expectedPosition.y(), transform.translation().y(), 1e-6);
+    EXPECT_NEAR(expectedPosition.z(), transform.translation().z(), 1e-6);
+  }
+
+  // handles not belonging to any collision are rejected
+  Eigen::Isometry3d transform;
+  EXPECT_FALSE(filter->getShapeTransform(filter->shapeCacheSlots.size(), transform));
+}
+
 TEST(RobotBodyFilter, ComputeMaskAllAtOnce)
 {
   ros::NodeHandle nh;
@@ -2403,6 +2899,114 @@ TEST(RobotBodyFilter, UpdateLaserScan)
   EXPECT_EQ(1.5, outScan.ranges[18]); EXPECT_EQ(18, outScan.intensities[18]);
 }
 
+TEST(RobotBodyFilter, UpdateLaserScanDirectly)
+{
+  ros::NodeHandle nh;
+
+  auto filter = std::make_shared<RobotBodyFilterLaserScanTest>();
+  auto filterBase = std::dynamic_pointer_cast<filters::FilterBase<sensor_msgs::LaserScan>>(filter);
+
+  nh.setParam("test_robot_description", ROBOT_URDF);
+  filterBase->configure("compute_mask_config_direct_scan", nh);
+
+  ASSERT_TRUE(filter->directScanClassification);
+
+  // a full circle of beams, the robot is in front of the laser (at angle 0)
+  sensor_msgs::LaserScan scan;
+  scan.header.frame_id = "laser";
+  scan.range_min = 0.01;
+  scan.range_max = 20;
+  scan.angle_min = -M_PI;
+  scan.angle_max = M_PI - M_PI / 18;
+  scan.angle_increment = M_PI / 18;
+  for (size_t i = 0; i < 36; ++i)
+  {
+    scan.intensities.push_back(i);
+    scan.ranges.push_back(2.0);
+  }
+  scan.ranges[15] = 1.0;  // inside
+  scan.ranges[16] = std::numeric_limits<float>::quiet_NaN();  // invalid
+  scan.ranges[17] = 4.0;  // shadow
+  scan.ranges[18] = 1.5;  // inside
+  scan.ranges[19] = 0.05;  // clipped by min_distance
+  scan.ranges[20] = 15.0;  // clipped by max_distance
+  scan.ranges[21] = std::numeric_limits<float>::infinity();  // invalid
+  scan.ranges[22] = 25.0;  // invalid, above range_max
+  scan.ranges[23] = 0.005;  // invalid, below range_min
+  for (size_t i = 24; i < 27; ++i)
+    scan.ranges[i] = 3.0;  // shadow or outside
+
+  {
+    geometry_msgs::TransformStamped tf;
+    ros::Time now = ros::Time::now();
+    scan.header.stamp = now;
+    tf.transform.rotation.w = 1;
+    for (double d = -5.0; d < 5.0; d += 0.1)
+    {
+      tf.header.stamp = now + ros::Duration(d);
+
+      tf.transform.translation.x = 0.122;
+      tf.header.frame_id = "odom";
+      tf.child_frame_id = "base_link";
+      ASSERT_TRUE(filter->tfBuffer->setTransform(tf, "test"));
+
+      tf.transform.translation.x = -1.5 - 0.122;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "laser";
+      ASSERT_TRUE(filter->tfBuffer->setTransform(tf, "test"));
+
+      tf.transform.translation.x = 0.01864 - 0.122;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "antenna";
+      ASSERT_TRUE(filter->tfBuffer->setTransform(tf, "test"));
+    }
+  }
+
+  // give TF frames watchdog some time to catch up
+  while (!filter->tfFramesWatchdog->isReachable("laser"))
+    ros::WallDuration(0.01).sleep();
+  while (!filter->tfFramesWatchdog->isReachable("base_link"))
+    ros::WallDuration(0.01).sleep();
+  while (!filter->tfFramesWatchdog->isReachable("antenna"))
+    ros::WallDuration(0.01).sleep();
+
+  sensor_msgs::LaserScan directScan;
+  ASSERT_TRUE(filter->update(scan, directScan));
+
+  // the same scan classified via the projected pointcloud
+  filter->directScanClassification = false;
+  sensor_msgs::LaserScan cloudScan;
+  ASSERT_TRUE(filter->update(scan, cloudScan));
+
+  ASSERT_EQ(36u, directScan.ranges.size());
+  ASSERT_EQ(36u, cloudScan.ranges.size());
+  EXPECT_EQ(cloudScan.range_min, directScan.range_min);
+  EXPECT_EQ(cloudScan.range_max, directScan.range_max);
+  for (size_t i = 0; i < 36; ++i)
+  {
+    SCOPED_TRACE("Beam " + std::to_string(i));
+    if (std::isnan(cloudScan.ranges[i]))
+      EXPECT_NAN(directScan.ranges[i]);
+    else
+      EXPECT_EQ(cloudScan.ranges[i], directScan.ranges[i]);
+    EXPECT_EQ(cloudScan.intensities[i], directScan.intensities[i]);
+  }
+
+  // make sure all the cases were exercised
+  EXPECT_EQ(2.0, directScan.ranges[0]);
+  EXPECT_EQ(2.0, directScan.ranges[9]);
+  EXPECT_NAN(directScan.ranges[15]);
+  EXPECT_NAN(directScan.ranges[16]);
+  EXPECT_NAN(directScan.ranges[17]);
+  EXPECT_NAN(directScan.ranges[18]);
+  EXPECT_NAN(directScan.ranges[19]);
+  EXPECT_NAN(directScan.ranges[20]);
+  EXPECT_EQ(std::numeric_limits<float>::infinity(), directScan.ranges[21]);
+  EXPECT_EQ(25.0, directScan.ranges[22]);
+  EXPECT_FLOAT_EQ(0.005, directScan.ranges[23]);
+  EXPECT_EQ(2.0, directScan.ranges[27]);
+}
+
 TEST(RobotBodyFilter, UpdatePointCloud2)
 {
   ros::NodeHandle nh;
@@ -2554,6 +3158,314 @@ TEST(RobotBodyFilter, UpdatePointCloud2)
   ++x_it, ++y_it, ++z_it;
 }
 
+TEST(RobotBodyFilter, ComputeMaskDepthCamera)
+{
+  ros::NodeHandle nh;
+
+  auto filter = std::make_shared<RobotBodyFilterPointCloud2Test>();
+  auto filterBase = std::dynamic_pointer_cast<filters::FilterBase<sensor_msgs::PointCloud2>>(filter);
+
+  nh.setParam("test_robot_description", ROBOT_URDF);
+  filterBase->configure("compute_mask_config_depth_camera", nh);
+
+  // the camera looks along its z axis at the robot which is 4 m in front of it
+  sensor_msgs::CameraInfo cameraInfo;
+  cameraInfo.header.frame_id = "camera";
+  cameraInfo.width = 4;
+  cameraInfo.height = 3;
+  cameraInfo.K = {8, 0, 1.5, 0, 8, 1, 0, 0, 1};
+
+  auto cameraInfoPublisher = nh.advertise<sensor_msgs::CameraInfo>("/test_camera_info", 1, true);
+  cameraInfoPublisher.publish(cameraInfo);
+  WAIT_FOR_MESSAGE(filter->cameraInfo)
+
+  Cloud cloud;
+  cloud.header.frame_id = "camera";
+  CloudModifier mod(cloud);
+  mod.setPointCloud2Fields(3,
+                           "x", 1, sensor_msgs::PointField::FLOAT32,
+                           "y", 1, sensor_msgs::PointField::FLOAT32,
+                           "z", 1, sensor_msgs::PointField::FLOAT32);
+  mod.resize(12);
+  cloud.width = 4;
+  cloud.height = 3;
+  cloud.row_step = cloud.width * cloud.point_step;
+
+  {
+    CloudIter x_it(cloud, "x");
+    CloudIter y_it(cloud, "y");
+    CloudIter z_it(cloud, "z");
+
+    // point on the ray of pixel (u, v) in the given depth
+    const auto setPixelPoint = [&](const double u, const double v, const double depth)
+    {
+      *x_it = (u - 1.5) / 8 * depth; *y_it = (v - 1) / 8 * depth; *z_it = depth; ++x_it, ++y_it, ++z_it;
+    };
+
+    setPixelPoint(0, 0, 0.05); // pointClipMin
+    setPixelPoint(1, 0, 2); // pointOutside
+    setPixelPoint(2, 0, 4); // pointInside
+    setPixelPoint(3, 0, 8); // pointShadow
+    setPixelPoint(0, 1, 12); // pointClipMax
+    setPixelPoint(1, 1, 4); // pointInside2
+    setPixelPoint(1, 1, 8); // pointShadowSamePixel (pixel (1, 1) already sees pointInside2)
+    *x_it = 0; *y_it = 0; *z_it = -1; ++x_it, ++y_it, ++z_it; // pointBehindCamera
+    *x_it = 1.1; *y_it = 0; *z_it = 4; ++x_it, ++y_it, ++z_it; // pointInsideOutOfImage
+    *x_it = 2.5; *y_it = 0; *z_it = 9; ++x_it, ++y_it, ++z_it; // pointShadowOutOfImage
+    setPixelPoint(2, 2, 2); // pointOutside2
+    *x_it = std::numeric_limits<float>::quiet_NaN(); *y_it = 0; *z_it = 0; ++x_it, ++y_it, ++z_it; // pointInvalid
+  }
+
+  {
+    ros::Time now = ros::Time::now();
+    cloud.header.stamp = now;
+    geometry_msgs::TransformStamped tf;
+    tf.transform.rotation.w = 1.0;
+    for (double d = -5.0; d < 5.0; d += 0.1)
+    {
+      tf.header.stamp = now + ros::Duration(d);
+
+      tf.transform.translation.x = 0.122;
+      tf.header.frame_id = "odom";
+      tf.child_frame_id = "base_link";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = -1.5 - 0.122;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "laser";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = 0.01864 - 0.122;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "antenna";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = 1.5;
+      tf.transform.translation.z = -4;
+      tf.header.frame_id = "laser";
+      tf.child_frame_id = "camera";
+      filter->tfBuffer->setTransform(tf, "test");
+      tf.transform.translation.z = 0;
+    }
+  }
+
+  filter->tfFramesWatchdog->addMonitoredFrame("camera");
+  while (!filter->tfFramesWatchdog->isReachable("camera"))
+    ros::WallDuration(0.01).sleep();
+  while (!filter->tfFramesWatchdog->isReachable("antenna"))
+    ros::WallDuration(0.01).sleep();
+
+  // the organized cloud matching the camera info is filtered by the depth camera
+  DepthCamera camera;
+  ASSERT_TRUE(filter->getDepthCamera(cloud, camera));
+  EXPECT_EQ(4u, camera.width);
+  EXPECT_EQ(3u, camera.height);
+  EXPECT_EQ(8, camera.fx);
+  EXPECT_EQ(8, camera.fy);
+  EXPECT_EQ(1.5, camera.cx);
+  EXPECT_EQ(1, camera.cy);
+
+  std::vector<RayCastingShapeMask::MaskValue> mask;
+  {
+    std::lock_guard<std::mutex> guard(*filter->modelMutex);
+    ASSERT_TRUE(filter->computeMask(cloud, mask, "camera", &camera));
+  }
+
+  ASSERT_EQ(num_points(cloud), mask.size());
+  EXPECT_EQ(RayCastingShapeMask::MaskValue::CLIP, mask[0]); // pointClipMin
+  EXPECT_EQ(RayCastingShapeMask::MaskValue::OUTSIDE, mask[1]); // pointOutside
+  EXPECT_EQ(RayCastingShapeMask::MaskValue::INSIDE, mask[2]); // pointInside
+  EXPECT_EQ(RayCastingShapeMask::MaskValue::SHADOW, mask[3]); // pointShadow
+  EXPECT_EQ(RayCastingShapeMask::MaskValue::CLIP, mask[4]); // pointClipMax
+  EXPECT_EQ(RayCastingShapeMask::MaskValue::INSIDE, mask[5]); // pointInside2
+  // the points not having a pixel of their own are classified by the per-point tests
+  EXPECT_EQ(RayCastingShapeMask::MaskValue::SHADOW, mask[6]); // pointShadowSamePixel
+  EXPECT_EQ(RayCastingShapeMask::MaskValue::OUTSIDE, mask[7]); // pointBehindCamera
+  EXPECT_EQ(RayCastingShapeMask::MaskValue::INSIDE, mask[8]); // pointInsideOutOfImage
+  EXPECT_EQ(RayCastingShapeMask::MaskValue::SHADOW, mask[9]); // pointShadowOutOfImage
+  EXPECT_EQ(RayCastingShapeMask::MaskValue::OUTSIDE, mask[10]); // pointOutside2
+  EXPECT_EQ(RayCastingShapeMask::MaskValue::OUTSIDE, mask[11]); // pointInvalid
+
+  // the per-point tests give the same results for this cloud
+  std::vector<RayCastingShapeMask::MaskValue> perPointMask;
+  {
+    std::lock_guard<std::mutex> guard(*filter->modelMutex);
+    ASSERT_TRUE(filter->computeMask(cloud, perPointMask, "camera"));
+  }
+  EXPECT_EQ(perPointMask, mask);
+
+  sensor_msgs::PointCloud2 outCloud;
+  ASSERT_TRUE(filter->update(cloud, outCloud));
+
+  ASSERT_EQ(num_points(cloud), num_points(outCloud));
+  EXPECT_EQ("camera", outCloud.header.frame_id);
+  EXPECT_EQ(cloud.height, outCloud.height);
+  EXPECT_EQ(cloud.width, outCloud.width);
+
+  CloudConstIter x_it(cloud, "x");
+  CloudConstIter out_x_it(outCloud, "x");
+  CloudConstIter out_z_it(outCloud, "z");
+  for (size_t i = 0; i < num_points(cloud); ++i, ++x_it, ++out_x_it, ++out_z_it)
+  {
+    SCOPED_TRACE("Point " + std::to_string(i));
+    if (mask[i] == RayCastingShapeMask::MaskValue::OUTSIDE && !std::isnan(*x_it))
+    {
+      EXPECT_NEAR(*x_it, *out_x_it, 1e-6);
+    }
+    else
+    {
+      EXPECT_NAN(*out_x_it); EXPECT_NAN(*out_z_it);
+    }
+  }
+
+  // camera info not matching the cloud is ignored and the cloud is filtered point by point
+  cameraInfo.width = 12;
+  cameraInfo.height = 1;
+  filter->cameraInfo.reset();
+  cameraInfoPublisher.publish(cameraInfo);
+  WAIT_FOR_MESSAGE(filter->cameraInfo)
+  EXPECT_FALSE(filter->getDepthCamera(cloud, camera));
+
+  ASSERT_TRUE(filter->update(cloud, outCloud));
+  out_x_it = CloudConstIter(outCloud, "x");
+  for (size_t i = 0; i < num_points(cloud); ++i, ++out_x_it)
+  {
+    SCOPED_TRACE("Point " + std::to_string(i));
+    EXPECT_EQ(mask[i] == RayCastingShapeMask::MaskValue::OUTSIDE && i != 11, !std::isnan(*out_x_it));
+  }
+}
+
+TEST(RobotBodyFilter, ForwardKinematics)
+{
+  ros::NodeHandle nh;
+
+  auto filter = std::make_shared<RobotBodyFilterPointCloud2Test>();
+  auto filterBase = std::dynamic_pointer_cast<filters::FilterBase<sensor_msgs::PointCloud2>>(filter);
+
+  // the payload is attached by a floating joint, which never comes in joint states
+  const std::string payloadUrdf =
+      "    <link name=\"payload\">\n"
+      "        <collision>\n"
+      "            <origin rpy=\"0 0 0\" xyz=\"0 0 0\"/>\n"
+      "            <geometry><box size=\"0.1 0.1 0.1\"/></geometry>\n"
+      "        </collision>\n"
+      "    </link>\n"
+      "    <joint name=\"payload_j\" type=\"floating\">\n"
+      "        <parent link=\"base_link\"/>\n"
+      "        <child link=\"payload\"/>\n"
+      "        <origin rpy=\"0 0 0\" xyz=\"1 0 0\"/>\n"
+      "    </joint>\n";
+  auto fkRobotUrdf = ROBOT_URDF;
+  fkRobotUrdf.insert(fkRobotUrdf.rfind("</robot>"), payloadUrdf);
+
+  nh.setParam("test_fk_robot_description", fkRobotUrdf);
+  filterBase->configure("compute_mask_config_forward_kinematics", nh);
+
+  ASSERT_NE(nullptr, filter->fkRobotModel);
+  EXPECT_EQ("base_link", filter->fkRobotModel->getRootLinkName());
+
+  // TF places the laser and antenna differently than the URDF, so it is visible where their poses come from
+  ros::Time now = ros::Time::now();
+  {
+    geometry_msgs::TransformStamped tf;
+    tf.transform.rotation.w = 1.0;
+    for (double d = -5.0; d < 5.0; d += 0.1)
+    {
+      tf.header.stamp = now + ros::Duration(d);
+
+      tf.transform.translation.x = 0.122;
+      tf.transform.translation.y = 0;
+      tf.transform.translation.z = 0;
+      tf.header.frame_id = "odom";
+      tf.child_frame_id = "base_link";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = -1.5;
+      tf.transform.translation.z = 0.3;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "laser";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = 0.01864;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "antenna";
+      filter->tfBuffer->setTransform(tf, "test");
+
+      tf.transform.translation.x = 1;
+      tf.transform.translation.y = 0.5;
+      tf.transform.translation.z = 0;
+      tf.header.frame_id = "base_link";
+      tf.child_frame_id = "payload";
+      filter->tfBuffer->setTransform(tf, "test");
+    }
+  }
+
+  auto jointStatesPublisher = nh.advertise<sensor_msgs::JointState>("/test_joint_states", 10);
+  for (size_t i = 0; i < 100 && jointStatesPublisher.getNumSubscribers() == 0; ++i)
+    ros::WallDuration(0.01).sleep();
+  ASSERT_LT(0u, jointStatesPublisher.getNumSubscribers());
+
+  sensor_msgs::JointState jointState;
+  jointState.name = {"laser_j"};
+  jointState.header.stamp = now - ros::Duration(1);
+  jointState.position = {-0.5};
+  jointStatesPublisher.publish(jointState);
+  jointState.header.stamp = now + ros::Duration(1);
+  jointState.position = {1.5};
+  jointStatesPublisher.publish(jointState);
+
+  std::vector<double> positions;
+  for (size_t i = 0; i < 100 && !filter->jointStates->getPositions(now + ros::Duration(1), {"laser_j"}, positions); ++i)
+  {
+    ros::spinOnce();
+    ros::WallDuration(0.01).sleep();
+  }
+  ASSERT_TRUE(filter->jointStates->getPositions(now, {"laser_j"}, positions));
+
+  while (!filter->tfFramesWatchdog->isReachable("payload"))
+    ros::WallDuration(0.01).sleep();
+  while (!filter->tfFramesWatchdog->isReachable("laser"))
+    ros::WallDuration(0.01).sleep();
+
+  std::map<std::string, point_containment_filter::ShapeHandle> shapes;
+  for (auto& pair : filter->shapesToLinks)
+    shapes[pair.second.cacheKey] = pair.first;
+  ASSERT_NE(shapes.end(), shapes.find("laser-0"));
+  ASSERT_NE(shapes.end(), shapes.find("antenna-0"));
+  ASSERT_NE(shapes.end(), shapes.find("payload-0"));
+
+  // the laser and antenna come from forward kinematics, the payload from TF
+  filter->updateTransformCache(now);
+
+  Eigen::Isometry3d transform;
+  ASSERT_TRUE(filter->getShapeTransform(shapes["laser-0"], transform));
+  EXPECT_NEAR(0.122 - 1.5, transform.translation().x(), 1e-6);
+  EXPECT_NEAR(0, transform.translation().y(), 1e-6);
+  EXPECT_NEAR(0, transform.translation().z(), 1e-6);
+  EXPECT_TRUE(transform.linear().isApprox(Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitX()).toRotationMatrix(), 1e-6));
+
+  ASSERT_TRUE(filter->getShapeTransform(shapes["antenna-0"], transform));
+  EXPECT_NEAR(0.122, transform.translation().x(), 1e-6);
+  EXPECT_NEAR(0, transform.translation().z(), 1e-6);
+
+  ASSERT_TRUE(filter->getShapeTransform(shapes["payload-0"], transform));
+  EXPECT_NEAR(1.122, transform.translation().x(), 1e-6);
+  EXPECT_NEAR(0.5, transform.translation().y(), 1e-6);
+  EXPECT_NEAR(0, transform.translation().z(), 1e-6);
+
+  // the last joint state is held only for a while, then the laser falls back to TF
+  filter->updateTransformCache(now + ros::Duration(3));
+
+  ASSERT_TRUE(filter->getShapeTransform(shapes["laser-0"], transform));
+  EXPECT_NEAR(0.122 - 1.5, transform.translation().x(), 1e-6);
+  EXPECT_NEAR(0.3, transform.translation().z(), 1e-6);
+  EXPECT_TRUE(transform.linear().isIdentity(1e-6));
+
+  ASSERT_TRUE(filter->getShapeTransform(shapes["antenna-0"], transform));
+  EXPECT_NEAR(0.122, transform.translation().x(), 1e-6);
+  EXPECT_NEAR(0, transform.translation().z(), 1e-6);
+}
+
   int main(int argc, char **argv)
 {
   ros::init(argc, argv, "test_robot_body_filter");
@@ -0,0 +1,108 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <memory>
+
+#include <geometric_shapes/mesh_operations.h>
+#include <robot_body_filter/utils/signed_distance_field.h>
+
+using namespace robot_body_filter;
+
+TEST(SignedDistanceField, MatchesContainsPoint)
+{
+  // box (1.0, 2.0, 3.0)
+  const std::unique_ptr<const shapes::Shape> shape(shapes::createMeshFromResource(
+      "package://robot_body_filter/test/box.dae"));
+
+  for (const auto scale : {1.0, 1.3, 0.7})
+  {
+    for (const auto padding : {0.0, 0.05})
+    {
+      bodies::ConvexMesh body(shape.get());
+      body.setScale(scale);
+      body.setPadding(padding);
+
+      for (const auto resolution : {0.02, 0.05, 0.3})
+      {
+        const SignedDistanceField field(body, resolution);
+        EXPECT_DOUBLE_EQ(resolution, field.getResolution());
+
+        // points out of the tolerance band have to be classified exactly
+        size_t numInside = 0, numOutside = 0;
+        for (size_t i = 0; i < 10000; ++i)
+        {
+          const Eigen::Vector3d point = Eigen::Vector3d::Random() * 2.5;
+          const auto containment = field.classify(point);
+          if (containment == SignedDistanceField::Containment::UNSURE)
+            continue;
+
+          const auto inside = containment == SignedDistanceField::Containment::INSIDE;
+          EXPECT_EQ(body.containsPoint(point), inside) << point.transpose() << ", scale " << scale
+            << ", padding " << padding << ", resolution " << resolution;
+          (inside ? numInside : numOutside)++;
+        }
+        EXPECT_LT(0, numInside);
+        EXPECT_LT(0, numOutside);
+      }
+    }
+  }
+}
+
+TEST(SignedDistanceField, Distance)
+{
+  const std::unique_ptr<const shapes::Shape> shape(shapes::createMeshFromResource(
+      "package://robot_body_filter/test/box.dae"));
+  bodies::ConvexMesh body(shape.get());
+
+  const SignedDistanceField field(body, 0.05);
+  const Eigen::Vector3d halfSize(0.5, 1.0, 1.5);
+  for (size_t i = 0; i < 10000; ++i)
+  {
+    const Eigen::Vector3d point = Eigen::Vector3d::Random().cwiseProduct(halfSize + Eigen::Vector3d::Constant(0.2));
+    // outside the box, the sampled function is the distance from the farthest face plane
+    const auto expected = (point.cwiseAbs() - halfSize).maxCoeff();
+    EXPECT_NEAR(expected, field.getDistance(point), field.getTolerance()) << point.transpose();
+  }
+}
+
+TEST(SignedDistanceField, PoseIsIgnored)
+{
+  const std::unique_ptr<const shapes::Shape> shape(shapes::createMeshFromResource(
+      "package://robot_body_filter/test/box.dae"));
+  bodies::ConvexMesh body(shape.get());
+  body.setPose(Eigen::Isometry3d(Eigen::Translation3d(10.0, 0.0, 0.0)));
+
+  const SignedDistanceField field(body, 0.05);
+  EXPECT_EQ(SignedDistanceField::Containment::INSIDE, field.classify({0.0, 0.0, 0.0}));
+  EXPECT_EQ(SignedDistanceField::Containment::OUTSIDE, field.classify({10.0, 0.0, 0.0}));
+}
+
+TEST(SignedDistanceField, OutsideGrid)
+{
+  const std::unique_ptr<const shapes::Shape> shape(shapes::createMeshFromResource(
+      "package://robot_body_filter/test/box.dae"));
+  bodies::ConvexMesh body(shape.get());
+
+  const SignedDistanceField field(body, 0.1);
+  EXPECT_EQ(SignedDistanceField::Containment::OUTSIDE, field.classify({100.0, 0.0, 0.0}));
+  EXPECT_EQ(SignedDistanceField::Containment::OUTSIDE, field.classify({0.0, -100.0, 0.0}));
+  EXPECT_EQ(SignedDistanceField::Containment::OUTSIDE, field.classify({0.0, 0.0, NAN}));
+  EXPECT_TRUE(std::isinf(field.getDistance({100.0, 0.0, 0.0})));
+}
+
+TEST(SignedDistanceField, CoarsenTooFineGrid)
+{
+  const std::unique_ptr<const shapes::Shape> shape(shapes::createMeshFromResource(
+      "package://robot_body_filter/test/box.dae"));
+  bodies::ConvexMesh body(shape.get());
+
+  const SignedDistanceField field(body, 1e-4);
+  EXPECT_LT(1e-4, field.getResolution());
+  EXPECT_GE(SignedDistanceField::MAX_NODES, static_cast<size_t>(field.getSize().prod()));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,79 @@
+#include "gtest/gtest.h"
+
+#include <memory>
+
+#include <robot_body_filter/utils/single_precision_body.h>
+#include <geometric_shapes/body_operations.h>
+#include <geometric_shapes/mesh_operations.h>
+#include <geometric_shapes/shapes.h>
+#include "utils.cpp"
+
+using namespace robot_body_filter;
+
+TEST(SinglePrecisionBody, Unsupported)
+{
+  const auto mesh = std::unique_ptr<shapes::Mesh>(shapes::createMeshFromShape(shapes::Box(1, 1, 1)));
+  const auto body = std::unique_ptr<bodies::Body>(bodies::createBodyFromShape(mesh.get()));
+  const SinglePrecisionBody floatBody(*body);
+
+  EXPECT_EQ(SinglePrecisionBody::Type::UNSUPPORTED, floatBody.getType());
+  EXPECT_FALSE(floatBody.containsPoint({0, 0, 0}));
+  EXPECT_FALSE(floatBody.intersectsRay({-2, 0, 0}, {1, 0, 0}, 10));
+}
+
+TEST(SinglePrecisionBody, CompareToDouble)
+{
+  const std::vector<std::shared_ptr<shapes::Shape>> shapes = {
+    std::make_shared<shapes::Sphere>(0.5),
+    std::make_shared<shapes::Box>(0.4, 0.8, 1.2),
+    std::make_shared<shapes::Cylinder>(0.3, 1.0),
+  };
+  const std::vector<SinglePrecisionBody::Type> types = {
+    SinglePrecisionBody::Type::SPHERE,
+    SinglePrecisionBody::Type::BOX,
+    SinglePrecisionBody::Type::CYLINDER,
+  };
+
+  for (size_t s = 0; s < shapes.size(); ++s)
+  {
+    const auto body = std::unique_ptr<bodies::Body>(bodies::createBodyFromShape(shapes[s].get()));
+    body->setScale(1.1);
+    body->setPadding(0.02);
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+      body->setPose(randomPose());
+      const SinglePrecisionBody floatBody(*body);
+      EXPECT_EQ(types[s], floatBody.getType());
+
+      EigenSTL::vector_Vector3d intersections;
+      for (size_t j = 0; j < 100; ++j)
+      {
+        // points this far from the surface have to be classified the same way
+        const Eigen::Vector3d point = body->getPose().translation() + Eigen::Vector3d::Random();
+        EXPECT_EQ(body->containsPoint(point), floatBody.containsPoint(point.cast<float>()));
+
+        const Eigen::Vector3d target = body->getPose().translation() + 2 * Eigen::Vector3d::Random();
+        const Eigen::Vector3d dir = (target - point).normalized();
+        const auto distance = (target - point).norm();
+
+        intersections.clear();
+        const auto expected = body->intersectsRay(point, dir, &intersections, 1) &&
+            dir.dot(target - intersections[0]) >= 0.0;
+        const auto result = floatBody.intersectsRay(point.cast<float>(), dir.cast<float>(),
+            static_cast<float>(distance));
+
+        // skip rays just grazing the surface or ending at it, where rounding errors may decide
+        if (!intersections.empty() && std::abs(dir.dot(target - intersections[0])) < 1e-4)
+          continue;
+        EXPECT_EQ(expected, result) << "Shape " << s << ", pose " << i << ", ray " << j;
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,99 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <limits>
+
+#include <robot_body_filter/utils/spherical_depth_map.h>
+
+using namespace robot_body_filter;
+
+TEST(SphericalDepthMap, Empty)
+{
+  SphericalDepthMap map(0.05);
+  map.reset({1, 2, 3});
+  EXPECT_EQ(Eigen::Vector3d(1, 2, 3), map.getOrigin());
+  EXPECT_EQ(std::numeric_limits<float>::infinity(), map.getMinDistance(Eigen::Vector3d(5, 5, 5)));
+  EXPECT_EQ(std::numeric_limits<float>::infinity(), map.getMinDistance(Eigen::Vector3f(-5, 0, 0)));
+}
+
+TEST(SphericalDepthMap, Sphere)
+{
+  SphericalDepthMap map(0.05);
+  map.reset({0, 0, 0});
+  map.addSphere({2, 0, 0}, 0.5);
+
+  // points in the direction of the sphere
+  EXPECT_NEAR(1.5, map.getMinDistance(Eigen::Vector3d(1, 0, 0)), 1e-5);
+  EXPECT_NEAR(1.5, map.getMinDistance(Eigen::Vector3d(10, 0.1, -0.1)), 1e-5);
+  EXPECT_NEAR(1.5, map.getMinDistance(Eigen::Vector3f(10, 0.1, -0.1)), 1e-5);
+  EXPECT_GE(1.5, map.getMinDistance(Eigen::Vector3d(1, 0, 0)));
+
+  // points in other directions
+  EXPECT_EQ(std::numeric_limits<float>::infinity(), map.getMinDistance(Eigen::Vector3d(-1, 0, 0)));
+  EXPECT_EQ(std::numeric_limits<float>::infinity(), map.getMinDistance(Eigen::Vector3d(0, 1, 0)));
+  EXPECT_EQ(std::numeric_limits<float>::infinity(), map.getMinDistance(Eigen::Vector3d(0, 0, 1)));
+
+  // the nearest sphere wins
+  map.addSphere({3, 0, 0}, 2.0);
+  EXPECT_NEAR(1.0, map.getMinDistance(Eigen::Vector3d(1, 0, 0)), 1e-5);
+  map.reset({0, 0, 0});
+  EXPECT_EQ(std::numeric_limits<float>::infinity(), map.getMinDistance(Eigen::Vector3d(1, 0, 0)));
+}
+
+TEST(SphericalDepthMap, OriginInsideSphere)
+{
+  SphericalDepthMap map(0.05);
+  map.reset({0, 0, 0});
+  map.addSphere({0.1, 0, 0}, 0.5);
+  EXPECT_EQ(0.0f, map.getMinDistance(Eigen::Vector3d(1, 0, 0)));
+  EXPECT_EQ(0.0f, map.getMinDistance(Eigen::Vector3d(-1, 0, 0)));
+  EXPECT_EQ(0.0f, map.getMinDistance(Eigen::Vector3d(0, 0, -1)));
+}
+
+TEST(SphericalDepthMap, Conservative)
+{
+  // directions to all points of the spheres have to get a depth not larger than the sphere distance
+  for (const auto resolution : {0.003, 0.01, 0.1, 0.5})
+  {
+    SphericalDepthMap map(resolution);
+    for (size_t i = 0; i < 50; ++i)
+    {
+      const Eigen::Vector3d origin = Eigen::Vector3d::Random();
+      map.reset(origin);
+      Eigen::Vector3d center = Eigen::Vector3d::Random() * 5.0;
+      // also test spheres around the poles and the azimuth wrap-around
+      if (i % 5 == 1)
+        center = origin + Eigen::Vector3d(0.01, 0.0, 3.0);
+      else if (i % 5 == 2)
+        center = origin + Eigen::Vector3d(-3.0, 0.0, 0.0);
+      const double radius = 0.05 + std::abs(Eigen::Vector3d::Random().x());
+      map.addSphere(center, radius);
+
+      for (size_t j = 0; j < 1000; ++j)
+      {
+        const Eigen::Vector3d surfacePoint = center + Eigen::Vector3d::Random().normalized() * radius;
+        const auto distance = (surfacePoint - origin).norm();
+        // a point further along the same direction
+        const Eigen::Vector3d point = origin + (surfacePoint - origin) * 3.0;
+        EXPECT_GE(distance, map.getMinDistance(point)) << "resolution " << resolution;
+        EXPECT_GE(distance, map.getMinDistance(Eigen::Vector3f(point.cast<float>())));
+      }
+    }
+  }
+}
+
+TEST(SphericalDepthMap, Resolution)
+{
+  SphericalDepthMap map;
+  EXPECT_DOUBLE_EQ(0.01, map.getAngularResolution());
+  map.setAngularResolution(0.1);
+  EXPECT_DOUBLE_EQ(0.1, map.getAngularResolution());
+  EXPECT_THROW(map.setAngularResolution(0.0), std::runtime_error);
+  EXPECT_THROW(map.setAngularResolution(-1.0), std::runtime_error);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,6 +1,8 @@
 #include "gtest/gtest.h"
 #include <robot_body_filter/TfFramesWatchdog.h>
 
+#include <thread>
+
 using namespace robot_body_filter;
 
 class TestWatchdog : public TFFramesWatchdog
@@ -9,18 +11,23 @@ class TestWatchdog : public TFFramesWatchdog
   TestWatchdog(const std::string &robotFrame,
                const std::set<std::string> &monitoredFrames,
                const std::shared_ptr<tf2_ros::Buffer> &tfBuffer,
-               const ros::Duration &unreachableTfLookupTimeout,
                const ros::Rate &unreachableFramesCheckRate) :
-    TFFramesWatchdog(robotFrame, monitoredFrames, tfBuffer, unreachableTfLookupTimeout,
-        unreachableFramesCheckRate)
+    TFFramesWatchdog(robotFrame, monitoredFrames, tfBuffer, unreachableFramesCheckRate)
   {
 
   }
 
   friend class TfFramesWatchdog_Basic_Test;
   friend class TfFramesWatchdog_ThreadControl_Test;
+  friend class TfFramesWatchdog_ReachabilitySnapshot_Test;
   friend class TfFramesWatchdog_SearchForReachableFrames_Test;
+  friend class TfFramesWatchdog_SearchForManyUnreachableFrames_Test;
+  friend class TfFramesWatchdog_ReachableWhileRunning_Test;
   friend class TfFramesWatchdog_LookupTransform_Test;
+  friend class TfFramesWatchdog_LookupTransforms_Test;
+  friend class TfFramesWatchdog_TransformMemo_Test;
+  friend class TfFramesWatchdog_TransformMemoClear_Test;
+  friend class TfFramesWatchdog_TransformMemoStampTolerance_Test;
 };
 
 TEST(TfFramesWatchdog, Basic)
@@ -29,8 +36,7 @@ TEST(TfFramesWatchdog, Basic)
   ros::Time::setNow(ros::Time(1));
 
   const std::shared_ptr<tf2_ros::Buffer> tfBuffer(new tf2_ros::Buffer());
-  TestWatchdog watchdog("base_link", {"left_track", "front_left_flipper"}, tfBuffer,
-      ros::Duration(0.1), ros::Rate(1.0));
+  TestWatchdog watchdog("base_link", {"left_track", "front_left_flipper"}, tfBuffer, ros::Rate(1.0));
 
   EXPECT_TRUE(watchdog.isMonitored("left_track"));
   EXPECT_TRUE(watchdog.isMonitored("front_left_flipper"));
@@ -69,14 +75,70 @@ TEST(TfFramesWatchdog, Basic)
   EXPECT_FALSE(watchdog.isReachable("test"));
 }
 
+TEST(TfFramesWatchdog, ReachabilitySnapshot)
+{
+  ros::Time::init();
+  ros::Time::setNow(ros::Time(1));
+
+  const std::shared_ptr<tf2_ros::Buffer> tfBuffer(new tf2_ros::Buffer());
+  TestWatchdog watchdog("base_link", {"left_track", "front_left_flipper"}, tfBuffer, ros::Rate(1.0));
+
+  const auto snapshot = watchdog.getReachabilitySnapshot();
+  ASSERT_NE(nullptr, snapshot);
+  EXPECT_EQ(2u, snapshot->frameIds.size());
+  EXPECT_TRUE(snapshot->isMonitored("left_track"));
+  EXPECT_FALSE(snapshot->isReachable("left_track"));
+  EXPECT_FALSE(snapshot->isMonitored("base_link"));
+  EXPECT_FALSE(snapshot->allReachable);
+
+  // the IDs are dense
+  std::vector<bool> usedIds(snapshot->frameIds.size(), false);
+  for (const auto& frameId : snapshot->frameIds)
+  {
+    ASSERT_LT(frameId.second, usedIds.size());
+    usedIds[frameId.second] = true;
+  }
+  EXPECT_TRUE(usedIds[0] && usedIds[1]);
+
+  watchdog.markReachable("left_track");
+  EXPECT_TRUE(watchdog.isReachable("left_track"));
+  EXPECT_FALSE(watchdog.areAllFramesReachable());
+  // a published snapshot never changes
+  EXPECT_FALSE(snapshot->isReachable("left_track"));
+  EXPECT_TRUE(watchdog.getReachabilitySnapshot()->isReachable("left_track"));
+
+  watchdog.markReachable("front_left_flipper");
+  EXPECT_TRUE(watchdog.areAllFramesReachable());
+  EXPECT_TRUE(watchdog.getReachabilitySnapshot()->allReachable);
+
+  // marking a reachable frame reachable again doesn't publish a new snapshot
+  const auto allReachableSnapshot = watchdog.getReachabilitySnapshot();
+  watchdog.markReachable("front_left_flipper");
+  EXPECT_EQ(allReachableSnapshot, watchdog.getReachabilitySnapshot());
+
+  watchdog.addMonitoredFrame("rear_left_flipper");
+  EXPECT_TRUE(watchdog.isMonitored("rear_left_flipper"));
+  EXPECT_FALSE(watchdog.isReachable("rear_left_flipper"));
+  EXPECT_FALSE(watchdog.areAllFramesReachable());
+
+  watchdog.setMonitoredFrames({"left_track"});
+  EXPECT_FALSE(watchdog.isMonitored("rear_left_flipper"));
+  EXPECT_TRUE(watchdog.isReachable("left_track"));
+  EXPECT_TRUE(watchdog.areAllFramesReachable());
+
+  watchdog.clear();
+  EXPECT_FALSE(watchdog.isMonitored("left_track"));
+  EXPECT_FALSE(watchdog.isReachable("left_track"));
+  EXPECT_TRUE(watchdog.getReachabilitySnapshot()->frameIds.empty());
+}
+
 TEST(TfFramesWatchdog, ThreadControl)
 {
   ros::Time::init();
   ros::Time::setNow(ros::Time(1));
 
   const std::shared_ptr<tf2_ros::Buffer> tfBuffer(new tf2_ros::Buffer());
-  TestWatchdog watchdog("base_link", {"left_track", "front_left_flipper"}, tfBuffer,
-                        ros::Duration(0.1), ros::Rate(1.0));
+  TestWatchdog watchdog("base_link", {"left_track", "front_left_flipper"}, tfBuffer, ros::Rate(1.0));
 
   EXPECT_FALSE(watchdog.started);
   EXPECT_TRUE(watchdog.paused);
@@ -137,21 +199,19 @@ TEST(TfFramesWatchdog, SearchForReachableFrames)
 
   const std::shared_ptr<tf2_ros::Buffer> tfBuffer(new tf2_ros::Buffer());
   tfBuffer->setUsingDedicatedThread(true);
-  TestWatchdog watchdog("base_link", {"left_track", "front_left_flipper"}, tfBuffer,
-                        ros::Duration(0.1), ros::Rate(1.0));
+  TestWatchdog watchdog("base_link", {"left_track", "front_left_flipper"}, tfBuffer, ros::Rate(1.0));
 
   watchdog.unpause(); // searchForReachableFrames checks this->paused
 
-  ros::Time start = ros::Time::now();
+  ros::WallTime start = ros::WallTime::now();
   watchdog.searchForReachableFrames();
-  ros::Time end = ros::Time::now();
+  ros::WallTime end = ros::WallTime::now();
 
+  // the search does not wait for the frames, it only issues the transformable requests
   EXPECT_FALSE(watchdog.isReachable("left_track"));
   EXPECT_FALSE(watchdog.isReachable("front_left_flipper"));
-  // we're searching for 2 frames; check that the search took at least 2x lookup timeout time, but
-  // it did not take much more
-  EXPECT_LE(2.0 * watchdog.unreachableTfLookupTimeout.toSec(), (end - start).toSec());
-  EXPECT_GE(2.5 * watchdog.unreachableTfLookupTimeout.toSec(), (end - start).toSec());
+  EXPECT_GE(0.05, (end - start).toSec());
+  EXPECT_EQ(2u, watchdog.pendingRequests.size());
 
   geometry_msgs::TransformStamped tf;
   tf.header.frame_id = "base_link";
@@ -163,29 +223,156 @@ TEST(TfFramesWatchdog, SearchForReachableFrames)
     tfBuffer->setTransform(tf, "test");
   }
 
-  start = ros::Time::now();
+  // the request of the connected frame is done and the next search finds the frame reachable
+  EXPECT_EQ(1u, watchdog.pendingRequests.size());
+  EXPECT_TRUE(watchdog.searchRequested);
   watchdog.searchForReachableFrames();
-  end = ros::Time::now();
-
   EXPECT_TRUE(watchdog.isReachable("left_track"));
   EXPECT_FALSE(watchdog.isReachable("front_left_flipper"));
-  // we're searching for 2 frames, one of which should be found immediately; check that the search
-  // took at least 1x lookup timeout time, but it did not take much more
-  EXPECT_LE(1.0 * watchdog.unreachableTfLookupTimeout.toSec(), (end - start).toSec());
-  EXPECT_GE(1.5 * watchdog.unreachableTfLookupTimeout.toSec(), (end - start).toSec());
+  EXPECT_EQ(1u, watchdog.pendingRequests.size());
+  EXPECT_FALSE(watchdog.searchRequested);
 
+  // searching again does not issue a duplicate request
+  watchdog.searchForReachableFrames();
+  EXPECT_EQ(1u, watchdog.pendingRequests.size());
+
+  // the frame gets connected, but only with old data
   tf.header.frame_id = "left_track";
   tf.child_frame_id = "front_left_flipper";
   tf.transform.rotation.w = 1.0;
-  for (double d = -5.0; d < 5.0; d += 0.1)
+  for (double d = -5.0; d < -1.0; d += 0.1)
   {
     tf.header.stamp = ros::Time::now() + ros::Duration(d);
     tfBuffer->setTransform(tf, "test");
   }
 
+  EXPECT_TRUE(watchdog.searchRequested);
   watchdog.searchForReachableFrames();
+  EXPECT_TRUE(watchdog.isReachable("left_track"));
+  EXPECT_FALSE(watchdog.isReachable("front_left_flipper"));
+  EXPECT_EQ(1u, watchdog.pendingRequests.size());
+
+  // the frame becomes reachable as soon as current data arrive, without another search
+  for (double d = -1.0; d < 5.0; d += 0.1)
+  {
+    tf.header.stamp = ros::Time::now() + ros::Duration(d);
+    tfBuffer->setTransform(tf, "test");
+  }
+
   EXPECT_TRUE(watchdog.isReachable("left_track"));
   EXPECT_TRUE(watchdog.isReachable("front_left_flipper"));
+  EXPECT_EQ(0u, watchdog.pendingRequests.size());
+
+  // a frame that is transformable right away is marked reachable by the search itself
+  watchdog.markUnreachable("left_track");
+  EXPECT_FALSE(watchdog.isReachable("left_track"));
+  watchdog.searchForReachableFrames();
+  EXPECT_TRUE(watchdog.isReachable("left_track"));
+  EXPECT_EQ(0u, watchdog.pendingRequests.size());
+
+  // frames that are no longer monitored are not watched
+  watchdog.setMonitoredFrames({"left_track", "rear_left_flipper"});
+  watchdog.searchForReachableFrames();
+  EXPECT_EQ(1u, watchdog.pendingRequests.size());
+  watchdog.setMonitoredFrames({"left_track"});
+  EXPECT_EQ(0u, watchdog.pendingRequests.size());
+}
+
+TEST(TfFramesWatchdog, SearchForManyUnreachableFrames)
+{
+  ros::Time::init(); // use system time for this test so that we don't have problems with timeouts
+
+  const size_t numLinks = 30;
+  std::set<std::string> arm;
+  for (size_t i = 0; i < numLinks; ++i)
+    arm.insert("arm_" + std::to_string(i));
+
+  const std::shared_ptr<tf2_ros::Buffer> tfBuffer(new tf2_ros::Buffer());
+  tfBuffer->setUsingDedicatedThread(true);
+  TestWatchdog watchdog("base_link", arm, tfBuffer, ros::Rate(1.0));
+  watchdog.unpause(); // searchForReachableFrames checks this->paused
+
+  // the whole arm dropped out of TF some time ago
+  geometry_msgs::TransformStamped tf;
+  tf.transform.rotation.w = 1.0;
+  const auto publishArm = [&](const double from, const double to)
+  {
+    for (double d = from; d < to; d += 0.1)
+    {
+      tf.header.stamp = ros::Time::now() + ros::Duration(d);
+      for (size_t i = 0; i < numLinks; ++i)
+      {
+        tf.header.frame_id = i == 0 ? "base_link" : "arm_" + std::to_string(i - 1);
+        tf.child_frame_id = "arm_" + std::to_string(i);
+        tfBuffer->setTransform(tf, "test");
+      }
+    }
+  };
+  publishArm(-5.0, -1.0);
+
+  // a sweep does not depend on the number of unreachable frames
+  const ros::WallTime start = ros::WallTime::now();
+  watchdog.searchForReachableFrames();
+  const ros::WallTime end = ros::WallTime::now();
+
+  EXPECT_GE(0.05, (end - start).toSec());
+  EXPECT_EQ(numLinks, watchdog.pendingRequests.size());
+  EXPECT_FALSE(watchdog.areAllFramesReachable());
+
+  // the whole arm recovers as soon as its TF comes back
+  publishArm(-1.0, 1.0);
+  EXPECT_TRUE(watchdog.areAllFramesReachable());
+  EXPECT_EQ(0u, watchdog.pendingRequests.size());
+}
+
+TEST(TfFramesWatchdog, ReachableWhileRunning)
+{
+  ros::Time::init(); // use system time for this test so that we don't have problems with timeouts
+
+  const std::shared_ptr<tf2_ros::Buffer> tfBuffer(new tf2_ros::Buffer());
+  tfBuffer->setUsingDedicatedThread(true);
+  // the check rate is so low that only the transformable requests can find the frame in time
+  TestWatchdog watchdog("base_link", {"left_track"}, tfBuffer, ros::Rate(0.01));
+  watchdog.start();
+
+  for (size_t i = 0; i < 100; ++i)
+  {
+    if (watchdog.started)
+      break;
+    ros::WallDuration(0.01).sleep();
+  }
+  ASSERT_TRUE(watchdog.started);
+  EXPECT_FALSE(watchdog.isReachable("left_track"));
+
+  geometry_msgs::TransformStamped tf;
+  tf.header.frame_id = "base_link";
+  tf.child_frame_id = "left_track";
+  tf.transform.rotation.w = 1.0;
+  for (double d = -5.0; d < 5.0; d += 0.1)
+  {
+    tf.header.stamp = ros::Time::now() + ros::Duration(d);
+    tfBuffer->setTransform(tf, "test");
+  }
+
+  // added frames are watched immediately
+  watchdog.addMonitoredFrame("front_left_flipper");
+  tf.header.frame_id = "left_track";
+  tf.child_frame_id = "front_left_flipper";
+  for (size_t i = 0; i < 100; ++i)
+  {
+    if (watchdog.isReachable("left_track") && !watchdog.isReachable("front_left_flipper"))
+    {
+      tf.header.stamp = ros::Time::now();
+      tfBuffer->setTransform(tf, "test");
+    }
+    if (watchdog.isReachable("front_left_flipper"))
+      break;
+    ros::WallDuration(0.01).sleep();
+  }
+  EXPECT_TRUE(watchdog.isReachable("left_track"));
+  EXPECT_TRUE(watchdog.isReachable("front_left_flipper"));
+
+  watchdog.stop();
 }
 
 TEST(TfFramesWatchdog, LookupTransform)
@@ -194,8 +381,7 @@ TEST(TfFramesWatchdog, LookupTransform)
 
   const std::shared_ptr<tf2_ros::Buffer> tfBuffer(new tf2_ros::Buffer());
   tfBuffer->setUsingDedicatedThread(true);
-  TestWatchdog watchdog("base_link", {"left_track", "front_left_flipper"}, tfBuffer,
-                        ros::Duration(0.1), ros::Rate(1.0));
+  TestWatchdog watchdog("base_link", {"left_track", "front_left_flipper"}, tfBuffer, ros::Rate(1.0));
 
   EXPECT_THROW(watchdog.lookupTransform("left_track", ros::Time::now(), ros::Duration(1)), std::runtime_error);
 
@@ -273,6 +459,273 @@ TEST(TfFramesWatchdog, LookupTransform)
   EXPECT_DOUBLE_EQ(1.0, resTf.value().transform.rotation.w);
 }
 
+TEST(TfFramesWatchdog, LookupTransforms)
+{
+  ros::Time::init(); // use system time for this test so that we don't have problems with timeouts
+
+  const std::shared_ptr<tf2_ros::Buffer> tfBuffer(new tf2_ros::Buffer());
+  tfBuffer->setUsingDedicatedThread(true);
+  TestWatchdog watchdog("base_link", {"left_track", "front_left_flipper", "right_track"}, tfBuffer, ros::Rate(1.0));
+
+  std::vector<geometry_msgs::TransformStamped> transforms;
+  std::vector<std::uint8_t> found;
+  EXPECT_THROW(watchdog.lookupTransforms({"left_track"}, ros::Time::now(), ros::Duration(1), transforms, found),
+               std::runtime_error);
+
+  watchdog.started = true; // fake the running thread
+
+  geometry_msgs::TransformStamped tf;
+  tf.header.frame_id = "base_link";
+  tf.transform.rotation.w = 1.0;
+  for (const auto& frame : {"left_track", "front_left_flipper"})
+  {
+    tf.child_frame_id = frame;
+    tf.transform.translation.x += 1.0;
+    for (double d = -5.0; d < 5.0; d += 0.1)
+    {
+      tf.header.stamp = ros::Time::now() + ros::Duration(d);
+      tfBuffer->setTransform(tf, "test");
+    }
+  }
+
+  // left_track is reachable and available, front_left_flipper is available but not marked reachable,
+  // right_track is marked reachable but not available and rear_left_flipper is not monitored
+  watchdog.markReachable("left_track");
+  watchdog.markReachable("right_track");
+  const std::vector<std::string> frames = {"left_track", "front_left_flipper", "right_track", "rear_left_flipper"};
+  const ros::Time time = ros::Time::now();
+  const ros::Time start = ros::Time::now();
+  EXPECT_EQ(1u, watchdog.lookupTransforms(frames, time, ros::Duration(1), transforms, found));
+  const ros::Time end = ros::Time::now();
+  ASSERT_EQ(frames.size(), transforms.size());
+  ASSERT_EQ(frames.size(), found.size());
+  EXPECT_TRUE(found[0]);
+  EXPECT_FALSE(found[1]);
+  EXPECT_FALSE(found[2]);
+  EXPECT_FALSE(found[3]);
+  // frames that are not in the buffer at all fail without waiting for the timeout
+  EXPECT_GE(0.5, (end - start).toSec());
+
+  EXPECT_EQ("base_link", transforms[0].header.frame_id);
+  EXPECT_EQ("left_track", transforms[0].child_frame_id);
+  EXPECT_EQ(time, transforms[0].header.stamp);
+  EXPECT_DOUBLE_EQ(1.0, transforms[0].transform.translation.x);
+
+  EXPECT_TRUE(watchdog.isReachable("left_track"));
+  EXPECT_FALSE(watchdog.isReachable("front_left_flipper"));
+  EXPECT_FALSE(watchdog.isReachable("right_track"));
+  EXPECT_TRUE(watchdog.isMonitored("rear_left_flipper"));
+
+  // all available frames are found once they are reachable
+  watchdog.markReachable("front_left_flipper");
+  EXPECT_EQ(2u, watchdog.lookupTransforms(frames, time, ros::Duration(0.1), transforms, found));
+  EXPECT_TRUE(found[0]);
+  EXPECT_TRUE(found[1]);
+  EXPECT_FALSE(found[2]);
+  EXPECT_FALSE(found[3]);
+  EXPECT_DOUBLE_EQ(1.0, transforms[0].transform.translation.x);
+  EXPECT_DOUBLE_EQ(2.0, transforms[1].transform.translation.x);
+
+  // transforms arriving later than the lookup started are waited for
+  tf.child_frame_id = "right_track";
+  tf.transform.translation.x = 3.0;
+  tf.header.stamp = time - ros::Duration(1.0);
+  tfBuffer->setTransform(tf, "test");
+  watchdog.markReachable("right_track");
+  std::thread publisher([&]()
+  {
+    ros::WallDuration(0.2).sleep();
+    tf.header.stamp = time + ros::Duration(1.0);
+    tfBuffer->setTransform(tf, "test");
+  });
+  EXPECT_EQ(3u, watchdog.lookupTransforms({"left_track", "front_left_flipper", "right_track"}, time,
+                                          ros::Duration(5), transforms, found));
+  publisher.join();
+  EXPECT_TRUE(found[2]);
+  EXPECT_DOUBLE_EQ(3.0, transforms[2].transform.translation.x);
+}
+
+TEST(TfFramesWatchdog, TransformMemo)
+{
+  ros::Time::init(); // use system time for this test so that we don't have problems with timeouts
+
+  const std::shared_ptr<tf2_ros::Buffer> tfBuffer(new tf2_ros::Buffer());
+  tfBuffer->setUsingDedicatedThread(true);
+  TestWatchdog watchdog("base_link", {"left_track", "right_track"}, tfBuffer, ros::Rate(1.0));
+  watchdog.started = true; // fake the running thread
+
+  const auto memo = std::make_shared<TransformMemo>(10);
+  watchdog.setTransformMemo(memo);
+
+  geometry_msgs::TransformStamped tf;
+  tf.header.frame_id = "base_link";
+  tf.child_frame_id = "left_track";
+  tf.transform.translation.x = 1.0;
+  tf.transform.rotation.w = 1.0;
+  for (double d = -5.0; d < 5.0; d += 0.1)
+  {
+    tf.header.stamp = ros::Time::now() + ros::Duration(d);
+    tfBuffer->setTransform(tf, "test");
+  }
+
+  // resolved transforms are memoized
+  watchdog.markReachable("left_track");
+  watchdog.markReachable("right_track");
+  const ros::Time time = ros::Time::now();
+  std::vector<geometry_msgs::TransformStamped> transforms;
+  std::vector<std::uint8_t> found;
+  EXPECT_EQ(1u, watchdog.lookupTransforms({"left_track"}, time, ros::Duration(0.1), transforms, found));
+  EXPECT_EQ(1u, memo->size());
+  geometry_msgs::TransformStamped memoized;
+  ASSERT_TRUE(memo->get("base_link", "left_track", time, memoized));
+  EXPECT_DOUBLE_EQ(1.0, memoized.transform.translation.x);
+
+  // memoized transforms are used without looking into the buffer (e.g. when put there by another watchdog)
+  tf.child_frame_id = "right_track";
+  tf.transform.translation.x = 2.0;
+  memo->put("base_link", "right_track", time, tf);
+  EXPECT_EQ(2u, watchdog.lookupTransforms({"left_track", "right_track"}, time, ros::Duration(0.1), transforms, found));
+  EXPECT_DOUBLE_EQ(1.0, transforms[0].transform.translation.x);
+  EXPECT_DOUBLE_EQ(2.0, transforms[1].transform.translation.x);
+  auto resTf = watchdog.lookupTransform("right_track", time, ros::Duration(0.1));
+  ASSERT_TRUE(resTf.has_value());
+  EXPECT_DOUBLE_EQ(2.0, resTf.value().transform.translation.x);
+
+  // unreachable frames fail even if they are memoized
+  watchdog.markUnreachable("right_track");
+  EXPECT_EQ(1u, watchdog.lookupTransforms({"left_track", "right_track"}, time, ros::Duration(0.1), transforms, found));
+  EXPECT_FALSE(found[1]);
+}
+
+TEST(TfFramesWatchdog, TransformMemoClear)
+{
+  ros::Time::init(); // use system time for this test so that we don't have problems with timeouts
+
+  const std::shared_ptr<tf2_ros::Buffer> tfBuffer(new tf2_ros::Buffer());
+  tfBuffer->setUsingDedicatedThread(true);
+  TestWatchdog watchdog("base_link", {"left_track"}, tfBuffer, ros::Rate(1.0));
+  watchdog.started = true; // fake the running thread
+
+  const auto memo = std::make_shared<TransformMemo>(10);
+  watchdog.setTransformMemo(memo, ros::Duration(0.005));
+
+  geometry_msgs::TransformStamped tf;
+  tf.header.frame_id = "base_link";
+  tf.child_frame_id = "left_track";
+  tf.transform.rotation.w = 1.0;
+  const ros::Time time = ros::Time::now();
+  const auto fillBuffer = [&](const double x)
+  {
+    tf.transform.translation.x = x;
+    for (double d = -5.0; d < 5.0; d += 0.1)
+    {
+      tf.header.stamp = time + ros::Duration(d);
+      tfBuffer->setTransform(tf, "test");
+    }
+  };
+
+  fillBuffer(1.0);
+  watchdog.markReachable("left_track");
+  std::vector<geometry_msgs::TransformStamped> transforms;
+  std::vector<std::uint8_t> found;
+  EXPECT_EQ(1u, watchdog.lookupTransforms({"left_track"}, time, ros::Duration(0.1), transforms, found));
+  EXPECT_DOUBLE_EQ(1.0, transforms[0].transform.translation.x);
+  EXPECT_EQ(1u, memo->size());
+
+  // clearing the buffer also forgets the memoized transforms resolved from it
+  watchdog.clear();
+  EXPECT_EQ(0u, memo->size());
+
+  // e.g. a bag file started playing again with different data
+  fillBuffer(3.0);
+  watchdog.setMonitoredFrames({"left_track"});
+  watchdog.markReachable("left_track");
+  EXPECT_EQ(1u, watchdog.lookupTransforms({"left_track"}, time + ros::Duration(0.003), ros::Duration(0.1),
+                                          transforms, found));
+  EXPECT_DOUBLE_EQ(3.0, transforms[0].transform.translation.x);
+  auto resTf = watchdog.lookupTransform("left_track", time, ros::Duration(0.1));
+  ASSERT_TRUE(resTf.has_value());
+  EXPECT_DOUBLE_EQ(3.0, resTf.value().transform.translation.x);
+}
+
+TEST(TfFramesWatchdog, TransformMemoStampTolerance)
+{
+  ros::Time::init(); // use system time for this test so that we don't have problems with timeouts
+
+  // two watchdogs of filters with unsynchronized sensors share the memo, but their buffers differ so that it is
+  // visible which of them resolved the transform
+  const std::shared_ptr<tf2_ros::Buffer> tfBuffer1(new tf2_ros::Buffer());
+  const std::shared_ptr<tf2_ros::Buffer> tfBuffer2(new tf2_ros::Buffer());
+  tfBuffer1->setUsingDedicatedThread(true);
+  tfBuffer2->setUsingDedicatedThread(true);
+  TestWatchdog watchdog1("base_link", {"left_track"}, tfBuffer1, ros::Rate(1.0));
+  TestWatchdog watchdog2("base_link", {"left_track"}, tfBuffer2, ros::Rate(1.0));
+  watchdog1.started = watchdog2.started = true; // fake the running threads
+
+  const auto memo = std::make_shared<TransformMemo>(10);
+  watchdog1.setTransformMemo(memo, ros::Duration(0.005));
+  watchdog2.setTransformMemo(memo, ros::Duration(0.005));
+
+  geometry_msgs::TransformStamped tf;
+  tf.header.frame_id = "base_link";
+  tf.child_frame_id = "left_track";
+  tf.transform.rotation.w = 1.0;
+  for (double d = -5.0; d < 5.0; d += 0.1)
+  {
+    tf.header.stamp = ros::Time::now() + ros::Duration(d);
+    tf.transform.translation.x = 1.0;
+    tfBuffer1->setTransform(tf, "test");
+    tf.transform.translation.x = 2.0;
+    tfBuffer2->setTransform(tf, "test");
+  }
+
+  watchdog1.markReachable("left_track");
+  watchdog2.markReachable("left_track");
+  const ros::Time time = ros::Time::now();
+  std::vector<geometry_msgs::TransformStamped> transforms;
+  std::vector<std::uint8_t> found;
+  EXPECT_EQ(1u, watchdog1.lookupTransforms({"left_track"}, time, ros::Duration(0.1), transforms, found));
+  EXPECT_DOUBLE_EQ(1.0, transforms[0].transform.translation.x);
+  EXPECT_EQ(1u, memo->size());
+
+  // the second sensor's scan is a few milliseconds later, so it reuses the transform of the first one
+  EXPECT_EQ(1u, watchdog2.lookupTransforms({"left_track"}, time + ros::Duration(0.003), ros::Duration(0.1),
+                                           transforms, found));
+  EXPECT_DOUBLE_EQ(1.0, transforms[0].transform.translation.x);
+  auto resTf = watchdog2.lookupTransform("left_track", time - ros::Duration(0.004), ros::Duration(0.1));
+  ASSERT_TRUE(resTf.has_value());
+  EXPECT_DOUBLE_EQ(1.0, resTf.value().transform.translation.x);
+  EXPECT_EQ(1u, memo->size());
+
+  // stamps further away are looked up in the buffer
+  EXPECT_EQ(1u, watchdog2.lookupTransforms({"left_track"}, time + ros::Duration(0.02), ros::Duration(0.1),
+                                           transforms, found));
+  EXPECT_DOUBLE_EQ(2.0, transforms[0].transform.translation.x);
+  EXPECT_EQ(2u, memo->size());
+
+  // without tolerance, only the exact stamp is reused
+  watchdog2.setTransformMemo(memo);
+  EXPECT_EQ(1u, watchdog2.lookupTransforms({"left_track"}, time + ros::Duration(0.003), ros::Duration(0.1),
+                                           transforms, found));
+  EXPECT_DOUBLE_EQ(2.0, transforms[0].transform.translation.x);
+  EXPECT_EQ(1u, watchdog2.lookupTransforms({"left_track"}, time, ros::Duration(0.1), transforms, found));
+  EXPECT_DOUBLE_EQ(1.0, transforms[0].transform.translation.x);
+}
+
+TEST(TfFramesWatchdog, DeprecatedConstructor)
+{
+  const std::shared_ptr<tf2_ros::Buffer> tfBuffer(new tf2_ros::Buffer());
+
+  // the unreachable lookup timeout is ignored, the other arguments keep working
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+  TFFramesWatchdog watchdog("base_link", {"left_track"}, tfBuffer, ros::Duration(0.2), ros::Rate(2.0));
+#pragma GCC diagnostic pop
+
+  EXPECT_TRUE(watchdog.isMonitored("left_track"));
+  EXPECT_FALSE(watchdog.isReachable("left_track"));
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,72 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include <robot_body_filter/utils/thread_pool.h>
+
+using namespace robot_body_filter;
+
+TEST(ThreadPool, NumThreads)
+{
+  const size_t numCores = std::max(1u, std::thread::hardware_concurrency());
+
+  EXPECT_EQ(1u, ThreadPool(1).getNumThreads());
+  EXPECT_EQ(std::min(size_t(2), numCores), ThreadPool(2).getNumThreads());
+  EXPECT_EQ(std::max(size_t(1), numCores - 1), ThreadPool(0).getNumThreads());
+  // the number of threads is capped by the number of cores
+  EXPECT_EQ(numCores, ThreadPool(numCores + 10).getNumThreads());
+}
+
+TEST(ThreadPool, ParallelFor)
+{
+  ThreadPool pool(4);
+
+  // run each task exactly once, also with less tasks than threads and with unbalanced tasks
+  for (size_t numTasks : {0, 1, 3, 4, 100, 1000})
+  {
+    std::vector<std::atomic<size_t>> runs(numTasks);
+    for (auto& run : runs)
+      run = 0;
+
+    pool.parallelFor(numTasks, [&](const size_t task, const size_t thread)
+    {
+      EXPECT_GT(pool.getNumThreads(), thread);
+      if (task < numTasks / 10)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      runs[task]++;
+    });
+
+    for (size_t i = 0; i < numTasks; ++i)
+      EXPECT_EQ(1u, runs[i]) << "Task " << i << " of " << numTasks;
+  }
+}
+
+TEST(ThreadPool, Exception)
+{
+  ThreadPool pool(4);
+  std::atomic<size_t> numRuns {0};
+
+  EXPECT_THROW(pool.parallelFor(100, [&](const size_t task, const size_t)
+  {
+    numRuns++;
+    if (task == 50)
+      throw std::runtime_error("test");
+  }), std::runtime_error);
+  // the other tasks have still been run
+  EXPECT_EQ(100u, numRuns);
+
+  // the pool is usable after an exception
+  numRuns = 0;
+  pool.parallelFor(10, [&](const size_t, const size_t) { numRuns++; });
+  EXPECT_EQ(10u, numRuns);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,169 @@
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+#include <robot_body_filter/utils/transform_memo.h>
+
+using namespace robot_body_filter;
+
+namespace
+{
+
+geometry_msgs::TransformStamped createTransform(const double x)
+{
+  geometry_msgs::TransformStamped transform;
+  transform.transform.translation.x = x;
+  transform.transform.rotation.w = 1.0;
+  return transform;
+}
+
+}
+
+TEST(TransformMemo, GetPut)
+{
+  TransformMemo memo(10);
+  EXPECT_EQ(10u, memo.getCapacity());
+  EXPECT_EQ(0u, memo.size());
+
+  geometry_msgs::TransformStamped transform;
+  EXPECT_FALSE(memo.get("base_link", "arm", ros::Time(1), transform));
+
+  memo.put("base_link", "arm", ros::Time(1), createTransform(1.0));
+  memo.put("base_link", "arm", ros::Time(2), createTransform(2.0));
+  memo.put("odom", "arm", ros::Time(1), createTransform(3.0));
+  EXPECT_EQ(3u, memo.size());
+
+  ASSERT_TRUE(memo.get("base_link", "arm", ros::Time(1), transform));
+  EXPECT_DOUBLE_EQ(1.0, transform.transform.translation.x);
+  ASSERT_TRUE(memo.get("base_link", "arm", ros::Time(2), transform));
+  EXPECT_DOUBLE_EQ(2.0, transform.transform.translation.x);
+  ASSERT_TRUE(memo.get("odom", "arm", ros::Time(1), transform));
+  EXPECT_DOUBLE_EQ(3.0, transform.transform.translation.x);
+  EXPECT_FALSE(memo.get("base_link", "arm", ros::Time(3), transform));
+  EXPECT_FALSE(memo.get("arm", "base_link", ros::Time(1), transform));
+
+  // putting an existing key replaces the transform
+  memo.put("base_link", "arm", ros::Time(1), createTransform(4.0));
+  EXPECT_EQ(3u, memo.size());
+  ASSERT_TRUE(memo.get("base_link", "arm", ros::Time(1), transform));
+  EXPECT_DOUBLE_EQ(4.0, transform.transform.translation.x);
+
+  // the latest transform changes over time, so it is not memoized
+  memo.put("base_link", "arm", ros::Time(0), createTransform(5.0));
+  EXPECT_EQ(3u, memo.size());
+  EXPECT_FALSE(memo.get("base_link", "arm", ros::Time(0), transform));
+
+  memo.clear();
+  EXPECT_EQ(0u, memo.size());
+  EXPECT_FALSE(memo.get("base_link", "arm", ros::Time(1), transform));
+}
+
+TEST(TransformMemo, LeastRecentlyUsed)
+{
+  TransformMemo memo(3);
+  memo.put("base_link", "a", ros::Time(1), createTransform(1.0));
+  memo.put("base_link", "b", ros::Time(1), createTransform(2.0));
+  memo.put("base_link", "c", ros::Time(1), createTransform(3.0));
+
+  // a is used, so b is the least recently used one
+  geometry_msgs::TransformStamped transform;
+  EXPECT_TRUE(memo.get("base_link", "a", ros::Time(1), transform));
+  memo.put("base_link", "d", ros::Time(1), createTransform(4.0));
+  EXPECT_EQ(3u, memo.size());
+  EXPECT_TRUE(memo.get("base_link", "a", ros::Time(1), transform));
+  EXPECT_FALSE(memo.get("base_link", "b", ros::Time(1), transform));
+  EXPECT_TRUE(memo.get("base_link", "c", ros::Time(1), transform));
+  EXPECT_TRUE(memo.get("base_link", "d", ros::Time(1), transform));
+
+  // shrinking drops the least recently used entries
+  memo.setCapacity(1);
+  EXPECT_EQ(1u, memo.size());
+  EXPECT_TRUE(memo.get("base_link", "d", ros::Time(1), transform));
+
+  // reserving never shrinks
+  memo.reserveCapacity(5);
+  EXPECT_EQ(5u, memo.getCapacity());
+  memo.reserveCapacity(2);
+  EXPECT_EQ(5u, memo.getCapacity());
+
+  // zero capacity disables the memo
+  memo.setCapacity(0);
+  memo.put("base_link", "a", ros::Time(1), createTransform(1.0));
+  EXPECT_EQ(0u, memo.size());
+  EXPECT_FALSE(memo.get("base_link", "a", ros::Time(1), transform));
+}
+
+TEST(TransformMemo, StampTolerance)
+{
+  TransformMemo memo(10);
+  memo.put("base_link", "arm", ros::Time(1.0), createTransform(1.0));
+  memo.put("base_link", "arm", ros::Time(1.1), createTransform(2.0));
+  memo.put("odom", "arm", ros::Time(1.05), createTransform(3.0));
+
+  // the closest stamp within the tolerance is used
+  geometry_msgs::TransformStamped transform;
+  EXPECT_FALSE(memo.get("base_link", "arm", ros::Time(1.01), transform));
+  ASSERT_TRUE(memo.get("base_link", "arm", ros::Time(1.01), ros::Duration(0.02), transform));
+  EXPECT_DOUBLE_EQ(1.0, transform.transform.translation.x);
+  ASSERT_TRUE(memo.get("base_link", "arm", ros::Time(0.99), ros::Duration(0.02), transform));
+  EXPECT_DOUBLE_EQ(1.0, transform.transform.translation.x);
+  ASSERT_TRUE(memo.get("base_link", "arm", ros::Time(1.04), ros::Duration(0.1), transform));
+  EXPECT_DOUBLE_EQ(1.0, transform.transform.translation.x);
+  ASSERT_TRUE(memo.get("base_link", "arm", ros::Time(1.06), ros::Duration(0.1), transform));
+  EXPECT_DOUBLE_EQ(2.0, transform.transform.translation.x);
+  ASSERT_TRUE(memo.get("base_link", "arm", ros::Time(1.2), ros::Duration(0.1), transform));
+  EXPECT_DOUBLE_EQ(2.0, transform.transform.translation.x);
+  EXPECT_FALSE(memo.get("base_link", "arm", ros::Time(1.05), ros::Duration(0.04), transform));
+  EXPECT_FALSE(memo.get("base_link", "arm", ros::Time(1.3), ros::Duration(0.1), transform));
+  EXPECT_FALSE(memo.get("arm", "base_link", ros::Time(1.0), ros::Duration(0.1), transform));
+
+  // forgetting the least recently used entries keeps the other stamps of the same frames
+  memo.setCapacity(2);
+  EXPECT_EQ(2u, memo.size());
+  EXPECT_FALSE(memo.get("odom", "arm", ros::Time(1.05), ros::Duration(0.1), transform));
+  ASSERT_TRUE(memo.get("base_link", "arm", ros::Time(1.0), transform));
+  EXPECT_DOUBLE_EQ(1.0, transform.transform.translation.x);
+  memo.setCapacity(1);
+  EXPECT_FALSE(memo.get("base_link", "arm", ros::Time(1.1), transform));
+  ASSERT_TRUE(memo.get("base_link", "arm", ros::Time(1.1), ros::Duration(0.1), transform));
+  EXPECT_DOUBLE_EQ(1.0, transform.transform.translation.x);
+}
+
+TEST(TransformMemo, ProcessWide)
+{
+  const auto& memo = TransformMemo::getProcessWide();
+  ASSERT_NE(nullptr, memo);
+  EXPECT_EQ(memo, TransformMemo::getProcessWide());
+  EXPECT_EQ(0u, memo->getCapacity());
+}
+
+TEST(TransformMemo, Threads)
+{
+  TransformMemo memo(100);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 4; ++t)
+  {
+    threads.emplace_back([&memo, t]()
+    {
+      geometry_msgs::TransformStamped transform;
+      for (size_t i = 0; i < 1000; ++i)
+      {
+        const ros::Time stamp(1.0 + static_cast<double>(i % 200));
+        if (!memo.get("base_link", "arm", stamp, transform))
+          memo.put("base_link", "arm", stamp, createTransform(static_cast<double>(i % 200)));
+        else
+          EXPECT_DOUBLE_EQ(static_cast<double>(i % 200), transform.transform.translation.x);
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(100u, memo.size());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,140 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <memory>
+
+#include <geometric_shapes/mesh_operations.h>
+#include <robot_body_filter/utils/triangle_mesh_hierarchy.h>
+
+using namespace robot_body_filter;
+
+namespace
+{
+
+// UV sphere with the given number of rings and segments
+shapes::Mesh* createSphereMesh(const double radius, const unsigned int rings, const unsigned int segments)
+{
+  EigenSTL::vector_Vector3d vertices;
+  std::vector<unsigned int> triangles;
+  vertices.emplace_back(0.0, 0.0, radius);
+  for (unsigned int r = 1; r < rings; ++r)
+  {
+    const auto theta = M_PI * r / rings;
+    for (unsigned int s = 0; s < segments; ++s)
+    {
+      const auto phi = 2 * M_PI * s / segments;
+      vertices.emplace_back(radius * std::sin(theta) * std::cos(phi), radius * std::sin(theta) * std::sin(phi),
+                            radius * std::cos(theta));
+    }
+  }
+  vertices.emplace_back(0.0, 0.0, -radius);
+
+  const auto ringVertex = [&](const unsigned int r, const unsigned int s) { return 1 + (r - 1) * segments + s % segments; };
+  const auto last = static_cast<unsigned int>(vertices.size() - 1);
+  for (unsigned int s = 0; s < segments; ++s)
+  {
+    triangles.insert(triangles.end(), {0, ringVertex(1, s), ringVertex(1, s + 1)});
+    for (unsigned int r = 1; r + 1 < rings; ++r)
+    {
+      triangles.insert(triangles.end(), {ringVertex(r, s), ringVertex(r + 1, s), ringVertex(r + 1, s + 1)});
+      triangles.insert(triangles.end(), {ringVertex(r, s), ringVertex(r + 1, s + 1), ringVertex(r, s + 1)});
+    }
+    triangles.insert(triangles.end(), {last, ringVertex(rings - 1, s + 1), ringVertex(rings - 1, s)});
+  }
+
+  return shapes::createMeshFromVertices(vertices, triangles);
+}
+
+// compare the hierarchy with the shadow test done by intersectsRay()
+void expectSameAsIntersectsRay(const bodies::ConvexMesh& body, const double range)
+{
+  const TriangleMeshHierarchy hierarchy(body);
+  const Eigen::Isometry3d inversePose = body.getPose().inverse();
+
+  size_t numHits = 0;
+  EigenSTL::vector_Vector3d intersections;
+  for (size_t i = 0; i < 10000; ++i)
+  {
+    const Eigen::Vector3d start = body.getPose() * (Eigen::Vector3d::Random() * range);
+    const Eigen::Vector3d end = body.getPose() * (Eigen::Vector3d::Random() * range);
+    const auto length = (end - start).norm();
+    const Eigen::Vector3d dir = (end - start) / length;
+
+    intersections.clear();
+    const auto expected = body.intersectsRay(start, dir, &intersections, 1) &&
+      dir.dot(end - intersections[0]) >= 0.0;
+    const auto hit = hierarchy.intersectsSegment(inversePose * start, inversePose.linear() * dir, length);
+    EXPECT_EQ(expected, hit) << start.transpose() << " -> " << end.transpose();
+    if (hit)
+      numHits++;
+  }
+  EXPECT_LT(0, numHits);
+}
+
+}
+
+TEST(TriangleMeshHierarchy, Box)
+{
+  // box (1.0, 2.0, 3.0)
+  const std::unique_ptr<const shapes::Shape> shape(shapes::createMeshFromResource(
+      "package://robot_body_filter/test/box.dae"));
+  bodies::ConvexMesh body(shape.get());
+  body.setPose(Eigen::Translation3d(1.0, 2.0, 3.0) * Eigen::AngleAxisd(0.5, Eigen::Vector3d(1, 2, 3).normalized()));
+
+  const TriangleMeshHierarchy hierarchy(body);
+  EXPECT_EQ(12u, hierarchy.getNumTriangles());
+
+  // the segments are given in the body frame
+  EXPECT_TRUE(hierarchy.intersectsSegment({-2.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, 4.0));
+  EXPECT_TRUE(hierarchy.intersectsSegment({-2.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, 1.6));
+  EXPECT_FALSE(hierarchy.intersectsSegment({-2.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, 1.4));
+  EXPECT_FALSE(hierarchy.intersectsSegment({-2.0, 0.0, 0.0}, {-1.0, 0.0, 0.0}, 4.0));
+  EXPECT_FALSE(hierarchy.intersectsSegment({-2.0, 1.1, 0.0}, {1.0, 0.0, 0.0}, 4.0));
+  // segments starting inside the body cross its surface when leaving it
+  EXPECT_TRUE(hierarchy.intersectsSegment({0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, 2.0));
+  EXPECT_FALSE(hierarchy.intersectsSegment({0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, 1.0));
+  // the direction doesn't need to be normalized
+  EXPECT_TRUE(hierarchy.intersectsSegment({-2.0, 0.0, 0.0}, {2.0, 0.0, 0.0}, 0.8));
+  EXPECT_FALSE(hierarchy.intersectsSegment({-2.0, 0.0, 0.0}, {2.0, 0.0, 0.0}, 0.7));
+  // rays through the edges don't slip between the triangles
+  EXPECT_TRUE(hierarchy.intersectsSegment({-2.0, 1.0, 1.5}, {1.0, 0.0, 0.0}, 4.0));
+  EXPECT_TRUE(hierarchy.intersectsSegment({-2.0, 0.0, 0.0}, {1.5, 1.0, 0.0}, 2.0));
+
+  expectSameAsIntersectsRay(body, 3.0);
+}
+
+TEST(TriangleMeshHierarchy, DetailedMesh)
+{
+  const std::unique_ptr<const shapes::Shape> shape(createSphereMesh(0.5, 40, 60));
+  bodies::ConvexMesh body(shape.get());
+  body.setPose(Eigen::Translation3d(-1.0, 0.0, 2.0) * Eigen::AngleAxisd(1.0, Eigen::Vector3d::UnitY()));
+
+  const TriangleMeshHierarchy hierarchy(body);
+  EXPECT_LT(1000u, hierarchy.getNumTriangles());
+
+  expectSameAsIntersectsRay(body, 1.0);
+}
+
+TEST(TriangleMeshHierarchy, ScaledAndPadded)
+{
+  const std::unique_ptr<const shapes::Shape> shape(shapes::createMeshFromResource(
+      "package://robot_body_filter/test/box.dae"));
+  bodies::ConvexMesh body(shape.get());
+  body.setScale(2.0);
+  body.setPadding(0.1);
+
+  // the hierarchy contains the scaled and padded mesh
+  const TriangleMeshHierarchy hierarchy(body);
+  Eigen::AlignedBox3d box;
+  for (const auto& vertex : body.getScaledVertices())
+    box.extend(vertex);
+  EXPECT_TRUE(hierarchy.intersectsSegment({box.min().x() - 0.1, 0.0, 0.0}, {1.0, 0.0, 0.0}, 0.11));
+  EXPECT_FALSE(hierarchy.intersectsSegment({box.min().x() - 0.1, 0.0, 0.0}, {1.0, 0.0, 0.0}, 0.09));
+  EXPECT_FALSE(hierarchy.intersectsSegment({-1.1, 0.0, 0.0}, {0.0, 1.0, 0.0}, 0.5));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,136 @@
+#include "gtest/gtest.h"
+
+#include <memory>
+
+#include <geometric_shapes/mesh_operations.h>
+#include <robot_body_filter/utils/voxel_occupancy_grid.h>
+
+using namespace robot_body_filter;
+
+TEST(VoxelOccupancyGrid, MatchesContainsPoint)
+{
+  // box (1.0, 2.0, 3.0)
+  const std::unique_ptr<const shapes::Shape> shape(shapes::createMeshFromResource(
+      "package://robot_body_filter/test/box.dae"));
+
+  for (const auto scale : {1.0, 1.3, 0.7})
+  {
+    for (const auto padding : {0.0, 0.05})
+    {
+      bodies::ConvexMesh body(shape.get());
+      body.setScale(scale);
+      body.setPadding(padding);
+
+      for (const auto resolution : {0.01, 0.05, 0.3})
+      {
+        const VoxelOccupancyGrid grid(body, resolution);
+        EXPECT_DOUBLE_EQ(resolution, grid.getResolution());
+
+        // points in INSIDE and OUTSIDE voxels have to be classified exactly
+        size_t numInside = 0, numOutside = 0;
+        for (size_t i = 0; i < 10000; ++i)
+        {
+          const Eigen::Vector3d point = Eigen::Vector3d::Random() * 2.5;
+          const auto occupancy = grid.getOccupancy(point);
+          if (occupancy == VoxelOccupancyGrid::Occupancy::SURFACE)
+            continue;
+
+          const auto inside = occupancy == VoxelOccupancyGrid::Occupancy::INSIDE;
+          EXPECT_EQ(body.containsPoint(point), inside) << point.transpose() << ", scale " << scale
+            << ", padding " << padding << ", resolution " << resolution;
+          (inside ? numInside : numOutside)++;
+        }
+        EXPECT_LT(0, numInside);
+        EXPECT_LT(0, numOutside);
+      }
+    }
+  }
+}
+
+TEST(VoxelOccupancyGrid, MatchesContainsPointSharpMesh)
+{
+  // a thin tetrahedron with a sharp vertex at (1, 0, 0); the padded body reaches far beyond this vertex
+  const EigenSTL::vector_Vector3d vertices = {{0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.1, 0.0}, {0.0, 0.0, 0.1}};
+  const std::vector<unsigned int> triangles = {0, 2, 1, 0, 1, 3, 0, 3, 2, 1, 2, 3};
+  const std::unique_ptr<const shapes::Shape> shape(shapes::createMeshFromVertices(vertices, triangles));
+
+  for (const auto scale : {1.0, 1.3, 0.7})
+  {
+    for (const auto padding : {0.05, 0.2})
+    {
+      bodies::ConvexMesh body(shape.get());
+      body.setScale(scale);
+      body.setPadding(padding);
+
+      // the mesh is scaled around the center of its vertices
+      const Eigen::Vector3d meshCenter(0.25, 0.025, 0.025);
+      const Eigen::Vector3d sharpVertex = meshCenter + (Eigen::Vector3d::UnitX() - meshCenter) * scale;
+
+      // coarse voxels hardly fit in the thin body, so the INSIDE voxels are counted over all resolutions
+      size_t numInside = 0, numOutside = 0;
+      for (const auto resolution : {0.01, 0.05})
+      {
+        const VoxelOccupancyGrid grid(body, resolution);
+
+        // points in INSIDE and OUTSIDE voxels have to be classified exactly, also around the sharp vertex
+        for (size_t i = 0; i < 20000; ++i)
+        {
+          const Eigen::Vector3d center = (i % 2 == 0) ? Eigen::Vector3d(0.6, 0.0, 0.0) : sharpVertex;
+          const auto range = (i % 2 == 0) ? 1.0 : 3.0 * padding;
+          const Eigen::Vector3d point = center + Eigen::Vector3d::Random() * range;
+          const auto occupancy = grid.getOccupancy(point);
+          if (occupancy == VoxelOccupancyGrid::Occupancy::SURFACE)
+            continue;
+
+          const auto inside = occupancy == VoxelOccupancyGrid::Occupancy::INSIDE;
+          EXPECT_EQ(body.containsPoint(point), inside) << point.transpose() << ", scale " << scale
+            << ", padding " << padding << ", resolution " << resolution;
+          (inside ? numInside : numOutside)++;
+        }
+      }
+      EXPECT_LT(0, numInside);
+      EXPECT_LT(0, numOutside);
+    }
+  }
+}
+
+TEST(VoxelOccupancyGrid, PoseIsIgnored)
+{
+  const std::unique_ptr<const shapes::Shape> shape(shapes::createMeshFromResource(
+      "package://robot_body_filter/test/box.dae"));
+  bodies::ConvexMesh body(shape.get());
+  body.setPose(Eigen::Isometry3d(Eigen::Translation3d(10.0, 0.0, 0.0)));
+
+  const VoxelOccupancyGrid grid(body, 0.05);
+  EXPECT_EQ(VoxelOccupancyGrid::Occupancy::INSIDE, grid.getOccupancy({0.0, 0.0, 0.0}));
+  EXPECT_EQ(VoxelOccupancyGrid::Occupancy::OUTSIDE, grid.getOccupancy({10.0, 0.0, 0.0}));
+}
+
+TEST(VoxelOccupancyGrid, OutsideGrid)
+{
+  const std::unique_ptr<const shapes::Shape> shape(shapes::createMeshFromResource(
+      "package://robot_body_filter/test/box.dae"));
+  bodies::ConvexMesh body(shape.get());
+
+  const VoxelOccupancyGrid grid(body, 0.1);
+  EXPECT_EQ(VoxelOccupancyGrid::Occupancy::OUTSIDE, grid.getOccupancy({100.0, 0.0, 0.0}));
+  EXPECT_EQ(VoxelOccupancyGrid::Occupancy::OUTSIDE, grid.getOccupancy({0.0, -100.0, 0.0}));
+  EXPECT_EQ(VoxelOccupancyGrid::Occupancy::OUTSIDE, grid.getOccupancy({0.0, 0.0, NAN}));
+}
+
+TEST(VoxelOccupancyGrid, CoarsenTooFineGrid)
+{
+  const std::unique_ptr<const shapes::Shape> shape(shapes::createMeshFromResource(
+      "package://robot_body_filter/test/box.dae"));
+  bodies::ConvexMesh body(shape.get());
+
+  const VoxelOccupancyGrid grid(body, 1e-4);
+  EXPECT_LT(1e-4, grid.getResolution());
+  EXPECT_GE(VoxelOccupancyGrid::MAX_VOXELS, static_cast<size_t>(grid.getSize().prod()));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}